@@ -7,6 +7,8 @@
 #include "Row.hpp"
 #include "textBuffer.hpp"
 
+#include <til/hash.h>
+
 static std::atomic<uint64_t> s_revision{ 0 };
 
 ImageSlice::ImageSlice(const til::size cellSize) noexcept :
@@ -38,6 +40,11 @@ til::CoordType ImageSlice::ColumnOffset() const noexcept
     return _columnBegin;
 }
 
+til::CoordType ImageSlice::ColumnEnd() const noexcept
+{
+    return _columnEnd;
+}
+
 til::CoordType ImageSlice::PixelWidth() const noexcept
 {
     return _pixelWidth;
@@ -45,23 +52,28 @@ til::CoordType ImageSlice::PixelWidth() const noexcept
 
 std::span<const RGBQUAD> ImageSlice::Pixels() const noexcept
 {
-    return _pixelBuffer;
+    if (!_pixelBuffer)
+    {
+        return {};
+    }
+    return *_pixelBuffer;
 }
 
 const RGBQUAD* ImageSlice::Pixels(const til::CoordType columnBegin) const noexcept
 {
     const auto pixelOffset = (columnBegin - _columnBegin) * _cellSize.width;
-    return &til::at(_pixelBuffer, pixelOffset);
+    return &til::at(*_pixelBuffer, pixelOffset);
 }
 
 RGBQUAD* ImageSlice::MutablePixels(const til::CoordType columnBegin, const til::CoordType columnEnd)
 {
+    const auto existingData = _pixelBuffer && !_pixelBuffer->empty();
+
     // IF the buffer is empty or isn't large enough for the requested range, we'll need to resize it.
-    if (_pixelBuffer.empty() || columnBegin < _columnBegin || columnEnd > _columnEnd)
+    if (!existingData || columnBegin < _columnBegin || columnEnd > _columnEnd)
     {
         const auto oldColumnBegin = _columnBegin;
         const auto oldPixelWidth = _pixelWidth;
-        const auto existingData = !_pixelBuffer.empty();
         _columnBegin = existingData ? std::min(_columnBegin, columnBegin) : columnBegin;
         _columnEnd = existingData ? std::max(_columnEnd, columnEnd) : columnEnd;
         _pixelWidth = (_columnEnd - _columnBegin) * _cellSize.width;
@@ -71,10 +83,11 @@ RGBQUAD* ImageSlice::MutablePixels(const til::CoordType columnBegin, const til::
         {
             // If there is existing data in the buffer, we need to copy it
             // across to the appropriate position in the new buffer.
-            auto newPixelBuffer = std::vector<RGBQUAD>(bufferSize);
+            // Since this creates a new tile anyway, there's no need for _makeTileUnique().
+            auto newPixelBuffer = std::make_shared<Tile>(bufferSize);
             const auto newPixelOffset = (oldColumnBegin - _columnBegin) * _cellSize.width;
-            auto newIterator = std::next(newPixelBuffer.data(), newPixelOffset);
-            auto oldIterator = _pixelBuffer.data();
+            auto newIterator = std::next(newPixelBuffer->data(), newPixelOffset);
+            auto oldIterator = _pixelBuffer->data();
             // Because widths are rounded up to multiples of 4, it's possible
             // that the old width will extend past the right border of the new
             // buffer, so the range that we copy must be clamped to fit.
@@ -90,11 +103,24 @@ RGBQUAD* ImageSlice::MutablePixels(const til::CoordType columnBegin, const til::
         else
         {
             // Otherwise we just initialize the buffer to the correct size.
-            _pixelBuffer.resize(bufferSize);
+            _pixelBuffer = std::make_shared<Tile>(bufferSize);
         }
     }
+    else
+    {
+        _makeTileUnique();
+    }
     const auto pixelOffset = (columnBegin - _columnBegin) * _cellSize.width;
-    return &til::at(_pixelBuffer, pixelOffset);
+    return &til::at(*_pixelBuffer, pixelOffset);
+}
+
+// Ensures that this slice is the only owner of its pixels before they get modified.
+void ImageSlice::_makeTileUnique()
+{
+    if (_pixelBuffer && _pixelBuffer.use_count() > 1)
+    {
+        _pixelBuffer = std::make_shared<Tile>(*_pixelBuffer);
+    }
 }
 
 void ImageSlice::CopyBlock(const TextBuffer& srcBuffer, const til::rect srcRect, TextBuffer& dstBuffer, const til::rect dstRect)
@@ -167,6 +193,20 @@ bool ImageSlice::_copyCells(const ImageSlice& srcSlice, const til::CoordType src
     const auto dstUsedBegin = std::max(dstColumnBegin, _columnBegin);
     const auto dstUsedEnd = std::max(std::min(dstColumnEnd, _columnEnd), dstUsedBegin);
 
+    // If the entire source image is copied to the same columns, and it replaces everything in the
+    // destination, we can simply share the source pixels. This is the common case when scrolling.
+    const auto srcComplete = srcUsedBegin == srcSlice._columnBegin && srcUsedEnd == srcSlice._columnEnd;
+    const auto dstReplaced = !_pixelBuffer || (dstUsedBegin == _columnBegin && dstUsedEnd == _columnEnd);
+    if (srcColumn == dstColumnBegin && srcSlice._pixelBuffer && srcUsedBegin < srcUsedEnd && srcComplete && dstReplaced)
+    {
+        _pixelBuffer = srcSlice._pixelBuffer;
+        _cellSize = srcSlice._cellSize;
+        _columnBegin = srcSlice._columnBegin;
+        _columnEnd = srcSlice._columnEnd;
+        _pixelWidth = srcSlice._pixelWidth;
+        return false;
+    }
+
     // The used source projected into the destination is the range we must overwrite.
     const auto projectedOffset = dstColumnBegin - srcColumn;
     const auto dstWriteBegin = srcUsedBegin + projectedOffset;
@@ -247,9 +287,10 @@ bool ImageSlice::_eraseCells(const til::CoordType columnBegin, const til::CoordT
         const auto eraseEnd = std::min(columnEnd, _columnEnd);
         if (eraseBegin < eraseEnd)
         {
+            _makeTileUnique();
             const auto eraseOffset = (eraseBegin - _columnBegin) * _cellSize.width;
             const auto eraseLength = (eraseEnd - eraseBegin) * _cellSize.width;
-            auto eraseIterator = std::next(_pixelBuffer.data(), eraseOffset);
+            auto eraseIterator = std::next(_pixelBuffer->data(), eraseOffset);
             for (auto y = 0; y < _cellSize.height; y++)
             {
                 std::memset(eraseIterator, 0, eraseLength * sizeof(RGBQUAD));
@@ -259,3 +300,48 @@ bool ImageSlice::_eraseCells(const til::CoordType columnBegin, const til::CoordT
         return false;
     }
 }
+
+// Replaces the pixels of the given slice with an identical, existing tile if there is one.
+// Otherwise, the slice's pixels are added to the table for future lookups.
+void ImageTileTable::Deduplicate(ImageSlice& slice)
+{
+    const auto tile = slice._pixelBuffer;
+    if (!tile || tile->empty())
+    {
+        return;
+    }
+
+    const auto byteCount = tile->size() * sizeof(RGBQUAD);
+    const auto hash = til::hash(tile->data(), byteCount);
+    auto& entry = _tiles[hash];
+
+    // The entry may be expired, belong to a different image with a colliding hash, or it may even have
+    // been modified in place after it was added (which is allowed if its only owner was the slice itself).
+    // In either case we simply replace it with the new tile.
+    if (const auto existing = entry.lock(); existing && existing != tile && existing->size() == tile->size() && memcmp(existing->data(), tile->data(), byteCount) == 0)
+    {
+        slice._pixelBuffer = existing;
+    }
+    else
+    {
+        entry = tile;
+    }
+
+    if (_tiles.size() >= _pruneThreshold)
+    {
+        _prune();
+    }
+}
+
+size_t ImageTileTable::Size() const noexcept
+{
+    return _tiles.size();
+}
+
+// Removes all expired entries. The threshold is doubled after each pass, so that
+// the cost of pruning is amortized over the number of Deduplicate() calls.
+void ImageTileTable::_prune() noexcept
+{
+    std::erase_if(_tiles, [](const auto& pair) { return pair.second.expired(); });
+    _pruneThreshold = std::max<size_t>(64, _tiles.size() * 2);
+}
@@ -7,21 +7,27 @@ Module Name:
 
 Abstract:
 - This serves as a structure to represent a slice of an image covering one textbuffer row.
+- The pixels are refcounted and shared between copies of a slice. They're only
+  copied when a slice that shares them is about to be modified (copy-on-write).
 --*/
 
 #pragma once
 
 #include "til.h"
+#include <memory>
 #include <span>
+#include <unordered_map>
 #include <vector>
 
 class ROW;
 class TextBuffer;
+class ImageTileTable;
 
 class ImageSlice
 {
 public:
     using Pointer = std::unique_ptr<ImageSlice>;
+    using Tile = std::vector<RGBQUAD>;
 
     ImageSlice(const ImageSlice& rhs) = default;
     ImageSlice(const til::size cellSize) noexcept;
@@ -31,6 +37,7 @@ public:
 
     til::size CellSize() const noexcept;
     til::CoordType ColumnOffset() const noexcept;
+    til::CoordType ColumnEnd() const noexcept;
     til::CoordType PixelWidth() const noexcept;
 
     std::span<const RGBQUAD> Pixels() const noexcept;
@@ -45,13 +52,32 @@ public:
     static void EraseCells(ROW& row, const til::CoordType columnBegin, const til::CoordType columnEnd);
 
 private:
+    friend class ImageTileTable;
+
+    void _makeTileUnique();
     bool _copyCells(const ImageSlice& srcSlice, const til::CoordType srcColumn, const til::CoordType dstColumnBegin, const til::CoordType dstColumnEnd);
     bool _eraseCells(const til::CoordType columnBegin, const til::CoordType columnEnd);
 
     uint64_t _revision = 0;
     til::size _cellSize;
-    std::vector<RGBQUAD> _pixelBuffer;
+    std::shared_ptr<Tile> _pixelBuffer;
     til::CoordType _columnBegin = 0;
     til::CoordType _columnEnd = 0;
     til::CoordType _pixelWidth = 0;
 };
+
+// Deduplicates the pixels of ImageSlices by their contents. Each TextBuffer owns one of these, so that
+// an application which repeatedly draws the same image (for instance a plot) only keeps 1 copy in memory.
+// The table only holds weak references, so it doesn't prevent unused tiles from being freed.
+class ImageTileTable
+{
+public:
+    void Deduplicate(ImageSlice& slice);
+    size_t Size() const noexcept;
+
+private:
+    void _prune() noexcept;
+
+    std::unordered_map<size_t, std::weak_ptr<ImageSlice::Tile>> _tiles;
+    size_t _pruneThreshold = 64;
+};
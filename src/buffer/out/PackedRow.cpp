@@ -0,0 +1,244 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include "PackedRow.hpp"
+
+#pragma warning(disable : 26481) // Don't use pointer arithmetic. Use span instead (bounds.1).
+#pragma warning(disable : 26490) // Don't use reinterpret_cast (type.1).
+
+// Packs the contents of the given row. The row's image slice is moved into the
+// returned PackedRow, but the row is otherwise left untouched. It's expected
+// that the caller destroys or resets the row afterwards.
+PackedRow PackedRow::Pack(ROW& row)
+{
+    const auto layout = _layout(row);
+
+    PackedRow packed;
+    packed._data = std::make_unique_for_overwrite<std::byte[]>(layout.size);
+    packed._size = layout.size;
+    packed._generation = row._generation;
+    packed._scrollbarData = row._promptData;
+    packed._imageSlice = std::move(row._imageSlice);
+
+    _write(row, layout, packed._data.get());
+    return packed;
+}
+
+// Appends the encoding that Pack() uses to `out`. Unlike Pack() it leaves the row untouched and
+// only encodes the contents of the row itself: The generation, marks and images aren't included.
+void PackedRow::Encode(const ROW& row, std::vector<std::byte>& out)
+{
+    const auto layout = _layout(row);
+    const auto offset = out.size();
+    out.resize(offset + layout.size);
+    _write(row, layout, out.data() + offset);
+}
+
+// Recreates a PackedRow from the output of Encode(). Since the data may come from a file, it gets validated to the
+// extent that Unpack() and the resulting ROW can't access memory out of bounds. Throws if the data is invalid.
+PackedRow PackedRow::Decode(std::span<const std::byte> data, const uint16_t columnCount, const size_t attributeCount)
+{
+    static constexpr auto invalidData = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+    THROW_HR_IF(invalidData, data.size() < sizeof(Header));
+    Header header;
+    memcpy(&header, data.data(), sizeof(Header));
+
+    const auto runsSize = header.attrRunCount * sizeof(AttrRun);
+    const auto charOffsetsSize = header.hasCharOffsets ? (columnCount + size_t{ 1 }) * sizeof(uint16_t) : 0;
+    const auto textSize = header.charCount * sizeof(wchar_t);
+    const auto size = sizeof(Header) + runsSize + charOffsetsSize + textSize;
+    THROW_HR_IF(invalidData, header.columnCount != columnCount || data.size() != size);
+    THROW_HR_IF(invalidData, header.lineRendition > LineRendition::DoubleHeightBottom);
+    // Without char offsets Unpack() relies on each column corresponding to 1 char.
+    THROW_HR_IF(invalidData, !header.hasCharOffsets && header.charCount > columnCount);
+
+    PackedRow packed;
+    packed._data = std::make_unique_for_overwrite<std::byte[]>(size);
+    packed._size = size;
+    memcpy(packed._data.get(), data.data(), size);
+
+    size_t columns = 0;
+    for (const auto& run : packed._attrRuns())
+    {
+        THROW_HR_IF(invalidData, run.value >= attributeCount);
+        columns += run.length;
+    }
+    THROW_HR_IF(invalidData, columns != columnCount);
+
+    if (header.hasCharOffsets)
+    {
+        const auto charOffsets = reinterpret_cast<const uint16_t*>(packed._data.get() + sizeof(Header) + runsSize);
+        uint16_t previous = 0;
+        for (size_t i = 0; i <= columnCount; ++i)
+        {
+            const uint16_t offset = charOffsets[i] & ROW::CharOffsetsMask;
+            THROW_HR_IF(invalidData, offset < previous || offset > header.charCount);
+            previous = offset;
+        }
+        THROW_HR_IF(invalidData, charOffsets[columnCount] != header.charCount);
+    }
+
+    return packed;
+}
+
+// Computes the size of each part of the encoding of the given row.
+PackedRow::Layout PackedRow::_layout(const ROW& row) noexcept
+{
+    const auto columnCount = row._columnCount;
+    const auto charOffsets = row._charOffsets.data();
+    const auto charCount = row._charSize();
+
+    // If each column maps to exactly 1 char (= only narrow glyphs that are 1 char long), _charOffsets
+    // is just the sequence 0, 1, 2, ... and we can skip storing it. This is the overwhelmingly common case.
+    auto hasCharOffsets = charCount != columnCount;
+    for (uint16_t i = 0; !hasCharOffsets && i <= columnCount; ++i)
+    {
+        hasCharOffsets = charOffsets[i] != i;
+    }
+
+    // Without a char offsets table, Unpack() relies on the freshly constructed
+    // ROW being filled with whitespace, which allows us to trim it here.
+    auto textLength = charCount;
+    if (!hasCharOffsets)
+    {
+        for (; textLength != 0 && row._chars[textLength - 1u] == L' '; --textLength)
+        {
+        }
+    }
+
+    const auto& runs = row._attr.runs();
+    const auto runsSize = runs.size() * sizeof(AttrRun);
+    const auto charOffsetsSize = hasCharOffsets ? (columnCount + size_t{ 1 }) * sizeof(uint16_t) : 0;
+    const auto textSize = textLength * sizeof(wchar_t);
+
+    return {
+        .header = {
+            .columnCount = columnCount,
+            .charCount = textLength,
+            .attrRunCount = gsl::narrow_cast<uint16_t>(runs.size()),
+            .lineRendition = row._lineRendition,
+            .wrapForced = row._wrapForced,
+            .doubleBytePadded = row._doubleBytePadded,
+            .hasCharOffsets = hasCharOffsets,
+        },
+        .runsSize = runsSize,
+        .charOffsetsSize = charOffsetsSize,
+        .textSize = textSize,
+        .size = sizeof(Header) + runsSize + charOffsetsSize + textSize,
+    };
+}
+
+// Writes the encoding of the given row into `ptr`, which must be at least `layout.size` bytes large.
+void PackedRow::_write(const ROW& row, const Layout& layout, std::byte* ptr) noexcept
+{
+    memcpy(ptr, &layout.header, sizeof(Header));
+    ptr += sizeof(Header);
+    memcpy(ptr, row._attr.runs().data(), layout.runsSize);
+    ptr += layout.runsSize;
+    if (layout.header.hasCharOffsets)
+    {
+        memcpy(ptr, row._charOffsets.data(), layout.charOffsetsSize);
+        ptr += layout.charOffsetsSize;
+    }
+    memcpy(ptr, row._chars.data(), layout.textSize);
+}
+
+// Restores the packed contents into the given row and releases the packed data.
+// The row must have the same width and be freshly constructed or Reset().
+void PackedRow::Unpack(ROW& row)
+{
+    const auto& header = _header();
+    assert(row._columnCount == header.columnCount);
+
+    const auto runs = _attrRuns();
+    auto ptr = _data.get() + sizeof(Header) + runs.size_bytes();
+
+    if (header.hasCharOffsets)
+    {
+        const auto charOffsetsSize = (header.columnCount + size_t{ 1 }) * sizeof(uint16_t);
+        memcpy(row._charOffsets.data(), ptr, charOffsetsSize);
+        ptr += charOffsetsSize;
+    }
+
+    if (header.charCount > row._chars.size())
+    {
+        row._charsHeap = std::make_unique_for_overwrite<wchar_t[]>(header.charCount);
+        row._chars = { row._charsHeap.get(), header.charCount };
+    }
+    memcpy(row._chars.data(), ptr, header.charCount * sizeof(wchar_t));
+
+    using Attributes = til::small_rle<TextAttributeTable::Id, uint16_t, 1>;
+    row._attr = Attributes{ Attributes::container(runs.begin(), runs.end()) };
+    row._lineRendition = header.lineRendition;
+    row._wrapForced = header.wrapForced;
+    row._doubleBytePadded = header.doubleBytePadded;
+    row._generation = _generation;
+    row._promptData = std::move(_scrollbarData);
+    row._imageSlice = std::move(_imageSlice);
+
+    _data.reset();
+    _size = 0;
+    _scrollbarData.reset();
+}
+
+PackedRow::operator bool() const noexcept
+{
+    return _data != nullptr;
+}
+
+// Returns the amount of heap memory used by this instance, excluding image slices.
+size_t PackedRow::MemoryUsage() const noexcept
+{
+    return _size;
+}
+
+// Identical to ROW::GetHyperlinks(), but without having to unpack the row.
+std::vector<uint16_t> PackedRow::GetHyperlinks(const TextAttributeTable& table) const
+{
+    std::vector<uint16_t> ids;
+    for (const auto& run : _attrRuns())
+    {
+        if (const auto& attr = table.Get(run.value); attr.IsHyperlink())
+        {
+            ids.emplace_back(attr.GetHyperlinkId());
+        }
+    }
+    return ids;
+}
+
+// Marks the attributes referenced by this row as alive. See TextAttributeTable::Sweep().
+void PackedRow::MarkAttributes(TextAttributeTable& table) const noexcept
+{
+    for (const auto& run : _attrRuns())
+    {
+        table.Mark(run.value);
+    }
+}
+
+const std::optional<ScrollbarData>& PackedRow::GetScrollbarData() const noexcept
+{
+    return _scrollbarData;
+}
+
+uint64_t PackedRow::GetGeneration() const noexcept
+{
+    return _generation;
+}
+
+const PackedRow::Header& PackedRow::_header() const noexcept
+{
+    assert(_data);
+    return *reinterpret_cast<const Header*>(_data.get());
+}
+
+std::span<const PackedRow::AttrRun> PackedRow::_attrRuns() const noexcept
+{
+    if (!_data)
+    {
+        return {};
+    }
+    const auto runs = reinterpret_cast<const AttrRun*>(_data.get() + sizeof(Header));
+    return { runs, _header().attrRunCount };
+}
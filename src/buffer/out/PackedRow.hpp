@@ -0,0 +1,88 @@
+/*++
+Copyright (c) Microsoft Corporation
+Licensed under the MIT license.
+
+Module Name:
+- PackedRow.hpp
+
+Abstract:
+- A compact, immutable encoding of a ROW. It's used by TextBuffer to implement
+  its "cold" scrollback tier: Rows that scrolled far out of the viewport are
+  packed and their backing memory in the TextBuffer arena is released.
+- Compared to a ROW, a PackedRow stores the text without trailing whitespace,
+  omits the char offsets table if all glyphs are narrow and 1 char long,
+  and stores the attribute runs in a flat array. The runs refer to ids in
+  the TextAttributeTable of the TextBuffer that packed the row.
+- The same encoding is used for the rows in buffer snapshots (see
+  TextBuffer::SerializeSnapshot), via Encode() and Decode().
+--*/
+
+#pragma once
+
+#include "Row.hpp"
+
+class PackedRow final
+{
+public:
+    PackedRow() = default;
+
+    PackedRow(const PackedRow&) = delete;
+    PackedRow& operator=(const PackedRow&) = delete;
+
+    PackedRow(PackedRow&&) = default;
+    PackedRow& operator=(PackedRow&&) = default;
+
+    static PackedRow Pack(ROW& row);
+    static void Encode(const ROW& row, std::vector<std::byte>& out);
+    static PackedRow Decode(std::span<const std::byte> data, uint16_t columnCount, size_t attributeCount);
+    void Unpack(ROW& row);
+
+    explicit operator bool() const noexcept;
+    size_t MemoryUsage() const noexcept;
+
+    std::vector<uint16_t> GetHyperlinks(const TextAttributeTable& table) const;
+    void MarkAttributes(TextAttributeTable& table) const noexcept;
+    const std::optional<ScrollbarData>& GetScrollbarData() const noexcept;
+    uint64_t GetGeneration() const noexcept;
+
+private:
+    using AttrRun = til::rle_pair<TextAttributeTable::Id, uint16_t>;
+    static_assert(std::is_trivially_copyable_v<AttrRun>);
+
+    struct Header
+    {
+        uint16_t columnCount;
+        uint16_t charCount;
+        uint16_t attrRunCount;
+        LineRendition lineRendition;
+        bool wrapForced : 1;
+        bool doubleBytePadded : 1;
+        bool hasCharOffsets : 1;
+    };
+
+    struct Layout
+    {
+        Header header;
+        size_t runsSize;
+        size_t charOffsetsSize;
+        size_t textSize;
+        size_t size;
+    };
+
+    static Layout _layout(const ROW& row) noexcept;
+    static void _write(const ROW& row, const Layout& layout, std::byte* ptr) noexcept;
+    const Header& _header() const noexcept;
+    std::span<const AttrRun> _attrRuns() const noexcept;
+
+    // The layout of _data is:
+    //   Header
+    //   AttrRun[attrRunCount]
+    //   uint16_t[columnCount + 1] (only if hasCharOffsets)
+    //   wchar_t[charCount]
+    // The fields are ordered by descending alignment so that no padding is needed.
+    std::unique_ptr<std::byte[]> _data;
+    size_t _size = 0;
+    uint64_t _generation = 0;
+    std::optional<ScrollbarData> _scrollbarData;
+    ImageSlice::Pointer _imageSlice;
+};
@@ -5,6 +5,7 @@
 #include "Row.hpp"
 
 #include <isa_availability.h>
+#include <til/hash.h>
 
 #include "../../types/inc/CodepointWidthDetector.hpp"
 
@@ -80,6 +81,40 @@ constexpr OutIt copy_n_small(InIt first, Diff count, OutIt dest)
     return dest;
 }
 
+// Only the bytes that are meaningful for the color's type are hashed, so that two colors that compare
+// the same when rendered can never produce different hashes due to leftovers in the unused bytes.
+static void hashColor(til::hasher& hasher, const TextColor& color) noexcept
+{
+    const auto type = color.GetType();
+    hasher.write(static_cast<uint8_t>(type));
+
+    switch (type)
+    {
+    case ColorType::IsIndex16:
+    case ColorType::IsIndex256:
+        hasher.write(color.GetIndex());
+        break;
+    case ColorType::IsRgb:
+        hasher.write(color.GetRGB());
+        break;
+    default:
+        break;
+    }
+}
+
+// Hashes the fields of a TextAttribute explicitly instead of its raw bytes, which include padding and unused bits.
+static void hashAttribute(til::hasher& hasher, const TextAttribute& attr) noexcept
+{
+    auto flags = attr.GetCharacterAttributes();
+    WI_ClearFlag(flags, CharacterAttributes::Unused1);
+
+    hashColor(hasher, attr.GetForeground());
+    hashColor(hasher, attr.GetBackground());
+    hashColor(hasher, attr.GetUnderlineColor());
+    hasher.write(static_cast<uint16_t>(flags));
+    hasher.write(attr.GetHyperlinkId());
+}
+
 CharToColumnMapper::CharToColumnMapper(const wchar_t* chars, const uint16_t* charOffsets, ptrdiff_t lastCharOffset, til::CoordType currentColumn) noexcept :
     _chars{ chars },
     _charOffsets{ charOffsets },
@@ -156,14 +191,16 @@ til::CoordType CharToColumnMapper::GetTrailingColumnAt(const wchar_t* str) noexc
 // - constructor
 // Arguments:
 // - rowWidth - the width of the row, cell elements
-// - fillAttribute - the default text attribute
+// - attributeTable - the table of the owning TextBuffer
+// - fillAttribute - the id of the default text attribute in attributeTable
 // Return Value:
 // - constructed object
-ROW::ROW(wchar_t* charsBuffer, uint16_t* charOffsetsBuffer, uint16_t rowWidth, const TextAttribute& fillAttribute) :
+ROW::ROW(wchar_t* charsBuffer, uint16_t* charOffsetsBuffer, uint16_t rowWidth, TextAttributeTable& attributeTable, TextAttributeTable::Id fillAttribute) :
     _charsBuffer{ charsBuffer },
     _chars{ charsBuffer, rowWidth },
     _charOffsets{ charOffsetsBuffer, ::base::strict_cast<size_t>(rowWidth) + 1u },
     _attr{ rowWidth, fillAttribute },
+    _attributeTable{ &attributeTable },
     _columnCount{ rowWidth }
 {
     _init();
@@ -199,6 +236,39 @@ LineRendition ROW::GetLineRendition() const noexcept
     return _lineRendition;
 }
 
+void ROW::SetGeneration(const uint64_t generation) noexcept
+{
+    _generation = generation;
+}
+
+uint64_t ROW::GetGeneration() const noexcept
+{
+    return _generation;
+}
+
+// Returns a fingerprint of everything that affects how this row is rendered: The text, the width of each glyph,
+// the attributes, the line rendition, the wrap flag and the revision of the image slice. Unlike the generation,
+// it's the same for two rows with identical contents, no matter how they got written.
+size_t ROW::GetContentHash() const noexcept
+{
+    til::hasher hasher;
+    hasher.write(_chars.data(), _charSize());
+    hasher.write(_charOffsets.data(), _columnCount + size_t{ 1 });
+
+    // The ids are resolved, because they may get reused for different attributes after TextAttributeTable::Sweep().
+    for (const auto& run : _attr.runs())
+    {
+        const auto& attr = _attributeTable->Get(run.value);
+        hashAttribute(hasher, attr);
+        hasher.write(run.length);
+    }
+
+    hasher.write(_lineRendition);
+    hasher.write(static_cast<uint8_t>(_wrapForced));
+    hasher.write(_imageSlice ? _imageSlice->Revision() : uint64_t{ 0 });
+    return hasher.finalize();
+}
+
 // Returns the index 1 past the last (technically) valid column in the row.
 // The interplay between the old console and newer VT APIs which support line renditions is
 // still unclear so it might be necessary to add two kinds of this function in the future.
@@ -218,7 +288,13 @@ til::CoordType ROW::GetReadableColumnCount() const noexcept
 // - Attr - The default attribute (color) to fill
 // Return Value:
 // - <none>
-void ROW::Reset(const TextAttribute& attr) noexcept
+void ROW::Reset(const TextAttribute& attr)
+{
+    Reset(_attributeTable->Intern(attr));
+}
+
+// Same as above, but for attributes that have already been interned into this row's table.
+void ROW::Reset(const TextAttributeTable::Id attr) noexcept
 {
     _charsHeap.reset();
     _chars = { _charsBuffer, _columnCount };
@@ -361,6 +437,46 @@ void ROW::CopyFrom(const ROW& source)
 
     _attr = source.Attributes();
     _attr.resize_trailing_extent(_columnCount);
+
+    // The source row might belong to a different TextBuffer and thus a different table.
+    if (source._attributeTable != _attributeTable)
+    {
+        // Until the loop is done, _attr contains ids of the other table that a collection would misinterpret.
+        const auto suspended = _attributeTable->SuspendCollection();
+        for (auto& run : _attr.runs())
+        {
+            run.value = _attributeTable->Intern(source._attributeTable->Get(run.value));
+        }
+    }
+}
+
+// Same as above, but the ids of the source row are translated with the given mapping,
+// which must have been created by TextAttributeTable::Import(). Unlike the above,
+// this doesn't modify this row's table and can thus be called on multiple threads.
+void ROW::CopyFrom(const ROW& source, const std::span<const TextAttributeTable::Id> attributeMap)
+{
+    _lineRendition = source._lineRendition;
+    _wrapForced = source._wrapForced;
+
+    RowCopyTextFromState state{
+        .source = source,
+        .sourceColumnLimit = source.GetReadableColumnCount(),
+    };
+    CopyTextFrom(state);
+
+    _attr = source.Attributes();
+    _attr.resize_trailing_extent(_columnCount);
+    TranslateAttributes(_attr, attributeMap);
+}
+
+// Translates the ids in the given attributes with a mapping created by TextAttributeTable::Import().
+// Distinct ids map to distinct ids, so adjacent runs don't need to be merged afterwards.
+void ROW::TranslateAttributes(til::small_rle<TextAttributeTable::Id, uint16_t, 1>& attributes, const std::span<const TextAttributeTable::Id> attributeMap)
+{
+    for (auto& run : attributes.runs())
+    {
+        run.value = til::at(attributeMap, run.value);
+    }
 }
 
 // Returns the previous possible cursor position, preceding the given column.
@@ -448,7 +564,7 @@ OutputCellIterator ROW::WriteCells(OutputCellIterator it, const til::CoordType c
             {
                 // Otherwise, commit this color into the run and save off the new one.
                 // Now commit the new color runs into the attr row.
-                _attr.replace(colorStarts, currentIndex, currentColor);
+                _attr.replace(colorStarts, currentIndex, _attributeTable->Intern(currentColor));
                 currentColor = it->TextAttr();
                 colorUses = 1;
                 colorStarts = currentIndex;
@@ -528,7 +644,7 @@ OutputCellIterator ROW::WriteCells(OutputCellIterator it, const til::CoordType c
     // Now commit the final color into the attr row
     if (colorUses)
     {
-        _attr.replace(colorStarts, currentIndex, currentColor);
+        _attr.replace(colorStarts, currentIndex, _attributeTable->Intern(currentColor));
     }
 
     return it;
@@ -536,12 +652,12 @@ OutputCellIterator ROW::WriteCells(OutputCellIterator it, const til::CoordType c
 
 void ROW::SetAttrToEnd(const til::CoordType columnBegin, const TextAttribute attr)
 {
-    _attr.replace(_clampedColumnInclusive(columnBegin), _attr.size(), attr);
+    _attr.replace(_clampedColumnInclusive(columnBegin), _attr.size(), _attributeTable->Intern(attr));
 }
 
 void ROW::ReplaceAttributes(const til::CoordType beginIndex, const til::CoordType endIndex, const TextAttribute& newAttr)
 {
-    _attr.replace(_clampedColumnInclusive(beginIndex), _clampedColumnInclusive(endIndex), newAttr);
+    _attr.replace(_clampedColumnInclusive(beginIndex), _clampedColumnInclusive(endIndex), _attributeTable->Intern(newAttr));
 }
 
 [[msvc::forceinline]] ROW::WriteHelper::WriteHelper(ROW& row, til::CoordType columnBegin, til::CoordType columnLimit, const std::wstring_view& chars) noexcept :
@@ -581,7 +697,7 @@ catch (...)
     // Due to this function writing _charOffsets first, then calling _resizeChars (which may throw) and only then finally
     // filling in _chars, we might end up in a situation were _charOffsets contains offsets outside of the _chars array.
     // --> Restore this row to a known "okay"-state.
-    Reset(TextAttribute{});
+    Reset(TextAttributeTable::DefaultId);
     throw;
 }
 
@@ -632,7 +748,7 @@ try
 }
 catch (...)
 {
-    Reset(TextAttribute{});
+    Reset(TextAttributeTable::DefaultId);
     throw;
 }
 
@@ -646,6 +762,83 @@ catch (...)
     const auto end = it + std::min<size_t>(chars.size(), colLimit - colBeg);
     size_t ch = chBeg;
 
+#pragma warning(push)
+#pragma warning(disable : 26481) // Don't use pointer arithmetic. Use span instead (bounds.1).
+#pragma warning(disable : 26490) // Don't use reinterpret_cast (type.1).
+    // The vectorized loops below validate 16 (AVX2) or 8 (SSE2/NEON) chars at a time and write the
+    // corresponding ascending sequence of char offsets. Both, the loads from `chars` and the stores
+    // into `_charOffsets`, stay within [it,end) and [colEnd,colLimit) respectively, because each
+    // char in the ASCII range corresponds to exactly 1 column. As soon as a chunk contains
+    // a non-ASCII char we leave it to the scalar loop to find it and switch to _replaceTextUnicode().
+#if defined(TIL_SSE_INTRINSICS)
+    if (__isa_available >= __ISA_AVAILABLE_AVX2)
+    {
+        const auto nonAscii = _mm256_set1_epi16(static_cast<short>(0xff80));
+        const auto increment = _mm256_set1_epi16(16);
+        auto offsets = _mm256_add_epi16(_mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm256_set1_epi16(static_cast<short>(ch)));
+
+        while (end - it >= 16)
+        {
+            const auto vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&*it));
+            if (!_mm256_testz_si256(vec, nonAscii))
+            {
+                break;
+            }
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row._charOffsets.data() + colEnd), offsets);
+            offsets = _mm256_add_epi16(offsets, increment);
+            colEnd += 16;
+            ch += 16;
+            it += 16;
+        }
+    }
+
+    {
+        const auto nonAscii = _mm_set1_epi16(static_cast<short>(0xff80));
+        const auto increment = _mm_set1_epi16(8);
+        auto offsets = _mm_add_epi16(_mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), _mm_set1_epi16(static_cast<short>(ch)));
+
+        while (end - it >= 8)
+        {
+            const auto vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&*it));
+            // SSE2 lacks _mm_testz_si128, so we compare the masked chars against 0 instead.
+            const auto ascii = _mm_cmpeq_epi16(_mm_and_si128(vec, nonAscii), _mm_setzero_si128());
+            if (_mm_movemask_epi8(ascii) != 0xffff)
+            {
+                break;
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row._charOffsets.data() + colEnd), offsets);
+            offsets = _mm_add_epi16(offsets, increment);
+            colEnd += 8;
+            ch += 8;
+            it += 8;
+        }
+    }
+#elif defined(TIL_ARM_NEON_INTRINSICS)
+    {
+        alignas(uint16x8_t) static constexpr uint16_t offsetsData[]{ 0, 1, 2, 3, 4, 5, 6, 7 };
+        const auto increment = vdupq_n_u16(8);
+        auto offsets = vaddq_u16(vld1q_u16(&offsetsData[0]), vdupq_n_u16(static_cast<uint16_t>(ch)));
+
+        while (end - it >= 8)
+        {
+            const auto vec = vld1q_u16(reinterpret_cast<const uint16_t*>(&*it));
+            if (vmaxvq_u16(vec) >= 0x80)
+            {
+                break;
+            }
+
+            vst1q_u16(row._charOffsets.data() + colEnd, offsets);
+            offsets = vaddq_u16(offsets, increment);
+            colEnd += 8;
+            ch += 8;
+            it += 8;
+        }
+    }
+#endif
+#pragma warning(pop)
+
     while (it != end)
     {
         if (*it >= 0x80) [[unlikely]]
@@ -723,33 +916,42 @@ catch (...)
 
     if (const auto end = chars.end(); it != end)
     {
-        GraphemeState state{ .beg = &*it };
+        // The text is segmented in batches, which is a lot faster than calling GraphemeNext() for each cluster.
+        // Each cluster is at least 1 column wide, so we never need more than 1 cluster past the column limit.
+#pragma warning(suppress : 26494) // Variable 'clusters' is uninitialized. Always initialize an object (type.5).
+        std::array<GraphemeCluster, 64> clusters;
 
         do
         {
-            cwd.GraphemeNext(state, chars);
+            const auto remaining = gsl::narrow_cast<size_t>(end - it);
+            const auto batch = std::min<size_t>(clusters.size(), colLimit - colEnd + 1u);
+            const auto count = cwd.GraphemeSegment({ &*it, remaining }, std::span{ clusters }.first(batch));
 
-            const auto width = std::max(1, state.width);
-            const auto colEndNew = gsl::narrow_cast<uint16_t>(colEnd + width);
-            if (colEndNew > colLimit)
+            for (size_t i = 0; i < count; ++i)
             {
-                colEndDirty = colLimit;
-                charsConsumed = ch - chBeg;
-                return;
-            }
+                const auto& cluster = til::at(clusters, i);
+                const auto width = std::max(1, cluster.width);
+                const auto colEndNew = gsl::narrow_cast<uint16_t>(colEnd + width);
+                if (colEndNew > colLimit)
+                {
+                    colEndDirty = colLimit;
+                    charsConsumed = ch - chBeg;
+                    return;
+                }
 
-            // Fill our char-offset buffer with 1 entry containing the mapping from the
-            // current column (colEnd) to the start of the glyph in the string (ch)...
-            til::at(row._charOffsets, colEnd++) = gsl::narrow_cast<uint16_t>(ch);
-            // ...followed by 0-N entries containing an indication that the
-            // columns are just a wide-glyph extension of the preceding one.
-            while (colEnd < colEndNew)
-            {
-                til::at(row._charOffsets, colEnd++) = gsl::narrow_cast<uint16_t>(ch | CharOffsetsTrailer);
-            }
+                // Fill our char-offset buffer with 1 entry containing the mapping from the
+                // current column (colEnd) to the start of the glyph in the string (ch)...
+                til::at(row._charOffsets, colEnd++) = gsl::narrow_cast<uint16_t>(ch);
+                // ...followed by 0-N entries containing an indication that the
+                // columns are just a wide-glyph extension of the preceding one.
+                while (colEnd < colEndNew)
+                {
+                    til::at(row._charOffsets, colEnd++) = gsl::narrow_cast<uint16_t>(ch | CharOffsetsTrailer);
+                }
 
-            ch += state.len;
-            it += state.len;
+                ch += cluster.len;
+                it += cluster.len;
+            }
         } while (it != end);
     }
 
@@ -806,10 +1008,39 @@ try
 }
 catch (...)
 {
-    Reset(TextAttribute{});
+    Reset(TextAttributeTable::DefaultId);
     throw;
 }
 
+// Computes the columnEnd and sourceColumnEnd that CopyTextFrom() would return when writing
+// into an empty row that is columnCount wide, without actually copying anything.
+// This allows TextBuffer::Reflow() to compute the layout of the new buffer upfront.
+void ROW::MeasureTextFrom(RowCopyTextFromState& state, til::CoordType columnCount) noexcept
+{
+    const auto& source = state.source;
+    const til::CoordType sourceColBeg = source._clampedColumnInclusive(state.sourceColumnBegin);
+    const til::CoordType sourceColLimit = source._clampedColumnInclusive(state.sourceColumnLimit);
+    const auto colBeg = std::clamp(state.columnBegin, 0, columnCount);
+    const auto colLimit = std::clamp(state.columnLimit, 0, columnCount);
+
+    if (sourceColBeg >= sourceColLimit || colBeg >= colLimit || WI_IsFlagSet(til::at(source._charOffsets, sourceColBeg), CharOffsetsTrailer))
+    {
+        state.columnEnd = colBeg;
+        state.sourceColumnEnd = source._columnCount;
+        return;
+    }
+
+    // Same as in WriteHelper::CopyTextFrom(): Copy as many columns as fit, but don't split up wide glyphs.
+    auto colEndInput = std::min(colLimit - colBeg, sourceColLimit - sourceColBeg);
+    for (; WI_IsFlagSet(til::at(source._charOffsets, sourceColBeg + colEndInput), CharOffsetsTrailer); --colEndInput)
+    {
+    }
+
+    // Same as in CopyTextFrom(): If we couldn't copy all of the text, the row is considered full.
+    state.columnEnd = colEndInput == sourceColLimit - sourceColBeg ? colBeg + colEndInput : colLimit;
+    state.sourceColumnEnd = sourceColBeg + colEndInput;
+}
+
 [[msvc::forceinline]] void ROW::WriteHelper::CopyTextFrom(const std::span<const uint16_t>& charOffsets) noexcept
 {
     // Since our `charOffsets` input is already in columns (just like the `ROW::_charOffsets`),
@@ -937,19 +1168,25 @@ void ROW::_resizeChars(uint16_t colEndDirty, uint16_t chBegDirty, size_t chEndDi
     }
 }
 
-til::small_rle<TextAttribute, uint16_t, 1>& ROW::Attributes() noexcept
+til::small_rle<TextAttributeTable::Id, uint16_t, 1>& ROW::Attributes() noexcept
 {
     return _attr;
 }
 
-const til::small_rle<TextAttribute, uint16_t, 1>& ROW::Attributes() const noexcept
+const til::small_rle<TextAttributeTable::Id, uint16_t, 1>& ROW::Attributes() const noexcept
 {
     return _attr;
 }
 
+// Returns the table that resolves the ids returned by Attributes().
+TextAttributeTable& ROW::GetAttributeTable() const noexcept
+{
+    return *_attributeTable;
+}
+
 TextAttribute ROW::GetAttrByColumn(const til::CoordType column) const
 {
-    return _attr.at(_clampedColumn(column));
+    return _attributeTable->Get(_attr.at(_clampedColumn(column)));
 }
 
 std::vector<uint16_t> ROW::GetHyperlinks() const
@@ -957,9 +1194,9 @@ std::vector<uint16_t> ROW::GetHyperlinks() const
     std::vector<uint16_t> ids;
     for (const auto& run : _attr.runs())
     {
-        if (run.value.IsHyperlink())
+        if (const auto& attr = _attributeTable->Get(run.value); attr.IsHyperlink())
         {
-            ids.emplace_back(run.value.GetHyperlinkId());
+            ids.emplace_back(attr.GetHyperlinkId());
         }
     }
     return ids;
@@ -1125,6 +1362,23 @@ std::wstring_view ROW::GetText(til::CoordType columnBegin, til::CoordType column
     return { _chars.data() + chBeg, chEnd - chBeg };
 }
 
+// Writes the offset at which each column in [columnBegin, columnEnd] begins into `offsets`, relative to the
+// start of GetText(columnBegin, columnEnd). The columns are clamped the same way. Both halves of a wide glyph
+// have the same offset, as described for _charOffsets. `offsets` should hold columnEnd - columnBegin + 1 items.
+void ROW::GetCharOffsets(til::CoordType columnBegin, til::CoordType columnEnd, std::span<uint16_t> offsets) const noexcept
+{
+    const auto columns = GetReadableColumnCount();
+    const auto colBeg = clamp(columnBegin, 0, columns);
+    const auto colEnd = clamp(columnEnd, colBeg, columns);
+    const auto base = _uncheckedCharOffset(gsl::narrow_cast<size_t>(colBeg));
+    const auto count = std::min(offsets.size(), gsl::narrow_cast<size_t>(colEnd - colBeg) + 1);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        til::at(offsets, i) = gsl::narrow_cast<uint16_t>(_uncheckedCharOffset(colBeg + i) - base);
+    }
+}
+
 til::CoordType ROW::GetLeadingColumnAtCharOffset(const ptrdiff_t offset) const noexcept
 {
     return _createCharToColumnMapper(offset).GetLeadingColumnAt(offset);
@@ -10,6 +10,7 @@
 #include "OutputCell.hpp"
 #include "OutputCellIterator.hpp"
 #include "Marks.hpp"
+#include "TextAttributeTable.hpp"
 
 class ROW;
 class TextBuffer;
@@ -115,8 +116,73 @@ public:
         return (columns * sizeof(uint16_t) + 16) & ~15;
     }
 
+    // Iterates over the attributes of each column. The ROW stores ids into the TextBuffer's
+    // TextAttributeTable and this resolves them. Comparing the Id() of two iterators
+    // into the same buffer is cheaper than comparing the attributes themselves.
+    class AttributeIterator
+    {
+    public:
+        using IdIterator = til::small_rle<TextAttributeTable::Id, uint16_t, 1>::const_iterator;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = TextAttribute;
+        using difference_type = IdIterator::difference_type;
+        using pointer = const TextAttribute*;
+        using reference = const TextAttribute&;
+
+        AttributeIterator(const TextAttributeTable* table, IdIterator it) noexcept :
+            _table{ table },
+            _it{ std::move(it) }
+        {
+        }
+
+        reference operator*() const noexcept { return _table->Get(*_it); }
+        pointer operator->() const noexcept { return &operator*(); }
+        TextAttributeTable::Id Id() const noexcept { return *_it; }
+
+        AttributeIterator& operator++() noexcept
+        {
+            ++_it;
+            return *this;
+        }
+        AttributeIterator operator++(int) noexcept
+        {
+            auto tmp = *this;
+            ++_it;
+            return tmp;
+        }
+        AttributeIterator& operator--() noexcept
+        {
+            --_it;
+            return *this;
+        }
+        AttributeIterator operator--(int) noexcept
+        {
+            auto tmp = *this;
+            --_it;
+            return tmp;
+        }
+        AttributeIterator& operator+=(difference_type move) noexcept
+        {
+            _it += move;
+            return *this;
+        }
+        AttributeIterator operator+(difference_type move) const noexcept
+        {
+            auto tmp = *this;
+            tmp._it += move;
+            return tmp;
+        }
+        difference_type operator-(const AttributeIterator& right) const noexcept { return _it - right._it; }
+        bool operator==(const AttributeIterator& right) const noexcept { return _it == right._it; }
+        bool operator!=(const AttributeIterator& right) const noexcept { return _it != right._it; }
+
+    private:
+        const TextAttributeTable* _table;
+        IdIterator _it;
+    };
+
     ROW() = default;
-    ROW(wchar_t* charsBuffer, uint16_t* charOffsetsBuffer, uint16_t rowWidth, const TextAttribute& fillAttribute);
+    ROW(wchar_t* charsBuffer, uint16_t* charOffsetsBuffer, uint16_t rowWidth, TextAttributeTable& attributeTable, TextAttributeTable::Id fillAttribute);
 
     ROW(const ROW& other) = delete;
     ROW& operator=(const ROW& other) = delete;
@@ -130,10 +196,16 @@ public:
     bool WasDoubleBytePadded() const noexcept;
     void SetLineRendition(const LineRendition lineRendition) noexcept;
     LineRendition GetLineRendition() const noexcept;
+    void SetGeneration(uint64_t generation) noexcept;
+    uint64_t GetGeneration() const noexcept;
+    size_t GetContentHash() const noexcept;
     til::CoordType GetReadableColumnCount() const noexcept;
 
-    void Reset(const TextAttribute& attr) noexcept;
+    void Reset(const TextAttribute& attr);
+    void Reset(TextAttributeTable::Id attr) noexcept;
     void CopyFrom(const ROW& source);
+    void CopyFrom(const ROW& source, std::span<const TextAttributeTable::Id> attributeMap);
+    static void TranslateAttributes(til::small_rle<TextAttributeTable::Id, uint16_t, 1>& attributes, std::span<const TextAttributeTable::Id> attributeMap);
 
     til::CoordType NavigateToPrevious(til::CoordType column) const noexcept;
     til::CoordType NavigateToNext(til::CoordType column) const noexcept;
@@ -147,9 +219,11 @@ public:
     void ReplaceCharacters(til::CoordType columnBegin, til::CoordType width, const std::wstring_view& chars);
     void ReplaceText(RowWriteState& state);
     void CopyTextFrom(RowCopyTextFromState& state);
+    static void MeasureTextFrom(RowCopyTextFromState& state, til::CoordType columnCount) noexcept;
 
-    til::small_rle<TextAttribute, uint16_t, 1>& Attributes() noexcept;
-    const til::small_rle<TextAttribute, uint16_t, 1>& Attributes() const noexcept;
+    til::small_rle<TextAttributeTable::Id, uint16_t, 1>& Attributes() noexcept;
+    const til::small_rle<TextAttributeTable::Id, uint16_t, 1>& Attributes() const noexcept;
+    TextAttributeTable& GetAttributeTable() const noexcept;
     TextAttribute GetAttrByColumn(til::CoordType column) const;
     std::vector<uint16_t> GetHyperlinks() const;
     ImageSlice* SetImageSlice(ImageSlice::Pointer imageSlice) noexcept;
@@ -164,12 +238,13 @@ public:
     DbcsAttribute DbcsAttrAt(til::CoordType column) const noexcept;
     std::wstring_view GetText() const noexcept;
     std::wstring_view GetText(til::CoordType columnBegin, til::CoordType columnEnd) const noexcept;
+    void GetCharOffsets(til::CoordType columnBegin, til::CoordType columnEnd, std::span<uint16_t> offsets) const noexcept;
     til::CoordType GetLeadingColumnAtCharOffset(ptrdiff_t offset) const noexcept;
     til::CoordType GetTrailingColumnAtCharOffset(ptrdiff_t offset) const noexcept;
     DelimiterClass DelimiterClassAt(til::CoordType column, const std::wstring_view& wordDelimiters) const noexcept;
 
-    auto AttrBegin() const noexcept { return _attr.begin(); }
-    auto AttrEnd() const noexcept { return _attr.end(); }
+    AttributeIterator AttrBegin() const noexcept { return { _attributeTable, _attr.begin() }; }
+    AttributeIterator AttrEnd() const noexcept { return { _attributeTable, _attr.end() }; }
 
     const std::optional<ScrollbarData>& GetScrollbarData() const noexcept;
     void SetScrollbarData(std::optional<ScrollbarData> data) noexcept;
@@ -182,6 +257,8 @@ public:
 #endif
 
 private:
+    friend class PackedRow;
+
     // WriteHelper exists because other forms of abstracting this functionality away (like templates with lambdas)
     // where only very poorly optimized by MSVC as it failed to inline the templates.
     struct WriteHelper
@@ -295,9 +372,11 @@ private:
     // In other words, _charOffsets tells us both the width in chars and width in columns.
     // See CharOffsetsTrailer for more information.
     std::span<uint16_t> _charOffsets;
-    // _attr is a run-length-encoded vector of TextAttribute with a decompressed
+    // _attr is a run-length-encoded vector of TextAttributeTable ids with a decompressed
     // length equal to _columnCount (= 1 TextAttribute per column).
-    til::small_rle<TextAttribute, uint16_t, 1> _attr;
+    til::small_rle<TextAttributeTable::Id, uint16_t, 1> _attr;
+    // The table of the TextBuffer this row belongs to. It resolves the ids in _attr.
+    TextAttributeTable* _attributeTable = nullptr;
     // The width of the row in visual columns.
     uint16_t _columnCount = 0;
     // Stores double-width/height (DECSWL/DECDWL/DECDHL) attributes.
@@ -309,6 +388,10 @@ private:
 
     std::optional<ScrollbarData> _promptData = std::nullopt;
 
+    // Assigned by TextBuffer::GetMutableRowByOffset() from TextBuffer::_lastMutationId.
+    // Two rows with the same non-zero generation have identical contents. 0 means the row was never modified.
+    uint64_t _generation = 0;
+
     // Stores any image content covering the row.
     ImageSlice::Pointer _imageSlice;
 };
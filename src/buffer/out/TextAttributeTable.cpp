@@ -0,0 +1,165 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include "TextAttributeTable.hpp"
+
+#include <til/hash.h>
+
+TextAttributeTable::TextAttributeTable()
+{
+    _insert(TextAttribute{});
+}
+
+size_t TextAttributeTable::Hasher::operator()(const TextAttribute& attr) const noexcept
+{
+    return til::hasher{}.write(static_cast<const void*>(&attr), sizeof(TextAttribute)).finalize();
+}
+
+// Returns the id of the given attributes, adding them to the table if necessary.
+// Before a new id is allocated, the unused ids are collected if NeedsCollection() says so.
+// If all 65536 ids are still in use afterwards, the attributes can't be represented and the
+// default attributes are used instead. This requires 65536 distinct attributes to be visible
+// in a single buffer at once.
+TextAttributeTable::Id TextAttributeTable::Intern(const TextAttribute& attr)
+{
+    if (attr == _lastAttribute)
+    {
+        return _lastId;
+    }
+
+    Id id;
+    if (const auto it = _ids.find(attr); it != _ids.end())
+    {
+        id = it->second;
+    }
+    else
+    {
+        if (_collector && _collectionSuspended == 0 && (NeedsCollection() || (_free.empty() && _attributes.size() >= MaxSize)))
+        {
+            // The collector calls Intern() itself, which must not recurse into another collection.
+            const auto suspended = SuspendCollection();
+            _collector();
+        }
+        if (_free.empty() && _attributes.size() >= MaxSize)
+        {
+            return DefaultId;
+        }
+        id = _insert(attr);
+    }
+
+    _lastAttribute = attr;
+    _lastId = id;
+    return id;
+}
+
+const TextAttribute& TextAttributeTable::Get(const Id id) const noexcept
+{
+    assert(id < _attributes.size());
+#pragma warning(suppress : 26446) // Prefer to use gsl::at() instead of unchecked subscript operator (bounds.4).
+    return _attributes[id];
+}
+
+// Returns the number of ids that are in use.
+size_t TextAttributeTable::Size() const noexcept
+{
+    return _attributes.size() - _free.size();
+}
+
+// Interns all attributes of the other table into this one and returns a mapping
+// from the other table's ids to ours. The result allows translating the ids of
+// rows from another buffer without having to touch this table, which is useful
+// for reflowing a buffer on multiple threads.
+std::vector<TextAttributeTable::Id> TextAttributeTable::Import(const TextAttributeTable& other)
+{
+    // The ids in the mapping aren't used by any row yet and would be freed by a collection.
+    const auto suspended = SuspendCollection();
+    std::vector<Id> mapping(other._attributes.size(), DefaultId);
+
+    // Free slots in the other table aren't in its _ids map, so this skips them.
+    for (const auto& [attr, id] : other._ids)
+    {
+        til::at(mapping, id) = Intern(attr);
+    }
+
+    return mapping;
+}
+
+// Returns true if enough new ids have been allocated that it's worth marking the ids that are in use.
+bool TextAttributeTable::NeedsCollection() const noexcept
+{
+    return Size() >= _collectionThreshold;
+}
+
+// Marks the given id as in use. Call this for every id referenced by any row and then call Sweep().
+void TextAttributeTable::Mark(const Id id) noexcept
+{
+    if (id < _marks.size())
+    {
+        _marks[id] = true;
+    }
+}
+
+// Frees all ids that haven't been marked since the last call to Sweep().
+void TextAttributeTable::Sweep()
+{
+    const auto size = _attributes.size();
+    assert(_marks.size() == size);
+
+    // The default attributes must always stay at id 0.
+    _marks[DefaultId] = true;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (!_marks[i])
+        {
+            auto& attr = til::at(_attributes, i);
+            _ids.erase(attr);
+            // Writing the default attributes into free slots ensures that a
+            // stale id behaves like the default attributes if it's ever used.
+            attr = {};
+            _free.emplace_back(gsl::narrow_cast<Id>(i));
+        }
+    }
+
+    // Reset the marks for the next collection. Free slots stay
+    // marked so that they aren't added to the free list twice.
+    _marks.assign(size, false);
+    for (const auto id : _free)
+    {
+        _marks[id] = true;
+    }
+
+    _lastAttribute = {};
+    _lastId = DefaultId;
+
+    // Don't collect again until the number of ids in use has doubled, to avoid
+    // repeatedly scanning the buffer when most of the ids are legitimately in use.
+    _collectionThreshold = std::clamp<size_t>(Size() * 2, 4096, MaxSize);
+}
+
+// Sets the function that marks all ids in use and calls Sweep(). See Intern().
+void TextAttributeTable::SetCollector(std::function<void()> collector)
+{
+    _collector = std::move(collector);
+}
+
+TextAttributeTable::Id TextAttributeTable::_insert(const TextAttribute& attr)
+{
+    Id id;
+    if (!_free.empty())
+    {
+        id = _free.back();
+        _free.pop_back();
+        til::at(_attributes, id) = attr;
+        _marks[id] = false;
+    }
+    else
+    {
+        id = gsl::narrow_cast<Id>(_attributes.size());
+        _attributes.emplace_back(attr);
+        _marks.emplace_back(false);
+    }
+    _ids.emplace(attr, id);
+    return id;
+}
@@ -0,0 +1,75 @@
+/*++
+Copyright (c) Microsoft Corporation
+Licensed under the MIT license.
+
+Module Name:
+- TextAttributeTable.hpp
+
+Abstract:
+- Interns the distinct TextAttribute values of a TextBuffer, so that ROWs can
+  store 16-bit ids in their run-length-encoded attributes instead of the full
+  18 byte TextAttribute. Besides the memory savings this allows comparing
+  attributes of the same buffer by comparing their ids.
+- Ids are never reference counted. Instead, TextBuffer marks the ids that are
+  still in use by its rows and calls Sweep() to free the rest. This happens
+  when rows scroll out of the buffer and, via the collector, whenever Intern()
+  needs to allocate an id while NeedsCollection() is true.
+--*/
+
+#pragma once
+
+#include "TextAttribute.hpp"
+
+class TextAttributeTable final
+{
+public:
+    using Id = uint16_t;
+
+    // Id 0 always refers to the default TextAttribute{}.
+    static constexpr Id DefaultId = 0;
+    static constexpr size_t MaxSize = 65536;
+
+    TextAttributeTable();
+
+    Id Intern(const TextAttribute& attr);
+    const TextAttribute& Get(Id id) const noexcept;
+    size_t Size() const noexcept;
+    std::vector<Id> Import(const TextAttributeTable& other);
+
+    bool NeedsCollection() const noexcept;
+    void Mark(Id id) noexcept;
+    void Sweep();
+
+    void SetCollector(std::function<void()> collector);
+
+    // Ids returned by Intern() and Import() aren't protected from collection until they're stored in a row.
+    // Code that holds on to them in the meantime (e.g. the mapping of an Import()) must suspend the collection.
+    [[nodiscard]] auto SuspendCollection() noexcept
+    {
+        ++_collectionSuspended;
+        return wil::scope_exit([this]() noexcept { --_collectionSuspended; });
+    }
+
+private:
+    struct Hasher
+    {
+        size_t operator()(const TextAttribute& attr) const noexcept;
+    };
+
+    Id _insert(const TextAttribute& attr);
+
+    std::vector<TextAttribute> _attributes;
+    std::unordered_map<TextAttribute, Id, Hasher> _ids;
+    std::vector<Id> _free;
+    // Used by the mark & sweep collection. It's as large as _attributes
+    // and free slots are always marked.
+    std::vector<bool> _marks;
+    size_t _collectionThreshold = 4096;
+    // Marks the ids in use and calls Sweep(). Provided by the TextBuffer that owns the table.
+    std::function<void()> _collector;
+    uint32_t _collectionSuspended = 0;
+    // Most writes use the same attributes as the previous one.
+    // Caching the last result avoids hashing them every time.
+    TextAttribute _lastAttribute;
+    Id _lastId = DefaultId;
+};
@@ -20,12 +20,19 @@ bool Search::Reset(Microsoft::Console::Render::IRenderData& renderData, const st
 {
     const auto& textBuffer = renderData.GetTextBuffer();
 
+    // The cache holds per-line results for the previous needle and flags. If only the buffer contents
+    // changed since, SearchText() will only search the lines that were modified in the meantime.
+    if (_needle != needle || _flags != flags)
+    {
+        _cache = {};
+    }
+
     _renderData = &renderData;
     _needle = needle;
     _flags = flags;
     _lastMutationId = textBuffer.GetLastMutationId();
 
-    auto result = textBuffer.SearchText(needle, _flags);
+    auto result = textBuffer.SearchText(needle, _flags, _cache);
     _ok = result.has_value();
     _results = std::move(result).value_or(std::vector<til::point_span>{});
     _index = reverse ? gsl::narrow_cast<ptrdiff_t>(_results.size()) - 1 : 0;
@@ -57,6 +57,7 @@ private:
     std::wstring _needle;
     SearchFlag _flags{};
     uint64_t _lastMutationId = 0;
+    TextBuffer::SearchCache _cache;
 
     bool _ok{ false };
     std::vector<til::point_span> _results;
@@ -4,6 +4,8 @@
 #include "precomp.h"
 #include "textBuffer.hpp"
 
+#include <execution>
+
 #include <til/hash.h>
 
 #include "UTextAdapter.h"
@@ -52,6 +54,7 @@ TextBuffer::TextBuffer(til::size screenBufferSize,
     // This way every TextBuffer will start with a ""unique"" _lastMutationId
     // and so it'll compare unequal with the counter of other TextBuffers.
     _lastMutationId{ s_lastMutationIdInitialValue.fetch_add(0x100000000) },
+    _changeJournalStart{ _lastMutationId },
     _cursor{ cursorSize, *this },
     _isActiveBuffer{ isActiveBuffer }
 {
@@ -59,6 +62,7 @@ TextBuffer::TextBuffer(til::size screenBufferSize,
     screenBufferSize.width = std::max(screenBufferSize.width, 1);
     screenBufferSize.height = std::max(screenBufferSize.height, 1);
     _reserve(screenBufferSize, defaultAttributes);
+    _attributeTable->SetCollector([this]() { _collectAttributes(); });
 }
 
 TextBuffer::~TextBuffer()
@@ -109,6 +113,7 @@ void TextBuffer::_reserve(til::size screenBufferSize, const TextAttribute& defau
     _bufferEnd = _buffer.get() + allocSize;
     _commitWatermark = _buffer.get();
     _initialAttributes = defaultAttributes;
+    _initialAttributesId = _attributeTable->Intern(defaultAttributes);
     _bufferRowStride = rowStride;
     _bufferOffsetChars = rowSize;
     _bufferOffsetCharOffsets = rowSize + charsBufferSize;
@@ -144,6 +149,12 @@ void TextBuffer::_decommit() noexcept
     _destroy();
     VirtualFree(_buffer.get(), 0, MEM_DECOMMIT);
     _commitWatermark = _buffer.get();
+    _packedRows.clear();
+    _unpackedColdRows.clear();
+    _markRows.clear();
+    _rowMap.clear();
+    _rowSlots.clear();
+    _resetChangeJournal();
 }
 
 // Constructs ROWs between [_commitWatermark,until).
@@ -151,19 +162,29 @@ void TextBuffer::_construct(const std::byte* until) noexcept
 {
     for (; _commitWatermark < until; _commitWatermark += _bufferRowStride)
     {
-        const auto row = reinterpret_cast<ROW*>(_commitWatermark);
-        const auto chars = reinterpret_cast<wchar_t*>(_commitWatermark + _bufferOffsetChars);
-        const auto indices = reinterpret_cast<uint16_t*>(_commitWatermark + _bufferOffsetCharOffsets);
-        std::construct_at(row, chars, indices, _width, _initialAttributes);
+        _constructRow(_commitWatermark);
     }
 }
 
+// Constructs a single ROW at the given address, which must be the start of a row stride.
+void TextBuffer::_constructRow(std::byte* row) noexcept
+{
+    const auto chars = reinterpret_cast<wchar_t*>(row + _bufferOffsetChars);
+    const auto indices = reinterpret_cast<uint16_t*>(row + _bufferOffsetCharOffsets);
+    std::construct_at(reinterpret_cast<ROW*>(row), chars, indices, _width, *_attributeTable, _initialAttributesId);
+}
+
 // Destructs ROWs between [_buffer,_commitWatermark).
 void TextBuffer::_destroy() const noexcept
 {
-    for (auto it = _buffer.get(); it < _commitWatermark; it += _bufferRowStride)
+    size_t offset = 0;
+    for (auto it = _buffer.get(); it < _commitWatermark; it += _bufferRowStride, ++offset)
     {
-        std::destroy_at(reinterpret_cast<ROW*>(it));
+        // Packed rows have already been destroyed by _packRow().
+        if (!_isPackedRow(offset))
+        {
+            std::destroy_at(reinterpret_cast<ROW*>(it));
+        }
     }
 }
 
@@ -178,27 +199,160 @@ ROW& TextBuffer::_getRowByOffsetDirect(size_t offset)
     {
         _commit(row);
     }
+    else if (_isPackedRow(offset)) [[unlikely]]
+    {
+        _unpackRow(offset, true);
+    }
 
     return *reinterpret_cast<ROW*>(row);
 }
 
-// See GetRowByOffset().
-ROW& TextBuffer::_getRow(til::CoordType y) const
+// Returns the circular row index ("slot") of the given row index. Unlike the offset of a row, its slot
+// is unaffected by ScrollRows(), and unlike its row index, it's unaffected by IncrementCircularBuffer().
+til::CoordType TextBuffer::_getRowSlot(til::CoordType y) const noexcept
 {
     // Rows are stored circularly, so the index you ask for is offset by the start position and mod the total of rows.
-    auto offset = (_firstRow + y) % _height;
+    auto slot = (_firstRow + y) % _height;
 
     // Support negative wrap around. This way an index of -1 will
     // wrap to _rowCount-1 and make implementing scrolling easier.
-    if (offset < 0)
+    if (slot < 0)
+    {
+        slot += _height;
+    }
+
+    return slot;
+}
+
+// The inverse of _getRowSlot().
+til::CoordType TextBuffer::_getSlotRowIndex(til::CoordType slot) const noexcept
+{
+    auto y = slot - _firstRow;
+    if (y < 0)
     {
-        offset += _height;
+        y += _height;
+    }
+    return y;
+}
+
+// Returns the offset for _getRowByOffsetDirect() that corresponds to the given row index.
+size_t TextBuffer::_getRowOffset(til::CoordType y) const noexcept
+{
+    const auto slot = _getRowSlot(y);
+
+    if (!_rowMap.empty())
+    {
+        return _rowMap[slot];
     }
 
     // We add 1 to the row offset, because row "0" is the one returned by GetScratchpadRow().
     // See GetScratchpadRow() for more explanation.
+    return gsl::narrow_cast<size_t>(slot) + 1;
+}
+
+// The inverse of _getRowOffset(). Returns the row index that corresponds to the given offset.
+til::CoordType TextBuffer::_getRowIndex(size_t offset) const noexcept
+{
+    return _getSlotRowIndex(_getOffsetSlot(offset));
+}
+
+// Returns the slot (see _getRowSlot()) of the row at the given offset.
+til::CoordType TextBuffer::_getOffsetSlot(size_t offset) const noexcept
+{
+    return _rowSlots.empty() ? gsl::narrow_cast<til::CoordType>(offset) - 1 : gsl::narrow_cast<til::CoordType>(_rowSlots[offset]);
+}
+
+// Moves the rows [top, top + count) by delta rows (positive is down) within that range,
+// by permuting their storage offsets. The rows that get pushed out of one end of the range
+// reappear at the other end. This costs O(count), independent of the width of the buffer.
+void TextBuffer::_rotateRows(const til::CoordType top, const til::CoordType count, const til::CoordType delta)
+{
+    if (_rowMap.empty())
+    {
+        _rowMap.resize(_height);
+        _rowSlots.resize(::base::strict_cast<size_t>(_height) + 1);
+        for (uint16_t slot = 0; slot < _height; ++slot)
+        {
+            _rowMap[slot] = gsl::narrow_cast<uint16_t>(slot + 1);
+            _rowSlots[slot + size_t{ 1 }] = slot;
+        }
+    }
+
+    const auto slotBeg = _getRowSlot(top);
+    const auto at = [&](til::CoordType i) -> uint16_t& {
+        return _rowMap[(slotBeg + i) % _height];
+    };
+
+    // Committing the row with the highest offset commits all the others as well.
+    // See the comment on _rowMap for why this is important.
+    uint16_t maxOffset = 0;
+    for (til::CoordType i = 0; i < count; ++i)
+    {
+        maxOffset = std::max(maxOffset, at(i));
+    }
+    _getRowByOffsetDirect(maxOffset);
+
+    // Rotating left by count - delta moves the row at i to i + delta. This uses the triple reversal
+    // algorithm, because the range may wrap around the end of _rowMap and std::rotate() can't handle that.
+    const auto reverse = [&](til::CoordType beg, til::CoordType end) {
+        for (--end; beg < end; ++beg, --end)
+        {
+            std::swap(at(beg), at(end));
+        }
+    };
+    const auto shift = ((count - delta) % count + count) % count;
+    reverse(0, shift);
+    reverse(shift, count);
+    reverse(0, count);
+
+    for (til::CoordType i = 0; i < count; ++i)
+    {
+        _rowSlots[at(i)] = gsl::narrow_cast<uint16_t>((slotBeg + i) % _height);
+    }
+
+    // The rows themselves didn't change, but they're now found at different indices.
+    ++_lastMutationId;
+    _journalSlotRangeChange(slotBeg, count);
+
+    // The marks of the rotated rows move along with them. _markRows is sorted by slot, so only the marks
+    // inside the range need to be looked at. Just like the range itself, they may wrap around the end.
+    if (!_markRows.empty())
+    {
+        std::vector<uint16_t> moved;
+        const auto extract = [&](til::CoordType beg, til::CoordType end) {
+            const auto first = std::lower_bound(_markRows.begin(), _markRows.end(), beg);
+            const auto last = std::lower_bound(first, _markRows.end(), end);
+            for (auto it = first; it != last; ++it)
+            {
+                auto i = *it - slotBeg;
+                if (i < 0)
+                {
+                    i += _height;
+                }
+                moved.emplace_back(gsl::narrow_cast<uint16_t>((slotBeg + ((i + delta) % count + count) % count) % _height));
+            }
+            _markRows.erase(first, last);
+        };
+
+        const auto slotEnd = slotBeg + count;
+        extract(slotBeg, std::min<til::CoordType>(slotEnd, _height));
+        if (slotEnd > _height)
+        {
+            extract(0, slotEnd - _height);
+        }
+
+        for (const auto slot : moved)
+        {
+            _markRows.insert(std::lower_bound(_markRows.begin(), _markRows.end(), slot), slot);
+        }
+    }
+}
+
+// See GetRowByOffset().
+ROW& TextBuffer::_getRow(til::CoordType y) const
+{
 #pragma warning(suppress : 26492) // Don't use const_cast to cast away const or volatile (type.3).
-    return const_cast<TextBuffer*>(this)->_getRowByOffsetDirect(gsl::narrow_cast<size_t>(offset) + 1);
+    return const_cast<TextBuffer*>(this)->_getRowByOffsetDirect(_getRowOffset(y));
 }
 
 // Returns the "user-visible" index of the last committed row, which can be used
@@ -225,8 +379,135 @@ const ROW& TextBuffer::GetRowByOffset(const til::CoordType index) const
 // (what corresponds to the top row of the screen buffer).
 ROW& TextBuffer::GetMutableRowByOffset(const til::CoordType index)
 {
-    _lastMutationId++;
-    return _getRow(index);
+    auto& row = _getRow(index);
+    // Every row that is handed out for modification gets a new, unique generation.
+    // This allows consumers like SearchText() to tell which rows changed since they last looked.
+    row.SetGeneration(++_lastMutationId);
+    _journalRowChange(_getRowOffset(index));
+    return row;
+}
+
+// Records that the row at the given offset changed at generation _lastMutationId. See GetRowsChangedSince().
+void TextBuffer::_journalRowChange(const size_t offset)
+{
+    const auto o = gsl::narrow_cast<uint16_t>(offset);
+
+    // Consecutive modifications of the same row are very common (e.g. when writing a line of text).
+    if (!_changeJournal.empty() && _changeJournal.back().slotCount == 0 && _changeJournal.back().offset == o)
+    {
+        _changeJournal.back().generation = _lastMutationId;
+        return;
+    }
+
+    _changeJournal.push_back({ _lastMutationId, o });
+    _compactChangeJournal();
+}
+
+// Records that the rows in the slots [slotBeg, slotBeg + count) (see _getRowSlot()) changed at generation
+// _lastMutationId. Unlike calling _journalRowChange() for each of them, this costs O(1).
+void TextBuffer::_journalSlotRangeChange(const til::CoordType slotBeg, const til::CoordType count)
+{
+    _changeJournal.push_back({ _lastMutationId, gsl::narrow_cast<uint16_t>(slotBeg), gsl::narrow_cast<uint16_t>(count) });
+    _compactChangeJournal();
+}
+
+void TextBuffer::_compactChangeJournal()
+{
+    if (_changeJournal.size() <= 2 * size_t{ _height } + 64)
+    {
+        return;
+    }
+
+    // Keep only the most recent entry of each row. This preserves the order of the remaining ones. Since rows
+    // only ever move through ScrollRows(), which journals the entire range it moved them in, a newer entry for
+    // the current slot of a row supersedes all older ones. A range is kept if it covers any slot that's unseen.
+    std::vector<bool> seen(_height);
+    auto out = _changeJournal.end();
+    for (auto it = _changeJournal.end(); it != _changeJournal.begin();)
+    {
+        --it;
+        auto keep = false;
+        if (it->slotCount == 0)
+        {
+            const auto slot = _getOffsetSlot(it->offset);
+            keep = !seen[slot];
+            seen[slot] = true;
+        }
+        else
+        {
+            for (til::CoordType i = 0; i < it->slotCount; ++i)
+            {
+                const auto slot = (it->offset + i) % _height;
+                keep |= !seen[slot];
+                seen[slot] = true;
+            }
+        }
+        if (keep)
+        {
+            *--out = *it;
+        }
+    }
+    _changeJournal.erase(_changeJournal.begin(), out);
+}
+
+// Forgets all recorded changes, because the contents of the buffer were replaced wholesale.
+// GetRowsChangedSince() reports all rows as changed for any generation before now.
+void TextBuffer::_resetChangeJournal() noexcept
+{
+    _changeJournal.clear();
+    _changeJournalStart = ++_lastMutationId;
+}
+
+// Returns the rows that were modified since the given generation, which is usually the `generation`
+// member of a previous result, or GetLastMutationId(). This allows consumers to only process the
+// rows that changed, instead of scanning the entire buffer (or viewport) after every write.
+TextBuffer::RowChanges TextBuffer::GetRowsChangedSince(const uint64_t generation) const
+{
+    RowChanges changes{
+        .generation = _lastMutationId,
+        .scrollCount = _scrollCount,
+    };
+
+    if (generation < _changeJournalStart || generation > _lastMutationId)
+    {
+        changes.all = true;
+        return changes;
+    }
+
+    const auto beg = std::upper_bound(_changeJournal.begin(), _changeJournal.end(), generation, [](uint64_t g, const ChangeJournalEntry& entry) {
+        return g < entry.generation;
+    });
+
+    changes.rows.reserve(_changeJournal.end() - beg);
+    for (auto it = beg; it != _changeJournal.end(); ++it)
+    {
+        if (it->slotCount == 0)
+        {
+            changes.rows.emplace_back(_getRowIndex(it->offset));
+        }
+        else
+        {
+            for (til::CoordType i = 0; i < it->slotCount; ++i)
+            {
+                changes.rows.emplace_back(_getSlotRowIndex((it->offset + i) % _height));
+            }
+        }
+    }
+
+    std::sort(changes.rows.begin(), changes.rows.end());
+    changes.rows.erase(std::unique(changes.rows.begin(), changes.rows.end()), changes.rows.end());
+    return changes;
+}
+
+// Identical to GetRowByOffset(index).GetGeneration(), but doesn't unpack cold rows.
+uint64_t TextBuffer::GetRowGeneration(const til::CoordType index) const
+{
+    const auto offset = _getRowOffset(index);
+    if (_isPackedRow(offset))
+    {
+        return _packedRows[offset].GetGeneration();
+    }
+    return GetRowByOffset(index).GetGeneration();
 }
 
 // Returns a row filled with whitespace and the current attributes, for you to freely use.
@@ -246,6 +527,178 @@ ROW& TextBuffer::GetScratchpadRow(const TextAttribute& attributes)
     return r;
 }
 
+bool TextBuffer::_isPackedRow(size_t offset) const noexcept
+{
+    return offset < _packedRows.size() && _packedRows[offset];
+}
+
+// Packs the ROW at the given offset into the cold scrollback tier.
+void TextBuffer::_packRow(size_t offset)
+{
+    const auto row = _buffer.get() + _bufferRowStride * offset;
+    // Rows that have never been committed are as compact as it gets already.
+    // The scratchpad row at offset 0 is used too frequently to ever be packed.
+    if (offset == 0 || row >= _commitWatermark || _isPackedRow(offset))
+    {
+        return;
+    }
+
+    if (_packedRows.empty())
+    {
+        _packedRows.resize(::base::strict_cast<size_t>(_height) + 1);
+    }
+
+    auto& r = *reinterpret_cast<ROW*>(row);
+    _packedRows[offset] = PackedRow::Pack(r);
+    std::destroy_at(&r);
+    _decommitPackedPages(row);
+}
+
+// The counterpart to _packRow(). If restoreContents is false, the packed
+// contents are discarded and the row is constructed with _initialAttributes.
+// Marked as noinline for the same reason as _commit().
+__declspec(noinline) void TextBuffer::_unpackRow(size_t offset, bool restoreContents)
+{
+    const auto row = _buffer.get() + _bufferRowStride * offset;
+
+    // _decommitPackedPages() may have released the pages this row is stored in.
+    // Committing memory that is already committed is a cheap no-op.
+    THROW_LAST_ERROR_IF_NULL(VirtualAlloc(row, _bufferRowStride, MEM_COMMIT, PAGE_READWRITE));
+
+    _constructRow(row);
+    auto packed = std::move(_packedRows[offset]);
+
+    if (restoreContents)
+    {
+        try
+        {
+            packed.Unpack(*reinterpret_cast<ROW*>(row));
+        }
+        catch (...)
+        {
+            // Keep the row in a consistent, albeit empty, state.
+            reinterpret_cast<ROW*>(row)->Reset(_initialAttributesId);
+            throw;
+        }
+
+        // The row is still in the cold region of the buffer. Rows are left unpacked for a while after
+        // they were accessed, so that scrolling around in the scrollback doesn't pack and unpack the
+        // same rows over and over again. But a search or copy of the entire scrollback shouldn't leave
+        // all of it unpacked, so once there are too many, the least recently unpacked one is packed.
+        _unpackedColdRows.emplace_back(offset);
+        while (_unpackedColdRows.size() > _unpackedColdRowBudget)
+        {
+            const auto oldest = _unpackedColdRows.front();
+            _unpackedColdRows.pop_front();
+            // The row may have been packed again or become hot in the meantime.
+            if (oldest != offset && _isColdRow(oldest))
+            {
+                _packRow(oldest);
+            }
+        }
+    }
+}
+
+// MEM_DECOMMITs all memory pages overlapping the given (already destroyed) row,
+// as long as they aren't shared with any other row that isn't packed.
+void TextBuffer::_decommitPackedPages(const std::byte* row) noexcept
+{
+    // VirtualAlloc() reservations are always page aligned and Windows uses 4KiB pages on all our platforms.
+    static constexpr uintptr_t pageSize = 4096;
+
+    const auto base = _buffer.get();
+    const auto rowBeg = gsl::narrow_cast<uintptr_t>(row - base);
+    const auto rowEnd = rowBeg + _bufferRowStride;
+    const auto committedEnd = gsl::narrow_cast<uintptr_t>(_commitWatermark - base);
+
+    for (auto page = rowBeg & ~(pageSize - 1); page < rowEnd; page += pageSize)
+    {
+        if (page + pageSize > committedEnd)
+        {
+            break;
+        }
+
+        const auto first = page / _bufferRowStride;
+        const auto last = (page + pageSize - 1) / _bufferRowStride;
+        auto exclusive = true;
+        for (auto offset = first; exclusive && offset <= last; ++offset)
+        {
+            exclusive = _isPackedRow(offset);
+        }
+
+        if (exclusive)
+        {
+            VirtualFree(base + page, pageSize, MEM_DECOMMIT);
+        }
+    }
+}
+
+// Returns true if the row at the given offset is in the cold region of the buffer.
+bool TextBuffer::_isColdRow(size_t offset) const noexcept
+{
+    if (offset == 0 || _hotRowCount <= 0 || _hotRowCount >= _height)
+    {
+        return false;
+    }
+    return _getRowIndex(offset) < _height - _hotRowCount;
+}
+
+// Moves the row that has scrolled out of the hot region at the bottom of the buffer into the cold
+// scrollback tier. This is called whenever the circular buffer rotates, which is when rows cross
+// into the cold region. Cold rows that were unpacked on access are packed again by _unpackRow().
+void TextBuffer::_packColdRows()
+{
+    if (_hotRowCount <= 0 || _hotRowCount >= _height)
+    {
+        return;
+    }
+
+    const auto coldRowCount = _height - _hotRowCount;
+    _packRow(_getRowOffset(coldRowCount - 1));
+}
+
+// Packs every row in the cold region. _packColdRows() only packs the one row that crosses into the
+// cold region per rotation, which isn't enough when the region changes all at once: after a reflow,
+// after a resize and when EnableColdScrollback() changes the size of the hot region.
+void TextBuffer::_packColdRegion()
+{
+    if (_hotRowCount <= 0 || _hotRowCount >= _height)
+    {
+        return;
+    }
+
+    const auto coldRowCount = _height - _hotRowCount;
+    for (til::CoordType y = 0; y < coldRowCount; ++y)
+    {
+        _packRow(_getRowOffset(y));
+    }
+
+    // All cold rows are packed now and the remaining ones are hot.
+    _unpackedColdRows.clear();
+}
+
+// Identical to GetRowByOffset(y).GetHyperlinks(), but doesn't unpack cold rows.
+std::vector<uint16_t> TextBuffer::_getHyperlinks(til::CoordType y) const
+{
+    const auto offset = _getRowOffset(y);
+    if (_isPackedRow(offset))
+    {
+        return _packedRows[offset].GetHyperlinks(*_attributeTable);
+    }
+    return GetRowByOffset(y).GetHyperlinks();
+}
+
+// Identical to GetRowByOffset(y).GetScrollbarData(), but doesn't unpack cold rows.
+const std::optional<ScrollbarData>& TextBuffer::_getScrollbarData(til::CoordType y) const
+{
+    const auto offset = _getRowOffset(y);
+    if (_isPackedRow(offset))
+    {
+        return _packedRows[offset].GetScrollbarData();
+    }
+    return GetRowByOffset(y).GetScrollbarData();
+}
+
 #pragma warning(pop)
 #pragma endregion
 
@@ -720,6 +1173,12 @@ void TextBuffer::IncrementCircularBuffer(const TextAttribute& fillAttributes)
     _PruneHyperlinks();
 
     // Second, clean out the old "first row" as it will become the "last row" of the buffer after the circle is performed.
+    // If it's a packed row, we can skip unpacking its contents since we'll overwrite them anyway.
+    if (const auto offset = _getRowOffset(0); _isPackedRow(offset))
+    {
+        _unpackRow(offset, false);
+    }
+    _removeMarkRow(0);
     GetMutableRowByOffset(0).Reset(fillAttributes);
     {
         // Now proceed to increment.
@@ -731,7 +1190,80 @@ void TextBuffer::IncrementCircularBuffer(const TextAttribute& fillAttributes)
         {
             _firstRow = 0;
         }
+        _scrollCount++;
+    }
+
+    _packColdRows();
+
+    // Rows that scroll out of the buffer may have been the last users of some attributes.
+    if (_attributeTable->NeedsCollection())
+    {
+        _collectAttributes();
+    }
+}
+
+// Frees the ids in the attribute table that aren't referenced by any row anymore.
+void TextBuffer::_collectAttributes()
+{
+    auto& table = *_attributeTable;
+    size_t offset = 0;
+
+    // This includes the scratchpad row.
+    for (auto it = _buffer.get(); it < _commitWatermark; it += _bufferRowStride, ++offset)
+    {
+        if (_isPackedRow(offset))
+        {
+            _packedRows[offset].MarkAttributes(table);
+        }
+        else
+        {
+            for (const auto& run : reinterpret_cast<const ROW*>(it)->Attributes().runs())
+            {
+                table.Mark(run.value);
+            }
+        }
     }
+
+    table.Mark(_initialAttributesId);
+    table.Sweep();
+
+    // Sweep() may have freed the id and the next Intern() would then reuse it.
+    _initialAttributesId = table.Intern(_initialAttributes);
+}
+
+// Enables the cold scrollback tier, which packs rows that are more than viewportHeight+1024 rows
+// away from the bottom of the buffer into a compact representation. They're transparently
+// unpacked when accessed. Rows that are already in the cold region are packed immediately, and
+// after that as they scroll into it via IncrementCircularBuffer(), Reflow() or ResizeTraditional().
+// Pass 0 to disable the tier. This will not unpack any rows that are already packed.
+void TextBuffer::EnableColdScrollback(til::CoordType viewportHeight)
+{
+    // The additional 1024 rows ensure that small scrolls by the user don't immediately hit the cold tier.
+    _hotRowCount = viewportHeight > 0 ? viewportHeight + 1024 : 0;
+    _packColdRegion();
+}
+
+// Returns the amount of memory used by packed rows in the cold scrollback tier.
+size_t TextBuffer::GetColdScrollbackMemoryUsage() const noexcept
+{
+    size_t usage = 0;
+    for (const auto& packed : _packedRows)
+    {
+        usage += packed.MemoryUsage();
+    }
+    return usage;
+}
+
+// Returns the table that resolves the attribute ids stored in this buffer's rows.
+TextAttributeTable& TextBuffer::GetAttributeTable() const noexcept
+{
+    return *_attributeTable;
+}
+
+// Returns the table used to share identical image pixels between the rows of this buffer.
+ImageTileTable& TextBuffer::GetImageTileTable() noexcept
+{
+    return _imageTileTable;
 }
 
 //Routine Description:
@@ -792,7 +1324,12 @@ void TextBuffer::_SetFirstRowIndex(const til::CoordType FirstRowIndex) noexcept
     _firstRow = FirstRowIndex;
 }
 
-void TextBuffer::ScrollRows(const til::CoordType firstRow, til::CoordType size, const til::CoordType delta)
+// Routine Description:
+// - Moves the rows [firstRow, firstRow + size) by delta rows (positive is down).
+// Arguments:
+// - keepVacatedRows - The rows that the scroll leaves behind keep their original contents if true.
+//   Pass false if they get overwritten anyway, which allows scrolling without copying any of them.
+void TextBuffer::ScrollRows(const til::CoordType firstRow, til::CoordType size, const til::CoordType delta, const bool keepVacatedRows)
 {
     if (delta == 0)
     {
@@ -803,6 +1340,33 @@ void TextBuffer::ScrollRows(const til::CoordType firstRow, til::CoordType size,
     // A negative size doesn't make any sense anyways.
     size = std::max(0, size);
 
+    // If the source and destination overlap, which is the case when scrolling inside of DECSTBM margins, we can
+    // rotate the rows instead of copying each of them. Only the |delta| rows that the scroll leaves behind need to be
+    // copied, if the caller relies on them retaining their original contents (e.g. ScrollConsoleScreenBufferW with a
+    // clip rectangle). They receive the storage of the rows that got scrolled out, including their scrollbar data, which
+    // gets cleared. Unlike with copying, the scrollbar data of the moved rows thus moves along with their contents.
+    const auto distance = std::abs(delta);
+    if (distance < size && size + distance <= _height)
+    {
+        _rotateRows(std::min(firstRow, firstRow + delta), size + distance, delta);
+
+        const auto vacatedBeg = delta > 0 ? firstRow : firstRow + size + delta;
+        for (auto vacated = vacatedBeg; vacated < vacatedBeg + distance; ++vacated)
+        {
+            // The original contents of the vacated row are now found delta rows away.
+            if (keepVacatedRows)
+            {
+                CopyRow(vacated + delta, vacated, *this);
+            }
+            if (_getScrollbarData(vacated).has_value())
+            {
+                GetMutableRowByOffset(vacated).SetScrollbarData(std::nullopt);
+                _removeMarkRow(vacated);
+            }
+        }
+        return;
+    }
+
     til::CoordType y = 0;
     til::CoordType end = 0;
     til::CoordType step = 0;
@@ -976,10 +1540,21 @@ void TextBuffer::Reset() noexcept
 {
     _decommit();
     _initialAttributes = _currentAttributes;
-}
 
-// Arguments:
-// - newFirstRow: The current y-position of the viewport. We'll clear up until here.
+    try
+    {
+        _initialAttributesId = _attributeTable->Intern(_initialAttributes);
+    }
+    catch (...)
+    {
+        LOG_CAUGHT_EXCEPTION();
+        _initialAttributes = {};
+        _initialAttributesId = TextAttributeTable::DefaultId;
+    }
+}
+
+// Arguments:
+// - newFirstRow: The current y-position of the viewport. We'll clear up until here.
 // - rowsToKeep: the number of rows to keep in the buffer.
 void TextBuffer::ClearScrollback(const til::CoordType newFirstRow, const til::CoordType rowsToKeep)
 {
@@ -1005,12 +1580,12 @@ void TextBuffer::ClearScrollback(const til::CoordType newFirstRow, const til::Co
     // operates modulo the buffer height and so the possibly-too-large startAbsolute won't be an issue.
     const auto startAbsolute = _firstRow + newFirstRow;
     _firstRow = 0;
-    ScrollRows(startAbsolute, rowsToKeep, -startAbsolute);
+    ScrollRows(startAbsolute, rowsToKeep, -startAbsolute, false);
 
     const auto end = _estimateOffsetOfLastCommittedRow();
     for (auto y = rowsToKeep; y <= end; ++y)
     {
-        GetMutableRowByOffset(y).Reset(_initialAttributes);
+        GetMutableRowByOffset(y).Reset(_initialAttributesId);
     }
 }
 
@@ -1047,13 +1622,25 @@ void TextBuffer::ResizeTraditional(til::size newSize)
     _bufferEnd = newBuffer._bufferEnd;
     _commitWatermark = newBuffer._commitWatermark;
     _initialAttributes = newBuffer._initialAttributes;
+    _initialAttributesId = newBuffer._initialAttributesId;
+    _attributeTable = std::move(newBuffer._attributeTable);
+    // The collector of newBuffer's table would walk the rows of newBuffer.
+    _attributeTable->SetCollector([this]() { _collectAttributes(); });
     _bufferRowStride = newBuffer._bufferRowStride;
     _bufferOffsetChars = newBuffer._bufferOffsetChars;
     _bufferOffsetCharOffsets = newBuffer._bufferOffsetCharOffsets;
+    _packedRows = std::move(newBuffer._packedRows);
+    _unpackedColdRows = std::move(newBuffer._unpackedColdRows);
     _width = newBuffer._width;
     _height = newBuffer._height;
+    // CopyRow() doesn't copy marks.
+    _markRows.clear();
+    _rowMap.clear();
+    _rowSlots.clear();
+    _resetChangeJournal();
 
     _SetFirstRowIndex(0);
+    _packColdRegion();
 }
 
 void TextBuffer::SetAsActiveBuffer(const bool isActiveBuffer) noexcept
@@ -1417,7 +2004,7 @@ void TextBuffer::_PruneHyperlinks()
     // If the buffer does not contain the same reference, we can remove that hyperlink from our map
     // This way, obsolete hyperlink references are cleared from our hyperlink map instead of hanging around
     // Get all the hyperlink references in the row we're erasing
-    const auto hyperlinks = GetRowByOffset(0).GetHyperlinks();
+    const auto hyperlinks = _getHyperlinks(0);
 
     if (!hyperlinks.empty())
     {
@@ -1433,7 +2020,7 @@ void TextBuffer::_PruneHyperlinks()
         // to see if those references are anywhere else
         for (til::CoordType i = 1; i < total; ++i)
         {
-            const auto nextRowRefs = GetRowByOffset(i).GetHyperlinks();
+            const auto nextRowRefs = _getHyperlinks(i);
             for (auto id : nextRowRefs)
             {
                 if (firstRowRefs.find(id) != firstRowRefs.end())
@@ -1886,6 +2473,108 @@ std::tuple<til::CoordType, til::CoordType, bool> TextBuffer::_RowCopyHelper(cons
     return { rowBeg, rowEnd, addLineBreak };
 }
 
+// Copying a selection formats its rows in chunks of this many rows, which are processed in parallel.
+// 1024 rows of 120 columns take roughly 100us to format as HTML, which amortizes the scheduling overhead.
+static constexpr til::CoordType copyChunkSize = 1024;
+
+// Formats the rows [beg, end] in chunks of copyChunkSize rows, calling formatRows(chunkBeg, chunkEnd, out) to
+// format the rows [chunkBeg, chunkEnd) into `out`. The chunks are formatted in parallel and then passed to
+// sink() in order. formatRows() gets called concurrently and must only read from the buffer.
+template<typename String, typename FormatRows, typename Sink>
+static void formatRowChunks(const til::CoordType beg, const til::CoordType end, const FormatRows& formatRows, const Sink& sink)
+{
+    const auto chunkCount = gsl::narrow_cast<size_t>((end - beg) / copyChunkSize + 1);
+    std::vector<String> chunks(chunkCount);
+    std::vector<std::exception_ptr> exceptions(chunkCount);
+
+    // Exceptions must not escape from std::for_each(std::execution::par), as that calls std::terminate().
+    const auto format = [&](String& out) noexcept {
+        const auto i = gsl::narrow_cast<size_t>(&out - chunks.data());
+        const auto chunkBeg = beg + gsl::narrow_cast<til::CoordType>(i) * copyChunkSize;
+        const auto chunkEnd = std::min(chunkBeg + copyChunkSize, end + 1);
+        try
+        {
+            formatRows(chunkBeg, chunkEnd, out);
+        }
+        catch (...)
+        {
+            til::at(exceptions, i) = std::current_exception();
+        }
+    };
+
+    if (std::thread::hardware_concurrency() > 1 && chunkCount > 1)
+    {
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), format);
+    }
+    else
+    {
+        std::for_each(chunks.begin(), chunks.end(), format);
+    }
+
+    for (const auto& exception : exceptions)
+    {
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    sink(std::span{ chunks });
+}
+
+// Concatenates the given parts with a single allocation, releasing each part once it has been appended.
+template<typename String>
+static String joinCopyParts(std::vector<String>& parts)
+{
+    size_t size = 0;
+    for (const auto& part : parts)
+    {
+        size += part.size();
+    }
+
+    String result;
+    result.reserve(size);
+    for (auto& part : parts)
+    {
+        result.append(part);
+        String{}.swap(part);
+    }
+    return result;
+}
+
+// Routine Description:
+// - Touches all rows of the copy request, which ensures that they're committed and unpacked (see
+//   _getRowByOffsetDirect()), so that formatRowChunks() can read them concurrently without modifying the buffer.
+// Arguments:
+// - req - the copy request
+// - onAttribute - Optional. Called once for each distinct attribute in the selection, in the order they appear in.
+void TextBuffer::_PrepareCopy(const CopyRequest& req, const std::function<void(TextAttributeTable::Id)>& onAttribute) const
+{
+    std::vector<bool> seen(onAttribute ? _attributeTable->Size() : 0);
+
+    for (auto iRow = req.beg.y; iRow <= req.end.y; ++iRow)
+    {
+        const auto& row = GetRowByOffset(iRow);
+        if (!onAttribute)
+        {
+            continue;
+        }
+
+        const auto [rowBeg, rowEnd, addLineBreak] = _RowCopyHelper(req, iRow, row);
+        const auto rowBegU16 = gsl::narrow_cast<uint16_t>(rowBeg);
+        const auto rowEndU16 = gsl::narrow_cast<uint16_t>(rowEnd);
+
+        for (const auto& run : row.Attributes().slice(rowBegU16, rowEndU16).runs())
+        {
+            if (!seen.at(run.value))
+            {
+                seen.at(run.value) = true;
+                onAttribute(run.value);
+            }
+        }
+    }
+}
+
 // Routine Description:
 // - Retrieves the text data from the buffer and presents it in a clipboard-ready format.
 // Arguments:
@@ -1893,29 +2582,40 @@ std::tuple<til::CoordType, til::CoordType, bool> TextBuffer::_RowCopyHelper(cons
 // Return Value:
 // - The text data from the selected region of the text buffer. Empty if the copy request is invalid.
 std::wstring TextBuffer::GetPlainText(const CopyRequest& req) const
+{
+    std::vector<std::wstring> parts;
+    _CopyPlainText(req, [&](std::span<std::wstring> chunks) {
+        std::move(chunks.begin(), chunks.end(), std::back_inserter(parts));
+    });
+    return joinCopyParts(parts);
+}
+
+void TextBuffer::_CopyPlainText(const CopyRequest& req, const std::function<void(std::span<std::wstring>)>& sink) const
 {
     if (req.beg > req.end)
     {
-        return {};
+        return;
     }
 
-    std::wstring selectedText;
+    _PrepareCopy(req, nullptr);
 
-    for (auto iRow = req.beg.y; iRow <= req.end.y; ++iRow)
-    {
-        const auto& row = GetRowByOffset(iRow);
-        const auto& [rowBeg, rowEnd, addLineBreak] = _RowCopyHelper(req, iRow, row);
+    const auto formatRows = [&](const til::CoordType beg, const til::CoordType end, std::wstring& selectedText) {
+        for (auto iRow = beg; iRow < end; ++iRow)
+        {
+            const auto& row = GetRowByOffset(iRow);
+            const auto& [rowBeg, rowEnd, addLineBreak] = _RowCopyHelper(req, iRow, row);
 
-        // save selected text
-        selectedText += row.GetText(rowBeg, rowEnd);
+            // save selected text
+            selectedText += row.GetText(rowBeg, rowEnd);
 
-        if (addLineBreak && iRow != req.end.y)
-        {
-            selectedText += L"\r\n";
+            if (addLineBreak && iRow != req.end.y)
+            {
+                selectedText += L"\r\n";
+            }
         }
-    }
+    };
 
-    return selectedText;
+    formatRowChunks<std::wstring>(req.beg.y, req.end.y, formatRows, sink);
 }
 
 // Routine Description:
@@ -1935,6 +2635,29 @@ std::string TextBuffer::GenHTML(const CopyRequest& req,
                                 const COLORREF backgroundColor,
                                 const bool isIntenseBold,
                                 std::function<std::tuple<COLORREF, COLORREF, COLORREF>(const TextAttribute&)> GetAttributeColors) const noexcept
+{
+    try
+    {
+        std::vector<std::string> parts;
+        _CopyHTML(req, fontHeightPoints, fontFaceName, backgroundColor, isIntenseBold, GetAttributeColors, [&](std::span<std::string> chunks) {
+            std::move(chunks.begin(), chunks.end(), std::back_inserter(parts));
+        });
+        return joinCopyParts(parts);
+    }
+    catch (...)
+    {
+        LOG_HR(wil::ResultFromCaughtException());
+        return {};
+    }
+}
+
+void TextBuffer::_CopyHTML(const CopyRequest& req,
+                           const int fontHeightPoints,
+                           const std::wstring_view fontFaceName,
+                           const COLORREF backgroundColor,
+                           const bool isIntenseBold,
+                           const std::function<std::tuple<COLORREF, COLORREF, COLORREF>(const TextAttribute&)>& GetAttributeColors,
+                           const std::function<void(std::span<std::string>)>& sink) const
 {
     // GH#5347 - Don't provide a title for the generated HTML, as many
     // web applications will paste the title first, followed by the HTML
@@ -1942,40 +2665,48 @@ std::string TextBuffer::GenHTML(const CopyRequest& req,
 
     if (req.beg > req.end)
     {
-        return {};
+        return;
     }
 
-    try
-    {
-        std::string htmlBuilder;
+    // GetAttributeColors() isn't necessarily safe to call concurrently,
+    // so we resolve the colors of all attributes up front.
+    std::vector<std::tuple<COLORREF, COLORREF, COLORREF>> attributeColors(_attributeTable->Size());
+    _PrepareCopy(req, [&](const TextAttributeTable::Id id) {
+        attributeColors.at(id) = GetAttributeColors(_attributeTable->Get(id));
+    });
 
-        // First we have to add some standard HTML boiler plate required for
-        // CF_HTML as part of the HTML Clipboard format
-        constexpr std::string_view htmlHeader = "<!DOCTYPE><HTML><HEAD></HEAD><BODY>";
-        htmlBuilder += htmlHeader;
+    // The parts are: The CF_HTML header, the start of the document, the rows and the end of the document.
+    std::vector<std::string> parts(2);
+    auto& htmlStart = parts[1];
 
-        htmlBuilder += "<!--StartFragment -->";
+    // First we have to add some standard HTML boiler plate required for
+    // CF_HTML as part of the HTML Clipboard format
+    constexpr std::string_view htmlHeader = "<!DOCTYPE><HTML><HEAD></HEAD><BODY>";
+    htmlStart += htmlHeader;
 
-        // apply global style in div element
-        {
-            htmlBuilder += "<DIV STYLE=\"";
-            htmlBuilder += "display:inline-block;";
-            htmlBuilder += "white-space:pre;";
-            fmt::format_to(std::back_inserter(htmlBuilder), FMT_COMPILE("background-color:{};"), Utils::ColorToHexString(backgroundColor));
+    htmlStart += "<!--StartFragment -->";
+
+    // apply global style in div element
+    {
+        htmlStart += "<DIV STYLE=\"";
+        htmlStart += "display:inline-block;";
+        htmlStart += "white-space:pre;";
+        fmt::format_to(std::back_inserter(htmlStart), FMT_COMPILE("background-color:{};"), Utils::ColorToHexString(backgroundColor));
 
-            // even with different font, add monospace as fallback
-            fmt::format_to(std::back_inserter(htmlBuilder), FMT_COMPILE("font-family:'{}',monospace;"), til::u16u8(fontFaceName));
+        // even with different font, add monospace as fallback
+        fmt::format_to(std::back_inserter(htmlStart), FMT_COMPILE("font-family:'{}',monospace;"), til::u16u8(fontFaceName));
 
-            fmt::format_to(std::back_inserter(htmlBuilder), FMT_COMPILE("font-size:{}pt;"), fontHeightPoints);
+        fmt::format_to(std::back_inserter(htmlStart), FMT_COMPILE("font-size:{}pt;"), fontHeightPoints);
 
-            // note: MS Word doesn't support padding (in this way at least)
-            // todo: customizable padding
-            htmlBuilder += "padding:4px;";
+        // note: MS Word doesn't support padding (in this way at least)
+        // todo: customizable padding
+        htmlStart += "padding:4px;";
 
-            htmlBuilder += "\">";
-        }
+        htmlStart += "\">";
+    }
 
-        for (auto iRow = req.beg.y; iRow <= req.end.y; ++iRow)
+    const auto formatRows = [&](const til::CoordType beg, const til::CoordType end, std::string& htmlBuilder) {
+        for (auto iRow = beg; iRow < end; ++iRow)
         {
             const auto& row = GetRowByOffset(iRow);
             const auto [rowBeg, rowEnd, addLineBreak] = _RowCopyHelper(req, iRow, row);
@@ -1984,10 +2715,11 @@ std::string TextBuffer::GenHTML(const CopyRequest& req,
             const auto runs = row.Attributes().slice(rowBegU16, rowEndU16).runs();
 
             auto x = rowBegU16;
-            for (const auto& [attr, length] : runs)
+            for (const auto& [attrId, length] : runs)
             {
+                const auto& attr = _attributeTable->Get(attrId);
                 const auto nextX = gsl::narrow_cast<uint16_t>(x + length);
-                const auto [fg, bg, ul] = GetAttributeColors(attr);
+                const auto [fg, bg, ul] = attributeColors.at(attrId);
                 const auto fgHex = Utils::ColorToHexString(fg);
                 const auto bgHex = Utils::ColorToHexString(bg);
                 const auto ulHex = Utils::ColorToHexString(ul);
@@ -2091,40 +2823,41 @@ std::string TextBuffer::GenHTML(const CopyRequest& req,
                 htmlBuilder += "<BR>";
             }
         }
+    };
 
-        htmlBuilder += "</DIV>";
-
-        htmlBuilder += "<!--EndFragment -->";
-
-        constexpr std::string_view HtmlFooter = "</BODY></HTML>";
-        htmlBuilder += HtmlFooter;
-
-        // once filled with values, there will be exactly 157 bytes in the clipboard header
-        constexpr size_t ClipboardHeaderSize = 157;
+    formatRowChunks<std::string>(req.beg.y, req.end.y, formatRows, [&](std::span<std::string> chunks) {
+        std::move(chunks.begin(), chunks.end(), std::back_inserter(parts));
+    });
 
-        // these values are byte offsets from start of clipboard
-        const auto htmlStartPos = ClipboardHeaderSize;
-        const auto htmlEndPos = ClipboardHeaderSize + gsl::narrow<size_t>(htmlBuilder.length());
-        const auto fragStartPos = ClipboardHeaderSize + gsl::narrow<size_t>(htmlHeader.length());
-        const auto fragEndPos = htmlEndPos - HtmlFooter.length();
+    constexpr std::string_view HtmlFooter = "</BODY></HTML>";
+    parts.emplace_back("</DIV><!--EndFragment -->").append(HtmlFooter);
 
-        // header required by HTML 0.9 format
-        std::string clipHeaderBuilder;
-        clipHeaderBuilder += "Version:0.9\r\n";
-        fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("StartHTML:{:0>10}\r\n"), htmlStartPos);
-        fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("EndHTML:{:0>10}\r\n"), htmlEndPos);
-        fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("StartFragment:{:0>10}\r\n"), fragStartPos);
-        fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("EndFragment:{:0>10}\r\n"), fragEndPos);
-        fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("StartSelection:{:0>10}\r\n"), fragStartPos);
-        fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("EndSelection:{:0>10}\r\n"), fragEndPos);
+    // once filled with values, there will be exactly 157 bytes in the clipboard header
+    constexpr size_t ClipboardHeaderSize = 157;
 
-        return clipHeaderBuilder + htmlBuilder;
-    }
-    catch (...)
+    size_t htmlLength = 0;
+    for (const auto& part : parts)
     {
-        LOG_HR(wil::ResultFromCaughtException());
-        return {};
+        htmlLength += part.size();
     }
+
+    // these values are byte offsets from start of clipboard
+    const auto htmlStartPos = ClipboardHeaderSize;
+    const auto htmlEndPos = ClipboardHeaderSize + htmlLength;
+    const auto fragStartPos = ClipboardHeaderSize + gsl::narrow<size_t>(htmlHeader.length());
+    const auto fragEndPos = htmlEndPos - HtmlFooter.length();
+
+    // header required by HTML 0.9 format
+    auto& clipHeaderBuilder = parts.front();
+    clipHeaderBuilder += "Version:0.9\r\n";
+    fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("StartHTML:{:0>10}\r\n"), htmlStartPos);
+    fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("EndHTML:{:0>10}\r\n"), htmlEndPos);
+    fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("StartFragment:{:0>10}\r\n"), fragStartPos);
+    fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("EndFragment:{:0>10}\r\n"), fragEndPos);
+    fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("StartSelection:{:0>10}\r\n"), fragStartPos);
+    fmt::format_to(std::back_inserter(clipHeaderBuilder), FMT_COMPILE("EndSelection:{:0>10}\r\n"), fragEndPos);
+
+    sink(parts);
 }
 
 // Routine Description:
@@ -2147,85 +2880,124 @@ std::string TextBuffer::GenRTF(const CopyRequest& req,
                                const bool isIntenseBold,
                                std::function<std::tuple<COLORREF, COLORREF, COLORREF>(const TextAttribute&)> GetAttributeColors) const noexcept
 {
-    if (req.beg > req.end)
+    try
+    {
+        std::vector<std::string> parts;
+        _CopyRTF(req, fontHeightPoints, fontFaceName, backgroundColor, isIntenseBold, GetAttributeColors, [&](std::span<std::string> chunks) {
+            std::move(chunks.begin(), chunks.end(), std::back_inserter(parts));
+        });
+        return joinCopyParts(parts);
+    }
+    catch (...)
     {
+        LOG_HR(wil::ResultFromCaughtException());
         return {};
     }
+}
 
-    try
+void TextBuffer::_CopyRTF(const CopyRequest& req,
+                          const int fontHeightPoints,
+                          const std::wstring_view fontFaceName,
+                          const COLORREF backgroundColor,
+                          const bool isIntenseBold,
+                          const std::function<std::tuple<COLORREF, COLORREF, COLORREF>(const TextAttribute&)>& GetAttributeColors,
+                          const std::function<void(std::span<std::string>)>& sink) const
+{
+    if (req.beg > req.end)
     {
-        std::string rtfBuilder;
-
-        // start rtf
-        rtfBuilder += "{";
-
-        // Standard RTF header.
-        // This is similar to the header generated by WordPad.
-        // \ansi:
-        //   Specifies that the ANSI char set is used in the current doc.
-        // \ansicpg1252:
-        //   Represents the ANSI code page which is used to perform
-        //   the Unicode to ANSI conversion when writing RTF text.
-        // \deff0:
-        //   Specifies that the default font for the document is the one
-        //   at index 0 in the font table.
-        // \nouicompat:
-        //   Some features are blocked by default to maintain compatibility
-        //   with older programs (Eg. Word 97-2003). `nouicompat` disables this
-        //   behavior, and unblocks these features. See: Spec 1.9.1, Pg. 51.
-        rtfBuilder += "\\rtf1\\ansi\\ansicpg1252\\deff0\\nouicompat";
-
-        // font table
-        // Brace escape: add an extra brace (of same kind) after a brace to escape it within the format string.
-        fmt::format_to(std::back_inserter(rtfBuilder), FMT_COMPILE("{{\\fonttbl{{\\f0\\fmodern\\fcharset0 {};}}}}"), til::u16u8(fontFaceName));
-
-        // map to keep track of colors:
-        // keys are colors represented by COLORREF
-        // values are indices of the corresponding colors in the color table
-        std::unordered_map<COLORREF, size_t> colorMap;
-
-        // RTF color table
-        std::string colorTableBuilder;
-        colorTableBuilder += "{\\colortbl ;";
-
-        const auto getColorTableIndex = [&](const COLORREF color) -> size_t {
-            // Exclude the 0 index for the default color, and start with 1.
-
-            const auto [it, inserted] = colorMap.emplace(color, colorMap.size() + 1);
-            if (inserted)
-            {
-                const auto red = static_cast<int>(GetRValue(color));
-                const auto green = static_cast<int>(GetGValue(color));
-                const auto blue = static_cast<int>(GetBValue(color));
-                fmt::format_to(std::back_inserter(colorTableBuilder), FMT_COMPILE("\\red{}\\green{}\\blue{};"), red, green, blue);
-            }
-            return it->second;
-        };
+        return;
+    }
+
+    std::string rtfBuilder;
+
+    // start rtf
+    rtfBuilder += "{";
+
+    // Standard RTF header.
+    // This is similar to the header generated by WordPad.
+    // \ansi:
+    //   Specifies that the ANSI char set is used in the current doc.
+    // \ansicpg1252:
+    //   Represents the ANSI code page which is used to perform
+    //   the Unicode to ANSI conversion when writing RTF text.
+    // \deff0:
+    //   Specifies that the default font for the document is the one
+    //   at index 0 in the font table.
+    // \nouicompat:
+    //   Some features are blocked by default to maintain compatibility
+    //   with older programs (Eg. Word 97-2003). `nouicompat` disables this
+    //   behavior, and unblocks these features. See: Spec 1.9.1, Pg. 51.
+    rtfBuilder += "\\rtf1\\ansi\\ansicpg1252\\deff0\\nouicompat";
+
+    // font table
+    // Brace escape: add an extra brace (of same kind) after a brace to escape it within the format string.
+    fmt::format_to(std::back_inserter(rtfBuilder), FMT_COMPILE("{{\\fonttbl{{\\f0\\fmodern\\fcharset0 {};}}}}"), til::u16u8(fontFaceName));
+
+    // map to keep track of colors:
+    // keys are colors represented by COLORREF
+    // values are indices of the corresponding colors in the color table
+    std::unordered_map<COLORREF, size_t> colorMap;
+
+    // RTF color table
+    std::string colorTableBuilder;
+    colorTableBuilder += "{\\colortbl ;";
+
+    const auto getColorTableIndex = [&](const COLORREF color) -> size_t {
+        // Exclude the 0 index for the default color, and start with 1.
+
+        const auto [it, inserted] = colorMap.emplace(color, colorMap.size() + 1);
+        if (inserted)
+        {
+            const auto red = static_cast<int>(GetRValue(color));
+            const auto green = static_cast<int>(GetGValue(color));
+            const auto blue = static_cast<int>(GetBValue(color));
+            fmt::format_to(std::back_inserter(colorTableBuilder), FMT_COMPILE("\\red{}\\green{}\\blue{};"), red, green, blue);
+        }
+        return it->second;
+    };
+
+    const auto backgroundColorIndex = getColorTableIndex(backgroundColor);
+
+    // The color table precedes the content, so we need to know all colors before formatting any of the rows.
+    // This also avoids calling GetAttributeColors() concurrently, which isn't necessarily safe.
+    std::vector<std::array<size_t, 3>> attributeColorIndices(_attributeTable->Size());
+    _PrepareCopy(req, [&](const TextAttributeTable::Id id) {
+        const auto [fg, bg, ul] = GetAttributeColors(_attributeTable->Get(id));
+        auto& indices = attributeColorIndices.at(id);
+        indices[0] = getColorTableIndex(fg);
+        indices[1] = getColorTableIndex(bg);
+        indices[2] = getColorTableIndex(ul);
+    });
+
+    // add color table to the final RTF
+    rtfBuilder += colorTableBuilder + "}";
 
-        // content
-        std::string contentBuilder;
+    // content
 
-        // \viewkindN: View mode of the document to be used. N=4 specifies that the document is in Normal view. (maybe unnecessary?)
-        // \ucN: Number of unicode fallback characters after each codepoint. (global)
-        contentBuilder += "\\viewkind4\\uc1";
+    // \viewkindN: View mode of the document to be used. N=4 specifies that the document is in Normal view. (maybe unnecessary?)
+    // \ucN: Number of unicode fallback characters after each codepoint. (global)
+    rtfBuilder += "\\viewkind4\\uc1";
 
-        // paragraph styles
-        // \pard: paragraph description
-        // \slmultN: line-spacing multiple
-        // \fN: font to be used for the paragraph, where N is the font index in the font table
-        contentBuilder += "\\pard\\slmult1\\f0";
+    // paragraph styles
+    // \pard: paragraph description
+    // \slmultN: line-spacing multiple
+    // \fN: font to be used for the paragraph, where N is the font index in the font table
+    rtfBuilder += "\\pard\\slmult1\\f0";
 
-        // \fsN: specifies font size in half-points. E.g. \fs20 results in a font
-        // size of 10 pts. That's why, font size is multiplied by 2 here.
-        fmt::format_to(std::back_inserter(contentBuilder), FMT_COMPILE("\\fs{}"), 2 * fontHeightPoints);
+    // \fsN: specifies font size in half-points. E.g. \fs20 results in a font
+    // size of 10 pts. That's why, font size is multiplied by 2 here.
+    fmt::format_to(std::back_inserter(rtfBuilder), FMT_COMPILE("\\fs{}"), 2 * fontHeightPoints);
 
-        // Set the background color for the page. But the standard way (\cbN) to do
-        // this isn't supported in Word. However, the following control words sequence
-        // works in Word (and other RTF editors also) for applying the text background
-        // color. See: Spec 1.9.1, Pg. 23.
-        fmt::format_to(std::back_inserter(contentBuilder), FMT_COMPILE("\\chshdng0\\chcbpat{}"), getColorTableIndex(backgroundColor));
+    // Set the background color for the page. But the standard way (\cbN) to do
+    // this isn't supported in Word. However, the following control words sequence
+    // works in Word (and other RTF editors also) for applying the text background
+    // color. See: Spec 1.9.1, Pg. 23.
+    fmt::format_to(std::back_inserter(rtfBuilder), FMT_COMPILE("\\chshdng0\\chcbpat{}"), backgroundColorIndex);
 
-        for (auto iRow = req.beg.y; iRow <= req.end.y; ++iRow)
+    sink({ &rtfBuilder, 1 });
+
+    const auto formatRows = [&](const til::CoordType beg, const til::CoordType end, std::string& contentBuilder) {
+        for (auto iRow = beg; iRow < end; ++iRow)
         {
             const auto& row = GetRowByOffset(iRow);
             const auto [rowBeg, rowEnd, addLineBreak] = _RowCopyHelper(req, iRow, row);
@@ -2234,13 +3006,11 @@ std::string TextBuffer::GenRTF(const CopyRequest& req,
             const auto runs = row.Attributes().slice(rowBegU16, rowEndU16).runs();
 
             auto x = rowBegU16;
-            for (auto& [attr, length] : runs)
+            for (const auto& [attrId, length] : runs)
             {
+                const auto& attr = _attributeTable->Get(attrId);
                 const auto nextX = gsl::narrow_cast<uint16_t>(x + length);
-                const auto [fg, bg, ul] = GetAttributeColors(attr);
-                const auto fgIdx = getColorTableIndex(fg);
-                const auto bgIdx = getColorTableIndex(bg);
-                const auto ulIdx = getColorTableIndex(ul);
+                const auto [fgIdx, bgIdx, ulIdx] = attributeColorIndices.at(attrId);
                 const auto ulStyle = attr.GetUnderlineStyle();
 
                 // start an RTF group that can be closed later to restore the
@@ -2307,20 +3077,12 @@ std::string TextBuffer::GenRTF(const CopyRequest& req,
                 contentBuilder += "\\line";
             }
         }
+    };
 
-        // add color table to the final RTF
-        rtfBuilder += colorTableBuilder + "}";
-
-        // add the text content to the final RTF
-        rtfBuilder += contentBuilder + "}";
+    formatRowChunks<std::string>(req.beg.y, req.end.y, formatRows, sink);
 
-        return rtfBuilder;
-    }
-    catch (...)
-    {
-        LOG_HR(wil::ResultFromCaughtException());
-        return {};
-    }
+    std::string rtfEnd{ "}" };
+    sink({ &rtfEnd, 1 });
 }
 
 void TextBuffer::_AppendRTFText(std::string& contentBuilder, const std::wstring_view& text)
@@ -2394,11 +3156,12 @@ void TextBuffer::Serialize(const wchar_t* destination) const
 
         for (; it != end; ++it)
         {
-            const auto attr = it->value.GetCharacterAttributes();
-            const auto hyperlinkId = it->value.GetHyperlinkId();
-            const auto fg = it->value.GetForeground();
-            const auto bg = it->value.GetBackground();
-            const auto ul = it->value.GetUnderlineColor();
+            const auto& value = _attributeTable->Get(it->value);
+            const auto attr = value.GetCharacterAttributes();
+            const auto hyperlinkId = value.GetHyperlinkId();
+            const auto fg = value.GetForeground();
+            const auto bg = value.GetBackground();
+            const auto ul = value.GetUnderlineColor();
 
             if (previousAttr != attr)
             {
@@ -2466,7 +3229,7 @@ void TextBuffer::Serialize(const wchar_t* destination) const
                         L"\x1b[4:5m", // UnderlineStyle::DashedUnderlined
                     };
 
-                    auto idx = WI_EnumValue(it->value.GetUnderlineStyle());
+                    auto idx = WI_EnumValue(value.GetUnderlineStyle());
                     if (idx >= std::size(mappings))
                     {
                         idx = 1; // UnderlineStyle::SinglyUnderlined
@@ -2589,7 +3352,7 @@ void TextBuffer::Serialize(const wchar_t* destination) const
             // As mentioned above for `delayedLineBreak`, rows are initialized with their first attribute, BUT
             // only if the viewport has begun to scroll. Otherwise, they're initialized with the default attributes.
             // In other words, we can only skip \x1b[K = Erase in Line, if both the first/last attribute are the default attribute.
-            static constexpr TextAttribute defaultAttr;
+            static constexpr auto defaultAttr = TextAttributeTable::DefaultId;
             const auto trimTrailingWhitespaces = it == last && lastCharX < newX;
             const auto clearToEndOfLine = trimTrailingWhitespaces && (beg->value != defaultAttr || last->value != defaultAttr);
 
@@ -2636,128 +3399,594 @@ void TextBuffer::Serialize(const wchar_t* destination) const
     }
 }
 
-// Function Description:
-// - Reflow the contents from the old buffer into the new buffer. The new buffer
-//   can have different dimensions than the old buffer. If it does, then this
-//   function will attempt to maintain the logical contents of the old buffer,
-//   by continuing wrapped lines onto the next line in the new buffer.
-// Arguments:
-// - oldBuffer - the text buffer to copy the contents FROM
-// - newBuffer - the text buffer to copy the contents TO
-// - lastCharacterViewport - Optional. If the caller knows that the last
-//   nonspace character is in a particular Viewport, the caller can provide this
-//   parameter as an optimization, as opposed to searching the entire buffer.
-// - positionInfo - Optional. The caller can provide a pair of rows in this
-//   parameter and we'll calculate the position of the _end_ of those rows in
-//   the new buffer. The rows's new value is placed back into this parameter.
-// Return Value:
-// - S_OK if we successfully copied the contents to the new buffer, otherwise an appropriate HRESULT.
-void TextBuffer::Reflow(TextBuffer& oldBuffer, TextBuffer& newBuffer, const Viewport* lastCharacterViewport, PositionInformation* positionInfo)
+// The binary snapshot format written by SerializeSnapshot(). It's a straight dump of the buffer contents in native
+// byte order, designed to be memory mapped and restored without parsing any VT sequences. Each record is padded to
+// a multiple of 8 bytes. In order:
+// * SnapshotHeader
+// * TextAttribute[attributeCount] - the attributes referenced by the rows, in the order of their ids
+// * (SnapshotString + wchar_t[length])[hyperlinkCount] - the entries of _hyperlinkMap
+// * (SnapshotString + wchar_t[length])[customIdCount] - the entries of _hyperlinkCustomIdMap
+// * for each of the rowCount rows:
+//   * SnapshotRow + the row encoded by PackedRow::Encode()
+//   * SnapshotMark, if the row has SnapshotRowFlags::HasMark set
+//   * SnapshotImage + RGBQUAD[pixelCount], if the row has SnapshotRowFlags::HasImage set
+namespace
 {
-    const auto& oldCursor = oldBuffer.GetCursor();
-    auto& newCursor = newBuffer.GetCursor();
+    constexpr uint32_t snapshotMagic = 0x53425457; // "WTBS" in little endian
+    constexpr uint32_t snapshotVersion = 1;
+    constexpr size_t snapshotAlignment = 8;
+    constexpr auto snapshotInvalidData = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
 
-    til::point oldCursorPos = oldCursor.GetPosition();
-    til::point newCursorPos;
+    enum SnapshotRowFlags : uint32_t
+    {
+        HasMark = 0x1,
+        HasImage = 0x2,
+    };
 
-    // BODGY: We use oldCursorPos in two critical places below:
-    // * To compute an oldHeight that includes at a minimum the cursor row
-    // * For REFLOW_JANK_CURSOR_WRAP (see comment below)
-    // Both of these would break the reflow algorithm, but the latter of the two in particular
-    // would cause the main copy loop below to deadlock. In other words, these two lines
-    // protect this function against yet-unknown bugs in other parts of the code base.
-    oldCursorPos.x = std::clamp(oldCursorPos.x, 0, oldBuffer._width - 1);
-    oldCursorPos.y = std::clamp(oldCursorPos.y, 0, oldBuffer._height - 1);
+    struct SnapshotHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t attributeSize;
+        uint32_t attributeCount;
+        uint32_t hyperlinkCount;
+        uint32_t customIdCount;
+        til::CoordType width;
+        til::CoordType rowCount;
+        til::CoordType cursorX;
+        til::CoordType cursorY;
+        uint32_t currentHyperlinkId;
+        uint32_t reserved;
+    };
 
-    const auto lastRowWithText = oldBuffer.GetLastNonSpaceCharacter(lastCharacterViewport).y;
+    struct SnapshotString
+    {
+        uint32_t id;
+        uint32_t length;
+    };
 
-    auto mutableViewportTop = positionInfo ? positionInfo->mutableViewportTop : til::CoordTypeMax;
-    auto visibleViewportTop = positionInfo ? positionInfo->visibleViewportTop : til::CoordTypeMax;
+    struct SnapshotRow
+    {
+        uint32_t size;
+        uint32_t flags;
+    };
 
-    til::CoordType oldY = 0;
-    til::CoordType newY = 0;
-    til::CoordType newX = 0;
-    til::CoordType newWidth = newBuffer.GetSize().Width();
-    til::CoordType newYLimit = til::CoordTypeMax;
+    struct SnapshotMark
+    {
+        uint8_t category;
+        uint8_t hasColor;
+        uint8_t hasExitCode;
+        uint8_t reserved;
+        uint32_t color;
+        uint32_t exitCode;
+        uint32_t reserved2;
+    };
 
-    const auto oldHeight = std::max(lastRowWithText, oldCursorPos.y) + 1;
-    const auto newHeight = newBuffer.GetSize().Height();
-    const auto newWidthU16 = gsl::narrow_cast<uint16_t>(newWidth);
+    struct SnapshotImage
+    {
+        til::CoordType cellWidth;
+        til::CoordType cellHeight;
+        til::CoordType columnBegin;
+        til::CoordType columnEnd;
+        uint32_t pixelCount;
+        uint32_t reserved;
+    };
 
-    // Copy oldBuffer into newBuffer until oldBuffer has been fully consumed.
-    for (; oldY < oldHeight && newY < newYLimit; ++oldY)
+    constexpr size_t alignSnapshotOffset(size_t offset) noexcept
     {
-        const auto& oldRow = oldBuffer.GetRowByOffset(oldY);
+        return (offset + snapshotAlignment - 1) & ~(snapshotAlignment - 1);
+    }
 
-        // A pair of double height rows should optimally wrap as a union (i.e. after wrapping there should be 4 lines).
-        // But for this initial implementation I chose the alternative approach: Just truncate them.
-        if (oldRow.GetLineRendition() != LineRendition::SingleWidth)
+    // Accumulates the snapshot in memory and writes it to the file in chunks of about writeThreshold bytes.
+    class SnapshotWriter
+    {
+    public:
+        explicit SnapshotWriter(const wchar_t* destination) :
+            _file{ CreateFileW(destination, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) }
         {
-            // Since rows with a non-standard line rendition should be truncated it's important
-            // that we pretend as if the previous row ended in a newline, even if it didn't.
-            // This is what this if does: It newlines.
-            if (newX)
-            {
-                newX = 0;
-                newY++;
-            }
+            THROW_LAST_ERROR_IF(!_file);
+            _buffer.reserve(writeThreshold + writeThreshold / 2);
+        }
 
-            auto& newRow = newBuffer.GetMutableRowByOffset(newY);
+        template<typename T>
+        void Write(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            Write(&value, sizeof(T));
+        }
 
-            // See the comment marked with "REFLOW_RESET".
-            if (newY >= newHeight)
-            {
-                newRow.Reset(newBuffer._initialAttributes);
-            }
+        void Write(const void* data, size_t size)
+        {
+            const auto beg = static_cast<const std::byte*>(data);
+            _buffer.insert(_buffer.end(), beg, beg + size);
+        }
 
-            newRow.CopyFrom(oldRow);
-            newRow.SetWrapForced(false);
+        void WriteString(uint32_t id, const std::wstring_view& str)
+        {
+            Write(SnapshotString{ id, gsl::narrow<uint32_t>(str.size()) });
+            Write(str.data(), str.size() * sizeof(wchar_t));
+            Align();
+        }
 
-            if (oldY == oldCursorPos.y)
-            {
-                newCursorPos = { newRow.AdjustToGlyphStart(oldCursorPos.x), newY };
-            }
-            if (oldY >= mutableViewportTop)
-            {
-                positionInfo->mutableViewportTop = newY;
-                mutableViewportTop = til::CoordTypeMax;
-            }
-            if (oldY >= visibleViewportTop)
-            {
-                positionInfo->visibleViewportTop = newY;
-                visibleViewportTop = til::CoordTypeMax;
-            }
+        void WriteRow(const ROW& row, uint32_t flags)
+        {
+            const auto offset = _buffer.size();
+            Write(SnapshotRow{ 0, flags });
+            PackedRow::Encode(row, _buffer);
 
-            newY++;
-            continue;
+            const auto size = gsl::narrow<uint32_t>(_buffer.size() - offset - sizeof(SnapshotRow));
+            memcpy(_buffer.data() + offset, &size, sizeof(size));
+            Align();
         }
 
-        // Rows don't store any information for what column the last written character is in.
-        // We simply truncate all trailing whitespace in this implementation.
-        auto oldRowLimit = oldRow.MeasureRight();
-        if (oldY == oldCursorPos.y)
+        void Align()
         {
-            // REFLOW_JANK_CURSOR_WRAP:
-            // Pretending as if there's always at least whitespace in front of the cursor has the benefit that
-            // * the cursor retains its distance from any preceding text.
-            // * when a client application starts writing on this new, empty line,
-            //   enlarging the buffer unwraps the text onto the preceding line.
-            oldRowLimit = std::max(oldRowLimit, oldCursorPos.x + 1);
+            const auto offset = _flushed + _buffer.size();
+            _buffer.resize(_buffer.size() + alignSnapshotOffset(offset) - offset);
         }
 
-        // Immediately copy this mark over to our new row. The positions of the
-        // marks themselves will be preserved, since they're just text
-        // attributes. But the "bookmark" needs to get moved to the new row too.
-        // * If a row wraps as it reflows, that's fine - we want to leave the
-        //   mark on the row it started on.
-        // * If the second row of a wrapped row had a mark, and it de-flows onto a
-        //   single row, that's fine! The mark was on that logical row.
-        if (oldRow.GetScrollbarData().has_value())
+        // Flushes the accumulated data if it exceeds writeThreshold. Only call this in between records.
+        void FlushIfNeeded()
         {
-            newBuffer.GetMutableRowByOffset(newY).SetScrollbarData(oldRow.GetScrollbarData());
+            if (_buffer.size() >= writeThreshold)
+            {
+                Flush();
+            }
         }
 
-        til::CoordType oldX = 0;
+        void Flush()
+        {
+            const auto size = gsl::narrow<DWORD>(_buffer.size());
+            DWORD bytesWritten = 0;
+            THROW_IF_WIN32_BOOL_FALSE(WriteFile(_file.get(), _buffer.data(), size, &bytesWritten, nullptr));
+            THROW_WIN32_IF_MSG(ERROR_WRITE_FAULT, bytesWritten != size, "failed to write");
+            _flushed += size;
+            _buffer.clear();
+        }
+
+    private:
+        static constexpr size_t writeThreshold = 32 * 1024;
+
+        wil::unique_handle _file;
+        std::vector<std::byte> _buffer;
+        size_t _flushed = 0;
+    };
+
+    // A bounds checked cursor over the snapshot data. Throws if the data ends prematurely.
+    class SnapshotReader
+    {
+    public:
+        explicit SnapshotReader(std::span<const std::byte> data) noexcept :
+            _data{ data }
+        {
+        }
+
+        template<typename T>
+        T Read()
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            T value;
+            memcpy(&value, ReadBytes(sizeof(T)).data(), sizeof(T));
+            return value;
+        }
+
+        std::span<const std::byte> ReadBytes(size_t size)
+        {
+            THROW_HR_IF(snapshotInvalidData, size > _data.size() - _offset);
+            const auto bytes = _data.subspan(_offset, size);
+            _offset += size;
+            return bytes;
+        }
+
+        std::wstring ReadString(size_t length)
+        {
+            THROW_HR_IF(snapshotInvalidData, length > (_data.size() - _offset) / sizeof(wchar_t));
+            const auto bytes = ReadBytes(length * sizeof(wchar_t));
+            std::wstring str(length, L'\0');
+            memcpy(str.data(), bytes.data(), bytes.size());
+            Align();
+            return str;
+        }
+
+        void Align()
+        {
+            ReadBytes(alignSnapshotOffset(_offset) - _offset);
+        }
+
+        size_t Remaining() const noexcept
+        {
+            return _data.size() - _offset;
+        }
+
+    private:
+        std::span<const std::byte> _data;
+        size_t _offset = 0;
+    };
+
+    // Rebuilds a color read from a snapshot through its constructors,
+    // so that any value a TextColor can't hold is rejected.
+    TextColor sanitizeSnapshotColor(const TextColor color)
+    {
+        switch (color.GetType())
+        {
+        case ColorType::IsDefault:
+            return {};
+        case ColorType::IsIndex16:
+            THROW_HR_IF(snapshotInvalidData, color.GetIndex() >= 16);
+            return { color.GetIndex(), false };
+        case ColorType::IsIndex256:
+            return { color.GetIndex(), true };
+        case ColorType::IsRgb:
+            return { color.GetRGB() };
+        default:
+            THROW_HR(snapshotInvalidData);
+        }
+    }
+
+    // Rebuilds an attribute read from a snapshot through its setters. Unknown flags, underline styles,
+    // mark kinds and colors are rejected. Hyperlink ids that aren't in the hyperlink map are dropped,
+    // since the attribute table may still contain attributes whose links have already been removed.
+    TextAttribute sanitizeSnapshotAttribute(const TextAttribute& raw, const std::unordered_map<uint16_t, std::wstring>& hyperlinkMap)
+    {
+        const auto attrs = raw.GetCharacterAttributes();
+        THROW_HR_IF(snapshotInvalidData, WI_IsFlagSet(attrs, CharacterAttributes::Unused1));
+        THROW_HR_IF(snapshotInvalidData, raw.GetUnderlineStyle() > UnderlineStyle::Max);
+        THROW_HR_IF(snapshotInvalidData, raw.GetMarkAttributes() > MarkKind::Output);
+
+        TextAttribute attr;
+        attr.SetCharacterAttributes(attrs);
+        attr.SetForeground(sanitizeSnapshotColor(raw.GetForeground()));
+        attr.SetBackground(sanitizeSnapshotColor(raw.GetBackground()));
+        attr.SetUnderlineColor(sanitizeSnapshotColor(raw.GetUnderlineColor()));
+        attr.SetMarkAttributes(raw.GetMarkAttributes());
+        if (const auto id = raw.GetHyperlinkId(); hyperlinkMap.contains(id))
+        {
+            attr.SetHyperlinkId(id);
+        }
+        return attr;
+    }
+}
+
+// Writes the buffer contents to the given file in the binary snapshot format described above.
+// Unlike Serialize() this preserves the buffer contents exactly, including marks and images,
+// and the result can be restored with FromSnapshot() without going through the VT parser.
+void TextBuffer::SerializeSnapshot(const wchar_t* destination) const
+{
+    SnapshotWriter writer{ destination };
+
+    const auto cursorPosition = _cursor.GetPosition();
+    const auto rowCount = std::max(GetLastNonSpaceCharacter(nullptr).y, cursorPosition.y) + 1;
+    const auto attributeCount = _attributeTable->Size();
+
+    writer.Write(SnapshotHeader{
+        .magic = snapshotMagic,
+        .version = snapshotVersion,
+        .attributeSize = sizeof(TextAttribute),
+        .attributeCount = gsl::narrow<uint32_t>(attributeCount),
+        .hyperlinkCount = gsl::narrow<uint32_t>(_hyperlinkMap.size()),
+        .customIdCount = gsl::narrow<uint32_t>(_hyperlinkCustomIdMap.size()),
+        .width = _width,
+        .rowCount = rowCount,
+        .cursorX = cursorPosition.x,
+        .cursorY = cursorPosition.y,
+        .currentHyperlinkId = _currentHyperlinkId,
+        .reserved = 0,
+    });
+
+    for (size_t id = 0; id < attributeCount; ++id)
+    {
+        writer.Write(_attributeTable->Get(gsl::narrow_cast<TextAttributeTable::Id>(id)));
+    }
+    writer.Align();
+
+    for (const auto& [id, uri] : _hyperlinkMap)
+    {
+        writer.WriteString(id, uri);
+    }
+    for (const auto& [customId, id] : _hyperlinkCustomIdMap)
+    {
+        writer.WriteString(id, customId);
+    }
+
+    for (til::CoordType y = 0; y < rowCount; ++y)
+    {
+        const auto& row = GetRowByOffset(y);
+        const auto& mark = row.GetScrollbarData();
+        const auto image = row.GetImageSlice();
+        const auto pixels = image ? image->Pixels() : std::span<const RGBQUAD>{};
+
+        uint32_t flags = 0;
+        WI_SetFlagIf(flags, SnapshotRowFlags::HasMark, mark.has_value());
+        WI_SetFlagIf(flags, SnapshotRowFlags::HasImage, !pixels.empty());
+
+        writer.WriteRow(row, flags);
+
+        if (mark)
+        {
+            writer.Write(SnapshotMark{
+                .category = WI_EnumValue(mark->category),
+                .hasColor = mark->color.has_value(),
+                .hasExitCode = mark->exitCode.has_value(),
+                .reserved = 0,
+                .color = mark->color ? static_cast<COLORREF>(*mark->color) : 0,
+                .exitCode = mark->exitCode.value_or(0),
+                .reserved2 = 0,
+            });
+        }
+
+        if (!pixels.empty())
+        {
+            const auto cellSize = image->CellSize();
+            writer.Write(SnapshotImage{
+                .cellWidth = cellSize.width,
+                .cellHeight = cellSize.height,
+                .columnBegin = image->ColumnOffset(),
+                .columnEnd = image->ColumnEnd(),
+                .pixelCount = gsl::narrow<uint32_t>(pixels.size()),
+                .reserved = 0,
+            });
+            writer.Write(pixels.data(), pixels.size_bytes());
+            writer.Align();
+        }
+
+        writer.FlushIfNeeded();
+    }
+
+    writer.Flush();
+}
+
+// Returns true if the given data starts like a snapshot written by SerializeSnapshot().
+bool TextBuffer::IsSnapshot(std::span<const std::byte> data) noexcept
+{
+    uint32_t magic = 0;
+    if (data.size() < sizeof(magic))
+    {
+        return false;
+    }
+    memcpy(&magic, data.data(), sizeof(magic));
+    return magic == snapshotMagic;
+}
+
+// Creates a new TextBuffer from a snapshot written by SerializeSnapshot(). The new buffer is exactly as large as
+// the snapshot, so callers will generally want to Reflow() it into their actual buffer. Since the data may come
+// from anywhere, it's fully validated and this throws if it's corrupted, truncated or of an unknown version.
+std::unique_ptr<TextBuffer> TextBuffer::FromSnapshot(std::span<const std::byte> data, Microsoft::Console::Render::Renderer* renderer)
+{
+    // The snapshot is read from a file of a reasonable size, not an arbitrarily large buffer.
+    // The limit on the row count just protects us from allocating an absurdly large buffer.
+    static constexpr til::CoordType maxRowCount = 1024 * 1024;
+
+    SnapshotReader reader{ data };
+    const auto header = reader.Read<SnapshotHeader>();
+    THROW_HR_IF(snapshotInvalidData, header.magic != snapshotMagic || header.version != snapshotVersion || header.attributeSize != sizeof(TextAttribute));
+    THROW_HR_IF(snapshotInvalidData, header.width <= 0 || header.width > SHRT_MAX || header.rowCount <= 0 || header.rowCount > maxRowCount);
+    THROW_HR_IF(snapshotInvalidData, header.attributeCount == 0 || header.attributeCount > TextAttributeTable::MaxSize);
+
+    auto buffer = std::make_unique<TextBuffer>(til::size{ header.width, header.rowCount }, TextAttribute{}, 0, false, renderer);
+
+    // The attributes are interned after reading the hyperlinks, because their validation depends on the latter.
+    const auto attributeBytes = reader.ReadBytes(header.attributeCount * sizeof(TextAttribute));
+    reader.Align();
+
+    for (uint32_t i = 0; i < header.hyperlinkCount; ++i)
+    {
+        const auto entry = reader.Read<SnapshotString>();
+        buffer->_hyperlinkMap.insert_or_assign(gsl::narrow_cast<uint16_t>(entry.id), reader.ReadString(entry.length));
+    }
+    for (uint32_t i = 0; i < header.customIdCount; ++i)
+    {
+        const auto entry = reader.Read<SnapshotString>();
+        buffer->_hyperlinkCustomIdMap.insert_or_assign(reader.ReadString(entry.length), gsl::narrow_cast<uint16_t>(entry.id));
+    }
+
+    // The ids in attrMap are only referenced by rows once they've been decoded below.
+    const auto suspended = buffer->_attributeTable->SuspendCollection();
+    std::vector<TextAttributeTable::Id> attrMap;
+    attrMap.reserve(header.attributeCount);
+    for (size_t i = 0; i < header.attributeCount; ++i)
+    {
+        TextAttribute raw;
+        memcpy(&raw, attributeBytes.data() + i * sizeof(TextAttribute), sizeof(TextAttribute));
+        attrMap.emplace_back(buffer->_attributeTable->Intern(sanitizeSnapshotAttribute(raw, buffer->_hyperlinkMap)));
+    }
+
+    const auto columnCount = gsl::narrow_cast<uint16_t>(header.width);
+
+    for (til::CoordType y = 0; y < header.rowCount; ++y)
+    {
+        const auto entry = reader.Read<SnapshotRow>();
+        auto packed = PackedRow::Decode(reader.ReadBytes(entry.size), columnCount, attrMap.size());
+        reader.Align();
+
+        auto& row = buffer->GetMutableRowByOffset(y);
+        packed.Unpack(row);
+        ROW::TranslateAttributes(row.Attributes(), attrMap);
+        row.SetGeneration(++buffer->_lastMutationId);
+
+        if (WI_IsFlagSet(entry.flags, SnapshotRowFlags::HasMark))
+        {
+            const auto mark = reader.Read<SnapshotMark>();
+            THROW_HR_IF(snapshotInvalidData, mark.category > WI_EnumValue(MarkCategory::Prompt));
+
+            ScrollbarData data{ .category = static_cast<MarkCategory>(mark.category) };
+            if (mark.hasColor)
+            {
+                data.color = til::color{ static_cast<COLORREF>(mark.color) };
+            }
+            if (mark.hasExitCode)
+            {
+                data.exitCode = mark.exitCode;
+            }
+            row.SetScrollbarData(std::move(data));
+        }
+
+        if (WI_IsFlagSet(entry.flags, SnapshotRowFlags::HasImage))
+        {
+            const auto image = reader.Read<SnapshotImage>();
+            THROW_HR_IF(snapshotInvalidData, image.cellWidth <= 0 || image.cellHeight <= 0 || image.cellWidth > SHRT_MAX || image.cellHeight > SHRT_MAX);
+            THROW_HR_IF(snapshotInvalidData, image.columnBegin < 0 || image.columnEnd <= image.columnBegin || image.columnEnd > header.width);
+
+            // This replicates the size computation in ImageSlice::MutablePixels() in 64-bit
+            // arithmetic, so that we can validate the pixel count before allocating anything.
+            auto pixelWidth = int64_t{ image.columnEnd - image.columnBegin } * image.cellWidth;
+            pixelWidth = (pixelWidth + 3) & ~3;
+            THROW_HR_IF(snapshotInvalidData, pixelWidth * image.cellHeight != image.pixelCount);
+            THROW_HR_IF(snapshotInvalidData, image.pixelCount > reader.Remaining() / sizeof(RGBQUAD));
+
+            const auto pixels = reader.ReadBytes(image.pixelCount * sizeof(RGBQUAD));
+            reader.Align();
+
+            auto slice = std::make_unique<ImageSlice>(til::size{ image.cellWidth, image.cellHeight });
+            memcpy(slice->MutablePixels(image.columnBegin, image.columnEnd), pixels.data(), pixels.size());
+            row.SetImageSlice(std::move(slice));
+        }
+    }
+
+    buffer->_rebuildMarkRows();
+    buffer->_resetChangeJournal();
+    buffer->_cursor.SetPosition({
+        std::clamp(header.cursorX, 0, header.width - 1),
+        std::clamp(header.cursorY, 0, header.rowCount - 1),
+    });
+    buffer->_currentHyperlinkId = gsl::narrow_cast<uint16_t>(std::max<uint32_t>(header.currentHyperlinkId, 1));
+    return buffer;
+}
+
+// Function Description:
+// - Reflow the contents from the old buffer into the new buffer. The new buffer
+//   can have different dimensions than the old buffer. If it does, then this
+//   function will attempt to maintain the logical contents of the old buffer,
+//   by continuing wrapped lines onto the next line in the new buffer.
+// Arguments:
+// - oldBuffer - the text buffer to copy the contents FROM
+// - newBuffer - the text buffer to copy the contents TO
+// - lastCharacterViewport - Optional. If the caller knows that the last
+//   nonspace character is in a particular Viewport, the caller can provide this
+//   parameter as an optimization, as opposed to searching the entire buffer.
+// - positionInfo - Optional. The caller can provide a pair of rows in this
+//   parameter and we'll calculate the position of the _end_ of those rows in
+//   the new buffer. The rows's new value is placed back into this parameter.
+// Return Value:
+// - S_OK if we successfully copied the contents to the new buffer, otherwise an appropriate HRESULT.
+void TextBuffer::Reflow(TextBuffer& oldBuffer, TextBuffer& newBuffer, const Viewport* lastCharacterViewport, PositionInformation* positionInfo)
+{
+    const auto& oldCursor = oldBuffer.GetCursor();
+    auto& newCursor = newBuffer.GetCursor();
+
+    til::point oldCursorPos = oldCursor.GetPosition();
+    til::point newCursorPos;
+
+    // BODGY: We use oldCursorPos in two critical places below:
+    // * To compute an oldHeight that includes at a minimum the cursor row
+    // * For REFLOW_JANK_CURSOR_WRAP (see comment below)
+    // Both of these would break the reflow algorithm, but the latter of the two in particular
+    // would cause the main copy loop below to deadlock. In other words, these two lines
+    // protect this function against yet-unknown bugs in other parts of the code base.
+    oldCursorPos.x = std::clamp(oldCursorPos.x, 0, oldBuffer._width - 1);
+    oldCursorPos.y = std::clamp(oldCursorPos.y, 0, oldBuffer._height - 1);
+
+    const auto lastRowWithText = oldBuffer.GetLastNonSpaceCharacter(lastCharacterViewport).y;
+
+    auto mutableViewportTop = positionInfo ? positionInfo->mutableViewportTop : til::CoordTypeMax;
+    auto visibleViewportTop = positionInfo ? positionInfo->visibleViewportTop : til::CoordTypeMax;
+
+    til::CoordType oldY = 0;
+    til::CoordType newY = 0;
+    til::CoordType newX = 0;
+    til::CoordType newWidth = newBuffer.GetSize().Width();
+    til::CoordType newYLimit = til::CoordTypeMax;
+
+    const auto oldHeight = std::max(lastRowWithText, oldCursorPos.y) + 1;
+    const auto newHeight = newBuffer.GetSize().Height();
+    const auto newWidthU16 = gsl::narrow_cast<uint16_t>(newWidth);
+
+    // Maps the attribute ids of the old buffer to those of the new one.
+    // They must survive until all rows have been copied, so the new table must not collect them until then.
+    const auto suspended = newBuffer._attributeTable->SuspendCollection();
+    const auto attrMap = newBuffer._attributeTable->Import(*oldBuffer._attributeTable);
+
+    // Large buffers are rewrapped on multiple threads. If that succeeds, all of the old rows
+    // have been consumed and the loop below is skipped. See _reflowParallel().
+    if (_reflowParallel(oldBuffer, newBuffer, attrMap, oldHeight, oldCursorPos, positionInfo, newY, newCursorPos))
+    {
+        oldY = oldHeight;
+    }
+
+    // Copy oldBuffer into newBuffer until oldBuffer has been fully consumed.
+    // NOTE: Modifications to this loop might have to be mirrored over to _reflowParallel().
+    for (; oldY < oldHeight && newY < newYLimit; ++oldY)
+    {
+        const auto& oldRow = oldBuffer.GetRowByOffset(oldY);
+
+        // A pair of double height rows should optimally wrap as a union (i.e. after wrapping there should be 4 lines).
+        // But for this initial implementation I chose the alternative approach: Just truncate them.
+        if (oldRow.GetLineRendition() != LineRendition::SingleWidth)
+        {
+            // Since rows with a non-standard line rendition should be truncated it's important
+            // that we pretend as if the previous row ended in a newline, even if it didn't.
+            // This is what this if does: It newlines.
+            if (newX)
+            {
+                newX = 0;
+                newY++;
+            }
+
+            auto& newRow = newBuffer.GetMutableRowByOffset(newY);
+
+            // See the comment marked with "REFLOW_RESET".
+            if (newY >= newHeight)
+            {
+                newRow.Reset(newBuffer._initialAttributesId);
+            }
+
+            newRow.CopyFrom(oldRow, attrMap);
+            newRow.SetWrapForced(false);
+
+            if (oldY == oldCursorPos.y)
+            {
+                newCursorPos = { newRow.AdjustToGlyphStart(oldCursorPos.x), newY };
+            }
+            if (oldY >= mutableViewportTop)
+            {
+                positionInfo->mutableViewportTop = newY;
+                mutableViewportTop = til::CoordTypeMax;
+            }
+            if (oldY >= visibleViewportTop)
+            {
+                positionInfo->visibleViewportTop = newY;
+                visibleViewportTop = til::CoordTypeMax;
+            }
+
+            newY++;
+            continue;
+        }
+
+        // Rows don't store any information for what column the last written character is in.
+        // We simply truncate all trailing whitespace in this implementation.
+        auto oldRowLimit = oldRow.MeasureRight();
+        if (oldY == oldCursorPos.y)
+        {
+            // REFLOW_JANK_CURSOR_WRAP:
+            // Pretending as if there's always at least whitespace in front of the cursor has the benefit that
+            // * the cursor retains its distance from any preceding text.
+            // * when a client application starts writing on this new, empty line,
+            //   enlarging the buffer unwraps the text onto the preceding line.
+            oldRowLimit = std::max(oldRowLimit, oldCursorPos.x + 1);
+        }
+
+        // Immediately copy this mark over to our new row. The positions of the
+        // marks themselves will be preserved, since they're just text
+        // attributes. But the "bookmark" needs to get moved to the new row too.
+        // * If a row wraps as it reflows, that's fine - we want to leave the
+        //   mark on the row it started on.
+        // * If the second row of a wrapped row had a mark, and it de-flows onto a
+        //   single row, that's fine! The mark was on that logical row.
+        if (oldRow.GetScrollbarData().has_value())
+        {
+            newBuffer.GetMutableRowByOffset(newY).SetScrollbarData(oldRow.GetScrollbarData());
+        }
+
+        til::CoordType oldX = 0;
 
         // Copy oldRow into newBuffer until oldRow has been fully consumed.
         // We use a do-while loop to ensure that line wrapping occurs and
@@ -2786,7 +4015,7 @@ void TextBuffer::Reflow(TextBuffer& oldBuffer, TextBuffer& newBuffer, const View
                 {
                     break;
                 }
-                newBuffer.GetMutableRowByOffset(newY).Reset(newBuffer._initialAttributes);
+                newBuffer.GetMutableRowByOffset(newY).Reset(newBuffer._initialAttributesId);
             }
 
             auto& newRow = newBuffer.GetMutableRowByOffset(newY);
@@ -2808,7 +4037,8 @@ void TextBuffer::Reflow(TextBuffer& oldBuffer, TextBuffer& newBuffer, const View
 
             const auto& oldAttr = oldRow.Attributes();
             auto& newAttr = newRow.Attributes();
-            const auto attributes = oldAttr.slice(gsl::narrow_cast<uint16_t>(oldX), oldAttr.size());
+            auto attributes = oldAttr.slice(gsl::narrow_cast<uint16_t>(oldX), oldAttr.size());
+            ROW::TranslateAttributes(attributes, attrMap);
             newAttr.replace(gsl::narrow_cast<uint16_t>(newX), newAttr.size(), attributes);
             newAttr.resize_trailing_extent(newWidthU16);
 
@@ -2869,6 +4099,7 @@ void TextBuffer::Reflow(TextBuffer& oldBuffer, TextBuffer& newBuffer, const View
         auto& newAttr = newRow.Attributes();
         newAttr = oldRow.Attributes();
         newAttr.resize_trailing_extent(newWidthU16);
+        ROW::TranslateAttributes(newAttr, attrMap);
     }
 
     // Since we didn't use IncrementCircularBuffer() we need to compute the proper
@@ -2886,6 +4117,11 @@ void TextBuffer::Reflow(TextBuffer& oldBuffer, TextBuffer& newBuffer, const View
 
     newBuffer.CopyProperties(oldBuffer);
     newBuffer.CopyHyperlinkMaps(oldBuffer);
+    // The marks were copied directly into the rows, partially on multiple threads.
+    newBuffer._rebuildMarkRows();
+    // The rows were written out of order and _firstRow was changed after the fact.
+    newBuffer._resetChangeJournal();
+    newBuffer._packColdRegion();
 
     assert(newCursorPos.x >= 0 && newCursorPos.x < newWidth);
     assert(newCursorPos.y >= 0 && newCursorPos.y < newHeight);
@@ -2893,6 +4129,291 @@ void TextBuffer::Reflow(TextBuffer& oldBuffer, TextBuffer& newBuffer, const View
     newCursor.SetPosition(newCursorPos);
 }
 
+// Implements the main loop of Reflow() on multiple threads. The old buffer is split into chunks at
+// explicit newlines, so that each chunk begins at the start of a new row in the new buffer as well.
+// A first parallel pass computes the number of new rows of each chunk without copying any text,
+// which gives us the position of each chunk in the new buffer. A second parallel pass then
+// copies the text, attributes, marks and images of each chunk directly into the new buffer.
+//
+// Returns false if the buffer is too small to benefit from this, or if the new buffer is too small to hold
+// all rows up to the cursor. The caller must then fall back to the serial loop in Reflow(), which handles that.
+// Otherwise, newY is set to the first unused row in the new buffer and newCursorPos to the new cursor position.
+bool TextBuffer::_reflowParallel(const TextBuffer& oldBuffer, TextBuffer& newBuffer, const std::vector<TextAttributeTable::Id>& attrMap, const til::CoordType oldHeight, const til::point oldCursorPos, PositionInformation* positionInfo, til::CoordType& newY, til::point& newCursorPos)
+{
+    // 1024 rows of 120 columns take roughly 100us to reflow, which is long enough to amortize the scheduling overhead.
+    static constexpr til::CoordType chunkSize = 1024;
+
+    if (oldHeight < 2 * chunkSize || std::thread::hardware_concurrency() < 2)
+    {
+        return false;
+    }
+
+    struct Chunk
+    {
+        til::CoordType oldBeg = 0;
+        til::CoordType oldEnd = 0;
+        // The first row in the new buffer and the number of rows this chunk occupies.
+        til::CoordType newBeg = 0;
+        til::CoordType newRows = 0;
+        // These are relative to newBeg. The cursor's x position hasn't been adjusted to glyph boundaries yet.
+        std::optional<til::point> cursor;
+        std::optional<til::CoordType> mutableViewportTop;
+        std::optional<til::CoordType> visibleViewportTop;
+    };
+
+    // This loop touches all old rows, which ensures that they're committed and unpacked
+    // (see _getRowByOffsetDirect()) so that the worker threads below only read from the old buffer.
+    std::vector<Chunk> chunks;
+    for (til::CoordType y = 0, beg = 0; y < oldHeight; ++y)
+    {
+        const auto& row = oldBuffer.GetRowByOffset(y);
+        const auto newline = !row.WasWrapForced() || row.GetLineRendition() != LineRendition::SingleWidth;
+        if ((newline && y + 1 - beg >= chunkSize) || y + 1 == oldHeight)
+        {
+            chunks.push_back({ .oldBeg = beg, .oldEnd = y + 1 });
+            beg = y + 1;
+        }
+    }
+
+    // A single huge line can't be split up.
+    if (chunks.size() < 2)
+    {
+        return false;
+    }
+
+    const auto newWidth = newBuffer.GetSize().Width();
+    const auto newHeight = newBuffer.GetSize().Height();
+    const auto newWidthU16 = gsl::narrow_cast<uint16_t>(newWidth);
+    const auto mutableViewportTop = positionInfo ? std::max(0, positionInfo->mutableViewportTop) : til::CoordTypeMax;
+    const auto visibleViewportTop = positionInfo ? std::max(0, positionInfo->visibleViewportTop) : til::CoordTypeMax;
+    // Rows before this one get overwritten by later rows in the circular new buffer. There's no point in writing them.
+    auto writeBeg = til::CoordTypeMax;
+
+    // This is a copy of the main loop in Reflow(), limited to a single chunk. If `write` is false, it only
+    // computes the layout of the chunk. Otherwise, it writes all rows at or past writeBeg into the new buffer.
+    const auto reflowChunk = [&](Chunk& chunk, bool write) {
+        til::CoordType newX = 0;
+        til::CoordType y = 0;
+        til::CoordType preparedY = -1;
+
+        // Returns the given row in the new buffer or nullptr if it shouldn't be written to.
+        // Rows that got wrapped around in the circular buffer are reset once, when they're first touched (see REFLOW_RESET).
+        const auto getNewRow = [&](til::CoordType relativeY) -> ROW* {
+            const auto absoluteY = chunk.newBeg + relativeY;
+            if (!write || absoluteY < writeBeg)
+            {
+                return nullptr;
+            }
+            auto& row = newBuffer._getRow(absoluteY);
+            if (relativeY > preparedY)
+            {
+                preparedY = relativeY;
+                if (absoluteY >= newHeight)
+                {
+                    row.Reset(newBuffer._initialAttributesId);
+                }
+            }
+            return &row;
+        };
+        const auto recordPosition = [&](til::CoordType oldY) {
+            if (oldY == mutableViewportTop && !chunk.mutableViewportTop)
+            {
+                chunk.mutableViewportTop = y;
+            }
+            if (oldY == visibleViewportTop && !chunk.visibleViewportTop)
+            {
+                chunk.visibleViewportTop = y;
+            }
+        };
+
+        for (auto oldY = chunk.oldBeg; oldY < chunk.oldEnd; ++oldY)
+        {
+            const auto& oldRow = oldBuffer.GetRowByOffset(oldY);
+
+            if (oldRow.GetLineRendition() != LineRendition::SingleWidth)
+            {
+                if (newX)
+                {
+                    newX = 0;
+                    y++;
+                }
+                if (const auto newRow = getNewRow(y))
+                {
+                    newRow->CopyFrom(oldRow, attrMap);
+                    newRow->SetWrapForced(false);
+                }
+                if (oldY == oldCursorPos.y)
+                {
+                    chunk.cursor = { oldCursorPos.x, y };
+                }
+                recordPosition(oldY);
+                y++;
+                continue;
+            }
+
+            // See REFLOW_JANK_CURSOR_WRAP.
+            auto oldRowLimit = oldRow.MeasureRight();
+            if (oldY == oldCursorPos.y)
+            {
+                oldRowLimit = std::max(oldRowLimit, oldCursorPos.x + 1);
+            }
+
+            if (oldRow.GetScrollbarData().has_value())
+            {
+                if (const auto newRow = getNewRow(y))
+                {
+                    newRow->SetScrollbarData(oldRow.GetScrollbarData());
+                }
+            }
+
+            til::CoordType oldX = 0;
+
+            do
+            {
+                if (newX >= newWidth)
+                {
+                    if (const auto newRow = getNewRow(y))
+                    {
+                        newRow->SetWrapForced(true);
+                    }
+                    newX = 0;
+                    y++;
+                }
+
+                RowCopyTextFromState state{
+                    .source = oldRow,
+                    .columnBegin = newX,
+                    .columnLimit = til::CoordTypeMax,
+                    .sourceColumnBegin = oldX,
+                    .sourceColumnLimit = oldRowLimit,
+                };
+
+                if (const auto newRow = getNewRow(y))
+                {
+                    newRow->CopyTextFrom(state);
+
+                    if (oldX == 0)
+                    {
+                        ImageSlice::CopyRow(oldRow, *newRow);
+                    }
+
+                    const auto& oldAttr = oldRow.Attributes();
+                    auto& newAttr = newRow->Attributes();
+                    auto attributes = oldAttr.slice(gsl::narrow_cast<uint16_t>(oldX), oldAttr.size());
+                    ROW::TranslateAttributes(attributes, attrMap);
+                    newAttr.replace(gsl::narrow_cast<uint16_t>(newX), newAttr.size(), attributes);
+                    newAttr.resize_trailing_extent(newWidthU16);
+                }
+                else
+                {
+                    ROW::MeasureTextFrom(state, newWidth);
+                }
+
+                if (oldY == oldCursorPos.y && oldCursorPos.x >= oldX)
+                {
+                    chunk.cursor = { oldCursorPos.x - oldX + newX, y };
+                }
+                recordPosition(oldY);
+
+                oldX = state.sourceColumnEnd;
+                newX = state.columnEnd;
+            } while (oldX < oldRowLimit);
+
+            if (!oldRow.WasWrapForced())
+            {
+                newX = 0;
+                y++;
+            }
+        }
+
+        // Only the last chunk may end in a wrapped row. Reflow() newlines after its main loop in that case.
+        if (newX != 0)
+        {
+            y++;
+        }
+
+        chunk.newRows = y;
+    };
+
+    const auto forEachChunk = [&](bool write) {
+        std::mutex exceptionLock;
+        std::exception_ptr exception;
+
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](Chunk& chunk) noexcept {
+            // Chunks that end before writeBeg would be entirely overwritten by later ones.
+            if (write && chunk.newBeg + chunk.newRows <= writeBeg)
+            {
+                return;
+            }
+
+            try
+            {
+                reflowChunk(chunk, write);
+            }
+            catch (...)
+            {
+                const std::scoped_lock lock{ exceptionLock };
+                exception = std::current_exception();
+            }
+        });
+
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    };
+
+    forEachChunk(false);
+
+    til::CoordType newRowCount = 0;
+    til::point cursor;
+    for (auto& chunk : chunks)
+    {
+        chunk.newBeg = newRowCount;
+        newRowCount += chunk.newRows;
+        if (chunk.cursor)
+        {
+            cursor = { chunk.cursor->x, chunk.newBeg + chunk.cursor->y };
+        }
+    }
+
+    // Reflow() stops writing before it would overwrite the cursor row in the circular buffer.
+    // That's rare, so we don't bother replicating it and let the serial implementation handle it.
+    if (newRowCount > cursor.y + newHeight)
+    {
+        return false;
+    }
+
+    writeBeg = std::max(0, newRowCount - newHeight);
+
+    // Commit all the rows we're going to write to, because _commit() isn't thread-safe.
+    newBuffer._getRow(std::min(newRowCount, newHeight) - 1);
+
+    forEachChunk(true);
+
+    // GetMutableRowByOffset() isn't thread-safe either, because it assigns each row a new generation.
+    for (auto y = writeBeg; y < newRowCount; ++y)
+    {
+        newBuffer.GetMutableRowByOffset(y);
+    }
+
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.mutableViewportTop)
+        {
+            positionInfo->mutableViewportTop = chunk.newBeg + *chunk.mutableViewportTop;
+        }
+        if (chunk.visibleViewportTop)
+        {
+            positionInfo->visibleViewportTop = chunk.newBeg + *chunk.visibleViewportTop;
+        }
+    }
+
+    newY = newRowCount;
+    newCursorPos = { newBuffer.GetRowByOffset(cursor.y).AdjustToGlyphStart(cursor.x), cursor.y };
+    return true;
+}
+
 // Method Description:
 // - Adds or updates a hyperlink in our hyperlink table
 // Arguments:
@@ -3006,6 +4527,47 @@ std::optional<std::vector<til::point_span>> TextBuffer::SearchText(const std::ws
     return SearchText(needle, flags, 0, til::CoordTypeMax);
 }
 
+// Compiles the regex used by SearchText(). Returns nullptr if the needle is an invalid regular expression.
+static ICU::unique_uregex createSearchRegex(const std::wstring_view& needle, SearchFlag flags) noexcept
+{
+    uint32_t icuFlags{ 0 };
+    WI_SetFlagIf(icuFlags, UREGEX_CASE_INSENSITIVE, WI_IsFlagSet(flags, SearchFlag::CaseInsensitive));
+
+    if (WI_IsFlagSet(flags, SearchFlag::RegularExpression))
+    {
+        WI_SetFlag(icuFlags, UREGEX_MULTILINE);
+    }
+    else
+    {
+        WI_SetFlag(icuFlags, UREGEX_LITERAL);
+    }
+
+    UErrorCode status = U_ZERO_ERROR;
+    auto re = ICU::CreateRegex(needle, icuFlags, &status);
+    if (status > U_ZERO_ERROR)
+    {
+        re.reset();
+    }
+    return re;
+}
+
+// Appends all matches of `re` within the rows [rowBeg,rowEnd) to `results`.
+static void searchRows(const TextBuffer& buffer, URegularExpression* re, til::CoordType rowBeg, til::CoordType rowEnd, std::vector<til::point_span>& results)
+{
+    auto text = ICU::UTextFromTextBuffer(buffer, rowBeg, rowEnd);
+
+    UErrorCode status = U_ZERO_ERROR;
+    uregex_setUText(re, &text, &status);
+
+    if (uregex_find(re, -1, &status))
+    {
+        do
+        {
+            results.emplace_back(ICU::BufferRangeFromMatch(&text, re));
+        } while (uregex_findNext(re, &status));
+    }
+}
+
 // Searches through the given rows [rowBeg,rowEnd) for `needle` and returns the coordinates in absolute coordinates.
 // While the end coordinates of the returned ranges are considered inclusive, the [rowBeg,rowEnd) range is half-open.
 // Returns nullopt if the parameters were invalid (e.g. regex search was requested with an invalid regex)
@@ -3021,37 +4583,201 @@ std::optional<std::vector<til::point_span>> TextBuffer::SearchText(const std::ws
         return results;
     }
 
-    auto text = ICU::UTextFromTextBuffer(*this, rowBeg, rowEnd);
+    const auto re = createSearchRegex(needle, flags);
+    if (!re)
+    {
+        return std::nullopt;
+    }
 
-    uint32_t icuFlags{ 0 };
-    WI_SetFlagIf(icuFlags, UREGEX_CASE_INSENSITIVE, WI_IsFlagSet(flags, SearchFlag::CaseInsensitive));
+    searchRows(*this, re.get(), rowBeg, rowEnd, results);
+    return results;
+}
 
-    if (WI_IsFlagSet(flags, SearchFlag::RegularExpression))
+// Searches through the entire buffer like SearchText(needle, flags), but reuses the results of the previous call
+// with the same `cache` for all lines that weren't modified since. This makes repeated searches during ongoing
+// output roughly proportional in cost to the amount of new output instead of the size of the buffer.
+//
+// Unlike the other overloads, matches never span multiple (wrapped) lines, because each line is cached separately.
+// This only affects regular expressions that match line breaks.
+std::optional<std::vector<til::point_span>> TextBuffer::SearchText(const std::wstring_view& needle, SearchFlag flags, SearchCache& cache) const
+{
+    const auto rowEnd = _estimateOffsetOfLastCommittedRow() + 1;
+
+    std::vector<til::point_span> results;
+    SearchCache next;
+    next.mutationId = _lastMutationId;
+
+    if (allWhitespace(needle))
     {
-        WI_SetFlag(icuFlags, UREGEX_MULTILINE);
+        cache = std::move(next);
+        return results;
     }
-    else
+
+    const auto re = createSearchRegex(needle, flags);
+    if (!re)
     {
-        WI_SetFlag(icuFlags, UREGEX_LITERAL);
+        return std::nullopt;
     }
 
-    UErrorCode status = U_ZERO_ERROR;
-    const auto re = ICU::CreateRegex(needle, icuFlags, &status);
-    if (status > U_ZERO_ERROR)
+    // If no row was modified, moved or scrolled out since the previous search, its results are still accurate.
+    if (!cache.lines.empty() && cache.rowGenerations.size() == gsl::narrow_cast<size_t>(rowEnd))
     {
-        return std::nullopt;
+        if (const auto changes = GetRowsChangedSince(cache.mutationId); !changes.all && changes.rows.empty())
+        {
+            til::CoordType top = 0;
+            uint32_t match = 0;
+            for (const auto& line : cache.lines)
+            {
+                for (; match < line.matchesEnd; ++match)
+                {
+                    auto m = til::at(cache.matches, match);
+                    m.start.y += top;
+                    m.end.y += top;
+                    results.emplace_back(m);
+                }
+                top = gsl::narrow_cast<til::CoordType>(line.rowsEnd);
+            }
+            cache.mutationId = _lastMutationId;
+            return results;
+        }
     }
 
-    uregex_setUText(re.get(), &text, &status);
+    // Rows never change their relative order without also getting a new generation. This allows us to walk
+    // the old cache in lockstep with the buffer, even if it got rotated by IncrementCircularBuffer() since.
+    // oldRow and oldMatch are the first row and match of cache.lines[oldLine].
+    size_t oldLine = 0;
+    size_t oldRow = 0;
+    size_t oldMatch = 0;
+    // Rows with a generation of 0 or one newer than the cache are definitely dirty. Everything else should
+    // be in the cache, unless the buffer contents were swapped out. In that case we stop using the cache.
+    auto cacheValid = !cache.lines.empty();
+
+    // The lines in [dirtyBeg,y) need to be searched. dirtyLines holds their past-the-end rows.
+    til::CoordType dirtyBeg = 0;
+    std::vector<std::pair<til::CoordType, bool>> dirtyLines;
+    std::vector<til::point_span> dirtyMatches;
+
+    const auto appendLine = [&](til::CoordType top, til::CoordType bottom, bool open) {
+        for (auto y = top; y < bottom; ++y)
+        {
+            next.rowGenerations.emplace_back(GetRowGeneration(y));
+        }
+        next.lines.push_back({
+            .rowsEnd = gsl::narrow_cast<uint32_t>(next.rowGenerations.size()),
+            .matchesEnd = gsl::narrow_cast<uint32_t>(next.matches.size()),
+            .open = open,
+        });
+    };
 
-    if (uregex_find(re.get(), -1, &status))
+    const auto flushDirtyLines = [&](til::CoordType dirtyEnd) {
+        if (dirtyBeg >= dirtyEnd)
+        {
+            return;
+        }
+
+        dirtyMatches.clear();
+        searchRows(*this, re.get(), dirtyBeg, dirtyEnd, dirtyMatches);
+
+        auto top = dirtyBeg;
+        auto it = dirtyMatches.begin();
+        for (const auto& [bottom, open] : dirtyLines)
+        {
+            for (; it != dirtyMatches.end() && it->start.y < bottom; ++it)
+            {
+                if (it->end.y < bottom)
+                {
+                    results.emplace_back(*it);
+                    next.matches.push_back({ { it->start.x, it->start.y - top }, { it->end.x, it->end.y - top } });
+                }
+            }
+            appendLine(top, bottom, open);
+            top = bottom;
+        }
+
+        dirtyLines.clear();
+        dirtyBeg = dirtyEnd;
+    };
+
+    // Returns the index of the row with the given generation in the old cache and moves oldLine to its line.
+    const auto seekCache = [&](uint64_t generation) -> std::optional<size_t> {
+        auto row = oldRow;
+        auto match = oldMatch;
+        for (auto line = oldLine; line < cache.lines.size(); ++line)
+        {
+            const auto& l = til::at(cache.lines, line);
+            for (auto r = row; r < l.rowsEnd; ++r)
+            {
+                if (til::at(cache.rowGenerations, r) == generation)
+                {
+                    oldLine = line;
+                    oldRow = row;
+                    oldMatch = match;
+                    return r;
+                }
+            }
+            row = l.rowsEnd;
+            match = l.matchesEnd;
+        }
+        return std::nullopt;
+    };
+
+    for (til::CoordType y = 0; y < rowEnd;)
     {
-        do
+        if (const auto generation = GetRowGeneration(y); cacheValid && generation != 0 && generation <= cache.mutationId)
         {
-            results.emplace_back(ICU::BufferRangeFromMatch(&text, re.get()));
-        } while (uregex_findNext(re.get(), &status));
+            const auto row = seekCache(generation);
+            cacheValid = row.has_value();
+
+            // We can only reuse a line if it still starts at this row and all of its rows are unchanged.
+            if (row == oldRow)
+            {
+                const auto& line = til::at(cache.lines, oldLine);
+                const auto height = gsl::narrow_cast<til::CoordType>(line.rowsEnd - oldRow);
+                auto reusable = !line.open && y + height <= rowEnd;
+
+                for (auto r = oldRow + 1; reusable && r < line.rowsEnd; ++r)
+                {
+                    reusable = GetRowGeneration(y + gsl::narrow_cast<til::CoordType>(r - oldRow)) == til::at(cache.rowGenerations, r);
+                }
+
+                if (reusable)
+                {
+                    flushDirtyLines(y);
+
+                    for (auto m = oldMatch; m < line.matchesEnd; ++m)
+                    {
+                        auto match = til::at(cache.matches, m);
+                        next.matches.emplace_back(match);
+                        match.start.y += y;
+                        match.end.y += y;
+                        results.emplace_back(match);
+                    }
+                    appendLine(y, y + height, false);
+
+                    oldRow = line.rowsEnd;
+                    oldMatch = line.matchesEnd;
+                    oldLine++;
+                    y += height;
+                    dirtyBeg = y;
+                    continue;
+                }
+            }
+        }
+
+        // This line needs to be searched. Find its end by following wrap-forced rows.
+        auto bottom = y;
+        auto wrapped = GetRowByOffset(bottom).WasWrapForced();
+        for (; wrapped && bottom + 1 < rowEnd; wrapped = GetRowByOffset(bottom).WasWrapForced())
+        {
+            bottom++;
+        }
+
+        y = bottom + 1;
+        dirtyLines.emplace_back(y, wrapped);
     }
 
+    flushDirtyLines(rowEnd);
+    cache = std::move(next);
     return results;
 }
 
@@ -3060,15 +4786,9 @@ std::optional<std::vector<til::point_span>> TextBuffer::SearchText(const std::ws
 std::vector<ScrollMark> TextBuffer::GetMarkRows() const
 {
     std::vector<ScrollMark> marks;
-    const auto bottom = _estimateOffsetOfLastCommittedRow();
-    for (auto y = 0; y <= bottom; y++)
+    for (const auto y : _getMarkRowOffsets())
     {
-        const auto& row = GetRowByOffset(y);
-        const auto& data{ row.GetScrollbarData() };
-        if (data.has_value())
-        {
-            marks.emplace_back(y, *data);
-        }
+        marks.emplace_back(y, *_getScrollbarData(y));
     }
     return marks;
 }
@@ -3089,17 +4809,12 @@ std::vector<MarkExtents> TextBuffer::GetMarkExtents(size_t limit) const
     }
 
     std::vector<MarkExtents> marks{};
-    const auto bottom = _estimateOffsetOfLastCommittedRow();
-    auto lastPromptY = bottom;
-    for (auto promptY = bottom; promptY >= 0; promptY--)
+    const auto promptRows = _getMarkRowOffsets();
+    auto lastPromptY = _estimateOffsetOfLastCommittedRow();
+    for (auto it = promptRows.rbegin(); it != promptRows.rend(); ++it)
     {
-        const auto& currRow = GetRowByOffset(promptY);
-        auto& rowPromptData = currRow.GetScrollbarData();
-        if (!rowPromptData.has_value())
-        {
-            // This row didn't start a prompt, don't even look here.
-            continue;
-        }
+        const auto promptY = *it;
+        auto& rowPromptData = _getScrollbarData(promptY);
 
         // Future thought! In #11000 & #14792, we considered the possibility of
         // scrolling to only an error mark, or something like that. Perhaps in
@@ -3146,9 +4861,12 @@ void TextBuffer::ClearMarksInRange(
         auto& row = GetMutableRowByOffset(y);
         auto& runs = row.Attributes().runs();
         row.SetScrollbarData(std::nullopt);
-        for (auto& [attr, length] : runs)
+        _removeMarkRow(y);
+        for (auto& [attrId, length] : runs)
         {
+            auto attr = _attributeTable->Get(attrId);
             attr.SetMarkAttributes(MarkKind::None);
+            attrId = _attributeTable->Intern(attr);
         }
     }
 }
@@ -3202,10 +4920,10 @@ MarkExtents TextBuffer::_scrollMarkExtentForRow(const til::CoordType rowOffset,
         const auto& row = GetRowByOffset(y);
         const auto runs = row.Attributes().runs();
         x = 0;
-        for (const auto& [attr, length] : runs)
+        for (const auto& [attrId, length] : runs)
         {
             const auto nextX = gsl::narrow_cast<uint16_t>(x + length);
-            const auto markKind{ attr.GetMarkAttributes() };
+            const auto markKind{ _attributeTable->Get(attrId).GetMarkAttributes() };
 
             if (markKind != MarkKind::None)
             {
@@ -3276,10 +4994,10 @@ std::wstring TextBuffer::_commandForRow(const til::CoordType rowOffset, const ti
         const auto& row = GetRowByOffset(y);
         const auto runs = row.Attributes().runs();
         auto x = 0;
-        for (const auto& [attr, length] : runs)
+        for (const auto& [attrId, length] : runs)
         {
             const auto nextX = gsl::narrow_cast<uint16_t>(x + length);
-            const auto markKind{ attr.GetMarkAttributes() };
+            const auto markKind{ _attributeTable->Get(attrId).GetMarkAttributes() };
             if (markKind != lastMarkKind)
             {
                 if (lastMarkKind == MarkKind::Command)
@@ -3307,39 +5025,28 @@ std::wstring TextBuffer::_commandForRow(const til::CoordType rowOffset, const ti
 
 std::wstring TextBuffer::CurrentCommand() const
 {
-    auto promptY = GetCursor().GetPosition().y;
-    for (; promptY >= 0; promptY--)
+    // Find the last prompt at or above the cursor.
+    const auto promptRows = _getMarkRowOffsets();
+    const auto it = std::upper_bound(promptRows.begin(), promptRows.end(), GetCursor().GetPosition().y);
+    if (it == promptRows.begin())
     {
-        const auto& currRow = GetRowByOffset(promptY);
-        auto& rowPromptData = currRow.GetScrollbarData();
-        if (!rowPromptData.has_value())
-        {
-            // This row didn't start a prompt, don't even look here.
-            continue;
-        }
-
-        // This row did start a prompt! Find the prompt that starts here.
-        // Presumably, no rows below us will have prompts, so pass in the last
-        // row with text as the bottom
-        return _commandForRow(promptY, _estimateOffsetOfLastCommittedRow());
+        return L"";
     }
-    return L"";
+
+    // This row did start a prompt! Find the prompt that starts here.
+    // Presumably, no rows below us will have prompts, so pass in the last
+    // row with text as the bottom
+    return _commandForRow(*std::prev(it), _estimateOffsetOfLastCommittedRow());
 }
 
 std::vector<std::wstring> TextBuffer::Commands() const
 {
     std::vector<std::wstring> commands{};
-    const auto bottom = _estimateOffsetOfLastCommittedRow();
-    auto lastPromptY = bottom;
-    for (auto promptY = bottom; promptY >= 0; promptY--)
+    const auto promptRows = _getMarkRowOffsets();
+    auto lastPromptY = _estimateOffsetOfLastCommittedRow();
+    for (auto it = promptRows.rbegin(); it != promptRows.rend(); ++it)
     {
-        const auto& currRow = GetRowByOffset(promptY);
-        auto& rowPromptData = currRow.GetScrollbarData();
-        if (!rowPromptData.has_value())
-        {
-            // This row didn't start a prompt, don't even look here.
-            continue;
-        }
+        const auto promptY = *it;
 
         // This row did start a prompt! Find the prompt that starts here.
         // Presumably, no rows below us will have prompts, so pass in the last
@@ -3360,6 +5067,7 @@ void TextBuffer::StartPrompt()
     const auto currentRowOffset = GetCursor().GetPosition().y;
     auto& currentRow = GetMutableRowByOffset(currentRowOffset);
     currentRow.StartPrompt();
+    _addMarkRow(currentRowOffset);
 
     _currentAttributes.SetMarkAttributes(MarkKind::Prompt);
 }
@@ -3404,8 +5112,10 @@ bool TextBuffer::_createPromptMarkIfNeeded()
     //   --> add a new mark to this row, set all the attrs in this row
     //   to be Prompt, and set the current attrs to Output.
 
-    auto& row = GetMutableRowByOffset(GetCursor().GetPosition().y);
+    const auto y = GetCursor().GetPosition().y;
+    auto& row = GetMutableRowByOffset(y);
     row.StartPrompt();
+    _addMarkRow(y);
     return true;
 }
 
@@ -3428,15 +5138,11 @@ void TextBuffer::EndCurrentCommand(std::optional<unsigned int> error)
 {
     _currentAttributes.SetMarkAttributes(MarkKind::None);
 
-    for (auto y = GetCursor().GetPosition().y; y >= 0; y--)
+    const auto promptRows = _getMarkRowOffsets();
+    const auto it = std::upper_bound(promptRows.begin(), promptRows.end(), GetCursor().GetPosition().y);
+    if (it != promptRows.begin())
     {
-        auto& currRow = GetMutableRowByOffset(y);
-        auto& rowPromptData = currRow.GetScrollbarData();
-        if (rowPromptData.has_value())
-        {
-            currRow.EndOutput(error);
-            return;
-        }
+        GetMutableRowByOffset(*std::prev(it)).EndOutput(error);
     }
 }
 
@@ -3444,12 +5150,76 @@ void TextBuffer::SetScrollbarData(ScrollbarData mark, til::CoordType y)
 {
     auto& row = GetMutableRowByOffset(y);
     row.SetScrollbarData(mark);
+    _addMarkRow(y);
+}
+
+// Returns the offsets of all rows with ScrollbarData in ascending order.
+// This costs O(marks) instead of having to look at each row in the buffer.
+std::vector<til::CoordType> TextBuffer::_getMarkRowOffsets() const
+{
+    std::vector<til::CoordType> offsets;
+    offsets.reserve(_markRows.size());
+
+    const auto bottom = _estimateOffsetOfLastCommittedRow();
+    const auto append = [&](auto beg, auto end) {
+        for (auto it = beg; it != end; ++it)
+        {
+            const auto y = _getSlotRowIndex(*it);
+            if (y <= bottom && _getScrollbarData(y).has_value())
+            {
+                offsets.emplace_back(y);
+            }
+        }
+    };
+
+    // _markRows is sorted by slot, but the rows start at the slot of row 0 and wrap around.
+    const auto mid = std::lower_bound(_markRows.begin(), _markRows.end(), _getRowSlot(0));
+    append(mid, _markRows.end());
+    append(_markRows.begin(), mid);
+    return offsets;
+}
+
+void TextBuffer::_addMarkRow(const til::CoordType y)
+{
+    const auto slot = gsl::narrow_cast<uint16_t>(_getRowSlot(y));
+    const auto it = std::lower_bound(_markRows.begin(), _markRows.end(), slot);
+    if (it == _markRows.end() || *it != slot)
+    {
+        _markRows.insert(it, slot);
+    }
+}
+
+void TextBuffer::_removeMarkRow(const til::CoordType y) noexcept
+{
+    const auto slot = _getRowSlot(y);
+    const auto it = std::lower_bound(_markRows.begin(), _markRows.end(), slot);
+    if (it != _markRows.end() && *it == slot)
+    {
+        _markRows.erase(it);
+    }
+}
+
+// Recreates _markRows from scratch by looking at every row.
+void TextBuffer::_rebuildMarkRows()
+{
+    _markRows.clear();
+    const auto bottom = _estimateOffsetOfLastCommittedRow();
+    for (auto y = 0; y <= bottom; y++)
+    {
+        if (_getScrollbarData(y).has_value())
+        {
+            _markRows.emplace_back(gsl::narrow_cast<uint16_t>(_getRowSlot(y)));
+        }
+    }
+    std::sort(_markRows.begin(), _markRows.end());
 }
 void TextBuffer::ManuallyMarkRowAsPrompt(til::CoordType y)
 {
     auto& row = GetMutableRowByOffset(y);
-    for (auto& [attr, len] : row.Attributes().runs())
+    for (auto& [attrId, len] : row.Attributes().runs())
     {
+        auto attr = _attributeTable->Get(attrId);
         attr.SetMarkAttributes(MarkKind::Prompt);
+        attrId = _attributeTable->Intern(attr);
     }
 }
@@ -50,6 +50,7 @@ filling in the last row, and updating the screen.
 #pragma once
 
 #include "cursor.h"
+#include "PackedRow.hpp"
 #include "Row.hpp"
 #include "TextAttribute.hpp"
 #include "../types/inc/Viewport.hpp"
@@ -89,6 +90,7 @@ public:
     ROW& GetScratchpadRow(const TextAttribute& attributes);
     const ROW& GetRowByOffset(til::CoordType index) const;
     ROW& GetMutableRowByOffset(til::CoordType index);
+    uint64_t GetRowGeneration(til::CoordType index) const;
 
     TextBufferCellIterator GetCellDataAt(const til::point at) const;
     TextBufferCellIterator GetCellLineDataAt(const til::point at) const;
@@ -124,17 +126,40 @@ public:
     // Scroll needs access to this to quickly rotate around the buffer.
     void IncrementCircularBuffer(const TextAttribute& fillAttributes = {});
 
+    void EnableColdScrollback(til::CoordType viewportHeight);
+    size_t GetColdScrollbackMemoryUsage() const noexcept;
+
+    TextAttributeTable& GetAttributeTable() const noexcept;
+    ImageTileTable& GetImageTileTable() noexcept;
+
     til::point GetLastNonSpaceCharacter(const Microsoft::Console::Types::Viewport* viewOptional = nullptr) const;
 
     Cursor& GetCursor() noexcept;
     const Cursor& GetCursor() const noexcept;
 
     uint64_t GetLastMutationId() const noexcept;
+
+    struct RowChanges
+    {
+        // The generation to pass to the next GetRowsChangedSince() call.
+        uint64_t generation = 0;
+        // The number of rows the buffer has scrolled by via IncrementCircularBuffer() in total.
+        // Between two calls, the unchanged rows moved up by the difference of their scrollCount.
+        uint64_t scrollCount = 0;
+        // True if the changes can't be tracked back to the given generation, for instance because
+        // the buffer was resized or the generation belongs to another buffer. All rows must be
+        // assumed to have changed in that case and `rows` is empty.
+        bool all = false;
+        // The indices of the rows that were modified or moved by ScrollRows(), in ascending order.
+        std::vector<til::CoordType> rows;
+    };
+
+    RowChanges GetRowsChangedSince(uint64_t generation) const;
     const til::CoordType GetFirstRowIndex() const noexcept;
 
     const Microsoft::Console::Types::Viewport GetSize() const noexcept;
 
-    void ScrollRows(const til::CoordType firstRow, const til::CoordType size, const til::CoordType delta);
+    void ScrollRows(const til::CoordType firstRow, const til::CoordType size, const til::CoordType delta, const bool keepVacatedRows = true);
     void CopyRow(const til::CoordType srcRow, const til::CoordType dstRow, TextBuffer& dstBuffer) const;
 
     til::CoordType TotalRowCount() const noexcept;
@@ -281,6 +306,9 @@ public:
                        std::function<std::tuple<COLORREF, COLORREF, COLORREF>(const TextAttribute&)> GetAttributeColors) const noexcept;
 
     void Serialize(const wchar_t* destination) const;
+    void SerializeSnapshot(const wchar_t* destination) const;
+    static bool IsSnapshot(std::span<const std::byte> data) noexcept;
+    static std::unique_ptr<TextBuffer> FromSnapshot(std::span<const std::byte> data, Microsoft::Console::Render::Renderer* renderer);
 
     struct PositionInformation
     {
@@ -293,6 +321,32 @@ public:
     std::optional<std::vector<til::point_span>> SearchText(const std::wstring_view& needle, SearchFlag flags) const;
     std::optional<std::vector<til::point_span>> SearchText(const std::wstring_view& needle, SearchFlag flags, til::CoordType rowBeg, til::CoordType rowEnd) const;
 
+    // Holds the per-line results of a previous SearchText() call, so that the next call only needs
+    // to search the lines that were modified since. It must be reset when the needle or flags change.
+    struct SearchCache
+    {
+        struct Line
+        {
+            // Past-the-end indices into rowGenerations and matches.
+            uint32_t rowsEnd = 0;
+            uint32_t matchesEnd = 0;
+            // True if the line's last row is wrap-forced and was the last searched row.
+            // The line may have been continued since, so it can't be reused.
+            bool open = false;
+        };
+
+        // The generation of each searched row, in buffer order.
+        std::vector<uint64_t> rowGenerations;
+        // Consecutive (wrapped) lines of rows in rowGenerations.
+        std::vector<Line> lines;
+        // The matches in each line. The y coordinates are relative to the top of the line.
+        std::vector<til::point_span> matches;
+        // GetLastMutationId() at the time of the search. Any rows with a newer generation were modified since.
+        uint64_t mutationId = 0;
+    };
+
+    std::optional<std::vector<til::point_span>> SearchText(const std::wstring_view& needle, SearchFlag flags, SearchCache& cache) const;
+
     // Mark handling
     std::vector<ScrollMark> GetMarkRows() const;
     std::vector<MarkExtents> GetMarkExtents(size_t limit = SIZE_T_MAX) const;
@@ -313,9 +367,31 @@ private:
     void _decommit() noexcept;
     void _construct(const std::byte* until) noexcept;
     void _destroy() const noexcept;
+    void _constructRow(std::byte* row) noexcept;
     ROW& _getRowByOffsetDirect(size_t offset);
+    til::CoordType _getRowSlot(til::CoordType y) const noexcept;
+    til::CoordType _getSlotRowIndex(til::CoordType slot) const noexcept;
+    size_t _getRowOffset(til::CoordType y) const noexcept;
+    til::CoordType _getRowIndex(size_t offset) const noexcept;
+    til::CoordType _getOffsetSlot(size_t offset) const noexcept;
+    void _rotateRows(til::CoordType top, til::CoordType count, til::CoordType delta);
     ROW& _getRow(til::CoordType y) const;
     til::CoordType _estimateOffsetOfLastCommittedRow() const noexcept;
+    void _journalRowChange(size_t offset);
+    void _journalSlotRangeChange(til::CoordType slotBeg, til::CoordType count);
+    void _compactChangeJournal();
+    void _resetChangeJournal() noexcept;
+    bool _isPackedRow(size_t offset) const noexcept;
+    void _packRow(size_t offset);
+    void _unpackRow(size_t offset, bool restoreContents);
+    void _decommitPackedPages(const std::byte* row) noexcept;
+    bool _isColdRow(size_t offset) const noexcept;
+    void _packColdRows();
+    void _packColdRegion();
+    void _collectAttributes();
+    std::vector<uint16_t> _getHyperlinks(til::CoordType y) const;
+    static bool _reflowParallel(const TextBuffer& oldBuffer, TextBuffer& newBuffer, const std::vector<TextAttributeTable::Id>& attrMap, til::CoordType oldHeight, til::point oldCursorPos, PositionInformation* positionInfo, til::CoordType& newY, til::point& newCursorPos);
+    const std::optional<ScrollbarData>& _getScrollbarData(til::CoordType y) const;
 
     void _SetFirstRowIndex(const til::CoordType FirstRowIndex) noexcept;
     void _ExpandTextRow(til::inclusive_rect& selectionRow) const;
@@ -329,8 +405,28 @@ private:
     std::wstring _commandForRow(const til::CoordType rowOffset, const til::CoordType bottomInclusive) const;
     MarkExtents _scrollMarkExtentForRow(const til::CoordType rowOffset, const til::CoordType bottomInclusive) const;
     bool _createPromptMarkIfNeeded();
+    std::vector<til::CoordType> _getMarkRowOffsets() const;
+    void _addMarkRow(til::CoordType y);
+    void _removeMarkRow(til::CoordType y) noexcept;
+    void _rebuildMarkRows();
 
     std::tuple<til::CoordType, til::CoordType, bool> _RowCopyHelper(const CopyRequest& req, const til::CoordType iRow, const ROW& row) const;
+    void _PrepareCopy(const CopyRequest& req, const std::function<void(TextAttributeTable::Id)>& onAttribute) const;
+    void _CopyPlainText(const CopyRequest& req, const std::function<void(std::span<std::wstring>)>& sink) const;
+    void _CopyHTML(const CopyRequest& req,
+                   const int fontHeightPoints,
+                   const std::wstring_view fontFaceName,
+                   const COLORREF backgroundColor,
+                   const bool isIntenseBold,
+                   const std::function<std::tuple<COLORREF, COLORREF, COLORREF>(const TextAttribute&)>& GetAttributeColors,
+                   const std::function<void(std::span<std::string>)>& sink) const;
+    void _CopyRTF(const CopyRequest& req,
+                  const int fontHeightPoints,
+                  const std::wstring_view fontFaceName,
+                  const COLORREF backgroundColor,
+                  const bool isIntenseBold,
+                  const std::function<std::tuple<COLORREF, COLORREF, COLORREF>(const TextAttribute&)>& GetAttributeColors,
+                  const std::function<void(std::span<std::string>)>& sink) const;
 
     static void _AppendRTFText(std::string& contentBuilder, const std::wstring_view& text);
 
@@ -383,6 +479,36 @@ private:
     // Before TextBuffer was made to use virtual memory it initialized the entire memory arena with the initial
     // attributes right away. To ensure it continues to work the way it used to, this stores these initial attributes.
     TextAttribute _initialAttributes;
+    TextAttributeTable::Id _initialAttributesId = TextAttributeTable::DefaultId;
+    // The ROWs store ids into this table instead of TextAttributes. It's heap allocated so that
+    // ResizeTraditional() can steal it from its temporary TextBuffer without invalidating the ROWs.
+    std::unique_ptr<TextAttributeTable> _attributeTable = std::make_unique<TextAttributeTable>();
+    // Deduplicates the pixels of the image slices in this buffer.
+    ImageTileTable _imageTileTable;
+    // The _getRowSlot() of every row that may carry ScrollbarData, sorted in ascending order. Since these are
+    // circular indices, they're unaffected by IncrementCircularBuffer(), and ScrollRows() moves them along with
+    // their rows. It's a superset of the rows with marks: Rows that lose their data some other way
+    // (e.g. ROW::Reset) are filtered by _getMarkRowOffsets().
+    std::vector<uint16_t> _markRows;
+    // ScrollRows() moves rows inside of scroll regions by permuting their storage offsets instead of copying them.
+    // _rowMap maps from the circular row index ((_firstRow + y) % _height) to the offset for _getRowByOffsetDirect()
+    // and _rowSlots is its inverse. Both are empty until the first permutation, which means that the mapping
+    // is the identity (+1 for the scratchpad row). The permutation only ever involves committed rows,
+    // which keeps _estimateOffsetOfLastCommittedRow() valid.
+    std::vector<uint16_t> _rowMap;
+    std::vector<uint16_t> _rowSlots;
+    // The storage offset of each row that got a new generation, in the order of their generation.
+    // See GetRowsChangedSince(). Only the most recent entry of each row is needed, which is why
+    // _journalRowChange() compacts the journal to at most _height entries whenever it grows too large.
+    struct ChangeJournalEntry
+    {
+        uint64_t generation;
+        // The storage offset of the row. If slotCount isn't 0, this is instead the first of
+        // slotCount consecutive slots (see _getRowSlot()) that changed at once. They may wrap around.
+        uint16_t offset;
+        uint16_t slotCount = 0;
+    };
+    std::vector<ChangeJournalEntry> _changeJournal;
     // ROW ---------------+--+--+
     // (padding)          |  |  v _bufferOffsetChars
     // ROW::_charsBuffer  |  |
@@ -392,6 +518,19 @@ private:
     size_t _bufferRowStride = 0;
     size_t _bufferOffsetChars = 0;
     size_t _bufferOffsetCharOffsets = 0;
+
+    // This block describes the "cold" scrollback tier. Once a row scrolls far enough out of the viewport,
+    // _packColdRows() packs it into a PackedRow, destroys the ROW and MEM_DECOMMITs any memory pages that
+    // are now exclusively occupied by packed rows. _getRowByOffsetDirect() transparently unpacks them again.
+    //
+    // Indexed identically to _getRowByOffsetDirect(). It's empty until the first row gets packed.
+    std::vector<PackedRow> _packedRows;
+    // Offsets of cold rows that got unpacked on access, from least to most recently unpacked.
+    // Once there are more than _unpackedColdRowBudget, _unpackRow() packs the oldest one again.
+    std::deque<size_t> _unpackedColdRows;
+    static constexpr size_t _unpackedColdRowBudget = 1024;
+    // The number of rows at the bottom of the buffer that are never packed. 0 if the cold tier is disabled.
+    til::CoordType _hotRowCount = 0;
     // The width of the buffer in columns.
     uint16_t _width = 0;
     // The height of the buffer in rows, excluding the scratchpad row.
@@ -399,7 +538,10 @@ private:
 
     TextAttribute _currentAttributes;
     til::CoordType _firstRow = 0; // indexes top row (not necessarily 0)
+    uint64_t _scrollCount = 0; // the number of IncrementCircularBuffer() calls
     uint64_t _lastMutationId = 0;
+    // The generation at which _changeJournal started recording. Changes before that are unknown.
+    uint64_t _changeJournalStart = 0;
 
     Cursor _cursor;
     bool _isActiveBuffer = false;
@@ -356,3 +356,10 @@ til::point TextBufferCellIterator::Pos() const noexcept
 {
     return _pos;
 }
+
+// Returns the id of the current cell's attributes in the buffer's TextAttributeTable.
+// Two cells of the same buffer have equal attributes if and only if their ids are equal.
+TextAttributeTable::Id TextBufferCellIterator::TextAttrId() const noexcept
+{
+    return _attrIter.Id();
+}
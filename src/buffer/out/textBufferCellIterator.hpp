@@ -47,13 +47,14 @@ public:
     const OutputCellView* operator->() const noexcept;
 
     til::point Pos() const noexcept;
+    TextAttributeTable::Id TextAttrId() const noexcept;
 
 protected:
     void _SetPos(const til::point newPos);
     void _GenerateView() noexcept;
     static const ROW* s_GetRow(const TextBuffer& buffer, const til::point pos);
 
-    til::small_rle<TextAttribute, uint16_t, 1>::const_iterator _attrIter;
+    ROW::AttributeIterator _attrIter;
     OutputCellView _view;
 
     const ROW* _pRow;
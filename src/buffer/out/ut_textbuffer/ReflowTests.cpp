@@ -805,6 +805,75 @@ class ReflowTests
             _compareTextBufferAgainstTestBuffer(*textBuffer, testBuffer);
         }
     }
+
+    TEST_METHOD(TestParallelReflow)
+    {
+        // Buffers with 2048+ rows are reflowed on multiple threads, in chunks split at explicit newlines.
+        // Reflowing such a buffer must be identical to reflowing each of its parts individually,
+        // which are small enough to be reflowed by the serial implementation.
+        static constexpr til::CoordType oldWidth = 100;
+        static constexpr til::CoordType newWidth = 57;
+        static constexpr size_t lineCount = 2000;
+        static constexpr size_t linesPerPart = 500;
+
+        // Writes lines [beg,end) into the buffer and returns the number of rows they occupy.
+        // Each logical line is 1-3 rows long and every other one contains wide glyphs.
+        const auto writeLines = [](TextBuffer& buffer, size_t beg, size_t end) {
+            til::CoordType y = 0;
+            for (auto i = beg; i < end; ++i)
+            {
+                const auto wrappedRows = i % 3;
+                for (size_t j = 0; j <= wrappedRows; ++j, ++y)
+                {
+                    std::wstring text;
+                    if (j < wrappedRows)
+                    {
+                        for (auto k = 0; k < oldWidth; ++k)
+                        {
+                            text.push_back(i % 2 && k % 7 == 0 ? L'\u732B' : static_cast<wchar_t>(L'a' + (i + k) % 26));
+                        }
+                    }
+                    else
+                    {
+                        text = fmt::format(L"line {}", i);
+                    }
+
+                    auto& row = buffer.GetMutableRowByOffset(y);
+                    RowWriteState state{ .text = text };
+                    row.ReplaceText(state);
+                    row.ReplaceAttributes(0, 4, TextAttribute{ gsl::narrow_cast<WORD>(i % 16) });
+                    row.SetWrapForced(j < wrappedRows);
+                }
+            }
+            return y;
+        };
+
+        TextBuffer oldBuffer{ { oldWidth, 4096 }, TextAttribute{ 0x7 }, 0, false, &renderer };
+        writeLines(oldBuffer, 0, lineCount);
+        TextBuffer newBuffer{ { newWidth, 9001 }, TextAttribute{ 0x7 }, 0, false, &renderer };
+        TextBuffer::Reflow(oldBuffer, newBuffer);
+
+        til::CoordType newY = 0;
+        for (size_t beg = 0; beg < lineCount; beg += linesPerPart)
+        {
+            TextBuffer oldPart{ { oldWidth, 2000 }, TextAttribute{ 0x7 }, 0, false, &renderer };
+            VERIFY_IS_LESS_THAN(writeLines(oldPart, beg, beg + linesPerPart), 2048);
+            TextBuffer newPart{ { newWidth, 4096 }, TextAttribute{ 0x7 }, 0, false, &renderer };
+            TextBuffer::Reflow(oldPart, newPart);
+
+            const auto partHeight = newPart.GetLastNonSpaceCharacter().y + 1;
+            for (til::CoordType y = 0; y < partHeight; ++y, ++newY)
+            {
+                const auto& expected = newPart.GetRowByOffset(y);
+                const auto& actual = newBuffer.GetRowByOffset(newY);
+                VERIFY_ARE_EQUAL(expected.GetText(), actual.GetText());
+                VERIFY_ARE_EQUAL(expected.WasWrapForced(), actual.WasWrapForced());
+                VERIFY_ARE_EQUAL(expected.GetAttrByColumn(0), actual.GetAttrByColumn(0));
+            }
+        }
+
+        VERIFY_ARE_EQUAL(newY, newBuffer.GetLastNonSpaceCharacter().y + 1);
+    }
 };
 
 DummyRenderer ReflowTests::renderer{};
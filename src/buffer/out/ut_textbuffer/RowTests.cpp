@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include "WexTestClass.h"
+#include "../../inc/consoletaeftemplates.hpp"
+
+#include "../textBuffer.hpp"
+#include "../../renderer/inc/DummyRenderer.hpp"
+
+using namespace WEX::Common;
+using namespace WEX::Logging;
+using namespace WEX::TestExecution;
+
+class RowTests
+{
+    TEST_CLASS(RowTests);
+
+    // ReplaceText() processes ASCII in vectorized chunks of 8 and 16 chars.
+    // This tests every chunk boundary with and without a non-ASCII char in each position.
+    TEST_METHOD(ReplaceTextAsciiFastPath)
+    {
+        static constexpr til::CoordType columns = 48;
+        static constexpr til::CoordType columnBegin = 3;
+
+        DummyRenderer renderer;
+        TextBuffer buffer{ til::size{ columns, 1 }, TextAttribute{}, 0, false, &renderer };
+
+        for (size_t length = 1; length <= 40; ++length)
+        {
+            // nonAscii == length means that the text is pure ASCII.
+            for (size_t nonAscii = 0; nonAscii <= length; ++nonAscii)
+            {
+                std::wstring text;
+                for (size_t i = 0; i < length; ++i)
+                {
+                    text.push_back(i == nonAscii ? L'é' : static_cast<wchar_t>(L'a' + i % 26));
+                }
+
+                auto& row = buffer.GetMutableRowByOffset(0);
+                row.Reset(TextAttribute{});
+
+                RowWriteState state{
+                    .text = text,
+                    .columnBegin = columnBegin,
+                };
+                row.ReplaceText(state);
+
+                VERIFY_IS_TRUE(state.text.empty());
+                VERIFY_ARE_EQUAL(columnBegin + gsl::narrow_cast<til::CoordType>(length), state.columnEnd);
+
+                std::wstring expected(columns, L' ');
+                expected.replace(columnBegin, length, text);
+                VERIFY_ARE_EQUAL(std::wstring_view{ expected }, row.GetText());
+
+                for (til::CoordType x = 0; x < columns; ++x)
+                {
+                    VERIFY_ARE_EQUAL(std::wstring_view{ &expected[x], 1 }, row.GlyphAt(x));
+                }
+            }
+        }
+    }
+
+    // Not a test per se, but a micro-benchmark for ReplaceText() which logs rows/s for various row widths.
+    TEST_METHOD(ReplaceTextAsciiThroughput)
+    {
+        BEGIN_TEST_METHOD_PROPERTIES()
+            TEST_METHOD_PROPERTY(L"Data:columns", L"{80, 120, 400}")
+        END_TEST_METHOD_PROPERTIES()
+
+        int columns = 0;
+        VERIFY_SUCCEEDED(TestData::TryGetValue(L"columns", columns));
+
+        static constexpr size_t iterations = 100000;
+
+        DummyRenderer renderer;
+        TextBuffer buffer{ til::size{ columns, 1 }, TextAttribute{}, 0, false, &renderer };
+
+        std::wstring ascii;
+        for (til::CoordType i = 0; i < columns; ++i)
+        {
+            ascii.push_back(static_cast<wchar_t>(L'!' + i % 94));
+        }
+
+        // The same text, but with a non-ASCII char at the end, which forces
+        // the last chunk of the text through the slower Unicode path.
+        auto mixed = ascii;
+        mixed.back() = L'é';
+
+        const auto measure = [&](const std::wstring_view& text) {
+            auto& row = buffer.GetMutableRowByOffset(0);
+            const auto start = std::chrono::steady_clock::now();
+
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                RowWriteState state{ .text = text };
+                row.ReplaceText(state);
+            }
+
+            const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            VERIFY_ARE_EQUAL(text, row.GetText());
+            return iterations / elapsed;
+        };
+
+        const auto asciiRowsPerSecond = measure(ascii);
+        const auto mixedRowsPerSecond = measure(mixed);
+
+        Log::Comment(NoThrowString().Format(L"%d columns: %.0f rows/s ASCII, %.0f rows/s with a trailing non-ASCII char", columns, asciiRowsPerSecond, mixedRowsPerSecond));
+    }
+
+    // Copying an image slice should share its pixels until either copy gets modified.
+    TEST_METHOD(ImageSliceCopyOnWrite)
+    {
+        static constexpr til::size cellSize{ 4, 2 };
+
+        DummyRenderer renderer;
+        TextBuffer buffer{ til::size{ 10, 2 }, TextAttribute{}, 0, false, &renderer };
+
+        auto& srcRow = buffer.GetMutableRowByOffset(0);
+        auto& dstRow = buffer.GetMutableRowByOffset(1);
+        const auto srcSlice = srcRow.SetImageSlice(std::make_unique<ImageSlice>(cellSize));
+        srcSlice->MutablePixels(2, 4)[0] = RGBQUAD{ 1, 2, 3, 4 };
+
+        ImageSlice::CopyRow(srcRow, dstRow);
+        VERIFY_ARE_EQUAL(srcRow.GetImageSlice()->Pixels().data(), dstRow.GetImageSlice()->Pixels().data());
+
+        // A copy of the entire row at the same columns is also just a pointer copy.
+        dstRow.SetImageSlice(nullptr);
+        ImageSlice::CopyCells(srcRow, 0, dstRow, 0, 10);
+        VERIFY_ARE_EQUAL(srcRow.GetImageSlice()->Pixels().data(), dstRow.GetImageSlice()->Pixels().data());
+
+        dstRow.GetMutableImageSlice()->MutablePixels(2, 3)[0] = RGBQUAD{ 5, 6, 7, 8 };
+        VERIFY_ARE_NOT_EQUAL(srcRow.GetImageSlice()->Pixels().data(), dstRow.GetImageSlice()->Pixels().data());
+        VERIFY_ARE_EQUAL(BYTE{ 1 }, srcRow.GetImageSlice()->Pixels(2)->rgbBlue);
+        VERIFY_ARE_EQUAL(BYTE{ 5 }, dstRow.GetImageSlice()->Pixels(2)->rgbBlue);
+
+        // Erasing part of a shared slice must not affect the other one either.
+        ImageSlice::CopyRow(srcRow, dstRow);
+        ImageSlice::EraseCells(dstRow, 2, 3);
+        VERIFY_ARE_EQUAL(BYTE{ 1 }, srcRow.GetImageSlice()->Pixels(2)->rgbBlue);
+        VERIFY_ARE_EQUAL(BYTE{ 0 }, dstRow.GetImageSlice()->Pixels(2)->rgbBlue);
+    }
+
+    TEST_METHOD(ImageTileDeduplication)
+    {
+        static constexpr til::size cellSize{ 4, 2 };
+
+        ImageTileTable table;
+        ImageSlice a{ cellSize };
+        ImageSlice b{ cellSize };
+        ImageSlice c{ cellSize };
+        a.MutablePixels(0, 2)[1] = RGBQUAD{ 1, 2, 3, 4 };
+        b.MutablePixels(0, 2)[1] = RGBQUAD{ 1, 2, 3, 4 };
+        c.MutablePixels(0, 2)[1] = RGBQUAD{ 4, 3, 2, 1 };
+
+        table.Deduplicate(a);
+        table.Deduplicate(b);
+        table.Deduplicate(c);
+        VERIFY_ARE_EQUAL(a.Pixels().data(), b.Pixels().data());
+        VERIFY_ARE_NOT_EQUAL(a.Pixels().data(), c.Pixels().data());
+        VERIFY_ARE_EQUAL(2u, table.Size());
+
+        // Modifying a deduplicated slice must not affect the other one.
+        b.MutablePixels(0, 1)[1] = RGBQUAD{ 9, 9, 9, 9 };
+        VERIFY_ARE_EQUAL(BYTE{ 1 }, a.Pixels(0)[1].rgbBlue);
+        VERIFY_ARE_EQUAL(BYTE{ 9 }, b.Pixels(0)[1].rgbBlue);
+    }
+};
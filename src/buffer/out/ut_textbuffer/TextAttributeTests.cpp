@@ -7,6 +7,7 @@
 #include "../../../renderer/inc/RenderSettings.hpp"
 
 #include "../TextAttribute.hpp"
+#include "../TextAttributeTable.hpp"
 
 using namespace WEX::Common;
 using namespace WEX::Logging;
@@ -25,6 +26,8 @@ class TextAttributeTests
     TEST_METHOD(TestReverseDefaultColors);
     TEST_METHOD(TestRoundtripDefaultColors);
     TEST_METHOD(TestIntenseAsBright);
+    TEST_METHOD(TestAttributeTableInterning);
+    TEST_METHOD(TestAttributeTableSweep);
 
     RenderSettings _renderSettings;
     const COLORREF _defaultFg = RGB(1, 2, 3);
@@ -325,3 +328,68 @@ void TextAttributeTests::TestIntenseAsBright()
     // Restore the default IntenseIsBright mode.
     _renderSettings.SetRenderMode(RenderSettings::Mode::IntenseIsBright, true);
 }
+
+void TextAttributeTests::TestAttributeTableInterning()
+{
+    TextAttributeTable table;
+    VERIFY_ARE_EQUAL(1u, table.Size());
+    VERIFY_ARE_EQUAL(TextAttributeTable::DefaultId, table.Intern(TextAttribute{}));
+
+    TextAttribute red;
+    red.SetIndexedForeground(TextColor::DARK_RED);
+    TextAttribute blue;
+    blue.SetIndexedForeground(TextColor::DARK_BLUE);
+
+    Log::Comment(L"Equal attributes must get equal ids and distinct attributes distinct ones");
+    const auto redId = table.Intern(red);
+    const auto blueId = table.Intern(blue);
+    VERIFY_ARE_NOT_EQUAL(redId, blueId);
+    VERIFY_ARE_NOT_EQUAL(TextAttributeTable::DefaultId, redId);
+    VERIFY_ARE_EQUAL(redId, table.Intern(red));
+    VERIFY_ARE_EQUAL(blueId, table.Intern(blue));
+    VERIFY_IS_TRUE(table.Get(redId) == red);
+    VERIFY_IS_TRUE(table.Get(blueId) == blue);
+    VERIFY_ARE_EQUAL(3u, table.Size());
+
+    Log::Comment(L"Import must map each id of the other table to an id for the same attributes");
+    TextAttributeTable other;
+    const auto otherBlueId = other.Intern(blue);
+    const auto mapping = table.Import(other);
+    VERIFY_ARE_EQUAL(TextAttributeTable::DefaultId, mapping.at(TextAttributeTable::DefaultId));
+    VERIFY_ARE_EQUAL(blueId, mapping.at(otherBlueId));
+    VERIFY_ARE_EQUAL(3u, table.Size());
+}
+
+void TextAttributeTests::TestAttributeTableSweep()
+{
+    TextAttributeTable table;
+
+    TextAttribute red;
+    red.SetIndexedForeground(TextColor::DARK_RED);
+    TextAttribute blue;
+    blue.SetIndexedForeground(TextColor::DARK_BLUE);
+    TextAttribute green;
+    green.SetIndexedForeground(TextColor::DARK_GREEN);
+
+    const auto redId = table.Intern(red);
+    const auto blueId = table.Intern(blue);
+    VERIFY_ARE_EQUAL(3u, table.Size());
+
+    Log::Comment(L"Unmarked ids must be freed, while marked ids and the default id must survive");
+    table.Mark(blueId);
+    table.Sweep();
+    VERIFY_ARE_EQUAL(2u, table.Size());
+    VERIFY_IS_TRUE(table.Get(TextAttributeTable::DefaultId) == TextAttribute{});
+    VERIFY_IS_TRUE(table.Get(blueId) == blue);
+    VERIFY_ARE_EQUAL(blueId, table.Intern(blue));
+
+    Log::Comment(L"Freed ids must be reused for new attributes");
+    VERIFY_ARE_EQUAL(redId, table.Intern(green));
+    VERIFY_IS_TRUE(table.Get(redId) == green);
+    VERIFY_ARE_EQUAL(3u, table.Size());
+
+    Log::Comment(L"Marks must not carry over into the next collection");
+    table.Sweep();
+    VERIFY_ARE_EQUAL(1u, table.Size());
+    VERIFY_IS_FALSE(table.NeedsCollection());
+}
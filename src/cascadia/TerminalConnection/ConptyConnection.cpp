@@ -19,6 +19,11 @@ using namespace std::string_view_literals;
 // Format is: "DecimalResult (HexadecimalForm)"
 static constexpr auto _errorFormat = L"{0} ({0:#010x})"sv;
 
+// The output of the connection is read into a fixed set of buffers. If the terminal falls behind
+// and all of them are in use, we stop reading, which in turn makes ConPTY stop accepting output.
+static constexpr uint32_t _outputBufferCount = 4;
+static constexpr size_t _outputBufferSize = 128 * 1024;
+
 // Notes:
 // There is a number of ways that the Conpty connection can be terminated (voluntarily or not):
 // 1. The connection is Close()d
@@ -643,6 +648,13 @@ namespace winrt::Microsoft::Terminal::TerminalConnection::implementation
         return commandline.to_hstring();
     }
 
+    // Method Description:
+    // - Raises TerminalOutput for everything that _ReadThread() reads from the pipe.
+    //   If TerminalOutputUtf8 has a handler, it's raised instead with the unconverted
+    //   output, because the terminal's parser can consume UTF-8 directly.
+    // - Whenever the handler (ControlCore) takes longer than a read, the reads pile up in the
+    //   channel and are passed on all at once, so that they get processed under a single lock.
+    //   If all buffers are in use, the read thread stops reading until we recycled some.
     DWORD ConptyConnection::_OutputThread()
     {
         // Keep us alive until the output thread terminates; the destructor
@@ -653,38 +665,80 @@ namespace winrt::Microsoft::Terminal::TerminalConnection::implementation
             _LastConPtyClientDisconnected();
         });
 
-        const wil::unique_event overlappedEvent{ CreateEventExW(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS) };
-        OVERLAPPED overlapped{ .hEvent = overlappedEvent.get() };
-        bool overlappedPending = false;
-        char buffer[128 * 1024];
-        DWORD read = 0;
-
-        til::u8state u8State;
-        std::wstring wstr;
-
-        // If we use overlapped IO We want to queue ReadFile() calls before processing the
-        // string, because TerminalOutput.raise() may take a while (relatively speaking).
-        // That's why the loop looks a little weird as it starts a read, processes the
-        // previous string, and finally converts the previous read to the next string.
-        for (;;)
+        try
         {
-            // When we have a `wstr` that's ready for processing we must do so without blocking.
-            // Otherwise, whatever the user typed will be delayed until the next IO operation.
-            // With overlapped IO that's not a problem because the ReadFile() calls won't block.
-            if (!ReadFile(_pipe.get(), &buffer[0], sizeof(buffer), &read, &overlapped))
+            auto [tx, rx] = til::spsc::pooled_channel<char>(_outputBufferCount, _outputBufferSize);
+
+            // The channel returns no more buffers once the read thread exits and
+            // drops `tx`, which is also when the loop below will exit.
+            std::thread readThread{ [this, tx = std::move(tx)]() {
+                _ReadThread(tx);
+            } };
+            LOG_IF_FAILED(SetThreadDescription(readThread.native_handle(), L"ConptyConnection Read Thread"));
+            const auto join = wil::scope_exit([&]() {
+                readThread.join();
+            });
+            // Declared after `join`, so that an exception drops our half of the channel
+            // before we wait for the read thread, which unblocks the read thread.
+            const auto output = std::move(rx);
+
+            std::array<std::span<char>, _outputBufferCount> buffers;
+            til::u8state u8State;
+            std::string str;
+            std::wstring wstr;
+            std::wstring wstrPart;
+
+            for (;;)
             {
-                if (GetLastError() != ERROR_IO_PENDING)
+                const auto count = output.drain(buffers.data(), buffers.size());
+                if (count == 0)
                 {
                     break;
                 }
-                overlappedPending = true;
-            }
 
-            // wstr can be empty in two situations:
-            // * The previous call to til::u8u16 failed.
-            // * We're using overlapped IO, and it's the first iteration.
-            if (!wstr.empty())
-            {
+                // The UTF-8 path hands the buffers to the handler as is,
+                // so they can only be recycled once it returned.
+                const auto recycle = wil::scope_exit([&]() {
+                    output.recycle(buffers.data(), count);
+                });
+                const auto& first = til::at(buffers, 0);
+                const auto utf8 = static_cast<bool>(TerminalOutputUtf8);
+                std::string_view utf8Output;
+
+                if (utf8)
+                {
+                    // The parser keeps track of UTF-8 sequences that are split across calls,
+                    // so we only need to concatenate if multiple buffers were pending.
+                    utf8Output = { first.data(), first.size() };
+                    if (count > 1)
+                    {
+                        str.assign(utf8Output);
+                        for (size_t i = 1; i < count; ++i)
+                        {
+                            const auto& buffer = til::at(buffers, i);
+                            str.append(buffer.data(), buffer.size());
+                        }
+                        utf8Output = str;
+                    }
+                }
+                else
+                {
+                    // If we hit a parsing error, eat it. It's bad utf-8, we can't do anything with it.
+                    // In the common case of a single buffer we can skip the concatenation.
+                    FAILED_LOG(til::u8u16({ first.data(), first.size() }, wstr, u8State));
+                    for (size_t i = 1; i < count; ++i)
+                    {
+                        const auto& buffer = til::at(buffers, i);
+                        FAILED_LOG(til::u8u16({ buffer.data(), buffer.size() }, wstrPart, u8State));
+                        wstr.append(wstrPart);
+                    }
+                }
+
+                if ((utf8 ? utf8Output.empty() : wstr.empty()) || _isStateAtOrBeyond(ConnectionState::Closing))
+                {
+                    continue;
+                }
+
                 if (!_receivedFirstByte)
                 {
                     const auto now = std::chrono::high_resolution_clock::now();
@@ -703,18 +757,53 @@ namespace winrt::Microsoft::Terminal::TerminalConnection::implementation
 
                 try
                 {
-                    TerminalOutput.raise(wstr);
+                    if (utf8)
+                    {
+                        const auto data = reinterpret_cast<const uint8_t*>(utf8Output.data());
+                        TerminalOutputUtf8.raise(winrt::array_view<const uint8_t>{ data, data + utf8Output.size() });
+                    }
+                    else
+                    {
+                        TerminalOutput.raise(wstr);
+                    }
                 }
                 CATCH_LOG();
             }
+        }
+        CATCH_LOG();
+
+        return 0;
+    }
+
+    // Method Description:
+    // - Reads from the pipe into the buffers of the output channel and submits them to _OutputThread().
+    // - Returns once the pipe was closed or the connection is closing.
+    void ConptyConnection::_ReadThread(const til::spsc::pool_producer<char>& output) noexcept
+    try
+    {
+        const wil::unique_event overlappedEvent{ CreateEventExW(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS) };
+        OVERLAPPED overlapped{ .hEvent = overlappedEvent.get() };
+        DWORD read = 0;
+
+        // Submitting a buffer never blocks, because the channel can hold all of them.
+        // This means that we're never blocked on the terminal while holding on to output,
+        // and that there's no need for queueing ReadFile() calls ahead of time.
+        for (;;)
+        {
+            // This blocks while _OutputThread() holds on to all buffers.
+            const auto buffer = output.acquire();
+            if (buffer.empty())
+            {
+                break;
+            }
 
-            // Here's the counterpart to the start of the loop. We processed whatever was in `wstr`,
-            // so blocking synchronously on the pipe is now possible.
-            // If we used overlapped IO, we need to wait for the ReadFile() to complete.
-            // If we didn't, we can now safely block on our ReadFile() call.
-            if (overlappedPending)
+            if (!ReadFile(_pipe.get(), buffer.data(), gsl::narrow_cast<DWORD>(buffer.size()), &read, &overlapped))
             {
-                overlappedPending = false;
+                if (GetLastError() != ERROR_IO_PENDING)
+                {
+                    break;
+                }
+                // If we used overlapped IO, we need to wait for the ReadFile() to complete.
                 if (FAILED(Utils::GetOverlappedResultSameThread(&overlapped, &read)))
                 {
                     break;
@@ -738,17 +827,18 @@ namespace winrt::Microsoft::Terminal::TerminalConnection::implementation
             TraceLoggingWrite(
                 g_hTerminalConnectionProvider,
                 "ReadFile",
-                TraceLoggingCountedUtf8String(&buffer[0], read, "buffer"),
+                TraceLoggingCountedUtf8String(buffer.data(), read, "buffer"),
                 TraceLoggingGuid(_sessionId, "session"),
                 TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
                 TraceLoggingKeyword(TIL_KEYWORD_TRACE));
 
-            // If we hit a parsing error, eat it. It's bad utf-8, we can't do anything with it.
-            FAILED_LOG(til::u8u16({ &buffer[0], gsl::narrow_cast<size_t>(read) }, wstr, u8State));
+            if (!output.submit(buffer, read))
+            {
+                break;
+            }
         }
-
-        return 0;
     }
+    CATCH_LOG()
 
     static winrt::event<NewConnectionHandler> _newConnectionHandlers;
 
@@ -8,6 +8,7 @@
 #include "ITerminalHandoff.h"
 
 #include <til/env.h>
+#include <til/spsc.h>
 #include <til/ticket_lock.h>
 
 namespace winrt::Microsoft::Terminal::TerminalConnection::implementation
@@ -52,6 +53,7 @@ namespace winrt::Microsoft::Terminal::TerminalConnection::implementation
                                                                          const winrt::guid& profileGuid);
 
         til::event<TerminalOutputHandler> TerminalOutput;
+        til::event<TerminalOutputUtf8Handler> TerminalOutputUtf8;
 
     private:
         static void closePseudoConsoleAsync(HPCON hPC) noexcept;
@@ -101,6 +103,7 @@ namespace winrt::Microsoft::Terminal::TerminalConnection::implementation
         } _startupInfo{};
 
         DWORD _OutputThread();
+        void _ReadThread(const til::spsc::pool_producer<char>& output) noexcept;
     };
 }
 
@@ -263,6 +263,7 @@ namespace winrt::Microsoft::Terminal::Control::implementation
         // revoke ALL old handlers immediately
 
         _connectionOutputEventRevoker.revoke();
+        _connectionOutputUtf8EventRevoker.revoke();
         _connectionStateChangedRevoker.revoke();
 
         _connection = newConnection;
@@ -291,6 +292,11 @@ namespace winrt::Microsoft::Terminal::Control::implementation
 
             // This event is explicitly revoked in the destructor: does not need weak_ref
             _connectionOutputEventRevoker = _connection.TerminalOutput(winrt::auto_revoke, { this, &ControlCore::_connectionOutputHandler });
+            // Connections that support it send us their output as UTF-8, which saves converting it to UTF-16 and back.
+            if (const auto utf8{ _connection.try_as<TerminalConnection::ITerminalConnectionUtf8>() })
+            {
+                _connectionOutputUtf8EventRevoker = utf8.TerminalOutputUtf8(winrt::auto_revoke, { this, &ControlCore::_connectionOutputUtf8Handler });
+            }
         }
 
         // Fire off a connection state changed notification, to let our hosting
@@ -1783,6 +1789,7 @@ namespace winrt::Microsoft::Terminal::Control::implementation
 
             // Stop accepting new output and state changes before we disconnect everything.
             _connectionOutputEventRevoker.revoke();
+            _connectionOutputUtf8EventRevoker.revoke();
             _connectionStateChangedRevoker.revoke();
             _connection.Close();
         }
@@ -1829,28 +1836,57 @@ namespace winrt::Microsoft::Terminal::Control::implementation
             message = fmt::format(FMT_COMPILE(L"\x1b[100;37m  [{} {} {}]\x1b[K\x1b[m\r\n"), msg, date, time);
         }
 
-        wchar_t buffer[32 * 1024];
-        DWORD read = 0;
-
-        // Ensure the text file starts with a UTF-16 BOM.
-        if (!ReadFile(file.get(), &buffer[0], 2, &read, nullptr) || read < 2 || buffer[0] != L'\uFEFF')
+        // Buffers are persisted as binary snapshots, which we can restore straight from a memory mapping.
+        // Older versions persisted them as UTF-16 text files with VT sequences, which are handled below.
+        auto restoredSnapshot = false;
+        try
         {
-            return;
+            LARGE_INTEGER fileSize{};
+            THROW_IF_WIN32_BOOL_FALSE(GetFileSizeEx(file.get(), &fileSize));
+
+            if (fileSize.QuadPart > 0)
+            {
+                const wil::unique_handle mapping{ CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr) };
+                THROW_LAST_ERROR_IF(!mapping);
+                const wil::unique_mapview_ptr<std::byte> view{ static_cast<std::byte*>(MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0)) };
+                THROW_LAST_ERROR_IF(!view);
+
+                const std::span<const std::byte> data{ view.get(), gsl::narrow<size_t>(fileSize.QuadPart) };
+                if (TextBuffer::IsSnapshot(data))
+                {
+                    const auto lock = _terminal->LockForWriting();
+                    _terminal->RestoreMainBuffer(data);
+                    restoredSnapshot = true;
+                }
+            }
         }
+        CATCH_LOG();
 
-        for (;;)
+        if (!restoredSnapshot)
         {
-            if (!ReadFile(file.get(), &buffer[0], sizeof(buffer), &read, nullptr))
+            wchar_t buffer[32 * 1024];
+            DWORD read = 0;
+
+            // Ensure the text file starts with a UTF-16 BOM.
+            if (!ReadFile(file.get(), &buffer[0], 2, &read, nullptr) || read < 2 || buffer[0] != L'\uFEFF')
             {
-                break;
+                return;
             }
 
-            const auto lock = _terminal->LockForWriting();
-            _terminal->Write({ &buffer[0], read / 2 });
-
-            if (read < sizeof(buffer))
+            for (;;)
             {
-                break;
+                if (!ReadFile(file.get(), &buffer[0], sizeof(buffer), &read, nullptr))
+                {
+                    break;
+                }
+
+                const auto lock = _terminal->LockForWriting();
+                _terminal->Write({ &buffer[0], read / 2 });
+
+                if (read < sizeof(buffer))
+                {
+                    break;
+                }
             }
         }
 
@@ -2178,12 +2214,23 @@ namespace winrt::Microsoft::Terminal::Control::implementation
         RaiseNotice.raise(*this, std::move(noticeArgs));
     }
     void ControlCore::_connectionOutputHandler(const hstring& hstr)
+    {
+        _writeConnectionOutput(std::wstring_view{ hstr });
+    }
+
+    void ControlCore::_connectionOutputUtf8Handler(const winrt::array_view<const uint8_t>& output)
+    {
+        _writeConnectionOutput(std::string_view{ reinterpret_cast<const char*>(output.data()), output.size() });
+    }
+
+    template<typename T>
+    void ControlCore::_writeConnectionOutput(const T text)
     {
         try
         {
             {
                 const auto lock = _terminal->LockForWriting();
-                _terminal->Write(hstr);
+                _terminal->Write(text);
             }
 
             // Start the throttled update of where our hyperlinks are.
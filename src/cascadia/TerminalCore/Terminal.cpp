@@ -48,6 +48,8 @@ void Terminal::Create(til::size viewportSize, til::CoordType scrollbackLines, Re
     const TextAttribute attr{};
     const UINT cursorSize = 12;
     _mainBuffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, true, &renderer);
+    // Rows far out of the viewport are rarely accessed, which makes them good candidates for compression.
+    _mainBuffer->EnableColdScrollback(viewportSize.height);
 
     auto dispatch = std::make_unique<AdaptDispatch>(*this, &renderer, _renderSettings, _terminalInput);
     auto engine = std::make_unique<OutputStateMachineEngine>(std::move(dispatch));
@@ -289,6 +291,7 @@ try
     };
 
     TextBuffer::Reflow(*_mainBuffer.get(), *newTextBuffer.get(), &_mutableViewport, &positionInfo);
+    newTextBuffer->EnableColdScrollback(viewportSize.height);
 
     // Restore the active text attributes
     newTextBuffer->SetCurrentAttributes(_mainBuffer->GetCurrentAttributes());
@@ -418,6 +421,13 @@ void Terminal::Write(std::wstring_view stringView)
     _stateMachine->ProcessString(stringView);
 }
 
+// Same as above, but for UTF-8 input, which spares the caller from having
+// to transcode the entire output of the connection to UTF-16 up front.
+void Terminal::Write(std::string_view stringView)
+{
+    _stateMachine->ProcessString(stringView);
+}
+
 // Method Description:
 // - Attempts to snap to the bottom of the buffer, if SnapOnInput is true. Does
 //   nothing if SnapOnInput is set to false, or we're already at the bottom of
@@ -1169,11 +1179,117 @@ void Terminal::SetCursorOn(const bool isOn) noexcept
 // - Update our internal knowledge about where regex patterns are on the screen
 // - This is called by TerminalControl (through a throttled function) when the visible
 //   region changes (for example by text entering the buffer or scrolling)
+// - Only logical lines with rows that were modified since the last call are scanned again.
+//   The matches of all other lines are taken from _patternCache. If none of the rows
+//   that are scanned below changed and the viewport still shows the same rows, nothing is scanned.
 // - INVARIANT: this function can only be called if the caller has the writing lock on the terminal
 void Terminal::UpdatePatternsUnderLock()
 {
+    const auto& buffer = _activeBuffer();
+    const auto beg = _VisibleStartIndex();
+    const auto end = _VisibleEndIndex();
+    const auto height = end - beg + 1;
+    const auto lastRow = buffer.GetSize().BottomInclusive();
+
+    {
+        const auto changes = buffer.GetRowsChangedSince(_patternCache.generation);
+        // The rows that were in the viewport moved up by `scrolled` rows since the last call.
+        const auto scrolled = changes.scrollCount - _patternCache.scrollCount;
+        const auto scanBeg = beg - height;
+        // Unless the scanned rows lie entirely within the buffer, rows may have scrolled out of them.
+        auto unchanged = !changes.all && height == _patternCache.viewportHeight &&
+                         int64_t{ beg } + int64_t(scrolled) == _patternCache.viewportTop &&
+                         (scrolled == 0 || scanBeg >= 0);
+
+        if (unchanged)
+        {
+            const auto bottomLimit = std::min(lastRow, end + height);
+            const auto it = std::lower_bound(changes.rows.begin(), changes.rows.end(), std::max(0, scanBeg));
+            unchanged = it == changes.rows.end() || *it > bottomLimit;
+        }
+
+        _patternCache.generation = changes.generation;
+        _patternCache.scrollCount = changes.scrollCount;
+        _patternCache.viewportTop = beg;
+        _patternCache.viewportHeight = height;
+
+        if (unchanged)
+        {
+            return;
+        }
+    }
+
+    // Lines that wrap across the viewport edges are scanned in full, so that URLs aren't cut off.
+    // This is limited to a viewport height in either direction to keep the cost bounded.
+    auto top = beg;
+    for (const auto limit = std::max(0, beg - height); top > limit && buffer.GetRowByOffset(top - 1).WasWrapForced();)
+    {
+        --top;
+    }
+    const auto bottomLimit = std::min(lastRow, end + height);
+
+    decltype(_patternCache.lines) lines;
+    PointTree::interval_vector intervals;
+
+    for (auto y = top; y <= end;)
+    {
+        auto bottom = y;
+        while (bottom < bottomLimit && buffer.GetRowByOffset(bottom).WasWrapForced())
+        {
+            ++bottom;
+        }
+
+        // Rows with a generation of 0 have never been written to and are thus blank.
+        // They also never wrap, so there's nothing to find in such a line.
+        const auto generation = buffer.GetRowGeneration(y);
+        if (generation == 0 && bottom == y)
+        {
+            y = bottom + 1;
+            continue;
+        }
+
+        PatternCache::Line line;
+        line.generations.reserve(gsl::narrow_cast<size_t>(bottom - y + 1));
+        for (auto row = y; row <= bottom; ++row)
+        {
+            line.generations.emplace_back(buffer.GetRowGeneration(row));
+        }
+
+        if (const auto it = _patternCache.lines.find(generation); it != _patternCache.lines.end() && it->second.generations == line.generations)
+        {
+            line.matches = std::move(it->second.matches);
+        }
+        else
+        {
+            _appendPatterns(y, bottom, line.matches);
+        }
+
+        // PointTree uses viewport-relative coordinates.
+        for (const auto& match : line.matches)
+        {
+            const til::point start{ match.start.x, match.start.y + y - beg };
+            const til::point stop{ match.stop.x, match.stop.y + y - beg };
+            if (stop.y >= 0 && start.y < height)
+            {
+                intervals.push_back(PointTree::interval(start, stop, match.value));
+            }
+        }
+
+        lines.emplace(generation, std::move(line));
+        y = bottom + 1;
+    }
+
+    _patternCache.lines = std::move(lines);
+
+    // The common case is that the output didn't change any patterns, in which case we don't need to redraw them.
+    if (intervals == _patternCache.intervals)
+    {
+        return;
+    }
+
     _InvalidatePatternTree();
-    _patternIntervalTree = _getPatterns(_VisibleStartIndex(), _VisibleEndIndex());
+    _patternCache.intervals = intervals;
+    _patternIntervalTree = PointTree{ std::move(intervals) };
     _InvalidatePatternTree();
 }
 
@@ -1189,6 +1305,7 @@ void Terminal::_clearPatternTree()
         _InvalidatePatternTree();
         _patternIntervalTree = {};
     }
+    _patternCache = {};
 }
 
 // Method Description:
@@ -1417,6 +1534,14 @@ private:
 static URegularExpressionInterner uregexInterner;
 
 PointTree Terminal::_getPatterns(til::CoordType beg, til::CoordType end) const
+{
+    PointTree::interval_vector intervals;
+    _appendPatterns(beg, end, intervals);
+    return PointTree{ std::move(intervals) };
+}
+
+// Appends the matches within the rows [beg,end] to intervals. Their y coordinates are relative to beg.
+void Terminal::_appendPatterns(til::CoordType beg, til::CoordType end, PointTree::interval_vector& intervals) const
 {
     static constexpr std::array<std::wstring_view, 1> patterns{
         LR"(\b(?:https?|ftp|file)://[-A-Za-z0-9+&@#/%?=~_|$!:,.;]*[A-Za-z0-9+&@#/%=~_|$])",
@@ -1424,7 +1549,6 @@ PointTree Terminal::_getPatterns(til::CoordType beg, til::CoordType end) const
 
     auto text = ICU::UTextFromTextBuffer(_activeBuffer(), beg, end + 1);
     UErrorCode status = U_ZERO_ERROR;
-    PointTree::interval_vector intervals;
 
     for (size_t i = 0; i < patterns.size(); ++i)
     {
@@ -1444,8 +1568,6 @@ PointTree Terminal::_getPatterns(til::CoordType beg, til::CoordType end) const
             } while (uregex_findNext(re.get(), &status));
         }
     }
-
-    return PointTree{ std::move(intervals) };
 }
 
 // NOTE: This is the version of AddMark that comes from the UI. The VT api call into this too.
@@ -1544,7 +1666,23 @@ std::wstring Terminal::CurrentCommand() const
 
 void Terminal::SerializeMainBuffer(const wchar_t* destination) const
 {
-    _mainBuffer->Serialize(destination);
+    _mainBuffer->SerializeSnapshot(destination);
+}
+
+// Restores the main buffer from a snapshot written by SerializeMainBuffer().
+// The snapshot is reflowed into the main buffer, as it may have been written
+// at a different width, and the viewport is moved down to the cursor.
+void Terminal::RestoreMainBuffer(std::span<const std::byte> snapshot)
+{
+    const auto restoredBuffer = TextBuffer::FromSnapshot(snapshot, _mainBuffer->GetRenderer());
+    TextBuffer::Reflow(*restoredBuffer, *_mainBuffer);
+
+    const auto viewportSize = _mutableViewport.Dimensions();
+    const auto cursorPosition = _mainBuffer->GetCursor().GetPosition();
+    const auto top = std::max(0, cursorPosition.y - viewportSize.height + 1);
+    _mutableViewport = Viewport::FromDimensions({ 0, top }, viewportSize);
+    _scrollOffset = 0;
+    _NotifyScrollEvent();
 }
 
 void Terminal::ColorSelection(const TextAttribute& attr, winrt::Microsoft::Terminal::Core::MatchMode matchMode)
@@ -101,6 +101,7 @@ public:
 
     // Write comes from the PTY and goes to our parser to be stored in the output buffer
     void Write(std::wstring_view stringView);
+    void Write(std::string_view stringView);
 
     void _assertLocked() const noexcept;
     void _assertUnlocked() const noexcept;
@@ -125,6 +126,7 @@ public:
     std::wstring CurrentCommand() const;
 
     void SerializeMainBuffer(const wchar_t* destination) const;
+    void RestoreMainBuffer(std::span<const std::byte> snapshot);
 
 #pragma region ITerminalApi
     // These methods are defined in TerminalApi.cpp
@@ -423,6 +425,30 @@ private:
     //      Either way, we should make this behavior controlled by a setting.
 
     interval_tree::IntervalTree<til::point, size_t> _patternIntervalTree;
+    // Remembers the pattern matches of each logical (wrapped) line in the viewport,
+    // so that UpdatePatternsUnderLock() only needs to scan the lines that changed.
+    struct PatternCache
+    {
+        struct Line
+        {
+            // The generation of each row in the line. See TextBuffer::GetRowGeneration().
+            std::vector<uint64_t> generations;
+            // The matches with y coordinates relative to the line's top row.
+            interval_tree::IntervalTree<til::point, size_t>::interval_vector matches;
+        };
+
+        // Keyed by the generation of the line's top row. Generations are unique,
+        // so a line is unchanged if all of its generations are unchanged.
+        std::unordered_map<uint64_t, Line> lines;
+        // The intervals _patternIntervalTree was built from.
+        interval_tree::IntervalTree<til::point, size_t>::interval_vector intervals;
+        // The state of the buffer and viewport at the time of the last update. See TextBuffer::GetRowsChangedSince().
+        uint64_t generation = 0;
+        uint64_t scrollCount = 0;
+        til::CoordType viewportTop = -1;
+        til::CoordType viewportHeight = 0;
+    };
+    PatternCache _patternCache;
     void _clearPatternTree();
     void _InvalidatePatternTree();
     void _InvalidateFromCoords(const til::point start, const til::point end);
@@ -460,6 +486,7 @@ private:
     TextBuffer& _activeBuffer() const noexcept;
     void _updateUrlDetection();
     interval_tree::IntervalTree<til::point, size_t> _getPatterns(til::CoordType beg, til::CoordType end) const;
+    void _appendPatterns(til::CoordType beg, til::CoordType end, interval_tree::IntervalTree<til::point, size_t>::interval_vector& intervals) const;
 
 #pragma region TextSelection
     // These methods are defined in TerminalSelection.cpp
@@ -361,6 +361,10 @@ void Terminal::NotifyBufferRotation(const int delta)
 
     // manually erase our pattern intervals since the locations have changed now
     _patternIntervalTree = {};
+    _patternCache.intervals.clear();
+    // Ensure that the next UpdatePatternsUnderLock() doesn't take its early-out and leave the tree empty.
+    // The per-line matches in _patternCache.lines stay valid, because they're relative to their line.
+    _patternCache.viewportHeight = 0;
 
     const auto oldScrollOffset = _scrollOffset;
     _PreserveUserScrollOffset(delta);
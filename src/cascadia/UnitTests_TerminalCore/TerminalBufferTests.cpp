@@ -5,6 +5,7 @@
 #include <WexTestClass.h>
 
 #include "../renderer/inc/DummyRenderer.hpp"
+#include "../renderer/inc/RecordingRenderEngine.hpp"
 #include "../cascadia/TerminalCore/Terminal.hpp"
 #include "MockTermSettings.h"
 #include "consoletaeftemplates.hpp"
@@ -53,6 +54,13 @@ class TerminalCoreUnitTests::TerminalBufferTests final
 
     TEST_METHOD(TestURLPatternDetection);
 
+    TEST_METHOD(TestURLPatternDetectionIncremental);
+
+    TEST_METHOD(TestRecordedFrames);
+    TEST_METHOD(TestRecordedRows);
+    TEST_METHOD(TestDroppedRedraws);
+    TEST_METHOD(TestUnlockedPainting);
+
     TEST_METHOD_SETUP(MethodSetup)
     {
         // STEP 1: Set up the Terminal
@@ -627,3 +635,200 @@ void TerminalBufferTests::TestURLPatternDetection()
     result = term->GetHyperlinkAtBufferPosition(til::point{ urlEndX + 1, 0 });
     VERIFY_IS_TRUE(result.empty(), L"URL is not detected after the actual URL.");
 }
+
+void TerminalBufferTests::TestURLPatternDetectionIncremental()
+{
+    using namespace std::string_view_literals;
+
+    constexpr auto UrlStr = L"https://www.contoso.com"sv;
+    constexpr auto urlEndX = gsl::narrow_cast<til::CoordType>(UrlStr.size()) - 1;
+
+    auto& termSm = *term->_stateMachine;
+    const auto hasUrlAt = [&](til::CoordType y) {
+        return term->GetHyperlinkIntervalFromViewportPosition({ 0, y }).has_value() &&
+               term->GetHyperlinkIntervalFromViewportPosition({ urlEndX, y }).has_value();
+    };
+
+    Log::Comment(L"Write URLs into the first and third row.");
+    termSm.ProcessString(fmt::format(FMT_COMPILE(L"{}\r\n\r\n{}"), UrlStr, UrlStr));
+    term->UpdatePatternsUnderLock();
+    VERIFY_IS_TRUE(hasUrlAt(0));
+    VERIFY_IS_FALSE(hasUrlAt(1));
+    VERIFY_IS_TRUE(hasUrlAt(2));
+
+    Log::Comment(L"Overwriting the first row must only remove its URL.");
+    termSm.ProcessString(L"\x1b[H\x1b[2K");
+    term->UpdatePatternsUnderLock();
+    VERIFY_IS_FALSE(hasUrlAt(0));
+    VERIFY_IS_TRUE(hasUrlAt(2));
+
+    Log::Comment(L"A URL written into an unchanged row must be detected.");
+    termSm.ProcessString(fmt::format(FMT_COMPILE(L"\x1b[2H{}"), UrlStr));
+    term->UpdatePatternsUnderLock();
+    VERIFY_IS_FALSE(hasUrlAt(0));
+    VERIFY_IS_TRUE(hasUrlAt(1));
+    VERIFY_IS_TRUE(hasUrlAt(2));
+
+    Log::Comment(L"A URL that wraps into the next row must be detected on both rows.");
+    const auto wrappedX = TerminalViewWidth - 8;
+    termSm.ProcessString(fmt::format(FMT_COMPILE(L"\x1b[5;{}H{}"), wrappedX + 1, UrlStr));
+    term->UpdatePatternsUnderLock();
+    VERIFY_IS_TRUE(term->GetHyperlinkIntervalFromViewportPosition({ wrappedX, 4 }).has_value());
+    VERIFY_IS_TRUE(term->GetHyperlinkIntervalFromViewportPosition({ 0, 5 }).has_value());
+    VERIFY_IS_TRUE(hasUrlAt(2));
+}
+
+void TerminalBufferTests::TestRecordedFrames()
+{
+    using namespace std::string_view_literals;
+    using Microsoft::Console::Render::RecordingRenderEngine;
+
+    RecordingRenderEngine engine;
+    emptyRenderer->AddRenderEngine(&engine);
+
+    auto& termSm = *term->_stateMachine;
+    termSm.ProcessString(L"\x1b[?25l\x1b[31mred\x1b[m plain");
+
+    Log::Comment(L"The first frame paints the entire viewport.");
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    auto log = engine.Log();
+    VERIFY_ARE_EQUAL(uint64_t{ 1 }, engine.FrameCount());
+    VERIFY_IS_TRUE(log.starts_with("frame 1 dirty 0,0,80,32\n"sv));
+    VERIFY_IS_TRUE(log.find("line 0,0 \"red\"\n"sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find("line 3,0 \" plain"sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find("line 0,31 "sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.ends_with("end\npresent\n"sv));
+
+    Log::Comment(L"Without any changes there's nothing to paint.");
+    engine.ClearLog();
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    VERIFY_ARE_EQUAL(uint64_t{ 1 }, engine.FrameCount());
+    VERIFY_IS_TRUE(engine.Log() == "present\n"sv);
+
+    Log::Comment(L"Writing a single cell only repaints that cell.");
+    engine.ClearLog();
+    termSm.ProcessString(L"\x1b[5;3H\x1b[1;4mx");
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    log = engine.Log();
+    VERIFY_ARE_EQUAL(uint64_t{ 2 }, engine.FrameCount());
+    VERIFY_IS_TRUE(log.starts_with("frame 2 dirty 2,4,3,5\n"sv));
+    VERIFY_IS_TRUE(log.find("intense\nline 2,4 \"x\"\ngrid 2,4 n=1 "sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find("line 0,0 "sv) == std::string_view::npos);
+
+    const auto& lines = engine.Stats(RecordingRenderEngine::Primitive::PaintBufferLine);
+    VERIFY_ARE_EQUAL(uint64_t{ 33 + 1 }, lines.calls);
+}
+
+void TerminalBufferTests::TestRecordedRows()
+{
+    using namespace std::string_view_literals;
+    using Microsoft::Console::Render::RecordingRenderEngine;
+
+    RecordingRenderEngine engine;
+    engine.SetRowPainting(true);
+    emptyRenderer->AddRenderEngine(&engine);
+
+    auto& termSm = *term->_stateMachine;
+    termSm.ProcessString(L"\x1b[?25l\x1b[31mred\x1b[m plain");
+
+    Log::Comment(L"Each row is painted with a single call, split into runs of identical attributes.");
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    auto log = engine.Log();
+    VERIFY_IS_TRUE(log.find("row 0-80,0 \"red plain "sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find("\" 0-3:#"sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find(" 3-80:#"sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find("row 0-80,31 "sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find("line "sv) == std::string_view::npos);
+    VERIFY_ARE_EQUAL(uint64_t{ 32 }, engine.Stats(RecordingRenderEngine::Primitive::PaintBufferRow).calls);
+    VERIFY_ARE_EQUAL(uint64_t{ 0 }, engine.Stats(RecordingRenderEngine::Primitive::PaintBufferLine).calls);
+
+    Log::Comment(L"Wide glyphs are passed as a whole, with both columns belonging to the same run.");
+    engine.ClearLog();
+    termSm.ProcessString(L"\x1b[2;5H\x1b[4m\u3042");
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    log = engine.Log();
+    VERIFY_IS_TRUE(log.find("row 4-6,1 \"\xe3\x81\x82\" 4-6:#"sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find("grid "sv) == std::string_view::npos);
+}
+
+void TerminalBufferTests::TestDroppedRedraws()
+{
+    using namespace std::string_view_literals;
+    using Microsoft::Console::Render::RecordingRenderEngine;
+
+    RecordingRenderEngine engine;
+    emptyRenderer->AddRenderEngine(&engine);
+
+    auto& termSm = *term->_stateMachine;
+    termSm.ProcessString(L"\x1b[?25l\x1b[2;1Hprogress \x1b[32m50%");
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    VERIFY_ARE_EQUAL(uint64_t{ 0 }, emptyRenderer->GetFrameSkipCounters().droppedRows);
+
+    Log::Comment(L"Rewriting a row with identical contents doesn't repaint it.");
+    engine.ClearLog();
+    termSm.ProcessString(L"\x1b[m\x1b[2;1Hprogress \x1b[32m50%");
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    VERIFY_IS_TRUE(engine.Log() == "present\n"sv);
+    VERIFY_ARE_EQUAL(uint64_t{ 1 }, engine.FrameCount());
+    VERIFY_ARE_EQUAL(uint64_t{ 1 }, emptyRenderer->GetFrameSkipCounters().droppedRows);
+    VERIFY_ARE_EQUAL(uint64_t{ 1 }, emptyRenderer->GetFrameSkipCounters().droppedFrames);
+
+    Log::Comment(L"Only the rows that actually changed are repainted.");
+    engine.ClearLog();
+    termSm.ProcessString(L"\x1b[m\x1b[1;1Hsame\x1b[1;1Hsame\x1b[2;1Hprogress \x1b[32m60%");
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    const auto log = engine.Log();
+    VERIFY_IS_TRUE(log.starts_with("frame 2 dirty 0,0,"sv));
+    VERIFY_IS_TRUE(log.find("line 9,1 \"60%\"\n"sv) != std::string_view::npos);
+
+    engine.ClearLog();
+    termSm.ProcessString(L"\x1b[m\x1b[1;1Hsame\x1b[2;10H\x1b[32m60%");
+    VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+    VERIFY_IS_TRUE(engine.Log() == "present\n"sv);
+    VERIFY_ARE_EQUAL(uint64_t{ 3 }, emptyRenderer->GetFrameSkipCounters().droppedRows);
+    VERIFY_ARE_EQUAL(uint64_t{ 2 }, emptyRenderer->GetFrameSkipCounters().droppedFrames);
+}
+
+void TerminalBufferTests::TestUnlockedPainting()
+{
+    using namespace std::string_view_literals;
+    using Microsoft::Console::Render::RecordingRenderEngine;
+
+    RecordingRenderEngine locked;
+    RecordingRenderEngine unlocked;
+    unlocked.SetUnlockedPainting(true);
+    emptyRenderer->AddRenderEngine(&locked);
+    emptyRenderer->AddRenderEngine(&unlocked);
+
+    auto& termSm = *term->_stateMachine;
+    const auto paint = [&](const std::wstring_view text) {
+        locked.ClearLog();
+        unlocked.ClearLog();
+        termSm.ProcessString(text);
+        VERIFY_SUCCEEDED(emptyRenderer->PaintFrame());
+        VERIFY_IS_TRUE(locked.Log() == unlocked.Log());
+        return unlocked.Log();
+    };
+
+    Log::Comment(L"Engines that paint without the lock paint the same frames as the others.");
+    auto log = paint(L"\x1b[31mred\x1b[m plain");
+    VERIFY_IS_TRUE(log.find("line 0,0 \"red\"\n"sv) != std::string_view::npos);
+
+    Log::Comment(L"This includes the frames that scroll the viewport.");
+    std::wstring output;
+    for (auto i = 0; i < 40; ++i)
+    {
+        fmt::format_to(std::back_inserter(output), FMT_COMPILE(L"\r\nrow {}"), i);
+    }
+    log = paint(output);
+    VERIFY_IS_TRUE(log.find("scroll 0,"sv) != std::string_view::npos);
+    VERIFY_IS_TRUE(log.find("line 0,31 \"row 39"sv) != std::string_view::npos);
+
+    Log::Comment(L"Rows that were written to after the previous frame are copied into the snapshot again.");
+    log = paint(L"\x1b[1;1H\x1b[4mfirst");
+    VERIFY_IS_TRUE(log.find("line 0,0 \"first\"\n"sv) != std::string_view::npos);
+
+    Log::Comment(L"Unchanged frames are skipped by both.");
+    log = paint(L"");
+    VERIFY_IS_TRUE(log == "present\n"sv);
+}
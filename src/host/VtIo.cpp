@@ -49,6 +49,11 @@ using namespace Microsoft::Console::Interactivity;
             CodepointWidthDetector::Singleton().Reset(mode);
         }
 
+        // Legacy console applications often make many tiny API calls in a row (e.g. one per cell or color change).
+        // Sending their output with one WriteFile() each costs more than the terminal takes to process it.
+        // 1ms is short enough to be imperceptible, and ConPTY's pipe buffer is 16KiB large.
+        SetCoalescingPolicy({ .maxBytes = 16 * 1024, .maxLatency = std::chrono::milliseconds{ 1 } });
+
         return _Initialize(pArgs->GetVtInHandle(), pArgs->GetVtOutHandle(), pArgs->GetSignalHandle());
     }
     // Didn't need to initialize if we didn't have VT stuff. It's still OK, but report we did nothing.
@@ -187,6 +192,9 @@ bool VtIo::IsUsingVt() const
         writer.Submit();
     }
 
+    // The terminal has to receive the DSR CPR before we wait for its response below.
+    Flush();
+
     if (_lookingForCursorPosition)
     {
         _lookingForCursorPosition = false;
@@ -410,23 +418,94 @@ void VtIo::Writer::Submit()
 void VtIo::_uncork()
 {
     _corked -= 1;
-    if (_corked <= 0)
+    if (_corked > 0)
     {
-        _flushNow();
+        return;
     }
-}
 
-void VtIo::_flushNow()
-{
-    size_t minSize = 0;
+    // We encountered an exception and shouldn't flush the broken pieces.
+    // Output of previous writers that we're still holding back is fine though.
+    if (_writerTainted)
+    {
+        _writerTainted = false;
+        _writerRestoreCursor = false;
+        _back.resize(_backCommitted);
+        return;
+    }
 
     if (_writerRestoreCursor)
     {
-        minSize = 4;
         _writerRestoreCursor = false;
-        _back.append("\x1b\x38"); // DECRC: DEC Restore Cursor (+ attributes)
+
+        // If all the writers wrote is the DECSC from BackupCursor(), we can drop it.
+        if (_back.size() - _backCommitted <= 2)
+        {
+            _back.resize(_backCommitted);
+        }
+        else
+        {
+            _back.append("\x1b\x38"); // DECRC: DEC Restore Cursor (+ attributes)
+        }
     }
 
+    _backCommitted = _back.size();
+
+    if (_back.empty())
+    {
+        return;
+    }
+
+    if (_coalescing.maxLatency.count() <= 0 || _back.size() >= _coalescing.maxBytes)
+    {
+        _flushNow();
+        return;
+    }
+
+    // If the IO thread is idle, no pending API call could add to this output anymore.
+    // This happens when other threads write, e.g. the input thread when it echoes a cooked read.
+    if (_flushIfIoThreadIdle())
+    {
+        return;
+    }
+
+    // Hold the output back until either more output pushes it past maxBytes,
+    // the IO thread goes idle, or the deadline passes.
+    const auto now = std::chrono::steady_clock::now();
+    if (!_flushDeadlinePending)
+    {
+        using filetime_duration = std::chrono::duration<int64_t, std::ratio<1, 10000000>>;
+        // The FILETIME struct measures time in 100ns steps. Negative values are relative to now.
+        auto dueTime = -std::chrono::duration_cast<filetime_duration>(_coalescing.maxLatency).count();
+        SetThreadpoolTimer(_flushTimer.get(), reinterpret_cast<FILETIME*>(&dueTime), 0, 0);
+
+        _flushDeadline = now + _coalescing.maxLatency;
+        _flushDeadlinePending = true;
+    }
+    else if (now >= _flushDeadline)
+    {
+        _flushNow();
+    }
+}
+
+// Flushes the held back output if the IO thread is waiting for the next API message. Otherwise,
+// it asks the IO thread to call _idleFlushCallback() once it does. Either this function observes
+// _ioThreadIdle or NotifyIoThreadIdle() observes _idleFlushWanted, because both store before they load.
+bool VtIo::_flushIfIoThreadIdle()
+{
+    _idleFlushWanted.store(true);
+    if (_ioThreadIdle.load() && _idleFlushWanted.exchange(false))
+    {
+        _flushNow();
+        return true;
+    }
+    return false;
+}
+
+void VtIo::_flushNow()
+{
+    _flushDeadlinePending = false;
+    _idleFlushWanted.store(false);
+
     if (_overlappedPending)
     {
         _overlappedPending = false;
@@ -442,6 +521,7 @@ void VtIo::_flushNow()
 
     _front.clear();
     _front.swap(_back);
+    _backCommitted = 0;
 
     // If it's >128KiB large and twice as large as the previous buffer, free the memory.
     // This ensures that there's a pathway for shrinking the buffer from large sizes.
@@ -450,16 +530,7 @@ void VtIo::_flushNow()
         _back = std::string{};
     }
 
-    // We encountered an exception and shouldn't flush the broken pieces.
-    if (_writerTainted)
-    {
-        _writerTainted = false;
-        return;
-    }
-
-    // If _back (now _front) was empty, we can return early. If all _front contains is
-    // DECSC/DECRC that was added by BackupCursor & us, we can also return early.
-    if (_front.size() <= minSize)
+    if (_front.empty())
     {
         return;
     }
@@ -472,6 +543,8 @@ void VtIo::_flushNow()
     }
 
     const auto write = gsl::narrow_cast<DWORD>(_front.size());
+    _flushCount += 1;
+    _flushBytes += write;
 
     TraceLoggingWrite(
         g_hConhostV2EventTraceProvider,
@@ -503,6 +576,195 @@ void VtIo::_flushNow()
     }
 }
 
+// Called by _flushTimer once the output that _uncork() held back is due.
+void CALLBACK VtIo::_flushTimerCallback(PTP_CALLBACK_INSTANCE /*instance*/, PVOID context, PTP_TIMER /*timer*/) noexcept
+{
+    auto& gci = ServiceLocator::LocateGlobals().getConsoleInformation();
+    const auto self = static_cast<VtIo*>(context);
+
+    gci.LockConsole();
+    // The output may have been flushed in the meantime, or a Writer may
+    // be active right now, in which case its Submit() will take care of it.
+    if (self->_flushDeadlinePending && self->_corked <= 0)
+    {
+        self->_flushNow();
+    }
+    gci.UnlockConsole();
+}
+
+// Submitted by NotifyIoThreadIdle() if output was held back while the IO thread was busy.
+void CALLBACK VtIo::_idleFlushCallback(PTP_CALLBACK_INSTANCE /*instance*/, PVOID context, PTP_WORK /*work*/) noexcept
+{
+    auto& gci = ServiceLocator::LocateGlobals().getConsoleInformation();
+    const auto self = static_cast<VtIo*>(context);
+
+    // A client that makes many small API calls in a row leaves the IO thread idle for a moment
+    // between each of them. Flushing right away would thus flush after every single call.
+    // Instead, we give the client the rest of the latency window to add more output.
+    for (;;)
+    {
+        auto remaining = std::chrono::steady_clock::duration::zero();
+
+        gci.LockConsole();
+        // The output may have been flushed in the meantime, or a Writer may
+        // be active right now, in which case its Submit() will take care of it.
+        if (self->_flushDeadlinePending && self->_corked <= 0)
+        {
+            remaining = self->_flushDeadline - std::chrono::steady_clock::now();
+            if (remaining <= remaining.zero())
+            {
+                self->_flushNow();
+            }
+        }
+        gci.UnlockConsole();
+
+        if (remaining <= remaining.zero())
+        {
+            break;
+        }
+
+        using filetime_duration = std::chrono::duration<int64_t, std::ratio<1, 10000000>>;
+        // The FILETIME struct measures time in 100ns steps. Negative values are relative to now.
+        LARGE_INTEGER dueTime{};
+        dueTime.QuadPart = -std::max<int64_t>(1, std::chrono::duration_cast<filetime_duration>(remaining).count());
+        if (!SetWaitableTimer(self->_idleFlushTimer.get(), &dueTime, 0, nullptr, nullptr, FALSE) ||
+            WaitForSingleObject(self->_idleFlushTimer.get(), INFINITE) != WAIT_OBJECT_0)
+        {
+            // _flushTimer will flush the output instead.
+            LOG_LAST_ERROR();
+            break;
+        }
+    }
+
+    // NotifyIoThreadIdle() doesn't submit us again while we're running.
+    // If it skipped doing so in the meantime, we need to catch up on that.
+    self->_idleFlushSubmitted.store(false);
+    if (self->_ioThreadIdle.load())
+    {
+        self->_submitIdleFlush();
+    }
+}
+
+// Method Description:
+// - Sets how long the output of consecutive Writers may be held back to combine it into a single write.
+//   Disabling coalescing sends any output that's still being held back.
+// - Coalescing stays disabled if the timer or the work item for flushing it can't be created.
+void VtIo::SetCoalescingPolicy(const CoalescingPolicy& policy) noexcept
+{
+    if (policy.maxLatency.count() > 0)
+    {
+        if (!_flushTimer)
+        {
+            _flushTimer.reset(CreateThreadpoolTimer(&_flushTimerCallback, this, nullptr));
+        }
+        if (!_idleFlushWork)
+        {
+            _idleFlushWork.reset(CreateThreadpoolWork(&_idleFlushCallback, this, nullptr));
+        }
+        if (!_idleFlushTimer)
+        {
+            _idleFlushTimer.reset(CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+            if (!_idleFlushTimer)
+            {
+                // High resolution timers are only supported since Windows 10 1803. Regular ones are bound
+                // to the system tick, just like _flushTimer, but still better than not coalescing at all.
+                _idleFlushTimer.reset(CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+            }
+        }
+        if (!_flushTimer || !_idleFlushWork || !_idleFlushTimer)
+        {
+            LOG_LAST_ERROR();
+            return;
+        }
+    }
+    else if (_flushDeadlinePending)
+    {
+        // We hold the console lock, so we can't wait for a running callback to finish.
+        // That's fine, because it only flushes if _flushDeadlinePending is still set.
+        SetThreadpoolTimer(_flushTimer.get(), nullptr, 0, 0);
+        if (_corked <= 0)
+        {
+            try
+            {
+                _flushNow();
+            }
+            CATCH_LOG();
+        }
+    }
+
+    _coalescing = policy;
+}
+
+// Method Description:
+// - Called by the console IO thread with true right before it waits for the next API message and with false once
+//   it received one. Output that's being held back is flushed once the IO thread is idle and maxLatency has passed
+//   since it was first held back. Until then, the next API message may still add to it.
+// - Unlike the other members, this one is called without holding the console lock.
+void VtIo::NotifyIoThreadIdle(const bool idle) noexcept
+{
+    _ioThreadIdle.store(idle);
+    if (idle)
+    {
+        _submitIdleFlush();
+    }
+}
+
+// Submits _idleFlushWork if output is being held back. A single _idleFlushCallback() waits for
+// the deadline and flushes everything that was written up to it, so one submission is enough.
+void VtIo::_submitIdleFlush() noexcept
+{
+    if (_idleFlushWanted.load() && !_idleFlushSubmitted.exchange(true))
+    {
+        _idleFlushWanted.store(false);
+        SubmitThreadpoolWork(_idleFlushWork.get());
+    }
+}
+
+// Method Description:
+// - Sends any output that's being held back and waits until it's written.
+//   Use this before waiting on a response from the terminal or before exiting.
+void VtIo::Flush()
+{
+    if (_corked > 0)
+    {
+        return;
+    }
+
+    _flushNow();
+
+    if (_overlappedPending)
+    {
+        _overlappedPending = false;
+
+        DWORD written;
+        if (FAILED(Utils::GetOverlappedResultSameThread(_overlapped, &written)))
+        {
+            _hOutput.reset();
+            SendCloseEvent();
+        }
+    }
+}
+
+VtIo::FlushStats VtIo::GetFlushStats() const noexcept
+{
+    return {
+        .flushes = _flushCount,
+        .bytes = _flushBytes,
+        .elapsed = std::chrono::steady_clock::now() - _flushStatsStart,
+    };
+}
+
+double VtIo::FlushStats::BytesPerFlush() const noexcept
+{
+    return flushes ? static_cast<double>(bytes) / static_cast<double>(flushes) : 0.0;
+}
+
+double VtIo::FlushStats::FlushesPerSecond() const noexcept
+{
+    const auto seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? static_cast<double>(flushes) / seconds : 0.0;
+}
+
 void VtIo::Writer::BackupCursor() const
 {
     if (!_io->_writerRestoreCursor)
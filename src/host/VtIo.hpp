@@ -50,6 +50,26 @@ namespace Microsoft::Console::VirtualTerminal
 
         friend struct Writer;
 
+        // Controls for how long the output of consecutive Writers may be held back, so that it's
+        // sent with a single write. A default constructed policy sends the output of each Writer right away.
+        struct CoalescingPolicy
+        {
+            // The pending output is sent as soon as it's at least this large.
+            size_t maxBytes = 0;
+            // The pending output is sent at the latest after this long. 0 disables coalescing.
+            std::chrono::microseconds maxLatency{ 0 };
+        };
+
+        struct FlushStats
+        {
+            uint64_t flushes = 0;
+            uint64_t bytes = 0;
+            std::chrono::steady_clock::duration elapsed{};
+
+            double BytesPerFlush() const noexcept;
+            double FlushesPerSecond() const noexcept;
+        };
+
         static void FormatAttributes(std::string& target, const TextAttribute& attributes);
         static void FormatAttributes(std::wstring& target, const TextAttribute& attributes);
 
@@ -67,10 +87,20 @@ namespace Microsoft::Console::VirtualTerminal
         void CreatePseudoWindow();
         Writer GetWriter() noexcept;
 
+        void SetCoalescingPolicy(const CoalescingPolicy& policy) noexcept;
+        void NotifyIoThreadIdle(bool idle) noexcept;
+        void Flush();
+        FlushStats GetFlushStats() const noexcept;
+
     private:
         [[nodiscard]] HRESULT _Initialize(const HANDLE InHandle, const HANDLE OutHandle, _In_opt_ const HANDLE SignalHandle);
 
+        static void CALLBACK _flushTimerCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer) noexcept;
+        static void CALLBACK _idleFlushCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work) noexcept;
+
         void _uncork();
+        bool _flushIfIoThreadIdle();
+        void _submitIdleFlush() noexcept;
         void _flushNow();
 
         // After CreateIoHandlers is called, these will be invalid.
@@ -94,6 +124,28 @@ namespace Microsoft::Console::VirtualTerminal
         bool _writerRestoreCursor = false;
         bool _writerTainted = false;
 
+        // The length of _back up to the end of the last submitted Writer. Writers that failed are truncated to it.
+        size_t _backCommitted = 0;
+        CoalescingPolicy _coalescing;
+        // If _back holds output that's waiting for more, this is when it gets flushed by _flushTimer.
+        std::chrono::steady_clock::time_point _flushDeadline;
+        bool _flushDeadlinePending = false;
+        // Threadpool timers are bound to the ~15.6ms system tick, which is far longer than maxLatency.
+        // Held back output is therefore primarily flushed by _idleFlushWork once the console IO thread
+        // is idle and the deadline passed, and _flushTimer only serves as a backstop. See NotifyIoThreadIdle().
+        wil::unique_threadpool_timer_nowait _flushTimer;
+        wil::unique_threadpool_work_nowait _idleFlushWork;
+        // A high resolution waitable timer that _idleFlushCallback() uses to wait for the deadline.
+        wil::unique_handle _idleFlushTimer;
+        // These three are accessed without holding the console lock.
+        std::atomic<bool> _ioThreadIdle{ false };
+        std::atomic<bool> _idleFlushWanted{ false };
+        std::atomic<bool> _idleFlushSubmitted{ false };
+
+        uint64_t _flushCount = 0;
+        uint64_t _flushBytes = 0;
+        std::chrono::steady_clock::time_point _flushStatsStart = std::chrono::steady_clock::now();
+
         bool _initialized = false;
         bool _lookingForCursorPosition = false;
         bool _closeEventSent = false;
@@ -32,6 +32,21 @@ using Microsoft::Console::Interactivity::ServiceLocator;
 // for maintaining LRU, then this datatype can be changed.
 std::list<CommandHistory> CommandHistory::s_historyLists;
 
+// Where the histories are persisted to, if enabled. Defaults to %LOCALAPPDATA%\Microsoft\Console\History if empty.
+static std::wstring s_persistenceDirectory;
+
+// A persisted history starts with this header, followed by the commands from the oldest to the newest.
+// Each command is stored as its length in bytes (32-bit) followed by its UTF-8 text.
+struct PersistedHistoryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+};
+static constexpr uint32_t persistedHistoryMagic = 0x54534843; // "CHST"
+static constexpr uint32_t persistedHistoryVersion = 1;
+// Anything larger than this is most likely not a history file we wrote.
+static constexpr uint64_t persistedHistoryMaxSize = 64 * 1024 * 1024;
+
 CommandHistory* CommandHistory::s_Find(const HANDLE processHandle)
 {
     for (auto& historyList : s_historyLists)
@@ -39,6 +54,7 @@ CommandHistory* CommandHistory::s_Find(const HANDLE processHandle)
         if (historyList._processHandle == processHandle)
         {
             FAIL_FAST_IF(WI_IsFlagClear(historyList.Flags, CLE_ALLOCATED));
+            historyList._EnsureLoaded();
             return &historyList;
         }
     }
@@ -48,15 +64,28 @@ CommandHistory* CommandHistory::s_Find(const HANDLE processHandle)
 
 // Routine Description:
 // - This routine marks the command history buffer freed.
+// - If the history is persisted, it gets saved to disk.
 // Arguments:
 // - processHandle - handle to client process.
 void CommandHistory::s_Free(const HANDLE processHandle)
 {
-    const auto History = CommandHistory::s_Find(processHandle);
-    if (History)
+    for (auto& historyList : s_historyLists)
     {
-        WI_ClearFlag(History->Flags, CLE_ALLOCATED);
-        History->_processHandle = nullptr;
+        if (historyList._processHandle == processHandle)
+        {
+            WI_ClearFlag(historyList.Flags, CLE_ALLOCATED);
+            historyList._processHandle = nullptr;
+
+            if (historyList._persistence == PersistenceState::Loaded)
+            {
+                try
+                {
+                    historyList._Save();
+                }
+                CATCH_LOG();
+            }
+            return;
+        }
     }
 }
 
@@ -99,12 +128,7 @@ void CommandHistory::_Reset()
 
     try
     {
-        if (_commands.size() == 0 ||
-            _commands.back().size() != newCommand.size() ||
-            !std::equal(_commands.back().cbegin(),
-                        _commands.back().cbegin() + newCommand.size(),
-                        newCommand.cbegin(),
-                        newCommand.cend()))
+        if (_count == 0 || GetNth(_count - 1) != newCommand)
         {
             std::wstring reuse{};
 
@@ -118,9 +142,9 @@ void CommandHistory::_Reset()
             }
 
             // find free record.  if all records are used, free the lru one.
-            if (GetNumberOfCommands() == _maxCommands)
+            if (_count == _maxCommands)
             {
-                _commands.erase(_commands.cbegin());
+                _PopFront();
                 // move LastDisplayed back one in order to stay synced with the
                 // command it referred to before erasing the lru one
                 --LastDisplayed;
@@ -129,19 +153,14 @@ void CommandHistory::_Reset()
             // add newCommand to array
             if (!reuse.empty())
             {
-                _commands.emplace_back(reuse);
+                _PushBack(std::move(reuse));
             }
             else
             {
-                _commands.emplace_back(newCommand);
+                _PushBack(std::wstring{ newCommand });
             }
 
-            if (LastDisplayed == -1 ||
-                _commands.at(LastDisplayed).size() != newCommand.size() ||
-                !std::equal(_commands.at(LastDisplayed).cbegin(),
-                            _commands.at(LastDisplayed).cbegin() + newCommand.size(),
-                            newCommand.cbegin(),
-                            newCommand.cend()))
+            if (LastDisplayed == -1 || GetNth(LastDisplayed) != newCommand)
             {
                 _Reset();
             }
@@ -155,18 +174,13 @@ void CommandHistory::_Reset()
 
 std::wstring_view CommandHistory::GetNth(Index index) const
 {
-    if (index >= 0 && index < GetNumberOfCommands())
+    if (index >= 0 && index < _count)
     {
-        return _commands.at(index);
+        return _EntryAt(index).node->first;
     }
     return {};
 }
 
-const std::vector<std::wstring>& CommandHistory::GetCommands() const noexcept
-{
-    return _commands;
-}
-
 std::wstring_view CommandHistory::Retrieve(const SearchDirection searchDirection)
 {
     if (searchDirection == SearchDirection::Previous)
@@ -193,14 +207,14 @@ std::wstring_view CommandHistory::Retrieve(const SearchDirection searchDirection
 
 std::wstring_view CommandHistory::RetrieveNth(Index index)
 {
-    if (_commands.empty())
+    if (_count == 0)
     {
         LastDisplayed = 0;
         return {};
     }
 
-    LastDisplayed = std::clamp(index, 0, GetNumberOfCommands() - 1);
-    return _commands.at(LastDisplayed);
+    LastDisplayed = std::clamp(index, 0, _count - 1);
+    return GetNth(LastDisplayed);
 }
 
 std::wstring_view CommandHistory::GetLastCommand() const
@@ -210,7 +224,7 @@ std::wstring_view CommandHistory::GetLastCommand() const
 
 void CommandHistory::Empty()
 {
-    _commands.clear();
+    _Clear();
     LastDisplayed = -1;
     WI_SetFlag(Flags, CLE_RESET);
 }
@@ -243,7 +257,21 @@ void CommandHistory::Realloc(const Index commands)
         return;
     }
 
-    _commands.resize(std::min(_commands.size(), gsl::narrow_cast<size_t>(std::max(0, commands))));
+    // Keep the oldest commands that still fit and straighten out the ring buffer.
+    const auto keep = std::min(_count, std::max(0, commands));
+    std::vector<Entry> ring;
+    ring.reserve(gsl::narrow_cast<size_t>(keep));
+    for (Index i = 0; i < keep; ++i)
+    {
+        ring.emplace_back(_EntryAt(i));
+    }
+    for (auto i = keep; i < _count; ++i)
+    {
+        _index.erase(_EntryAt(i).node);
+    }
+    _ring = std::move(ring);
+    _head = 0;
+    _count = keep;
 
     WI_SetFlag(Flags, CLE_RESET);
     LastDisplayed = GetNumberOfCommands() - 1;
@@ -271,6 +299,7 @@ CommandHistory* CommandHistory::s_FindByExe(const std::wstring_view appName)
     {
         if (WI_IsFlagSet(historyList.Flags, CLE_ALLOCATED) && historyList.IsAppNameMatch(appName))
         {
+            historyList._EnsureLoaded();
             return &historyList;
         }
     }
@@ -316,14 +345,16 @@ CommandHistory* CommandHistory::s_Allocate(const std::wstring_view appName, cons
     // command history buffers hasn't been allocated, allocate a new one.
     if (!SameApp && s_historyLists.size() < gci.GetNumberOfHistoryBuffers())
     {
-        CommandHistory History;
+        auto& History = s_historyLists.emplace_front();
 
         History._appName = appName;
         History.Flags = CLE_ALLOCATED;
         History.LastDisplayed = -1;
         History._maxCommands = gsl::narrow<Index>(gci.GetHistoryBufferSize());
         History._processHandle = processHandle;
-        return &s_historyLists.emplace_front(History);
+        // The persisted commands are only loaded once the history is used. See _EnsureLoaded().
+        History._persistence = gci.GetPersistHistory() ? PersistenceState::NotLoaded : PersistenceState::Disabled;
+        return &History;
     }
 
     // If we have no candidate already and we need one,
@@ -335,7 +366,7 @@ CommandHistory* CommandHistory::s_Allocate(const std::wstring_view appName, cons
         {
             if (WI_IsFlagClear(it->Flags, CLE_ALLOCATED))
             {
-                if (it->_commands.empty() || BestCandidate == end || !BestCandidate->_commands.empty())
+                if (it->_count == 0 || BestCandidate == end || BestCandidate->_count != 0)
                 {
                     BestCandidate = it;
                 }
@@ -348,9 +379,10 @@ CommandHistory* CommandHistory::s_Allocate(const std::wstring_view appName, cons
     {
         if (!SameApp)
         {
-            BestCandidate->_commands.clear();
+            BestCandidate->_Clear();
             BestCandidate->LastDisplayed = -1;
             BestCandidate->_appName = appName;
+            BestCandidate->_persistence = gci.GetPersistHistory() ? PersistenceState::NotLoaded : PersistenceState::Disabled;
         }
 
         BestCandidate->_processHandle = processHandle;
@@ -366,7 +398,7 @@ CommandHistory* CommandHistory::s_Allocate(const std::wstring_view appName, cons
 
 CommandHistory::Index CommandHistory::GetNumberOfCommands() const
 {
-    return gsl::narrow_cast<Index>(_commands.size());
+    return _count;
 }
 
 void CommandHistory::_Prev(Index& ind) const
@@ -412,8 +444,26 @@ std::wstring CommandHistory::Remove(const Index iDel)
         return {};
     }
 
-    const auto str = std::move(_commands.at(iDel));
-    _commands.erase(_commands.begin() + iDel);
+    auto str = std::move(_index.extract(_EntryAt(iDel).node).key());
+
+    // Close the gap by moving the shorter side of the ring buffer.
+    // This retains the order of the sequence numbers.
+    if (iDel < _count / 2)
+    {
+        for (auto i = iDel; i > 0; --i)
+        {
+            _EntryAt(i) = _EntryAt(i - 1);
+        }
+        _head = (_head + 1) % _ring.size();
+    }
+    else
+    {
+        for (auto i = iDel; i < _count - 1; ++i)
+        {
+            _EntryAt(i) = _EntryAt(i + 1);
+        }
+    }
+    _count--;
 
     if (LastDisplayed == iDel)
     {
@@ -429,6 +479,7 @@ std::wstring CommandHistory::Remove(const Index iDel)
 
 // Routine Description:
 // - this routine finds the most recent command that starts with the letters already in the current command.  it returns the array index (no mod needed).
+// - "Most recent" is relative to the starting index: The search goes backwards from it and wraps around to the newest command.
 [[nodiscard]] bool CommandHistory::FindMatchingCommand(const std::wstring_view givenCommand,
                                                        const Index startingIndex,
                                                        Index& indexFound,
@@ -436,7 +487,7 @@ std::wstring CommandHistory::Remove(const Index iDel)
 {
     indexFound = startingIndex;
 
-    if (_commands.size() == 0)
+    if (_count == 0)
     {
         return false;
     }
@@ -455,25 +506,51 @@ std::wstring CommandHistory::Remove(const Index iDel)
         return true;
     }
 
-    try
+    if (indexFound < 0 || indexFound >= _count)
     {
-        for (size_t i = 0; i < _commands.size(); i++)
+        return false;
+    }
+
+    // Since the sequence numbers grow with the index, the match we're looking for is the one with
+    // the largest sequence number up to the starting one, or if there's none, the largest one overall.
+    const auto startingSeq = _EntryAt(indexFound).seq;
+    std::optional<uint64_t> before;
+    std::optional<uint64_t> newest;
+    const auto consider = [&](const uint64_t seq) {
+        if (seq <= startingSeq && (!before || seq > *before))
         {
-            const auto& storedCommand = _commands.at(indexFound);
-            if ((WI_IsFlagClear(options, MatchOptions::ExactMatch) && (givenCommand.size() <= storedCommand.size())) || (givenCommand.size() == storedCommand.size()))
-            {
-                if (til::starts_with(storedCommand, givenCommand))
-                {
-                    return true;
-                }
-            }
+            before = seq;
+        }
+        if (!newest || seq > *newest)
+        {
+            newest = seq;
+        }
+    };
 
-            _Prev(indexFound);
+    if (WI_IsFlagSet(options, MatchOptions::ExactMatch))
+    {
+        const auto [beg, end] = _index.equal_range(givenCommand);
+        for (auto it = beg; it != end; ++it)
+        {
+            consider(it->second);
+        }
+    }
+    else
+    {
+        // All commands that start with givenCommand are sorted right after it.
+        for (auto it = _index.lower_bound(givenCommand); it != _index.end() && til::starts_with(it->first, givenCommand); ++it)
+        {
+            consider(it->second);
         }
     }
-    CATCH_LOG();
 
-    return false;
+    if (!newest)
+    {
+        return false;
+    }
+
+    indexFound = _IndexOfSeq(before ? *before : *newest);
+    return true;
 }
 
 #ifdef UNIT_TESTING
@@ -481,6 +558,11 @@ void CommandHistory::s_ClearHistoryListStorage()
 {
     s_historyLists.clear();
 }
+
+void CommandHistory::s_SetPersistenceDirectory(std::wstring directory)
+{
+    s_persistenceDirectory = std::move(directory);
+}
 #endif
 
 // Routine Description:
@@ -495,8 +577,201 @@ void CommandHistory::Swap(const Index indexA, const Index indexB)
         indexA >= 0 && indexA < num &&
         indexB >= 0 && indexB < num)
     {
-        std::swap(_commands.at(indexA), _commands.at(indexB));
+        // The sequence numbers stay in place, because they reflect the order of the entries.
+        auto& a = _EntryAt(indexA);
+        auto& b = _EntryAt(indexB);
+        std::swap(a.node, b.node);
+        a.node->second = a.seq;
+        b.node->second = b.seq;
+    }
+}
+
+void CommandHistory::_Clear() noexcept
+{
+    _index.clear();
+    _ring.clear();
+    _head = 0;
+    _count = 0;
+}
+
+CommandHistory::Entry& CommandHistory::_EntryAt(const Index index) noexcept
+{
+    return til::at(_ring, (_head + gsl::narrow_cast<size_t>(index)) % _ring.size());
+}
+
+const CommandHistory::Entry& CommandHistory::_EntryAt(const Index index) const noexcept
+{
+    return til::at(_ring, (_head + gsl::narrow_cast<size_t>(index)) % _ring.size());
+}
+
+// Routine Description:
+// - Appends a command to the end of the history. The caller must ensure that there's room for it.
+void CommandHistory::_PushBack(std::wstring command)
+{
+    if (gsl::narrow_cast<size_t>(_count) == _ring.size())
+    {
+        // The ring buffer is full, but hasn't reached _maxCommands yet. Straighten it out, so that it can grow at the end.
+        std::rotate(_ring.begin(), _ring.begin() + _head, _ring.end());
+        _head = 0;
+        _ring.emplace_back();
+    }
+
+    const auto node = _index.emplace(std::move(command), _nextSeq);
+    _EntryAt(_count) = { _nextSeq, node };
+    _nextSeq++;
+    _count++;
+}
+
+void CommandHistory::_PopFront() noexcept
+{
+    _index.erase(_EntryAt(0).node);
+    _head = (_head + 1) % _ring.size();
+    _count--;
+}
+
+// Routine Description:
+// - Returns the index of the entry with the given sequence number, which must exist.
+CommandHistory::Index CommandHistory::_IndexOfSeq(const uint64_t seq) const noexcept
+{
+    Index lo = 0;
+    Index hi = _count;
+    while (lo < hi)
+    {
+        const auto mid = lo + (hi - lo) / 2;
+        if (_EntryAt(mid).seq < seq)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+std::wstring CommandHistory::_PersistencePath() const
+{
+    std::wstring path = s_persistenceDirectory.empty() ? wil::ExpandEnvironmentStringsW<std::wstring>(LR"(%LOCALAPPDATA%\Microsoft\Console\History)") : s_persistenceDirectory;
+
+    // The app name is usually just the name of the executable, but let's be sure it can't escape the directory.
+    path.push_back(L'\\');
+    for (const auto ch : _appName)
+    {
+        path.push_back(wcschr(LR"(\/:*?"<>|)", ch) ? L'_' : ch);
+    }
+    path.append(L".history");
+    return path;
+}
+
+// Routine Description:
+// - Loads the persisted commands the first time the history is looked up for use.
+//   This way we don't read a file for every client process that connects, but only for those
+//   that actually use the history (by reading cooked input or calling the history APIs).
+void CommandHistory::_EnsureLoaded() noexcept
+{
+    if (_persistence != PersistenceState::NotLoaded)
+    {
+        return;
+    }
+
+    // We only try this once. A damaged file gets overwritten the next time the history is saved.
+    _persistence = PersistenceState::Loaded;
+
+    if (_count != 0)
+    {
+        return;
+    }
+
+    try
+    {
+        _Load();
+    }
+    catch (...)
+    {
+        LOG_CAUGHT_EXCEPTION();
+        _Clear();
+    }
+
+    _Reset();
+}
+
+void CommandHistory::_Load()
+{
+    const wil::unique_hfile file{ CreateFileW(_PersistencePath().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+    if (!file)
+    {
+        // The app simply doesn't have a persisted history yet.
+        return;
+    }
+
+    LARGE_INTEGER size;
+    THROW_IF_WIN32_BOOL_FALSE(GetFileSizeEx(file.get(), &size));
+    const auto fileSize = gsl::narrow_cast<uint64_t>(size.QuadPart);
+    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), fileSize < sizeof(PersistedHistoryHeader) || fileSize > persistedHistoryMaxSize);
+
+    std::string data(gsl::narrow_cast<size_t>(fileSize), '\0');
+    DWORD read = 0;
+    THROW_IF_WIN32_BOOL_FALSE(ReadFile(file.get(), data.data(), gsl::narrow_cast<DWORD>(data.size()), &read, nullptr));
+    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), read != data.size());
+
+    PersistedHistoryHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), header.magic != persistedHistoryMagic || header.version != persistedHistoryVersion);
+
+    // The file may hold more commands than fit into the history (if HistoryBufferSize was lowered since).
+    // Collect them all first, so that we can skip the oldest ones.
+    std::vector<std::string_view> commands;
+    std::string_view rest{ data };
+    rest.remove_prefix(sizeof(header));
+    while (!rest.empty())
+    {
+        uint32_t length;
+        THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), rest.size() < sizeof(length));
+        memcpy(&length, rest.data(), sizeof(length));
+        rest.remove_prefix(sizeof(length));
+        THROW_HR_IF(HRESULT_FROM_WIN32(ERROR_INVALID_DATA), length > rest.size());
+        commands.emplace_back(rest.substr(0, length));
+        rest.remove_prefix(length);
+    }
+
+    const auto skip = commands.size() - std::min(commands.size(), gsl::narrow_cast<size_t>(std::max(0, _maxCommands)));
+    for (auto it = commands.begin() + skip; it != commands.end(); ++it)
+    {
+        _PushBack(til::u8u16(*it));
+    }
+}
+
+void CommandHistory::_Save() const
+{
+    const auto path = _PersistencePath();
+
+    std::string data;
+    const PersistedHistoryHeader header{ persistedHistoryMagic, persistedHistoryVersion };
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::string command;
+    for (Index i = 0; i < _count; ++i)
+    {
+        THROW_IF_FAILED(til::u16u8(GetNth(i), command));
+        const auto length = gsl::narrow<uint32_t>(command.size());
+        data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        data.append(command);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path{ path }.parent_path(), ec);
+
+    // Write to a temporary file first, so that we never leave a truncated history behind.
+    const auto temp = path + L".tmp";
+    {
+        const wil::unique_hfile file{ CreateFileW(temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+        THROW_LAST_ERROR_IF(!file);
+
+        DWORD written = 0;
+        THROW_IF_WIN32_BOOL_FALSE(WriteFile(file.get(), data.data(), gsl::narrow<DWORD>(data.size()), &written, nullptr));
     }
+    THROW_IF_WIN32_BOOL_FALSE(MoveFileExW(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING));
 }
 
 // Routine Description:
@@ -618,8 +893,9 @@ HRESULT GetConsoleCommandHistoryLengthImplHelper(const std::wstring_view exeName
         // Every command history item is made of a string length followed by 1 null character.
         const size_t cchNull = 1;
 
-        for (const auto& command : pCommandHistory->GetCommands())
+        for (CommandHistory::Index i = 0, count = pCommandHistory->GetNumberOfCommands(); i < count; ++i)
         {
+            const auto command = pCommandHistory->GetNth(i);
             auto cchCommand = command.size();
 
             // If we're counting how much multibyte space will be needed, trial convert the command string before we add.
@@ -724,8 +1000,9 @@ HRESULT GetConsoleCommandHistoryWImplHelper(const std::wstring_view exeName,
 
         const size_t cchNull = 1;
 
-        for (const auto& command : CommandHistory->GetCommands())
+        for (CommandHistory::Index i = 0, count = CommandHistory->GetNumberOfCommands(); i < count; ++i)
         {
+            const auto command = CommandHistory->GetNth(i);
             const auto cchCommand = command.size();
 
             size_t cchNeeded;
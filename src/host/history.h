@@ -13,6 +13,10 @@ public:
     static constexpr int CLE_ALLOCATED = 0x00000001;
     static constexpr int CLE_RESET = 0x00000002;
 
+    CommandHistory() = default;
+    CommandHistory(const CommandHistory&) = delete;
+    CommandHistory& operator=(const CommandHistory&) = delete;
+
     static CommandHistory* s_Allocate(const std::wstring_view appName, const HANDLE processHandle);
     static CommandHistory* s_Find(const HANDLE processHandle);
     static CommandHistory* s_FindByExe(const std::wstring_view appName);
@@ -48,7 +52,6 @@ public:
 
     Index GetNumberOfCommands() const;
     std::wstring_view GetNth(Index index) const;
-    const std::vector<std::wstring>& GetCommands() const noexcept;
 
     void Realloc(Index commands);
     void Empty();
@@ -63,7 +66,37 @@ public:
     void Swap(const Index indexA, const Index indexB);
 
 private:
+    // The text of each command lives in the node of _index, which is sorted by the text.
+    // This makes prefix searches a lower_bound() away, finds exact duplicates with an equal_range(),
+    // and node iterators stay valid while the entries move around in the ring buffer.
+    using CommandIndex = std::multimap<std::wstring, uint64_t, std::less<>>;
+
+    struct Entry
+    {
+        // The entries are ordered by their sequence number, from oldest to newest. It's unique within a history.
+        uint64_t seq = 0;
+        CommandIndex::iterator node;
+    };
+
+    enum class PersistenceState : uint8_t
+    {
+        Disabled,
+        NotLoaded,
+        Loaded,
+    };
+
     void _Reset();
+    void _Clear() noexcept;
+    Entry& _EntryAt(Index index) noexcept;
+    const Entry& _EntryAt(Index index) const noexcept;
+    void _PushBack(std::wstring command);
+    void _PopFront() noexcept;
+    Index _IndexOfSeq(uint64_t seq) const noexcept;
+
+    std::wstring _PersistencePath() const;
+    void _EnsureLoaded() noexcept;
+    void _Load();
+    void _Save() const;
 
     // _Next and _Prev go to the next and prev command
     // _Inc  and _Dec go to the next and prev slots
@@ -73,10 +106,16 @@ private:
     void _Dec(Index& ind) const;
     void _Inc(Index& ind) const;
 
-    // NOTE: In conhost v1 this used to be a circular buffer because removal at the
-    // start is a very common operation. It seems this was lost in the C++ refactor.
-    std::vector<std::wstring> _commands;
+    // A ring buffer of _count entries starting at _head. It grows up to _maxCommands entries,
+    // after which adding a command overwrites the oldest one.
+    std::vector<Entry> _ring;
+    size_t _head = 0;
+    Index _count = 0;
     Index _maxCommands = 0;
+    uint64_t _nextSeq = 0;
+    CommandIndex _index;
+
+    PersistenceState _persistence = PersistenceState::Disabled;
 
     std::wstring _appName;
     HANDLE _processHandle = nullptr;
@@ -89,6 +128,7 @@ public:
 
 #ifdef UNIT_TESTING
     static void s_ClearHistoryListStorage();
+    static void s_SetPersistenceDirectory(std::wstring directory);
     friend class HistoryTests;
 #endif
 };
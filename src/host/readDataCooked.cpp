@@ -843,9 +843,13 @@ void COOKED_READ_DATA::_replace(size_t offset, size_t remove, const wchar_t* inp
 
 void COOKED_READ_DATA::_replace(const std::wstring_view& str)
 {
+    // Commands from the history often share a prefix with the current contents (e.g. when pressing up/down).
+    // There's no need to redraw that part.
+    const auto common = std::mismatch(_buffer.begin(), _buffer.end(), str.begin(), str.end()).first - _buffer.begin();
+
     _buffer.assign(str);
     _bufferCursor = _buffer.size();
-    _bufferDirtyBeg = 0;
+    _bufferDirtyBeg = std::min(_bufferDirtyBeg, gsl::narrow_cast<size_t>(common));
     _dirty = true;
 }
 
@@ -869,6 +873,9 @@ std::wstring_view COOKED_READ_DATA::_slice(size_t from, size_t to) const noexcep
 // Without this, pasting text would otherwise quickly turn into "accidentally quadratic" meme material.
 //
 // NOTE: Don't call _flushBuffer() after appending newlines to the buffer! See _handlePostCharInputLoop for more information.
+//
+// Similarly, the lines of the previous layout that end before _bufferDirtyBeg are reused, and only the rest of the buffer
+// is laid out again. This keeps the cost of a keystroke independent of the length of the prompt (= when editing its end).
 void COOKED_READ_DATA::_redisplay()
 {
     if (!_dirty || WI_IsFlagClear(_pInputBuffer->InputMode, ENABLE_ECHO_INPUT))
@@ -880,7 +887,19 @@ void COOKED_READ_DATA::_redisplay()
     auto originInViewportFinal = _originInViewport;
     til::point cursorPositionFinal;
     til::point pagerPromptEnd;
-    std::vector<Line> lines;
+    auto lines = std::move(_layout);
+    _layout.clear();
+
+    if (_layoutWidth != size.width || _layoutColumnBegin != _originInViewport.x)
+    {
+        lines.clear();
+    }
+
+    // The number of lines that make up the prompt and the size of the last one.
+    // Everything that gets added afterwards is removed again before storing the lines in _layout.
+    size_t promptLineCount = 0;
+    size_t promptTailSize = 0;
+    til::CoordType promptTailColumns = 0;
 
     // FYI: This loop does not loop. It exists because goto is considered evil
     // and if MSVC says that then that must be true.
@@ -888,16 +907,41 @@ void COOKED_READ_DATA::_redisplay()
     {
         cursorPositionFinal = { _originInViewport.x, 0 };
 
+        // Keep the lines that end before _bufferDirtyBeg. The line that contains it (or ends right at it) is laid out
+        // again, because whether the text that follows still fits into the line (e.g. a wide glyph) may have changed.
+        const auto dirtyLine = std::partition_point(lines.begin(), lines.end(), [&](const Line& line) { return line.bufferOffset < _bufferDirtyBeg; });
+        const auto reuse = gsl::narrow_cast<size_t>(std::max<ptrdiff_t>(0, dirtyLine - lines.begin() - 1));
+        const auto start = reuse < lines.size() ? til::at(lines, reuse).bufferOffset : 0;
+        lines.resize(reuse);
+
+        for (auto& line : lines)
+        {
+            line.dirtyBegOffset = line.text.size();
+            line.dirtyBegColumn = line.columns;
+        }
+
+        // If the cursor is within the reused lines we need to lay out the line it's on to find its column.
+        // This mirrors how the loop below finds the cursor position: At the end of the text preceding it.
+        if (_bufferCursor != 0 && _bufferCursor <= start)
+        {
+            const auto it = std::partition_point(lines.begin(), lines.end(), [&](const Line& line) { return line.bufferOffset < _bufferCursor; });
+            const auto y = gsl::narrow_cast<til::CoordType>(it - lines.begin()) - 1;
+            std::wstring scratch;
+            const auto res = _layoutLine(scratch, _slice(0, _bufferCursor), til::at(lines, y).bufferOffset, y == 0 ? _originInViewport.x : 0, size.width);
+            cursorPositionFinal = { res.column, y };
+        }
+
         // Construct the first line manually so that it starts at the correct horizontal position.
-        LayoutResult res{ .column = cursorPositionFinal.x };
-        lines.emplace_back(std::wstring{}, 0, cursorPositionFinal.x, cursorPositionFinal.x);
+        const auto columnBegin = reuse == 0 ? _originInViewport.x : 0;
+        LayoutResult res{ .column = columnBegin };
+        lines.emplace_back(std::wstring{}, 0, columnBegin, columnBegin, start);
 
         // Split the buffer into 3 segments, so that we can find the row/column coordinates of
         // the cursor within the buffer, as well as the start of the dirty parts of the buffer.
         const size_t offsets[]{
-            0,
-            std::min(_bufferDirtyBeg, _bufferCursor),
-            std::max(_bufferDirtyBeg, _bufferCursor),
+            start,
+            std::max(start, std::min(_bufferDirtyBeg, _bufferCursor)),
+            std::max(start, std::max(_bufferDirtyBeg, _bufferCursor)),
             npos,
         };
 
@@ -916,7 +960,7 @@ void COOKED_READ_DATA::_redisplay()
             {
                 if (res.column >= size.width)
                 {
-                    lines.emplace_back();
+                    lines.emplace_back().bufferOffset = gsl::narrow_cast<size_t>(segment.data() - _buffer.data()) + beg;
                 }
 
                 auto& line = lines.back();
@@ -940,6 +984,9 @@ void COOKED_READ_DATA::_redisplay()
         }
 
         pagerPromptEnd = { res.column, gsl::narrow_cast<til::CoordType>(lines.size() - 1) };
+        promptLineCount = lines.size();
+        promptTailSize = lines.back().text.size();
+        promptTailColumns = lines.back().columns;
 
         // If the content got a little shorter than it was before, we need to erase the tail end.
         // If the last character on a line got removed, we'll skip this code because `remaining`
@@ -1080,6 +1127,8 @@ void COOKED_READ_DATA::_redisplay()
     cursorPositionFinal.y += originInViewportFinal.y - pagerContentTop;
 
     std::wstring output;
+    size_t scrollClearLine = npos;
+    size_t scrollClearSize = 0;
 
     // Disable the cursor when opening a popup, reenable it when closing them.
     if (const auto popupOpened = !_popups.empty(); _popupOpened != popupOpened)
@@ -1125,7 +1174,9 @@ void COOKED_READ_DATA::_redisplay()
         {
             // We may not be scrolling with VT, because we're scrolling by more rows than the pagerHeight.
             // Since no one is now clearing the scrolled in rows for us anymore, we need to do it ourselves.
-            auto& lastLine = lines.at(pagerHeight - 1 + pagerContentTop);
+            scrollClearLine = gsl::narrow_cast<size_t>(pagerHeight - 1 + pagerContentTop);
+            auto& lastLine = lines.at(scrollClearLine);
+            scrollClearSize = lastLine.text.size();
             if (lastLine.columns < size.width)
             {
                 lastLine.text.append(L"\x1b[K");
@@ -1222,6 +1273,19 @@ void COOKED_READ_DATA::_redisplay()
     _appendCUP(output, cursorPositionFinal);
     WriteCharsVT(_screenInfo, output);
 
+    // Undo the modifications to the prompt lines made after the layout, so that they can be reused.
+    lines.resize(promptLineCount);
+    if (scrollClearLine < promptLineCount)
+    {
+        til::at(lines, scrollClearLine).text.resize(scrollClearSize);
+    }
+    lines.back().text.resize(promptTailSize);
+    lines.back().columns = promptTailColumns;
+
+    _layout = std::move(lines);
+    _layoutWidth = size.width;
+    _layoutColumnBegin = originInViewportFinal.x;
+
     _originInViewport = originInViewportFinal;
     _pagerPromptEnd = pagerPromptEnd;
     _pagerContentTop = pagerContentTop;
@@ -118,6 +118,8 @@ private:
         size_t dirtyBegOffset = 0;
         til::CoordType dirtyBegColumn = 0;
         til::CoordType columns = 0;
+        // The offset into _buffer at which this line starts. Only used for the lines of the prompt.
+        size_t bufferOffset = 0;
     };
 
     static size_t _wordPrev(const std::wstring_view& chars, size_t position);
@@ -177,4 +179,14 @@ private:
 
     std::vector<Popup> _popups;
     bool _popupOpened = false;
+
+    // The lines of the prompt from the previous _redisplay() call. The ones before _bufferDirtyBeg are reused as is.
+    // It's only valid for the _layoutWidth and _layoutColumnBegin (the column the prompt starts at) it was made for.
+    std::vector<Line> _layout;
+    til::CoordType _layoutWidth = 0;
+    til::CoordType _layoutColumnBegin = 0;
+
+#ifdef UNIT_TESTING
+    friend class CookedReadTests;
+#endif
 };
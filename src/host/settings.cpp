@@ -791,3 +791,13 @@ bool Settings::GetEnableBuiltinGlyphs() const noexcept
 {
     return _fEnableBuiltinGlyphs;
 }
+
+bool Settings::GetPersistHistory() const noexcept
+{
+    return _fPersistHistory;
+}
+
+void Settings::SetPersistHistory(const bool persistHistory) noexcept
+{
+    _fPersistHistory = persistHistory;
+}
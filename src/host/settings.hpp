@@ -181,6 +181,8 @@ public:
     SettingsTextMeasurementMode GetTextMeasurementMode() const noexcept;
     void SetTextMeasurementMode(SettingsTextMeasurementMode mode) noexcept;
     bool GetEnableBuiltinGlyphs() const noexcept;
+    bool GetPersistHistory() const noexcept;
+    void SetPersistHistory(const bool persistHistory) noexcept;
 
 private:
     RenderSettings _renderSettings;
@@ -226,6 +228,7 @@ private:
     bool _fUseDx;
     bool _fCopyColor;
     bool _fEnableBuiltinGlyphs = true;
+    bool _fPersistHistory = false; // whether command histories are saved to disk per app
 
     // this is used for the special STARTF_USESIZE mode.
     bool _fUseWindowSizePixels;
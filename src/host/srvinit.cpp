@@ -1011,14 +1011,25 @@ DWORD WINAPI ConsoleIoThread(LPVOID lpParameter)
             LOG_IF_FAILED(ReplyMsg->ReleaseMessageBuffers());
         }
 
+        // ReadIo() blocks until the next message arrives. VtIo uses this to flush output that it held back.
+        const auto vtIo = globals.getConsoleInformation().GetVtIo();
+        vtIo->NotifyIoThreadIdle(true);
         // TODO: 9115192 correct mixed NTSTATUS/HRESULT
         auto hr = ServiceLocator::LocateGlobals().pDeviceComm->ReadIo(ReplyMsg, &ReceiveMsg);
+        vtIo->NotifyIoThreadIdle(false);
         if (FAILED(hr))
         {
             if (hr == HRESULT_FROM_WIN32(ERROR_PIPE_NOT_CONNECTED))
             {
                 fShouldExit = true;
 
+                // VtIo may be holding back the last output of our clients to coalesce it with more.
+                LockConsole();
+                LOG_IF_FAILED(wil::ResultFromException([]() {
+                    ServiceLocator::LocateGlobals().getConsoleInformation().GetVtIo()->Flush();
+                }));
+                UnlockConsole();
+
                 // This will not return. Terminate immediately when disconnected.
                 ServiceLocator::RundownAndExit(STATUS_SUCCESS);
             }
@@ -0,0 +1,288 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include "WexTestClass.h"
+#include "../../inc/consoletaeftemplates.hpp"
+
+#include "CommonState.hpp"
+
+#include "_stream.h"
+#include "readDataCooked.hpp"
+
+#include "../interactivity/inc/ServiceLocator.hpp"
+
+using namespace WEX::Common;
+using namespace WEX::Logging;
+using namespace WEX::TestExecution;
+using Microsoft::Console::Interactivity::ServiceLocator;
+
+// COOKED_READ_DATA::_redisplay() reuses the layout of the previous call for the part of the prompt that didn't change.
+// These tests edit the prompt in various ways and check after every step that the result is identical
+// to what laying out the entire prompt from scratch produces.
+class CookedReadTests
+{
+    TEST_CLASS(CookedReadTests);
+
+    std::unique_ptr<CommonState> m_state;
+
+    TEST_METHOD_SETUP(MethodSetup)
+    {
+        m_state = std::make_unique<CommonState>();
+        m_state->PrepareGlobalInputBuffer();
+        m_state->PrepareGlobalScreenBuffer();
+        m_state->PrepareReadHandle();
+        return true;
+    }
+
+    TEST_METHOD_CLEANUP(MethodCleanup)
+    {
+        m_state->CleanupCookedReadData();
+        m_state->CleanupReadHandle();
+        m_state->CleanupGlobalScreenBuffer();
+        m_state->CleanupGlobalInputBuffer();
+        m_state.reset();
+        return true;
+    }
+
+    TEST_METHOD(TypingAtEndOfMultiLinePrompt)
+    {
+        auto& cookedReadData = _PrepareCookedRead();
+
+        Log::Comment(L"Type enough text to fill three lines, one character at a time.");
+        std::wstring text;
+        for (auto i = 0; i < 200; i++)
+        {
+            text.push_back(i % 7 == 6 ? L' ' : gsl::narrow_cast<wchar_t>(L'a' + i % 26));
+        }
+        _Type(cookedReadData, text);
+        VERIFY_ARE_EQUAL(3u, cookedReadData._layout.size());
+
+        Log::Comment(L"Erase the text again across the line boundaries.");
+        _Type(cookedReadData, std::wstring(100, UNICODE_BACKSPACE));
+
+        Log::Comment(L"Erase the previous words, which crosses the line boundary in a single step.");
+        _Type(cookedReadData, L"some more words");
+        _Type(cookedReadData, std::wstring(8, EXTKEY_ERASE_PREV_WORD));
+    }
+
+    TEST_METHOD(WideGlyphAtWrapBoundary)
+    {
+        auto& cookedReadData = _PrepareCookedRead();
+        const auto width = _Width();
+
+        Log::Comment(L"Leave a single column at the end of the first line.");
+        _Type(cookedReadData, std::wstring(width - s_promptLength - 1, L'a'));
+
+        Log::Comment(L"A wide glyph doesn't fit into it and gets wrapped into the second line.");
+        _Type(cookedReadData, L"\u304b");
+        VERIFY_ARE_EQUAL(2u, cookedReadData._layout.size());
+
+        Log::Comment(L"Removing it again invalidates the line that ends right at the dirty offset.");
+        _Type(cookedReadData, std::wstring(1, UNICODE_BACKSPACE));
+
+        Log::Comment(L"A narrow glyph fits into the last column, so the next wide glyph starts a new line.");
+        _Type(cookedReadData, L"b\u304b\u304d");
+
+        Log::Comment(L"Inserting wide glyphs in front of the boundary shifts which glyph gets wrapped.");
+        cookedReadData._setCursorPosition(10);
+        _Redisplay(cookedReadData);
+        _Type(cookedReadData, L"\u304f");
+        _Type(cookedReadData, L"c");
+        _Type(cookedReadData, L"\u3051");
+
+        Log::Comment(L"Removing them shifts it back.");
+        _Type(cookedReadData, std::wstring(3, UNICODE_BACKSPACE));
+    }
+
+    TEST_METHOD(HistoryReplaceSharingPrefix)
+    {
+        auto& cookedReadData = _PrepareCookedRead();
+
+        const auto command = L"echo " + std::wstring(300, L'x');
+        const std::wstring commands[]{
+            command,
+            command + L" foo",
+            command.substr(0, 170),
+            command,
+            L"echo yyy",
+            L"dir",
+            L"",
+            command,
+        };
+
+        for (const auto& c : commands)
+        {
+            Log::Comment(NoThrowString().Format(L"Replace the prompt with %zu characters", c.size()));
+            cookedReadData._replace(c);
+            _Redisplay(cookedReadData);
+        }
+    }
+
+    TEST_METHOD(CursorInReusedLine)
+    {
+        auto& cookedReadData = _PrepareCookedRead();
+        const auto width = _Width();
+        const auto firstLineLength = gsl::narrow_cast<size_t>(width - s_promptLength);
+
+        _Type(cookedReadData, std::wstring(250, L'a'));
+
+        // The cursor positions at the end of the first line and at the start of the second one are the same offset.
+        const size_t positions[]{ 0, 1, 40, firstLineLength - 1, firstLineLength, firstLineLength + 1, firstLineLength + width, 249, 250, 0 };
+        for (const auto position : positions)
+        {
+            Log::Comment(NoThrowString().Format(L"Move the cursor to %zu", position));
+            cookedReadData._setCursorPosition(position);
+            _Redisplay(cookedReadData);
+        }
+
+        Log::Comment(L"Type in the middle of the first line and at the line boundary.");
+        cookedReadData._setCursorPosition(40);
+        _Type(cookedReadData, L"bb");
+        cookedReadData._setCursorPosition(firstLineLength);
+        _Type(cookedReadData, L"cc");
+    }
+
+    TEST_METHOD(OpenAndClosePopup)
+    {
+        auto& cookedReadData = _PrepareCookedRead();
+
+        _Type(cookedReadData, std::wstring(200, L'a'));
+
+        Log::Comment(L"The popup gets drawn below the prompt, without becoming part of the cached layout.");
+        cookedReadData._popupPush(COOKED_READ_DATA::PopupKind::CopyToChar);
+        _Redisplay(cookedReadData);
+        VERIFY_ARE_EQUAL(3u, cookedReadData._layout.size());
+
+        Log::Comment(L"Closing the popup erases it without redrawing the prompt.");
+        cookedReadData._popupsDone();
+        _Redisplay(cookedReadData);
+
+        _Type(cookedReadData, L"bb");
+    }
+
+    TEST_METHOD(PagerFallback)
+    {
+        auto& cookedReadData = _PrepareCookedRead();
+        const auto size = _Size();
+
+        Log::Comment(L"Paste more lines than fit into the viewport, which restarts the layout at column 0.");
+        std::wstring text;
+        for (til::CoordType i = 0; i <= size.height; i++)
+        {
+            text.append(size.width, gsl::narrow_cast<wchar_t>(L'a' + i % 26));
+        }
+        cookedReadData._replace(0, 0, text.data(), text.size());
+        _Redisplay(cookedReadData);
+        VERIFY_ARE_EQUAL(0, cookedReadData._originInViewport.x);
+        VERIFY_ARE_EQUAL(0, cookedReadData._layoutColumnBegin);
+
+        Log::Comment(L"Type and erase at the end.");
+        _Type(cookedReadData, L"xyz");
+        _Type(cookedReadData, std::wstring(1, UNICODE_BACKSPACE));
+
+        Log::Comment(L"Scroll the pager up by moving the cursor to the start and type there.");
+        cookedReadData._setCursorPosition(10);
+        _Redisplay(cookedReadData);
+        _Type(cookedReadData, L"\u304b");
+
+        Log::Comment(L"Scroll back down.");
+        cookedReadData._setCursorPosition(text.size());
+        _Redisplay(cookedReadData);
+    }
+
+private:
+    static constexpr std::wstring_view s_prompt{ L"C:\\> " };
+    static constexpr til::CoordType s_promptLength = gsl::narrow_cast<til::CoordType>(s_prompt.size());
+
+    struct Snapshot
+    {
+        std::vector<std::wstring> rows;
+        til::point cursor;
+        std::vector<COOKED_READ_DATA::Line> lines;
+    };
+
+    static til::size _Size()
+    {
+        auto& gci = ServiceLocator::LocateGlobals().getConsoleInformation();
+        return gci.GetActiveOutputBuffer().GetVtPageArea().Dimensions();
+    }
+
+    static til::CoordType _Width()
+    {
+        return _Size().width;
+    }
+
+    // Writes a shell prompt, so that the cooked read doesn't start at column 0, and starts reading.
+    COOKED_READ_DATA& _PrepareCookedRead()
+    {
+        auto& gci = ServiceLocator::LocateGlobals().getConsoleInformation();
+        WriteCharsVT(gci.GetActiveOutputBuffer(), s_prompt);
+        m_state->PrepareCookedReadData();
+
+        auto& cookedReadData = gci.CookedReadData();
+        cookedReadData.SetInsertMode(true);
+        return cookedReadData;
+    }
+
+    static Snapshot _TakeSnapshot(const COOKED_READ_DATA& cookedReadData)
+    {
+        const auto& screenInfo = ServiceLocator::LocateGlobals().getConsoleInformation().GetActiveOutputBuffer();
+        const auto& textBuffer = screenInfo.GetTextBuffer();
+        const auto viewport = screenInfo.GetVtPageArea();
+
+        Snapshot snapshot;
+        for (auto y = viewport.Top(); y <= viewport.BottomInclusive(); y++)
+        {
+            snapshot.rows.emplace_back(textBuffer.GetRowByOffset(y).GetText());
+        }
+        snapshot.cursor = textBuffer.GetCursor().GetPosition();
+        snapshot.lines = cookedReadData._layout;
+        return snapshot;
+    }
+
+    // Redraws the prompt and compares the result against laying out the entire prompt from scratch.
+    static void _Redisplay(COOKED_READ_DATA& cookedReadData)
+    {
+        cookedReadData._redisplay();
+        const auto incremental = _TakeSnapshot(cookedReadData);
+
+        cookedReadData._layout.clear();
+        cookedReadData._bufferDirtyBeg = 0;
+        cookedReadData._dirty = true;
+        cookedReadData._redisplay();
+        const auto full = _TakeSnapshot(cookedReadData);
+
+        VERIFY_ARE_EQUAL(full.cursor, incremental.cursor);
+
+        VERIFY_ARE_EQUAL(full.rows.size(), incremental.rows.size());
+        for (size_t i = 0; i < full.rows.size(); i++)
+        {
+            const std::wstring_view expected{ full.rows[i] };
+            const std::wstring_view actual{ incremental.rows[i] };
+            VERIFY_ARE_EQUAL(expected, actual, NoThrowString().Format(L"row %zu", i));
+        }
+
+        VERIFY_ARE_EQUAL(full.lines.size(), incremental.lines.size());
+        for (size_t i = 0; i < full.lines.size(); i++)
+        {
+            const auto& expected = full.lines[i];
+            const auto& actual = incremental.lines[i];
+            const std::wstring_view expectedText{ expected.text };
+            const std::wstring_view actualText{ actual.text };
+            VERIFY_ARE_EQUAL(expectedText, actualText, NoThrowString().Format(L"line %zu", i));
+            VERIFY_ARE_EQUAL(expected.columns, actual.columns, NoThrowString().Format(L"line %zu", i));
+            VERIFY_ARE_EQUAL(expected.bufferOffset, actual.bufferOffset, NoThrowString().Format(L"line %zu", i));
+        }
+    }
+
+    // Feeds each character to the cooked read like a key press and verifies the result after each one.
+    static void _Type(COOKED_READ_DATA& cookedReadData, const std::wstring_view& text)
+    {
+        for (const auto wch : text)
+        {
+            cookedReadData._handleChar(wch, 0);
+            _Redisplay(cookedReadData);
+        }
+    }
+};
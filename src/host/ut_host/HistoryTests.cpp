@@ -242,6 +242,171 @@ class HistoryTests
         VERIFY_ARE_EQUAL(2, history->GetNumberOfCommands());
     }
 
+    TEST_METHOD(FindMatchingCommandWrapsAround)
+    {
+        auto history = CommandHistory::s_Allocate(_manyApps[0], _MakeHandle(0));
+        VERIFY_IS_NOT_NULL(history);
+
+        VERIFY_SUCCEEDED(history->Add(L"dir", false));
+        VERIFY_SUCCEEDED(history->Add(L"cd ..", false));
+        VERIFY_SUCCEEDED(history->Add(L"dir /w", false));
+        VERIFY_SUCCEEDED(history->Add(L"echo", false));
+        VERIFY_SUCCEEDED(history->Add(L"dir /p", false));
+
+        Log::Comment(L"Repeated prefix searches walk backwards through the matches, like F8 does, and wrap around.");
+        CommandHistory::Index index;
+        for (const auto expected : { 4, 2, 0, 4 })
+        {
+            VERIFY_IS_TRUE(history->FindMatchingCommand(L"dir", history->LastDisplayed, index, CommandHistory::MatchOptions::None));
+            VERIFY_ARE_EQUAL(expected, index);
+            history->LastDisplayed = index;
+        }
+
+        VERIFY_IS_FALSE(history->FindMatchingCommand(L"dirs", history->LastDisplayed, index, CommandHistory::MatchOptions::None));
+        VERIFY_IS_FALSE(history->FindMatchingCommand(L"di", history->LastDisplayed, index, CommandHistory::MatchOptions::ExactMatch | CommandHistory::MatchOptions::JustLooking));
+        VERIFY_IS_TRUE(history->FindMatchingCommand(L"dir", 4, index, CommandHistory::MatchOptions::ExactMatch | CommandHistory::MatchOptions::JustLooking));
+        VERIFY_ARE_EQUAL(0, index);
+    }
+
+    TEST_METHOD(FindMatchingCommandAfterReordering)
+    {
+        auto history = CommandHistory::s_Allocate(_manyApps[0], _MakeHandle(0));
+        VERIFY_IS_NOT_NULL(history);
+
+        Log::Comment(L"Overflow the history, which evicts the two oldest commands.");
+        for (const auto& item : _manyHistoryItems)
+        {
+            VERIFY_SUCCEEDED(history->Add(item, false));
+        }
+        VERIFY_ARE_EQUAL(s_BufferSize, history->GetNumberOfCommands());
+        VERIFY_ARE_EQUAL(std::wstring_view{ _manyHistoryItems[2] }, history->GetNth(0));
+
+        CommandHistory::Index index;
+        VERIFY_IS_TRUE(history->FindMatchingCommand(L"dir", 9, index, CommandHistory::MatchOptions::JustLooking));
+        VERIFY_ARE_EQUAL(0, index);
+        VERIFY_IS_FALSE(history->FindMatchingCommand(L"dir /w", 9, index, CommandHistory::MatchOptions::ExactMatch | CommandHistory::MatchOptions::JustLooking));
+
+        Log::Comment(L"Searches find commands at their new position after moving them around.");
+        history->Swap(0, 5);
+        VERIFY_ARE_EQUAL(std::wstring_view{ _manyHistoryItems[2] }, history->GetNth(5));
+        VERIFY_IS_TRUE(history->FindMatchingCommand(L"dir", 9, index, CommandHistory::MatchOptions::JustLooking));
+        VERIFY_ARE_EQUAL(5, index);
+
+        const auto removed = history->Remove(2);
+        VERIFY_ARE_EQUAL(std::wstring_view{ _manyHistoryItems[4] }, std::wstring_view{ removed });
+        VERIFY_ARE_EQUAL(s_BufferSize - 1, history->GetNumberOfCommands());
+        VERIFY_IS_TRUE(history->FindMatchingCommand(L"dir", 9, index, CommandHistory::MatchOptions::JustLooking));
+        VERIFY_ARE_EQUAL(4, index);
+        VERIFY_IS_TRUE(history->FindMatchingCommand(L"ipconfig", 9, index, CommandHistory::MatchOptions::JustLooking));
+        VERIFY_ARE_EQUAL(std::wstring_view{ _manyHistoryItems[5] }, history->GetNth(index));
+
+        Log::Comment(L"Adding a duplicate moves it to the end.");
+        VERIFY_SUCCEEDED(history->Add(_manyHistoryItems[2], true));
+        VERIFY_ARE_EQUAL(s_BufferSize - 1, history->GetNumberOfCommands());
+        VERIFY_ARE_EQUAL(std::wstring_view{ _manyHistoryItems[2] }, history->GetNth(s_BufferSize - 2));
+        VERIFY_IS_TRUE(history->FindMatchingCommand(L"dir", 0, index, CommandHistory::MatchOptions::JustLooking));
+        VERIFY_ARE_EQUAL(s_BufferSize - 2, index);
+    }
+
+    TEST_METHOD(PersistHistory)
+    {
+        wchar_t directory[MAX_PATH];
+        VERIFY_IS_TRUE(GetTempPathW(MAX_PATH, &directory[0]) != 0);
+        const auto path = std::wstring{ &directory[0] } + L"HistoryTests";
+        std::filesystem::create_directories(path);
+
+        auto& gci = ServiceLocator::LocateGlobals().getConsoleInformation();
+        gci.SetPersistHistory(true);
+        CommandHistory::s_SetPersistenceDirectory(path);
+        const auto cleanup = wil::scope_exit([&]() {
+            gci.SetPersistHistory(false);
+            CommandHistory::s_SetPersistenceDirectory({});
+            std::error_code ec;
+            std::filesystem::remove_all(path, ec);
+        });
+
+        auto history = CommandHistory::s_Allocate(_manyApps[0], _MakeHandle(0));
+        VERIFY_IS_NOT_NULL(history);
+        VERIFY_ARE_EQUAL(history, CommandHistory::s_Find(_MakeHandle(0)));
+        for (const auto& item : _manyHistoryItems)
+        {
+            VERIFY_SUCCEEDED(history->Add(item, false));
+        }
+        VERIFY_SUCCEEDED(history->Add(L"\u00e9cho \U0001F600", false));
+        CommandHistory::s_Free(_MakeHandle(0));
+
+        Log::Comment(L"A new session loads the saved commands once the history is looked up.");
+        CommandHistory::s_ClearHistoryListStorage();
+        history = CommandHistory::s_Allocate(_manyApps[0], _MakeHandle(1));
+        VERIFY_IS_NOT_NULL(history);
+        VERIFY_ARE_EQUAL(0, history->GetNumberOfCommands());
+        VERIFY_ARE_EQUAL(history, CommandHistory::s_Find(_MakeHandle(1)));
+        VERIFY_ARE_EQUAL(s_BufferSize, history->GetNumberOfCommands());
+        VERIFY_ARE_EQUAL(std::wstring_view{ _manyHistoryItems[3] }, history->GetNth(0));
+        VERIFY_ARE_EQUAL(std::wstring_view{ L"\u00e9cho \U0001F600" }, history->GetNth(s_BufferSize - 1));
+        VERIFY_ARE_EQUAL(s_BufferSize - 1, history->LastDisplayed);
+
+        Log::Comment(L"Other apps don't share the history.");
+        history = CommandHistory::s_Allocate(_manyApps[1], _MakeHandle(2));
+        VERIFY_IS_NOT_NULL(history);
+        VERIFY_ARE_EQUAL(history, CommandHistory::s_Find(_MakeHandle(2)));
+        VERIFY_ARE_EQUAL(0, history->GetNumberOfCommands());
+    }
+
+    // Not a test per se, but a benchmark for adding and searching a large history.
+    TEST_METHOD(LargeHistoryThroughput)
+    {
+        static constexpr CommandHistory::Index commands = 100000;
+
+        auto history = CommandHistory::s_Allocate(_manyApps[0], _MakeHandle(0));
+        VERIFY_IS_NOT_NULL(history);
+        history->Realloc(commands);
+
+        std::vector<std::wstring> items;
+        items.reserve(commands);
+        for (CommandHistory::Index i = 0; i < commands; ++i)
+        {
+            items.emplace_back(fmt::format(L"{} {}", _manyHistoryItems[i % _manyHistoryItems.size()], i));
+        }
+
+        const auto measure = [&](const wchar_t* what, auto&& func) {
+            const auto start = std::chrono::steady_clock::now();
+            func();
+            const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            Log::Comment(NoThrowString().Format(L"%s: %d commands in %.1fms", what, commands, elapsed * 1000));
+        };
+
+        size_t succeeded = 0;
+        measure(L"Add (no duplicates)", [&]() {
+            for (const auto& item : items)
+            {
+                succeeded += SUCCEEDED(history->Add(item, true));
+            }
+        });
+        VERIFY_ARE_EQUAL(items.size(), succeeded);
+        VERIFY_ARE_EQUAL(commands, history->GetNumberOfCommands());
+
+        succeeded = 0;
+        measure(L"Add (evicting the oldest)", [&]() {
+            for (const auto& item : items)
+            {
+                succeeded += SUCCEEDED(history->Add(item, false));
+            }
+        });
+        VERIFY_ARE_EQUAL(items.size(), succeeded);
+        VERIFY_ARE_EQUAL(commands, history->GetNumberOfCommands());
+
+        succeeded = 0;
+        measure(L"FindMatchingCommand (prefix)", [&]() {
+            CommandHistory::Index index;
+            for (const auto& item : items)
+            {
+                succeeded += history->FindMatchingCommand(item, commands - 1, index, CommandHistory::MatchOptions::JustLooking);
+            }
+        });
+        VERIFY_ARE_EQUAL(items.size(), succeeded);
+    }
+
 private:
     const std::array<std::wstring, 5> _manyApps = {
         L"foo.exe",
@@ -267,6 +267,8 @@ class ScreenBufferTests
     TEST_METHOD(SimpleMarkCommand);
     TEST_METHOD(SimpleWrappedCommand);
     TEST_METHOD(SimplePromptRegions);
+
+    TEST_METHOD(ColoredOutputThroughput);
 };
 
 void ScreenBufferTests::SingleAlternateBufferCreationTest()
@@ -8585,3 +8587,44 @@ void ScreenBufferTests::SimplePromptRegions()
         VERIFY_IS_FALSE(mark.outputEnd.has_value());
     }
 }
+
+// Not a test per se, but a benchmark for output that consists mostly of short SGR sequences,
+// modeled after a syntax-highlighted `git log -p`.
+void ScreenBufferTests::ColoredOutputThroughput()
+{
+    auto& gci = ServiceLocator::LocateGlobals().getConsoleInformation();
+    auto& si = gci.GetActiveOutputBuffer();
+    auto& stateMachine = si.GetStateMachine();
+
+    static constexpr size_t iterations = 20;
+    static constexpr std::wstring_view hunk = L"\x1b[33mcommit 4f2a9c81d0e3b7a6c5d4e3f2a1b0c9d8e7f6a5b4\x1b[m\r\n"
+                                              L"\x1b[1mdiff --git a/src/main.cpp b/src/main.cpp\x1b[m\r\n"
+                                              L"\x1b[36m@@ -12,7 +12,8 @@\x1b[m \x1b[38;5;141mint\x1b[m main()\r\n"
+                                              L"\x1b[31m-    \x1b[38;5;208mreturn\x1b[31m \x1b[38;5;81m0\x1b[31m;\x1b[m\r\n"
+                                              L"\x1b[32m+    \x1b[38;5;208mif\x1b[32m (\x1b[38;5;141margc\x1b[32m > \x1b[38;5;81m1\x1b[32m)\x1b[m\r\n"
+                                              L"\x1b[32m+        \x1b[38;5;208mreturn\x1b[32m \x1b[38;5;81m1\x1b[32m;\x1b[m\r\n"
+                                              L"     \x1b[38;5;246m// unchanged context line\x1b[m\r\n";
+
+    std::wstring text;
+    for (auto i = 0; i < 1000; ++i)
+    {
+        text.append(hunk);
+    }
+    const auto utf8 = til::u16u8(text);
+
+    const auto measure = [&](auto&& write) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            write();
+        }
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return iterations * text.size() / elapsed / 1e6;
+    };
+
+    const auto utf16CharsPerSecond = measure([&]() { stateMachine.ProcessString(text); });
+    const auto utf8CharsPerSecond = measure([&]() { stateMachine.ProcessString(std::string_view{ utf8 }); });
+
+    VERIFY_ARE_EQUAL(0, si.GetTextBuffer().GetCursor().GetPosition().x);
+    Log::Comment(NoThrowString().Format(L"%.1fM chars/s from UTF-16, %.1fM chars/s from UTF-8", utf16CharsPerSecond, utf8CharsPerSecond));
+}
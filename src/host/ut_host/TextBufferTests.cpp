@@ -12,6 +12,7 @@
 
 #include "globals.h"
 #include "../buffer/out/textBuffer.hpp"
+#include "../buffer/out/search.h"
 
 #include "input.h"
 #include "_stream.h"
@@ -97,6 +98,10 @@ class TextBufferTests
     TEST_METHOD(TestGetLastNonSpaceCharacter);
 
     TEST_METHOD(TestIncrementCircularBuffer);
+    TEST_METHOD(TestColdScrollback);
+    TEST_METHOD(TestColdScrollbackAfterReflow);
+    TEST_METHOD(TestColdScrollbackAfterSearch);
+    TEST_METHOD(TestIncrementalSearch);
 
     TEST_METHOD(TestMixedRgbAndLegacyForeground);
     TEST_METHOD(TestMixedRgbAndLegacyBackground);
@@ -131,6 +136,9 @@ class TextBufferTests
 
     TEST_METHOD(ResizeTraditionalRotationPreservesHighUnicode);
     TEST_METHOD(ScrollBufferRotationPreservesHighUnicode);
+    TEST_METHOD(ScrollRowsRotatesRegion);
+    TEST_METHOD(RowsChangedSince);
+    TEST_METHOD(RowContentHashIgnoresUnusedAttributeBits);
 
     TEST_METHOD(ResizeTraditionalHighUnicodeRowRemoval);
     TEST_METHOD(ResizeTraditionalHighUnicodeColumnRemoval);
@@ -148,11 +156,19 @@ class TextBufferTests
 
     TEST_METHOD(GetTextRects);
     TEST_METHOD(GetPlainText);
+    TEST_METHOD(CopyInParallelChunks);
+    TEST_METHOD(CopyThroughput);
 
     TEST_METHOD(HyperlinkTrim);
     TEST_METHOD(NoHyperlinkTrim);
 
     TEST_METHOD(ReflowPromptRegions);
+    TEST_METHOD(MarkRowsFollowCircularBuffer);
+
+    TEST_METHOD(SnapshotRoundTrip);
+    TEST_METHOD(SnapshotRejectsCorruptData);
+
+    TEST_METHOD(AttributeCollectionWithoutScrolling);
 };
 
 void TextBufferTests::TestBufferCreate()
@@ -478,6 +494,201 @@ void TextBufferTests::TestIncrementCircularBuffer()
     }
 }
 
+void TextBufferTests::TestColdScrollback()
+{
+    // EnableColdScrollback() keeps viewportHeight+1024 rows hot, so the buffer needs to be a bit taller than that.
+    const til::size bufferSize{ 20, 1100 };
+    const TextAttribute attr{ 0x7f };
+    const TextAttribute otherAttr{ 0x1e };
+    TextBuffer buffer{ bufferSize, attr, 12, false, &_renderer };
+    buffer.EnableColdScrollback(10);
+
+    const auto coldRowCount = bufferSize.height - 10 - 1024;
+    const auto expectedText = [](til::CoordType y) {
+        // Every other row contains a wide glyph, which requires the PackedRow to store its char offsets.
+        auto text = fmt::format(L"row {}", y);
+        if (y & 1)
+        {
+            text.append(L"\u732B");
+        }
+        return text;
+    };
+
+    for (til::CoordType y = 0; y < bufferSize.height; ++y)
+    {
+        auto& row = buffer.GetMutableRowByOffset(y);
+        const auto text = expectedText(y);
+        RowWriteState state{ .text = text };
+        row.ReplaceText(state);
+        row.ReplaceAttributes(0, 3, otherAttr);
+        row.SetWrapForced(y % 3 == 0);
+    }
+
+    // After 200 rotations, the rows that were originally at y=200+ are now at y=0+.
+    // All of them passed the boundary of the cold region and must have been packed.
+    static constexpr til::CoordType rotations = 200;
+    for (auto i = 0; i < rotations; ++i)
+    {
+        buffer.IncrementCircularBuffer(attr);
+    }
+
+    for (til::CoordType y = 0; y < coldRowCount; ++y)
+    {
+        VERIFY_IS_TRUE(buffer._isPackedRow(buffer._getRowOffset(y)));
+    }
+    VERIFY_IS_FALSE(buffer._isPackedRow(buffer._getRowOffset(coldRowCount)));
+    VERIFY_IS_GREATER_THAN(buffer.GetColdScrollbackMemoryUsage(), 0u);
+
+    for (til::CoordType y = 0; y < coldRowCount; ++y)
+    {
+        const auto originalY = y + rotations;
+        const auto& row = buffer.GetRowByOffset(y);
+        VERIFY_IS_FALSE(buffer._isPackedRow(buffer._getRowOffset(y)));
+
+        const auto text = expectedText(originalY);
+        VERIFY_ARE_EQUAL(text, row.GetText().substr(0, text.size()));
+        VERIFY_ARE_EQUAL(std::wstring_view::npos, row.GetText().find_first_not_of(L' ', text.size()));
+        VERIFY_ARE_EQUAL(otherAttr, row.GetAttrByColumn(2));
+        VERIFY_ARE_EQUAL(attr, row.GetAttrByColumn(3));
+        VERIFY_ARE_EQUAL(originalY % 3 == 0, row.WasWrapForced());
+    }
+}
+
+void TextBufferTests::TestColdScrollbackAfterReflow()
+{
+    const til::size bufferSize{ 20, 1100 };
+    const TextAttribute attr{ 0x7f };
+
+    const auto countPackedRows = [](const TextBuffer& buffer) {
+        til::CoordType count = 0;
+        for (til::CoordType y = 0; y < buffer.GetSize().Height(); ++y)
+        {
+            count += buffer._isPackedRow(buffer._getRowOffset(y)) ? 1 : 0;
+        }
+        return count;
+    };
+
+    TextBuffer oldBuffer{ bufferSize, attr, 12, false, &_renderer };
+    for (til::CoordType y = 0; y < bufferSize.height; ++y)
+    {
+        const auto text = fmt::format(L"row {}", y);
+        RowWriteState state{ .text = text };
+        oldBuffer.GetMutableRowByOffset(y).ReplaceText(state);
+    }
+
+    Log::Comment(L"Reflow() must pack the entire cold region of the new buffer, not just the rows that rotate into it.");
+    TextBuffer newBuffer{ { 30, bufferSize.height }, attr, 12, false, &_renderer };
+    newBuffer.EnableColdScrollback(10);
+    TextBuffer::Reflow(oldBuffer, newBuffer);
+    VERIFY_ARE_EQUAL(bufferSize.height - 10 - 1024, countPackedRows(newBuffer));
+    VERIFY_ARE_EQUAL(L"row 0", newBuffer.GetRowByOffset(0).GetText().substr(0, 5));
+
+    Log::Comment(L"Growing the cold region packs the rows that just became cold.");
+    newBuffer.EnableColdScrollback(5);
+    VERIFY_ARE_EQUAL(bufferSize.height - 5 - 1024, countPackedRows(newBuffer));
+
+    Log::Comment(L"ResizeTraditional() must do the same.");
+    newBuffer.ResizeTraditional({ 40, bufferSize.height });
+    VERIFY_ARE_EQUAL(bufferSize.height - 5 - 1024, countPackedRows(newBuffer));
+    VERIFY_ARE_EQUAL(L"row 1", newBuffer.GetRowByOffset(1).GetText().substr(0, 5));
+}
+
+void TextBufferTests::TestColdScrollbackAfterSearch()
+{
+    // The cold region needs to be a lot larger than the budget of unpacked rows.
+    const til::size bufferSize{ 20, 4000 };
+    const TextAttribute attr{ 0x7f };
+    TextBuffer buffer{ bufferSize, attr, 12, false, &_renderer };
+
+    for (til::CoordType y = 0; y < bufferSize.height; ++y)
+    {
+        const auto text = fmt::format(L"row {}", y);
+        RowWriteState state{ .text = text };
+        buffer.GetMutableRowByOffset(y).ReplaceText(state);
+    }
+
+    buffer.EnableColdScrollback(10);
+    const auto coldRowCount = bufferSize.height - 10 - 1024;
+
+    const auto countUnpackedColdRows = [&]() {
+        til::CoordType count = 0;
+        for (til::CoordType y = 0; y < coldRowCount; ++y)
+        {
+            count += buffer._isPackedRow(buffer._getRowOffset(y)) ? 0 : 1;
+        }
+        return gsl::narrow_cast<size_t>(count);
+    };
+
+    VERIFY_ARE_EQUAL(0u, countUnpackedColdRows());
+
+    Log::Comment(L"Searching the entire buffer accesses every row, but mustn't leave all of them unpacked.");
+    const auto results = buffer.SearchText(L"row", SearchFlag::None);
+    VERIFY_IS_TRUE(results.has_value());
+    VERIFY_ARE_EQUAL(gsl::narrow_cast<size_t>(bufferSize.height), results->size());
+    VERIFY_IS_LESS_THAN_OR_EQUAL(countUnpackedColdRows(), TextBuffer::_unpackedColdRowBudget);
+    VERIFY_IS_LESS_THAN_OR_EQUAL(buffer._unpackedColdRows.size(), TextBuffer::_unpackedColdRowBudget);
+
+    Log::Comment(L"The rows that were packed again are still intact.");
+    VERIFY_ARE_EQUAL(L"row 0", buffer.GetRowByOffset(0).GetText().substr(0, 5));
+    VERIFY_ARE_EQUAL(L"row 1", buffer.GetRowByOffset(1).GetText().substr(0, 5));
+}
+
+void TextBufferTests::TestIncrementalSearch()
+{
+    const til::size bufferSize{ 20, 50 };
+    const TextAttribute attr{ 0x7f };
+    TextBuffer buffer{ bufferSize, attr, 12, false, &_renderer };
+
+    const auto writeRow = [&](til::CoordType y, const std::wstring& text, bool wrap) {
+        auto& row = buffer.GetMutableRowByOffset(y);
+        row.Reset(attr);
+        RowWriteState state{ .text = text };
+        row.ReplaceText(state);
+        row.SetWrapForced(wrap);
+    };
+
+    for (til::CoordType y = 0; y < bufferSize.height; ++y)
+    {
+        writeRow(y, fmt::format(L"row {}", y), y % 4 == 0);
+    }
+
+    const auto verifySearch = [&](TextBuffer::SearchCache& cache) {
+        const auto expected = buffer.SearchText(L"row 1", SearchFlag::None);
+        const auto actual = buffer.SearchText(L"row 1", SearchFlag::None, cache);
+        VERIFY_IS_TRUE(expected.has_value());
+        VERIFY_IS_TRUE(actual.has_value());
+        VERIFY_ARE_EQUAL(expected->size(), actual->size());
+        for (size_t i = 0; i < expected->size(); ++i)
+        {
+            VERIFY_ARE_EQUAL(expected->at(i).start, actual->at(i).start);
+            VERIFY_ARE_EQUAL(expected->at(i).end, actual->at(i).end);
+        }
+        VERIFY_ARE_EQUAL(buffer.GetLastMutationId(), cache.mutationId);
+    };
+
+    TextBuffer::SearchCache cache;
+    verifySearch(cache);
+    const auto initialLineCount = cache.lines.size();
+    VERIFY_IS_LESS_THAN(initialLineCount, gsl::narrow_cast<size_t>(bufferSize.height));
+
+    // Modify a row in the middle of the buffer, add a match to a wrapped line, and scroll some new rows in.
+    writeRow(5, L"row 1 again", false);
+    writeRow(8, L"row 8", true);
+    writeRow(9, L"row 10", false);
+    for (til::CoordType i = 0; i < 3; ++i)
+    {
+        buffer.IncrementCircularBuffer(attr);
+        writeRow(bufferSize.height - 1, fmt::format(L"row 1{}", i), false);
+    }
+    verifySearch(cache);
+
+    // Searching an unmodified buffer again must yield the same results.
+    verifySearch(cache);
+
+    // An invalid regular expression must fail with and without a cache.
+    VERIFY_IS_FALSE(buffer.SearchText(L"(", SearchFlag::RegularExpression, cache).has_value());
+}
+
 void TextBufferTests::TestMixedRgbAndLegacyForeground()
 {
     auto& gci = ServiceLocator::LocateGlobals().getConsoleInformation();
@@ -1704,6 +1915,151 @@ void TextBufferTests::ScrollBufferRotationPreservesHighUnicode()
     VERIFY_ARE_EQUAL(String(fire), String(shouldBeFireText.data(), gsl::narrow<int>(shouldBeFireText.size())));
 }
 
+// Scrolling a region by less than its height rotates the rows instead of copying them.
+// The rows left behind by the scroll must still retain their original contents.
+void TextBufferTests::ScrollRowsRotatesRegion()
+{
+    TextBuffer tb{ { 10, 8 }, TextAttribute{}, 0, false, &_renderer };
+    const auto text = [&](til::CoordType y) {
+        return std::wstring{ tb.GetRowByOffset(y).GetText().substr(0, 1) };
+    };
+    const auto texts = [&]() {
+        std::wstring result;
+        for (auto y = 0; y < 8; ++y)
+        {
+            result.append(text(y));
+        }
+        return result;
+    };
+
+    for (auto y = 0; y < 8; ++y)
+    {
+        const auto ch = gsl::narrow_cast<wchar_t>(L'a' + y);
+        tb.GetMutableRowByOffset(y).ReplaceCharacters(0, 1, { &ch, 1 });
+    }
+    tb.SetScrollbarData(ScrollbarData{ .category = MarkCategory::Prompt }, 3);
+
+    Log::Comment(L"Scrolling rows 2-6 up by 1 leaves row 6 behind unchanged.");
+    const auto generation = tb.GetRowGeneration(4);
+    tb.ScrollRows(2, 5, -1);
+    VERIFY_ARE_EQUAL(std::wstring{ L"acdefggh" }, texts());
+    VERIFY_ARE_EQUAL(generation, tb.GetRowGeneration(3));
+    VERIFY_ARE_EQUAL(size_t{ 1 }, tb.GetMarkRows().size());
+    VERIFY_ARE_EQUAL(2, tb.GetMarkRows()[0].row);
+
+    Log::Comment(L"Scrolling rows 1-4 down by 2 leaves rows 1-2 behind unchanged.");
+    tb.ScrollRows(1, 4, 2);
+    VERIFY_ARE_EQUAL(std::wstring{ L"acdcdefh" }, texts());
+    VERIFY_ARE_EQUAL(size_t{ 1 }, tb.GetMarkRows().size());
+    VERIFY_ARE_EQUAL(4, tb.GetMarkRows()[0].row);
+
+    Log::Comment(L"The rotated rows must stay in place when the circular buffer rotates.");
+    tb.IncrementCircularBuffer(TextAttribute{});
+    VERIFY_ARE_EQUAL(std::wstring{ L"cdcdefh " }, texts());
+    VERIFY_ARE_EQUAL(3, tb.GetMarkRows()[0].row);
+
+    Log::Comment(L"The rotation also works across the end of the underlying storage.");
+    tb.ScrollRows(6, 2, -1);
+    VERIFY_ARE_EQUAL(std::wstring{ L"cdcdeh  " }, texts());
+
+    Log::Comment(L"Rows that the caller erases anyway aren't copied and the rotation is journaled as a single entry.");
+    tb.SetScrollbarData(ScrollbarData{ .category = MarkCategory::Prompt }, 5);
+    tb.SetScrollbarData(ScrollbarData{ .category = MarkCategory::Prompt }, 7);
+    const auto mutationId = tb.GetLastMutationId();
+    const auto journalSize = tb._changeJournal.size();
+    tb.ScrollRows(2, 4, -2, false);
+    VERIFY_ARE_EQUAL(std::wstring{ L"cdehcd  " }, texts());
+    VERIFY_ARE_EQUAL(journalSize + 1, tb._changeJournal.size());
+    VERIFY_ARE_EQUAL((std::vector<til::CoordType>{ 0, 1, 2, 3, 4, 5 }), tb.GetRowsChangedSince(mutationId).rows);
+
+    Log::Comment(L"The marks stay ordered, including the one past the end of the underlying storage.");
+    const auto marks = tb.GetMarkRows();
+    VERIFY_ARE_EQUAL(size_t{ 3 }, marks.size());
+    VERIFY_ARE_EQUAL(1, marks[0].row);
+    VERIFY_ARE_EQUAL(3, marks[1].row);
+    VERIFY_ARE_EQUAL(7, marks[2].row);
+}
+
+void TextBufferTests::RowsChangedSince()
+{
+    TextBuffer tb{ { 10, 8 }, TextAttribute{}, 0, false, &_renderer };
+    using Rows = std::vector<til::CoordType>;
+
+    Log::Comment(L"Generations from before the buffer existed can't be answered.");
+    auto changes = tb.GetRowsChangedSince(0);
+    VERIFY_IS_TRUE(changes.all);
+    VERIFY_ARE_EQUAL(tb.GetLastMutationId(), changes.generation);
+
+    Log::Comment(L"Each modified row is reported once, in ascending order.");
+    tb.GetMutableRowByOffset(5);
+    tb.GetMutableRowByOffset(2);
+    tb.GetMutableRowByOffset(5);
+    auto previous = changes;
+    changes = tb.GetRowsChangedSince(previous.generation);
+    VERIFY_IS_FALSE(changes.all);
+    VERIFY_ARE_EQUAL((Rows{ 2, 5 }), changes.rows);
+
+    Log::Comment(L"Nothing changed since the last query.");
+    previous = changes;
+    changes = tb.GetRowsChangedSince(previous.generation);
+    VERIFY_IS_TRUE(changes.rows.empty());
+
+    Log::Comment(L"Rows are reported at their current index after the buffer scrolled.");
+    previous = changes;
+    tb.GetMutableRowByOffset(3);
+    tb.IncrementCircularBuffer(TextAttribute{});
+    changes = tb.GetRowsChangedSince(previous.generation);
+    VERIFY_ARE_EQUAL((Rows{ 2, 7 }), changes.rows);
+    VERIFY_ARE_EQUAL(previous.scrollCount + 1, changes.scrollCount);
+
+    Log::Comment(L"Rows moved by ScrollRows() count as changed.");
+    previous = changes;
+    const auto scrollGeneration = previous.generation;
+    tb.ScrollRows(1, 2, 1);
+    changes = tb.GetRowsChangedSince(previous.generation);
+    VERIFY_ARE_EQUAL((Rows{ 1, 2, 3 }), changes.rows);
+
+    Log::Comment(L"The journal retains all rows even after it was compacted.");
+    previous = changes;
+    for (auto i = 0; i < 100; ++i)
+    {
+        tb.GetMutableRowByOffset(i % 2 ? 6 : 4);
+    }
+    changes = tb.GetRowsChangedSince(previous.generation);
+    VERIFY_ARE_EQUAL((Rows{ 4, 6 }), changes.rows);
+    VERIFY_ARE_EQUAL((Rows{ 1, 2, 3, 4, 6 }), tb.GetRowsChangedSince(scrollGeneration).rows);
+
+    Log::Comment(L"Resizing replaces all rows.");
+    previous = changes;
+    tb.ResizeTraditional({ 12, 8 });
+    changes = tb.GetRowsChangedSince(previous.generation);
+    VERIFY_IS_TRUE(changes.all);
+    VERIFY_IS_FALSE(tb.GetRowsChangedSince(changes.generation).all);
+}
+
+void TextBufferTests::RowContentHashIgnoresUnusedAttributeBits()
+{
+    TextBuffer tb{ { 10, 3 }, TextAttribute{}, 0, false, &_renderer };
+    TextAttribute attr{ RGB(1, 2, 3), RGB(4, 5, 6) };
+    attr.SetUnderlineColor(TextColor{ 7, true });
+    attr.SetHyperlinkId(1);
+
+    auto other = attr;
+    other.SetCharacterAttributes(attr.GetCharacterAttributes() | CharacterAttributes::Unused1);
+    other.SetMarkAttributes(MarkKind::Output);
+
+    tb.GetMutableRowByOffset(0).SetAttrToEnd(0, attr);
+    tb.GetMutableRowByOffset(1).SetAttrToEnd(0, other);
+    Log::Comment(L"Rows that render the same have the same hash.");
+    VERIFY_ARE_EQUAL(tb.GetRowByOffset(0).GetContentHash(), tb.GetRowByOffset(1).GetContentHash());
+
+    other = attr;
+    other.SetUnderlineColor(TextColor{ 8, true });
+    tb.GetMutableRowByOffset(2).SetAttrToEnd(0, other);
+    Log::Comment(L"A different underline color changes the hash.");
+    VERIFY_ARE_NOT_EQUAL(tb.GetRowByOffset(0).GetContentHash(), tb.GetRowByOffset(2).GetContentHash());
+}
+
 // This tests that rows removed from the buffer while resizing traditionally will also drop the high unicode
 // characters from the Unicode Storage buffer
 void TextBufferTests::ResizeTraditionalHighUnicodeRowRemoval()
@@ -2694,6 +3050,91 @@ void TextBufferTests::GetPlainText()
     }
 }
 
+// Fills the first `rows` rows of the buffer with text in a different color every 30 columns.
+static void _writeColoredRows(TextBuffer& buffer, til::CoordType rows)
+{
+    const auto width = buffer.GetSize().Width();
+    for (til::CoordType y = 0; y < rows; ++y)
+    {
+        auto& row = buffer.GetMutableRowByOffset(y);
+        const auto text = fmt::format(FMT_COMPILE(L"row {} <&> {{\\}} \u732B"), y);
+        RowWriteState state{ .text = text };
+        row.ReplaceText(state);
+        for (til::CoordType x = 0; x < width; x += 30)
+        {
+            row.ReplaceAttributes(x, std::min(x + 30, width), TextAttribute{ gsl::narrow_cast<WORD>((x / 30 + y) % 256) });
+        }
+        row.SetWrapForced(y % 5 == 4);
+    }
+}
+
+static std::tuple<COLORREF, COLORREF, COLORREF> _copyAttributeColors(const TextAttribute& attr)
+{
+    const auto legacy = attr.GetLegacyAttributes();
+    return { RGB(legacy & 0xf, 0, 0), RGB(0, legacy >> 4, 0), RGB(0, 0, legacy) };
+}
+
+void TextBufferTests::CopyInParallelChunks()
+{
+    // Selections are formatted in chunks of 1024 rows in parallel.
+    // The result must not depend on how the rows are split up.
+    static constexpr til::CoordType rows = 3000;
+
+    TextBuffer buffer{ { 40, rows }, TextAttribute{}, 0, false, &_renderer };
+    _writeColoredRows(buffer, rows);
+
+    const TextBuffer::CopyRequest req{ buffer, { 0, 0 }, { 39, rows - 1 }, false, true, true, false };
+
+    std::wstring expectedText;
+    for (til::CoordType y = 0; y < rows; ++y)
+    {
+        const TextBuffer::CopyRequest rowReq{ buffer, { 0, y }, { 39, y }, false, true, true, false };
+        expectedText += buffer.GetPlainText(rowReq);
+        if (y != rows - 1 && !buffer.GetRowByOffset(y).WasWrapForced())
+        {
+            expectedText += L"\r\n";
+        }
+    }
+
+    const auto text = buffer.GetPlainText(req);
+    VERIFY_ARE_EQUAL(expectedText, text);
+
+    const auto html = buffer.GenHTML(req, 12, L"Consolas", RGB(1, 2, 3), true, _copyAttributeColors);
+    VERIFY_IS_TRUE(html.find(fmt::format(FMT_COMPILE("EndHTML:{:0>10}\r\n"), html.size())) != std::string::npos);
+    VERIFY_IS_TRUE(html.find("row 2999 &lt;&amp;&gt;") != std::string::npos);
+
+    const auto rtf = buffer.GenRTF(req, 12, L"Consolas", RGB(1, 2, 3), true, _copyAttributeColors);
+    // The background color is always the first entry in the color table.
+    VERIFY_IS_TRUE(rtf.starts_with("{\\rtf1"));
+    VERIFY_IS_TRUE(rtf.find("{\\colortbl ;\\red1\\green2\\blue3;") != std::string::npos);
+    VERIFY_IS_TRUE(rtf.find("row 2999 <&> \\{\\\\\\}") != std::string::npos);
+    VERIFY_IS_TRUE(rtf.ends_with("}"));
+}
+
+// Not a test per se, but a benchmark for copying a large selection in all clipboard formats.
+void TextBufferTests::CopyThroughput()
+{
+    static constexpr til::CoordType rows = 100000;
+    static constexpr til::CoordType columns = 120;
+
+    TextBuffer buffer{ { columns, rows }, TextAttribute{}, 0, false, &_renderer };
+    _writeColoredRows(buffer, rows);
+
+    const TextBuffer::CopyRequest req{ buffer, { 0, 0 }, { columns - 1, rows - 1 }, false, true, true, false };
+
+    const auto measure = [&](const wchar_t* format, auto&& copy) {
+        const auto start = std::chrono::steady_clock::now();
+        const auto size = copy();
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        VERIFY_IS_GREATER_THAN(size, size_t{ 0 });
+        Log::Comment(NoThrowString().Format(L"%s: %d rows in %.1fms (%zu bytes)", format, rows, elapsed * 1000, size));
+    };
+
+    measure(L"Plain text", [&]() { return buffer.GetPlainText(req).size() * sizeof(wchar_t); });
+    measure(L"HTML", [&]() { return buffer.GenHTML(req, 12, L"Consolas", RGB(0, 0, 0), true, _copyAttributeColors).size(); });
+    measure(L"RTF", [&]() { return buffer.GenRTF(req, 12, L"Consolas", RGB(0, 0, 0), true, _copyAttributeColors).size(); });
+}
+
 // This tests that when we increment the circular buffer, obsolete hyperlink references
 // are removed from the hyperlink map
 void TextBufferTests::HyperlinkTrim()
@@ -2900,3 +3341,211 @@ void TextBufferTests::ReflowPromptRegions()
     Log::Comment(L"========== Checking the host buffer state (after) ==========");
     verifyBuffer(*newBuffer, si.GetViewport().ToExclusive(), false, true);
 }
+
+void TextBufferTests::MarkRowsFollowCircularBuffer()
+{
+    TextBuffer tb{ { 10, 5 }, TextAttribute{}, 0, false, &_renderer };
+    const auto markRows = [&]() {
+        std::vector<til::CoordType> rows;
+        for (const auto& mark : tb.GetMarkRows())
+        {
+            rows.emplace_back(mark.row);
+        }
+        return rows;
+    };
+
+    for (auto y = 0; y < 5; y++)
+    {
+        tb.GetMutableRowByOffset(y).ReplaceCharacters(0, 1, L"x");
+    }
+    tb.SetScrollbarData(ScrollbarData{ .category = MarkCategory::Prompt }, 3);
+    tb.SetScrollbarData(ScrollbarData{ .category = MarkCategory::Prompt }, 1);
+    VERIFY_ARE_EQUAL((std::vector<til::CoordType>{ 1, 3 }), markRows());
+
+    Log::Comment(L"Marks move up with their rows and disappear once they're scrolled out of the buffer.");
+    tb.IncrementCircularBuffer(TextAttribute{});
+    VERIFY_ARE_EQUAL((std::vector<til::CoordType>{ 0, 2 }), markRows());
+    tb.IncrementCircularBuffer(TextAttribute{});
+    VERIFY_ARE_EQUAL((std::vector<til::CoordType>{ 1 }), markRows());
+
+    Log::Comment(L"The order must be preserved when the marks wrap around the end of the underlying storage.");
+    tb.SetScrollbarData(ScrollbarData{ .category = MarkCategory::Prompt }, 4);
+    tb.SetScrollbarData(ScrollbarData{ .category = MarkCategory::Prompt }, 0);
+    VERIFY_ARE_EQUAL((std::vector<til::CoordType>{ 0, 1, 4 }), markRows());
+
+    Log::Comment(L"Resetting a row removes its mark.");
+    tb.GetMutableRowByOffset(1).Reset(TextAttribute{});
+    VERIFY_ARE_EQUAL((std::vector<til::CoordType>{ 0, 4 }), markRows());
+
+    tb.ClearAllMarks();
+    VERIFY_IS_TRUE(markRows().empty());
+}
+
+static std::vector<std::byte> _serializeSnapshot(const TextBuffer& tb)
+{
+    wchar_t directory[MAX_PATH];
+    wchar_t path[MAX_PATH];
+    VERIFY_IS_TRUE(GetTempPathW(MAX_PATH, &directory[0]) != 0);
+    VERIFY_IS_TRUE(GetTempFileNameW(&directory[0], L"tbs", 0, &path[0]) != 0);
+    const auto cleanup = wil::scope_exit([&]() { DeleteFileW(&path[0]); });
+
+    tb.SerializeSnapshot(&path[0]);
+
+    const wil::unique_handle file{ CreateFileW(&path[0], GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+    VERIFY_IS_TRUE(static_cast<bool>(file));
+    LARGE_INTEGER size{};
+    VERIFY_WIN32_BOOL_SUCCEEDED(GetFileSizeEx(file.get(), &size));
+
+    std::vector<std::byte> data(gsl::narrow<size_t>(size.QuadPart));
+    DWORD read = 0;
+    VERIFY_WIN32_BOOL_SUCCEEDED(ReadFile(file.get(), data.data(), gsl::narrow<DWORD>(data.size()), &read, nullptr));
+    VERIFY_ARE_EQUAL(data.size(), size_t{ read });
+    return data;
+}
+
+void TextBufferTests::SnapshotRoundTrip()
+{
+    TextBuffer tb{ { 10, 6 }, TextAttribute{}, 0, false, &_renderer };
+    const auto write = [&](til::CoordType y, til::CoordType x, std::wstring_view text) {
+        RowWriteState state{ .text = text, .columnBegin = x };
+        tb.GetMutableRowByOffset(y).ReplaceText(state);
+    };
+
+    TextAttribute red;
+    red.SetForeground(TextColor{ RGB(255, 0, 0) });
+    TextAttribute link;
+    link.SetHyperlinkId(tb.GetHyperlinkId(L"https://example.com", L"custom"));
+    tb.AddHyperlinkToMap(L"https://example.com", link.GetHyperlinkId());
+
+    write(0, 0, L"hello");
+    tb.GetMutableRowByOffset(0).ReplaceAttributes(0, 5, red);
+    tb.GetMutableRowByOffset(0).SetWrapForced(true);
+    write(1, 0, L"\u304b\U0001F600!");
+    write(2, 3, L"link");
+    tb.GetMutableRowByOffset(2).ReplaceAttributes(3, 7, link);
+    tb.SetScrollbarData(ScrollbarData{ .category = MarkCategory::Prompt, .color = til::color{ 0x11, 0x22, 0x33 }, .exitCode = 1 }, 2);
+    tb.GetMutableRowByOffset(3).SetImageSlice(std::make_unique<ImageSlice>(til::size{ 4, 2 }))->MutablePixels(1, 3)[5] = RGBQUAD{ 1, 2, 3, 4 };
+    tb.GetCursor().SetPosition({ 4, 4 });
+
+    const auto data = _serializeSnapshot(tb);
+    VERIFY_IS_TRUE(TextBuffer::IsSnapshot(data));
+    const auto restored = TextBuffer::FromSnapshot(data, &_renderer);
+
+    VERIFY_ARE_EQUAL((til::size{ 10, 5 }), restored->GetSize().Dimensions());
+    VERIFY_ARE_EQUAL((til::point{ 4, 4 }), restored->GetCursor().GetPosition());
+
+    for (til::CoordType y = 0; y < 5; y++)
+    {
+        const auto& expected = tb.GetRowByOffset(y);
+        const auto& actual = restored->GetRowByOffset(y);
+        VERIFY_ARE_EQUAL(expected.GetText(), actual.GetText());
+        VERIFY_ARE_EQUAL(expected.WasWrapForced(), actual.WasWrapForced());
+        for (til::CoordType x = 0; x < 10; x++)
+        {
+            VERIFY_ARE_EQUAL(expected.GlyphAt(x), actual.GlyphAt(x));
+            VERIFY_ARE_EQUAL(expected.GetAttrByColumn(x), actual.GetAttrByColumn(x));
+        }
+    }
+
+    VERIFY_ARE_EQUAL(L"https://example.com", restored->GetHyperlinkUriFromId(link.GetHyperlinkId()));
+    VERIFY_ARE_EQUAL(link.GetHyperlinkId(), restored->GetHyperlinkId(L"https://example.com", L"custom"));
+
+    const auto marks = restored->GetMarkRows();
+    VERIFY_ARE_EQUAL(1u, marks.size());
+    VERIFY_ARE_EQUAL(2, marks[0].row);
+    VERIFY_IS_TRUE(marks[0].data.category == MarkCategory::Prompt);
+    VERIFY_ARE_EQUAL(til::color{ 0x11, 0x22, 0x33 }, marks[0].data.color.value());
+    VERIFY_ARE_EQUAL(1u, marks[0].data.exitCode.value());
+
+    const auto image = restored->GetRowByOffset(3).GetImageSlice();
+    VERIFY_IS_NOT_NULL(image);
+    VERIFY_ARE_EQUAL(1, image->ColumnOffset());
+    VERIFY_ARE_EQUAL(3, image->ColumnEnd());
+    VERIFY_ARE_EQUAL(BYTE{ 1 }, image->Pixels()[5].rgbBlue);
+}
+
+void TextBufferTests::SnapshotRejectsCorruptData()
+{
+    TextBuffer tb{ { 10, 3 }, TextAttribute{}, 0, false, &_renderer };
+    TextAttribute attr;
+    attr.SetForeground(TextColor{ RGB(0x12, 0x34, 0x56) });
+    tb.GetMutableRowByOffset(0).ReplaceCharacters(0, 2, L"\u304b");
+    tb.GetMutableRowByOffset(2).ReplaceCharacters(0, 1, L"x");
+    tb.GetMutableRowByOffset(2).ReplaceAttributes(0, 1, attr);
+    const auto data = _serializeSnapshot(tb);
+
+    Log::Comment(L"Every truncation of the snapshot must be rejected.");
+    for (size_t size = 0; size < data.size(); size++)
+    {
+        VERIFY_THROWS(TextBuffer::FromSnapshot({ data.data(), size }, &_renderer), wil::ResultException);
+    }
+
+    // The attribute table is the only place where the snapshot contains attributes as is.
+    const auto attrBytes = std::as_bytes(std::span{ &attr, 1 });
+    const auto attrOffset = gsl::narrow_cast<size_t>(std::ranges::search(data, attrBytes).begin() - data.begin());
+    VERIFY_IS_LESS_THAN(attrOffset, data.size());
+
+    const auto withAttribute = [&](const TextAttribute& replacement) {
+        auto copy = data;
+        memcpy(copy.data() + attrOffset, &replacement, sizeof(replacement));
+        return copy;
+    };
+
+    Log::Comment(L"Attributes that TextAttribute can't represent must be rejected.");
+    {
+        auto invalid = attr;
+        invalid._foreground._meta = static_cast<ColorType>(4);
+        VERIFY_THROWS(TextBuffer::FromSnapshot(withAttribute(invalid), &_renderer), wil::ResultException);
+    }
+    {
+        auto invalid = attr;
+        invalid.SetBackground(TextColor{ 16, false });
+        VERIFY_THROWS(TextBuffer::FromSnapshot(withAttribute(invalid), &_renderer), wil::ResultException);
+    }
+    {
+        auto invalid = attr;
+        invalid.SetCharacterAttributes(static_cast<CharacterAttributes>(7 << UNDERLINE_STYLE_SHIFT));
+        VERIFY_THROWS(TextBuffer::FromSnapshot(withAttribute(invalid), &_renderer), wil::ResultException);
+    }
+    {
+        auto invalid = attr;
+        invalid.SetMarkAttributes(static_cast<MarkKind>(4));
+        VERIFY_THROWS(TextBuffer::FromSnapshot(withAttribute(invalid), &_renderer), wil::ResultException);
+    }
+
+    Log::Comment(L"Hyperlink ids that aren't in the hyperlink map are dropped.");
+    {
+        auto stale = attr;
+        stale.SetHyperlinkId(1234);
+        const auto restored = TextBuffer::FromSnapshot(withAttribute(stale), &_renderer);
+        VERIFY_ARE_EQUAL(attr, restored->GetRowByOffset(2).GetAttrByColumn(0));
+    }
+
+    Log::Comment(L"A VT buffer dump isn't a snapshot.");
+    static constexpr wchar_t vt[] = L"\uFEFFhello\r\n";
+    VERIFY_IS_FALSE(TextBuffer::IsSnapshot(std::as_bytes(std::span{ vt })));
+}
+
+void TextBufferTests::AttributeCollectionWithoutScrolling()
+{
+    // A buffer that never scrolls (like the alternate screen of a TUI) must still collect unused
+    // attribute ids, because otherwise it runs out of them and new attributes turn into the default ones.
+    TextBuffer tb{ { 4, 2 }, TextAttribute{}, 0, false, &_renderer };
+    auto& row = tb.GetMutableRowByOffset(0);
+
+    Log::Comment(L"Repeatedly overwrite the same cell with more distinct attributes than the table can hold.");
+    const auto count = TextAttributeTable::MaxSize + 4096;
+    for (size_t i = 0; i < count; i++)
+    {
+        TextAttribute attr;
+        attr.SetForeground(TextColor{ gsl::narrow_cast<COLORREF>(i) });
+        row.ReplaceAttributes(0, 1, attr);
+
+        if (row.GetAttrByColumn(0) != attr)
+        {
+            VERIFY_FAIL(NoThrowString().Format(L"attribute %zu didn't round-trip", i));
+        }
+    }
+
+    VERIFY_IS_LESS_THAN(tb.GetAttributeTable().Size(), TextAttributeTable::MaxSize);
+}
@@ -113,6 +113,111 @@ class ::Microsoft::Console::VirtualTerminal::VtIoTests
         VERIFY_ARE_EQUAL(expected, actual);
     }
 
+    TEST_METHOD(CoalescedOutput)
+    {
+        auto& vtIo = *ServiceLocator::LocateGlobals().getConsoleInformation().GetVtIo();
+        resetContents();
+        readOutput();
+
+        // The latency never expires during the test, so only maxBytes and Flush() send the output.
+        vtIo.SetCoalescingPolicy({ .maxBytes = 16, .maxLatency = std::chrono::hours{ 1 } });
+        const auto cleanup = wil::scope_exit([&]() {
+            vtIo.SetCoalescingPolicy({});
+        });
+        const auto before = vtIo.GetFlushStats();
+
+        THROW_IF_FAILED(routines.SetConsoleCursorPositionImpl(*screenInfo, { 2, 3 }));
+        THROW_IF_FAILED(routines.SetConsoleCursorPositionImpl(*screenInfo, { 0, 0 }));
+        VERIFY_IS_TRUE(readOutput().empty());
+
+        // The third CUP exceeds maxBytes and all three are sent at once.
+        THROW_IF_FAILED(routines.SetConsoleCursorPositionImpl(*screenInfo, { 7, 3 }));
+        auto expected = cup(4, 3) cup(1, 1) cup(4, 8);
+        auto actual = readOutput();
+        VERIFY_ARE_EQUAL(expected, actual);
+
+        THROW_IF_FAILED(routines.SetConsoleCursorPositionImpl(*screenInfo, { 3, 2 }));
+        VERIFY_IS_TRUE(readOutput().empty());
+        vtIo.Flush();
+        expected = cup(3, 4);
+        actual = readOutput();
+        VERIFY_ARE_EQUAL(expected, actual);
+
+        const auto after = vtIo.GetFlushStats();
+        VERIFY_ARE_EQUAL(uint64_t{ 2 }, after.flushes - before.flushes);
+        VERIFY_ARE_EQUAL(uint64_t{ 24 }, after.bytes - before.bytes);
+    }
+
+    TEST_METHOD(CoalescedOutputFlushesWhenIdle)
+    {
+        auto& vtIo = *ServiceLocator::LocateGlobals().getConsoleInformation().GetVtIo();
+        resetContents();
+        readOutput();
+
+        // The idle flush waits for the latency to expire, so it needs to be short enough for the test,
+        // but long enough that the held back output can be observed before that.
+        vtIo.SetCoalescingPolicy({ .maxBytes = 1024, .maxLatency = std::chrono::milliseconds{ 100 } });
+        const auto cleanup = wil::scope_exit([&]() {
+            vtIo.NotifyIoThreadIdle(false);
+            vtIo.SetCoalescingPolicy({});
+        });
+
+        Log::Comment(L"Output that's written while the IO thread is busy is held back until it's idle and the latency expired.");
+        THROW_IF_FAILED(routines.SetConsoleCursorPositionImpl(*screenInfo, { 2, 3 }));
+        VERIFY_IS_TRUE(readOutput().empty());
+        vtIo.NotifyIoThreadIdle(true);
+        WaitForThreadpoolWorkCallbacks(vtIo._idleFlushWork.get(), FALSE);
+        auto expected = cup(4, 3);
+        auto actual = readOutput();
+        VERIFY_ARE_EQUAL(expected, actual);
+
+        Log::Comment(L"Output that's written while the IO thread is idle, like the echo of a cooked read, is sent right away.");
+        THROW_IF_FAILED(routines.SetConsoleCursorPositionImpl(*screenInfo, { 0, 0 }));
+        expected = cup(1, 1);
+        actual = readOutput();
+        VERIFY_ARE_EQUAL(expected, actual);
+
+        Log::Comment(L"Disabling coalescing sends the output that's still held back.");
+        vtIo.NotifyIoThreadIdle(false);
+        THROW_IF_FAILED(routines.SetConsoleCursorPositionImpl(*screenInfo, { 7, 3 }));
+        VERIFY_IS_TRUE(readOutput().empty());
+        vtIo.SetCoalescingPolicy({});
+        expected = cup(4, 8);
+        actual = readOutput();
+        VERIFY_ARE_EQUAL(expected, actual);
+    }
+
+    TEST_METHOD(CoalescedOutputOfChattyClient)
+    {
+        auto& vtIo = *ServiceLocator::LocateGlobals().getConsoleInformation().GetVtIo();
+        resetContents();
+        readOutput();
+
+        vtIo.SetCoalescingPolicy({ .maxBytes = 1024, .maxLatency = std::chrono::milliseconds{ 100 } });
+        const auto cleanup = wil::scope_exit([&]() {
+            vtIo.NotifyIoThreadIdle(false);
+            vtIo.SetCoalescingPolicy({});
+        });
+        const auto before = vtIo.GetFlushStats();
+
+        Log::Comment(L"The IO thread briefly goes idle between the API calls of a client, which mustn't flush each call on its own.");
+        static constexpr til::CoordType calls = 16;
+        for (til::CoordType i = 0; i < calls; ++i)
+        {
+            vtIo.NotifyIoThreadIdle(false);
+            THROW_IF_FAILED(routines.SetConsoleCursorPositionImpl(*screenInfo, { 1 + i % 2, i % 3 }));
+            vtIo.NotifyIoThreadIdle(true);
+        }
+        WaitForThreadpoolWorkCallbacks(vtIo._idleFlushWork.get(), FALSE);
+
+        const auto actual = readOutput();
+        VERIFY_ARE_EQUAL(gsl::narrow_cast<size_t>(calls), gsl::narrow_cast<size_t>(std::ranges::count(actual, 'H')));
+
+        const auto after = vtIo.GetFlushStats();
+        VERIFY_IS_GREATER_THAN(after.flushes, before.flushes);
+        VERIFY_IS_LESS_THAN(after.flushes - before.flushes, uint64_t{ calls });
+    }
+
     TEST_METHOD(SetConsoleOutputMode)
     {
         const auto initialMode = screenInfo->OutputMode;
@@ -642,4 +642,95 @@ namespace til::spsc
         const auto arc = new details::arc<T>(capacity);
         return { std::piecewise_construct, std::forward_as_tuple(arc), std::forward_as_tuple(arc) };
     }
+
+    // pool_producer is the sending half of a pooled_channel().
+    template<typename T>
+    struct pool_producer
+    {
+        pool_producer(producer<std::span<T>> filled, consumer<std::span<T>> empty, std::shared_ptr<T[]> storage, size_t bufferSize) noexcept :
+            _filled(std::move(filled)),
+            _empty(std::move(empty)),
+            _storage(std::move(storage)),
+            _bufferSize(bufferSize) {}
+
+        // acquire returns an unused buffer for the producer to fill.
+        // If all buffers are in use, it blocks until the consumer recycled one,
+        // which makes a lagging consumer slow down the producer ("back-pressure").
+        // The returned span will be empty if the consumer is gone.
+        std::span<T> acquire() const
+        {
+            const auto buffer = _empty.pop();
+            return buffer ? std::span<T>{ buffer->data(), _bufferSize } : std::span<T>{};
+        }
+
+        // submit sends the first `size` items of a buffer returned by acquire() to the consumer.
+        // The return value will be false, if the consumer is gone.
+        bool submit(std::span<T> buffer, size_t size) const
+        {
+            return _filled.emplace(buffer.first(size));
+        }
+
+    private:
+        producer<std::span<T>> _filled;
+        consumer<std::span<T>> _empty;
+        std::shared_ptr<T[]> _storage;
+        size_t _bufferSize = 0;
+    };
+
+    // pool_consumer is the receiving half of a pooled_channel().
+    template<typename T>
+    struct pool_consumer
+    {
+        pool_consumer(consumer<std::span<T>> filled, producer<std::span<T>> empty, std::shared_ptr<T[]> storage) noexcept :
+            _filled(std::move(filled)),
+            _empty(std::move(empty)),
+            _storage(std::move(storage)) {}
+
+        // drain blocks until at least one buffer was submitted and then
+        // reads up to `count` of the submitted buffers into `buffers` without blocking.
+        // It returns the number of buffers read, which will be 0 if the producer is gone.
+        size_t drain(std::span<T>* buffers, size_t count) const
+        {
+            return _filled.pop_n(block_initially, buffers, count).first;
+        }
+
+        // recycle hands buffers returned by drain() back to the producer.
+        void recycle(const std::span<T>* buffers, size_t count) const
+        {
+            _empty.push_n(buffers, count);
+        }
+
+    private:
+        consumer<std::span<T>> _filled;
+        producer<std::span<T>> _empty;
+        std::shared_ptr<T[]> _storage;
+    };
+
+    // pooled_channel returns a single-producer, single-consumer channel of `buffers`-many
+    // buffers with `bufferSize` items each. The producer fills buffers and submits them
+    // and the consumer hands them back once it's done, which means that no memory is
+    // allocated after construction. The buffers are owned by both halves of the channel.
+    template<typename T>
+    std::pair<pool_producer<T>, pool_consumer<T>> pooled_channel(uint32_t buffers, size_t bufferSize)
+    {
+        if (bufferSize == 0)
+        {
+            throw std::invalid_argument{ "invalid buffer size" };
+        }
+
+        auto storage = std::make_shared_for_overwrite<T[]>(static_cast<size_t>(buffers) * bufferSize);
+        auto [filledTx, filledRx] = channel<std::span<T>>(buffers);
+        auto [emptyTx, emptyRx] = channel<std::span<T>>(buffers);
+
+        for (uint32_t i = 0; i < buffers; ++i)
+        {
+            emptyTx.emplace(storage.get() + i * bufferSize, bufferSize);
+        }
+
+        return {
+            std::piecewise_construct,
+            std::forward_as_tuple(std::move(filledTx), std::move(emptyRx), storage, bufferSize),
+            std::forward_as_tuple(std::move(filledRx), std::move(emptyTx), storage),
+        };
+    }
 }
@@ -66,6 +66,7 @@ const RegistrySerialization::_RegPropertyMap RegistrySerialization::s_PropertyMa
 #if TIL_FEATURE_CONHOSTATLASENGINE_ENABLED
     { _RegPropertyType::Boolean,        L"EnableBuiltinGlyphs",                         SET_FIELD_AND_SIZE(_fEnableBuiltinGlyphs)        },
 #endif
+    { _RegPropertyType::Boolean,        L"PersistHistory",                              SET_FIELD_AND_SIZE(_fPersistHistory)             },
 
     // Special cases that are handled manually in Registry::LoadFromRegistry:
     // - CONSOLE_REGISTRY_WINDOWPOS
@@ -69,6 +69,17 @@ try
         }
     }
 
+    if (_api.pendingCursor)
+    {
+        *_api.s.write()->cursor.write() = *_api.pendingCursor;
+        _api.pendingCursor.reset();
+    }
+    if (_api.pendingBackgroundColor)
+    {
+        _api.s.write()->misc.write()->backgroundColor = *_api.pendingBackgroundColor;
+        _api.pendingBackgroundColor.reset();
+    }
+
     if (_p.s != _api.s)
     {
         _handleSettingsUpdate();
@@ -132,6 +143,13 @@ try
     _p.scrollOffsetX = _api.viewportOffset.x;
     _p.scrollDeltaY = _api.scrollOffset;
 
+    _api.paintViewportOffset = _api.viewportOffset;
+    _api.paintCursorArea = _api.invalidatedCursorArea;
+    _api.paintBackgroundOpaqueMixin = _api.backgroundOpaqueMixin;
+    _api.invalidatedCursorArea = invalidatedAreaNone;
+    _api.invalidatedRows = invalidatedRowsNone;
+    _api.scrollOffset = 0;
+
     // This if condition serves 2 purposes:
     // * By setting top/bottom to the full height we ensure that we call Present() without
     //   any dirty rects and not Present1() on the first frame after the settings change.
@@ -267,7 +285,7 @@ try
 
     // PaintCursor() is only called when the cursor is visible, but we need to invalidate the cursor area
     // even if it isn't. Otherwise a transition from a visible to an invisible cursor wouldn't be rendered.
-    if (const auto r = _api.invalidatedCursorArea; r.non_empty())
+    if (const auto r = _api.paintCursorArea; r.non_empty())
     {
         _p.dirtyRectInPx.left = std::min(_p.dirtyRectInPx.left, r.left * _p.s->font->cellSize.x);
         _p.dirtyRectInPx.top = std::min(_p.dirtyRectInPx.top, r.top * _p.s->font->cellSize.y);
@@ -275,9 +293,6 @@ try
         _p.dirtyRectInPx.bottom = std::max(_p.dirtyRectInPx.bottom, r.bottom * _p.s->font->cellSize.y);
     }
 
-    _api.invalidatedCursorArea = invalidatedAreaNone;
-    _api.invalidatedRows = invalidatedRowsNone;
-    _api.scrollOffset = 0;
     return S_OK;
 }
 CATCH_RETURN()
@@ -295,8 +310,8 @@ CATCH_RETURN()
 
         // get the buffer origin relative to the viewport, and use it to calculate
         // the dirty region to be relative to the buffer origin
-        const til::CoordType offsetX = _api.viewportOffset.x;
-        const til::CoordType offsetY = _api.viewportOffset.y;
+        const til::CoordType offsetX = _api.paintViewportOffset.x;
+        const til::CoordType offsetY = _api.paintViewportOffset.y;
         const til::point bufferOrigin{ -offsetX, -offsetY };
         const auto dr = _api.dirtyRect.to_origin(bufferOrigin);
 
@@ -394,7 +409,7 @@ try
     const til::CoordType y = row;
     const til::CoordType x1 = begX;
     const til::CoordType x2 = endX;
-    const auto offset = til::point{ _api.viewportOffset.x, _api.viewportOffset.y };
+    const auto offset = til::point{ _api.paintViewportOffset.x, _api.paintViewportOffset.y };
     auto it = highlights.begin();
     const auto itEnd = highlights.end();
     auto hiStart = it->start - offset;
@@ -469,7 +484,7 @@ try
     }
 
     const auto shift = gsl::narrow_cast<u8>(_api.lineRendition != LineRendition::SingleWidth);
-    const auto x = gsl::narrow_cast<u16>(clamp<int>(coord.x - (_api.viewportOffset.x >> shift), 0, _p.s->viewportCellCount.x));
+    const auto x = gsl::narrow_cast<u16>(clamp<int>(coord.x - (_api.paintViewportOffset.x >> shift), 0, _p.s->viewportCellCount.x));
     auto columnEnd = x;
 
     // _api.bufferLineColumn contains 1 more item than _api.bufferLine, as it represents the
@@ -507,11 +522,83 @@ try
 }
 CATCH_RETURN()
 
+[[nodiscard]] HRESULT AtlasEngine::PaintBufferRow(const BufferRow& row, const RenderSettings& renderSettings) noexcept
+try
+{
+    const auto y = gsl::narrow_cast<u16>(clamp<int>(row.targetRow, 0, _p.s->viewportCellCount.y - 1));
+
+    if (_api.lastPaintBufferLineCoord.y != y)
+    {
+        _flushBufferLine();
+    }
+
+    const auto shift = gsl::narrow_cast<u8>(_api.lineRendition != LineRendition::SingleWidth);
+    const auto toViewport = [&](til::CoordType column) {
+        return gsl::narrow_cast<u16>(clamp<int>(column - (_api.paintViewportOffset.x >> shift), 0, _p.s->viewportCellCount.x));
+    };
+
+    _api.lastPaintBufferLineCoord = { toViewport(row.columnBegin), y };
+
+    // Both halves of a wide glyph share the same char offset. Its text belongs to its leading column,
+    // even if the trailing half happens to be in the next run (= it has different attributes).
+    u16 glyphColumn = 0;
+
+    for (const auto& run : row.runs)
+    {
+        // This may call _flushBufferLine(), which is why _api.bufferLineColumn
+        // has to hold the past-the-end column in between runs.
+        auto [fg, bg] = renderSettings.GetAttributeColorsWithAlpha(run.attributes);
+        fg |= 0xff000000;
+        bg |= _api.paintBackgroundOpaqueMixin;
+        _setDrawingBrushes(run.attributes, renderSettings, fg, bg);
+
+        // See PaintBufferLine().
+        if (!_api.bufferLineColumn.empty())
+        {
+            _api.bufferLineColumn.pop_back();
+        }
+
+        for (auto column = run.columnBegin; column < run.columnEnd; ++column)
+        {
+            const auto idx = gsl::narrow_cast<size_t>(column - row.columnBegin);
+            const auto beg = til::at(row.charOffsets, idx);
+            const auto end = til::at(row.charOffsets, idx + 1);
+
+            if (idx == 0 || beg != til::at(row.charOffsets, idx - 1))
+            {
+                glyphColumn = toViewport(column);
+            }
+
+            for (auto i = beg; i < end; ++i)
+            {
+                _api.bufferLine.emplace_back(til::at(row.text, i));
+                _api.bufferLineColumn.emplace_back(glyphColumn);
+            }
+        }
+
+        const auto x1 = toViewport(run.columnBegin);
+        const auto x2 = toViewport(run.columnEnd);
+        _api.bufferLineColumn.emplace_back(x2);
+        _fillColorBitmap(y, x1, x2, _api.currentForeground, _api.currentBackground);
+        RETURN_IF_FAILED(_drawHighlighted(_api.searchHighlights, y, x1, x2, highlightFg, highlightBg));
+        RETURN_IF_FAILED(_drawHighlighted(_api.searchHighlightFocused, y, x1, x2, highlightFocusFg, highlightFocusBg));
+
+        if (run.gridlines.any())
+        {
+            const auto cchLine = gsl::narrow_cast<size_t>(run.columnEnd - run.columnBegin);
+            RETURN_IF_FAILED(PaintBufferGridLines(run.gridlines, run.gridlineColor, run.underlineColor, cchLine, { run.columnBegin, row.targetRow }));
+        }
+    }
+
+    return S_OK;
+}
+CATCH_RETURN()
+
 [[nodiscard]] HRESULT AtlasEngine::PaintBufferGridLines(const GridLineSet lines, const COLORREF gridlineColor, const COLORREF underlineColor, const size_t cchLine, const til::point coordTarget) noexcept
 try
 {
     const auto shift = gsl::narrow_cast<u8>(_api.lineRendition != LineRendition::SingleWidth);
-    const auto x = std::max(0, coordTarget.x - (_api.viewportOffset.x >> shift));
+    const auto x = std::max(0, coordTarget.x - (_api.paintViewportOffset.x >> shift));
     const auto y = gsl::narrow_cast<u16>(clamp<til::CoordType>(coordTarget.y, 0, _p.s->viewportCellCount.y - 1));
     const auto from = gsl::narrow_cast<u16>(clamp<til::CoordType>(x << shift, 0, _p.s->viewportCellCount.x - 1));
     const auto to = gsl::narrow_cast<u16>(clamp<size_t>((x + cchLine) << shift, from, _p.s->viewportCellCount.x));
@@ -604,10 +691,10 @@ try
             .cursorType = gsl::narrow_cast<u16>(options.cursorType),
             .heightPercentage = gsl::narrow_cast<u16>(options.ulCursorHeightPercent),
         };
-        if (*_api.s->cursor != cachedOptions)
+        if (*_p.s->cursor != cachedOptions)
         {
-            *_api.s.write()->cursor.write() = cachedOptions;
             *_p.s.write()->cursor.write() = cachedOptions;
+            _api.pendingCursor = cachedOptions;
         }
     }
 
@@ -617,7 +704,7 @@ try
         const auto top = options.coordCursor.y;
         const auto bottom = top + 1;
         const auto shift = gsl::narrow_cast<u8>(_p.rows[top]->lineRendition != LineRendition::SingleWidth);
-        auto left = options.coordCursor.x - (_api.viewportOffset.x >> shift);
+        auto left = options.coordCursor.x - (_api.paintViewportOffset.x >> shift);
         auto right = left + cursorWidth;
 
         left <<= shift;
@@ -648,33 +735,40 @@ try
 {
     auto [fg, bg] = renderSettings.GetAttributeColorsWithAlpha(textAttributes);
     fg |= 0xff000000;
-    bg |= _api.backgroundOpaqueMixin;
+    bg |= _api.paintBackgroundOpaqueMixin;
 
     if (!isSettingDefaultBrushes)
     {
-        auto attributes = FontRelevantAttributes::None;
-        WI_SetFlagIf(attributes, FontRelevantAttributes::Bold, textAttributes.IsIntense() && renderSettings.GetRenderMode(RenderSettings::Mode::IntenseIsBold));
-        WI_SetFlagIf(attributes, FontRelevantAttributes::Italic, textAttributes.IsItalic());
-
-        if (_api.attributes != attributes)
-        {
-            _flushBufferLine();
-        }
-
-        _api.currentBackground = gsl::narrow_cast<u32>(bg);
-        _api.currentForeground = gsl::narrow_cast<u32>(fg);
-        _api.attributes = attributes;
+        _setDrawingBrushes(textAttributes, renderSettings, fg, bg);
     }
-    else if (textAttributes.BackgroundIsDefault() && bg != _api.s->misc->backgroundColor)
+    else if (textAttributes.BackgroundIsDefault() && bg != _p.s->misc->backgroundColor)
     {
-        _api.s.write()->misc.write()->backgroundColor = bg;
         _p.s.write()->misc.write()->backgroundColor = bg;
+        _api.pendingBackgroundColor = bg;
     }
 
     return S_OK;
 }
 CATCH_RETURN()
 
+// Sets the colors and font attributes used by the following PaintBufferLine()/PaintBufferRow() calls.
+// fg and bg are the colors of textAttributes, already resolved by the caller including their alpha.
+void AtlasEngine::_setDrawingBrushes(const TextAttribute& textAttributes, const RenderSettings& renderSettings, const u32 fg, const u32 bg)
+{
+    auto attributes = FontRelevantAttributes::None;
+    WI_SetFlagIf(attributes, FontRelevantAttributes::Bold, textAttributes.IsIntense() && renderSettings.GetRenderMode(RenderSettings::Mode::IntenseIsBold));
+    WI_SetFlagIf(attributes, FontRelevantAttributes::Italic, textAttributes.IsItalic());
+
+    if (_api.attributes != attributes)
+    {
+        _flushBufferLine();
+    }
+
+    _api.currentBackground = bg;
+    _api.currentForeground = fg;
+    _api.attributes = attributes;
+}
+
 #pragma endregion
 
 void AtlasEngine::_handleSettingsUpdate()
@@ -25,6 +25,7 @@ namespace Microsoft::Console::Render::Atlas
         [[nodiscard]] HRESULT StartPaint() noexcept override;
         [[nodiscard]] HRESULT EndPaint() noexcept override;
         [[nodiscard]] bool RequiresContinuousRedraw() noexcept override;
+        [[nodiscard]] bool SupportsUnlockedPainting() noexcept override;
         void WaitUntilCanRender() noexcept override;
         [[nodiscard]] HRESULT Present() noexcept override;
         [[nodiscard]] HRESULT ScrollFrame() noexcept override;
@@ -42,6 +43,7 @@ namespace Microsoft::Console::Render::Atlas
         [[nodiscard]] HRESULT PrepareLineTransform(LineRendition lineRendition, til::CoordType targetRow, til::CoordType viewportLeft) noexcept override;
         [[nodiscard]] HRESULT PaintBackground() noexcept override;
         [[nodiscard]] HRESULT PaintBufferLine(std::span<const Cluster> clusters, til::point coord, bool fTrimLeft, bool lineWrapped) noexcept override;
+        [[nodiscard]] HRESULT PaintBufferRow(const BufferRow& row, const RenderSettings& renderSettings) noexcept override;
         [[nodiscard]] HRESULT PaintBufferGridLines(const GridLineSet lines, const COLORREF gridlineColor, const COLORREF underlineColor, const size_t cchLine, const til::point coordTarget) noexcept override;
         [[nodiscard]] HRESULT PaintImageSlice(const ImageSlice& imageSlice, til::CoordType targetRow, til::CoordType viewportLeft) noexcept override;
         [[nodiscard]] HRESULT PaintSelection(const til::rect& rect) noexcept override;
@@ -90,6 +92,7 @@ namespace Microsoft::Console::Render::Atlas
         void _mapCharacters(const wchar_t* text, u32 textLength, u32* mappedLength, IDWriteFontFace2** mappedFontFace) const;
         void _mapComplex(IDWriteFontFace2* mappedFontFace, u32 idx, u32 length, ShapedRow& row);
         ATLAS_ATTR_COLD void _mapReplacementCharacter(u32 from, u32 to, ShapedRow& row);
+        void _setDrawingBrushes(const TextAttribute& textAttributes, const RenderSettings& renderSettings, u32 fg, u32 bg);
         void _fillColorBitmap(const size_t y, const size_t x1, const size_t x2, const u32 fgColor, const u32 bgColor) noexcept;
         [[nodiscard]] HRESULT _drawHighlighted(std::span<const til::point_span>& highlights, const u16 row, const u16 begX, const u16 endX, const u32 fgColor, const u32 bgColor) noexcept;
 
@@ -180,6 +183,17 @@ namespace Microsoft::Console::Render::Atlas
 
             // The position of the viewport inside the text buffer (in cells).
             u16x2 viewportOffset{ 0, 0 };
+
+            // The console lock isn't held between StartPaint() and EndPaint() (see SupportsUnlockedPainting()).
+            // The methods called in between must thus not read the fields above that the API methods write to.
+            // StartPaint() latches them into the following fields and resets the invalidation instead.
+            u16x2 paintViewportOffset{ 0, 0 };
+            u16r paintCursorArea = invalidatedAreaNone;
+            u32 paintBackgroundOpaqueMixin = 0xff000000;
+            // For the same reason PaintCursor() and UpdateDrawingBrushes() only write to _p.s.
+            // The next StartPaint() applies their changes to `s` so that the two stay in sync.
+            std::optional<CursorSettings> pendingCursor;
+            std::optional<u32> pendingBackgroundColor;
         } _api;
     };
 }
@@ -80,6 +80,12 @@ CATCH_RETURN()
     return ATLAS_DEBUG_CONTINUOUS_REDRAW || (_b && _b->RequiresContinuousRedraw());
 }
 
+// All the state that the paint methods need is latched in StartPaint(). See ApiState.
+[[nodiscard]] bool AtlasEngine::SupportsUnlockedPainting() noexcept
+{
+    return true;
+}
+
 void AtlasEngine::WaitUntilCanRender() noexcept
 {
     if constexpr (ATLAS_DEBUG_RENDER_DELAY)
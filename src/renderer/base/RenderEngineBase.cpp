@@ -64,6 +64,14 @@ HRESULT RenderEngineBase::PrepareLineTransform(const LineRendition /*lineRenditi
     return S_FALSE;
 }
 
+// Method Description:
+// - Engines paint rows cluster by cluster by default. See IRenderEngine::PaintBufferRow.
+HRESULT RenderEngineBase::PaintBufferRow(const BufferRow& /*row*/,
+                                         const RenderSettings& /*renderSettings*/) noexcept
+{
+    return S_FALSE;
+}
+
 HRESULT RenderEngineBase::PaintImageSlice(const ImageSlice& /*imageSlice*/,
                                           const til::CoordType /*targetRow*/,
                                           const til::CoordType /*viewportLeft*/) noexcept
@@ -81,6 +89,14 @@ HRESULT RenderEngineBase::PaintImageSlice(const ImageSlice& /*imageSlice*/,
     return false;
 }
 
+// Method Description:
+// - By default, engines paint while the console lock is held, because they
+//   aren't prepared to be invalidated by other threads while they're painting.
+[[nodiscard]] bool RenderEngineBase::SupportsUnlockedPainting() noexcept
+{
+    return false;
+}
+
 // Method Description:
 // - Blocks until the engine is able to render without blocking.
 void RenderEngineBase::WaitUntilCanRender() noexcept
@@ -285,3 +285,20 @@ try
     }
 }
 CATCH_LOG()
+
+// Routine Description:
+// - Returns whether any blinking cells were painted since the last blink cycle.
+bool RenderSettings::IsBlinkInUse() const noexcept
+{
+    return _blinkIsInUse;
+}
+
+// Routine Description:
+// - The Renderer paints with a copy of the settings, so that they can change while it's painting.
+//   This carries the blink attribute usage that the copy observed over to the original.
+// Arguments:
+// - other: the copy that was used for painting.
+void RenderSettings::MergeBlinkUsage(const RenderSettings& other) const noexcept
+{
+    _blinkIsInUse = _blinkIsInUse || other._blinkIsInUse;
+}
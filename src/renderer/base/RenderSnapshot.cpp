@@ -0,0 +1,154 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include "RenderSnapshot.hpp"
+
+#pragma hdrstop
+
+using namespace Microsoft::Console::Render;
+using namespace Microsoft::Console::Types;
+
+// Routine Description:
+// - Copies the rows of the given viewport that changed since the last call.
+// - A row's generation changes whenever it's handed out for modification and is unique across all buffers,
+//   so two rows with the same generation have the same contents. This means that for regular output only
+//   the rows that were written to get copied, and when the viewport scrolls down, only the rows that scrolled in.
+// Arguments:
+// - buffer - The text buffer to copy the rows from.
+// - viewport - The visible part of the buffer. Must be within the buffer.
+void RenderSnapshot::CopyRows(const TextBuffer& buffer, const Viewport& viewport)
+{
+    const til::size size{ buffer.GetSize().Width(), viewport.Height() };
+
+    // Every row we copy interns its attributes into our own table. Since the snapshot never scrolls, the
+    // table is never collected, so we simply start over once it's grown large enough (this is rare).
+    if (!_buffer || _buffer->GetSize().Dimensions() != size || _buffer->GetAttributeTable().NeedsCollection())
+    {
+        _buffer = std::make_unique<TextBuffer>(size, TextAttribute{}, 0, false, nullptr);
+        _generations.assign(gsl::narrow_cast<size_t>(size.height), 0);
+    }
+
+    const auto top = viewport.Top();
+    const auto height = std::min(size.height, buffer.GetSize().Height() - top);
+
+    // If the top row of the viewport is found further down in the snapshot, the contents scrolled up
+    // (the common case for a shell that prints a lot of output). Rotate our rows to match.
+    if (height > 1)
+    {
+        const auto generation = buffer.GetRowByOffset(top).GetGeneration();
+        if (generation != 0 && generation != _generations.front())
+        {
+            const auto it = std::find(_generations.begin() + 1, _generations.begin() + height, generation);
+            if (it != _generations.begin() + height)
+            {
+                const auto distance = gsl::narrow_cast<til::CoordType>(it - _generations.begin());
+                // The rows at the bottom are copied from the buffer below, since their generation is reset to 0.
+                _buffer->ScrollRows(distance, size.height - distance, -distance, false);
+                std::move(it, _generations.end(), _generations.begin());
+                std::fill(_generations.end() - distance, _generations.end(), 0);
+            }
+        }
+    }
+    for (til::CoordType y = 0; y < height; ++y)
+    {
+        const auto& src = buffer.GetRowByOffset(top + y);
+        const auto generation = src.GetGeneration();
+        auto& cached = til::at(_generations, gsl::narrow_cast<size_t>(y));
+
+        if (generation != 0 && generation == cached)
+        {
+            continue;
+        }
+
+        auto& dst = _buffer->GetMutableRowByOffset(y);
+        dst.CopyFrom(src);
+        dst.SetDoubleBytePadded(src.WasDoubleBytePadded());
+        ImageSlice::CopyRow(src, dst);
+        cached = generation;
+        _copiedRows++;
+    }
+}
+
+// Routine Description:
+// - Ensures that the given row gets copied again on the next CopyRows() call.
+//   The Renderer calls this after drawing the active composition into a row of the snapshot.
+void RenderSnapshot::InvalidateRow(const til::CoordType y) noexcept
+{
+    if (y >= 0 && gsl::narrow_cast<size_t>(y) < _generations.size())
+    {
+        til::at(_generations, gsl::narrow_cast<size_t>(y)) = 0;
+    }
+}
+
+// Routine Description:
+// - Hovered patterns (like URLs) are underlined, which requires asking the console for the patterns at each
+//   cell. Since the hovered interval is usually tiny, we simply ask for every cell inside of it up front.
+// Arguments:
+// - data - The console to get the pattern ids from.
+// - interval - The hovered interval in viewport coordinates, if any.
+void RenderSnapshot::CopyHoveredPatterns(const IRenderData& data, const std::optional<PointTree::interval>& interval)
+{
+    hoveredInterval = interval;
+    _hoveredPatternCells.clear();
+
+    if (!interval)
+    {
+        return;
+    }
+
+    const auto width = viewport.Width();
+    const auto beg = std::max(0, interval->start.y);
+    const auto end = std::min(viewport.Height(), interval->stop.y + 1);
+    if (beg >= end)
+    {
+        return;
+    }
+
+    _hoveredPatternTop = beg;
+    _hoveredPatternWidth = width;
+    _hoveredPatternCells.resize(gsl::narrow_cast<size_t>(end - beg) * gsl::narrow_cast<size_t>(width));
+
+    size_t index = 0;
+    for (auto y = beg; y < end; ++y)
+    {
+        for (til::CoordType x = 0; x < width; ++x, ++index)
+        {
+            const til::point position{ x, y };
+            if (interval->start <= position && position <= interval->stop)
+            {
+                _hoveredPatternCells[index] = !data.GetPatternId(position).empty();
+            }
+        }
+    }
+}
+
+const TextBuffer& RenderSnapshot::GetTextBuffer() const noexcept
+{
+    return *_buffer;
+}
+
+TextBuffer& RenderSnapshot::GetMutableTextBuffer() noexcept
+{
+    return *_buffer;
+}
+
+// Routine Description:
+// - Returns the number of rows that CopyRows() copied so far.
+uint64_t RenderSnapshot::GetCopiedRowCount() const noexcept
+{
+    return _copiedRows;
+}
+
+// Routine Description:
+// - Returns whether the given viewport position is inside the hovered interval and part of a pattern.
+bool RenderSnapshot::IsInHoveredPattern(const til::point position) const noexcept
+{
+    if (_hoveredPatternCells.empty() || position.x < 0 || position.x >= _hoveredPatternWidth || position.y < _hoveredPatternTop)
+    {
+        return false;
+    }
+
+    const auto index = gsl::narrow_cast<size_t>(position.y - _hoveredPatternTop) * gsl::narrow_cast<size_t>(_hoveredPatternWidth) + gsl::narrow_cast<size_t>(position.x);
+    return index < _hoveredPatternCells.size() && _hoveredPatternCells[index];
+}
@@ -0,0 +1,67 @@
+/*++
+Copyright (c) Microsoft Corporation
+Licensed under the MIT license.
+
+Module Name:
+- RenderSnapshot.hpp
+
+Abstract:
+- A copy of the console state that the Renderer paints a frame from.
+- It's updated at the start of every frame while the console lock is held. Afterwards
+  the lock can be released and engines that support it (see IRenderEngine::SupportsUnlockedPainting)
+  paint from the snapshot, while the console keeps processing output on other threads.
+- Only the visible rows whose generation changed since the previous frame are copied.
+--*/
+
+#pragma once
+
+#include "../inc/IRenderData.hpp"
+#include "../inc/RenderSettings.hpp"
+#include "../inc/CursorOptions.h"
+
+#include "../../buffer/out/textBuffer.hpp"
+
+namespace Microsoft::Console::Render
+{
+    class RenderSnapshot
+    {
+    public:
+        using PointTree = interval_tree::IntervalTree<til::point, size_t>;
+
+        void CopyRows(const TextBuffer& buffer, const Types::Viewport& viewport);
+        void InvalidateRow(til::CoordType y) noexcept;
+        void CopyHoveredPatterns(const IRenderData& data, const std::optional<PointTree::interval>& interval);
+
+        // The rows of the viewport at the time of the last CopyRows(). Row 0 is the top row of the viewport.
+        const TextBuffer& GetTextBuffer() const noexcept;
+        TextBuffer& GetMutableTextBuffer() noexcept;
+        uint64_t GetCopiedRowCount() const noexcept;
+        bool IsInHoveredPattern(til::point position) const noexcept;
+
+        // The remaining state is copied over by the Renderer as is.
+        Types::Viewport viewport;
+        RenderSettings settings;
+        CursorOptions cursor;
+        std::vector<til::rect> selectionRects;
+        std::vector<til::point_span> searchHighlights;
+        std::optional<til::point_span> searchHighlightFocused;
+        std::wstring title;
+        bool gridLinesAllowed = false;
+        size_t lastSoftFontChar = 0;
+        uint16_t hyperlinkHoveredId = 0;
+        std::optional<PointTree::interval> hoveredInterval;
+
+    private:
+        std::unique_ptr<TextBuffer> _buffer;
+        // The generation of each row at the time it was copied.
+        // A generation of 0 means unknown and the row is copied regardless.
+        std::vector<uint64_t> _generations;
+        uint64_t _copiedRows = 0;
+
+        // For each cell of the viewport rows that the hovered interval spans,
+        // whether it's part of the interval and a pattern. See CopyHoveredPatterns().
+        til::CoordType _hoveredPatternTop = 0;
+        til::CoordType _hoveredPatternWidth = 0;
+        std::vector<bool> _hoveredPatternCells;
+    };
+}
@@ -4,6 +4,8 @@
 #include "precomp.h"
 #include "renderer.hpp"
 
+#include <til/hash.h>
+
 #pragma hdrstop
 
 using namespace Microsoft::Console::Render;
@@ -112,6 +114,14 @@ IRenderData* Renderer::GetRenderData() const noexcept
 
 [[nodiscard]] HRESULT Renderer::_PaintFrame() noexcept
 {
+    // The result of StartPaint() for each engine that paints without the console lock.
+    std::array<HRESULT, std::tuple_size_v<decltype(_engines)>> unlockedPaints;
+    unlockedPaints.fill(S_FALSE);
+    auto unlockedPainting = false;
+    auto blinkWasInUse = false;
+    // The first failure of any engine.
+    auto hr = S_OK;
+
     {
         _pData->LockConsole();
         auto unlock = wil::scope_exit([&]() {
@@ -121,6 +131,11 @@ IRenderData* Renderer::GetRenderData() const noexcept
         // Last chance check if anything scrolled without an explicit invalidate notification since the last frame.
         _CheckViewportAndScroll();
 
+        // If the hovered hyperlink changed, rows may look different even if their contents didn't.
+        const auto decorationHash = _getDecorationHash();
+        _flushPendingRedraws(decorationHash == _lastDecorationHash);
+        _lastDecorationHash = decorationHash;
+
         _invalidateCurrentCursor(); // Invalidate the previous cursor position.
         _invalidateOldComposition();
 
@@ -130,12 +145,69 @@ IRenderData* Renderer::GetRenderData() const noexcept
         _invalidateCurrentCursor(); // Invalidate the new cursor position.
         _prepareNewComposition();
 
+        try
+        {
+            _publishSnapshot();
+        }
+        CATCH_RETURN();
+        blinkWasInUse = _snapshot.settings.IsBlinkInUse();
+
+        // A failing engine mustn't keep the others from painting, because
+        // the unlocked ones need their EndPaint() once they started painting.
+        size_t i = 0;
         FOREACH_ENGINE(pEngine)
         {
-            RETURN_IF_FAILED(_PaintFrameForEngine(pEngine));
+            if (pEngine->SupportsUnlockedPainting())
+            {
+                // Only StartPaint() needs the lock, because that's where the engine takes over the invalidated areas.
+                auto& startHr = til::at(unlockedPaints, i);
+                startHr = pEngine->StartPaint();
+                LOG_IF_FAILED(startHr);
+                hr = SUCCEEDED(hr) ? startHr : hr;
+                unlockedPainting = unlockedPainting || startHr == S_OK;
+            }
+            else
+            {
+                const auto paintHr = _PaintFrameForEngine(pEngine);
+                hr = SUCCEEDED(hr) ? paintHr : hr;
+            }
+            ++i;
+        }
+
+        if (!unlockedPainting)
+        {
+            _renderSettings.MergeBlinkUsage(_snapshot.settings);
         }
     }
 
+    if (unlockedPainting)
+    {
+        // Paint all engines that started painting, even if one of them fails,
+        // because each StartPaint() needs to be followed by an EndPaint().
+        size_t i = 0;
+        FOREACH_ENGINE(pEngine)
+        {
+            if (til::at(unlockedPaints, i) == S_OK)
+            {
+                const auto paintHr = _PaintFrameContents(pEngine);
+                hr = SUCCEEDED(hr) ? paintHr : hr;
+            }
+            ++i;
+        }
+
+        // ToggleBlinkRendition() only redraws if it knows that blinking cells are visible.
+        // Since we painted with the snapshot's copy of the settings, it needs to be told.
+        if (!blinkWasInUse && _snapshot.settings.IsBlinkInUse())
+        {
+            _pData->LockConsole();
+            _renderSettings.MergeBlinkUsage(_snapshot.settings);
+            _pData->UnlockConsole();
+        }
+    }
+
+    // Only now that every engine that started painting got its EndPaint().
+    RETURN_IF_FAILED(hr);
+
     FOREACH_ENGINE(pEngine)
     {
         RETURN_IF_FAILED(pEngine->Present());
@@ -161,6 +233,21 @@ try
         return S_OK;
     }
 
+    return _PaintFrameContents(pEngine);
+}
+CATCH_RETURN()
+
+// Routine Description:
+// - Paints a frame from the snapshot, after the engine's StartPaint() returned S_OK.
+// - This doesn't access the console, which allows engines that support it to be
+//   painted without holding the console lock. See IRenderEngine::SupportsUnlockedPainting().
+// Arguments:
+// - pEngine - The engine to paint with.
+// Return Value:
+// - S_OK or the first failure of the engine.
+[[nodiscard]] HRESULT Renderer::_PaintFrameContents(_In_ IRenderEngine* const pEngine) noexcept
+try
+{
     auto endPaint = wil::scope_exit([&]() {
         LOG_IF_FAILED(pEngine->EndPaint());
 
@@ -233,6 +320,9 @@ void Renderer::TriggerSystemRedraw(const til::rect* const prcDirtyClient)
 
 // Routine Description:
 // - Called when a particular region within the console buffer has changed.
+// - The engines aren't invalidated until the next frame, which allows us to drop
+//   the redraw if the rows turn out to be identical to what's already on screen.
+//   See _flushPendingRedraws().
 // Arguments:
 // - <none>
 // Return Value:
@@ -257,9 +347,16 @@ void Renderer::TriggerRedraw(const Viewport& region)
     if (view.TrimToViewport(&srUpdateRegion))
     {
         view.ConvertToOrigin(&srUpdateRegion);
-        FOREACH_ENGINE(pEngine)
+
+        if (_pendingRedraws.size() < gsl::narrow_cast<size_t>(srUpdateRegion.bottom))
+        {
+            _pendingRedraws.resize(gsl::narrow_cast<size_t>(srUpdateRegion.bottom));
+        }
+        for (auto y = srUpdateRegion.top; y < srUpdateRegion.bottom; ++y)
         {
-            LOG_IF_FAILED(pEngine->Invalidate(&srUpdateRegion));
+            auto& pending = til::at(_pendingRedraws, y);
+            pending.left = std::min(pending.left, srUpdateRegion.left);
+            pending.right = std::max(pending.right, srUpdateRegion.right);
         }
 
         NotifyPaintFrame();
@@ -287,6 +384,9 @@ void Renderer::TriggerRedraw(const til::point* const pcoord)
 // - <none>
 void Renderer::TriggerRedrawAll(const bool backgroundChanged, const bool frameChanged)
 {
+    // Everything gets redrawn anyway and whatever changed might not be part of the row contents.
+    _resetPendingRedraws();
+
     FOREACH_ENGINE(pEngine)
     {
         LOG_IF_FAILED(pEngine->InvalidateAll());
@@ -401,6 +501,10 @@ bool Renderer::_CheckViewportAndScroll()
     coordDelta.x = srOldViewport.left - srNewViewport.left;
     coordDelta.y = srOldViewport.top - srNewViewport.top;
 
+    // The pending redraws are relative to the viewport and need to be scrolled along with the rest.
+    _flushPendingRedraws(false);
+    _rowFingerprints.clear();
+
     FOREACH_ENGINE(engine)
     {
         LOG_IF_FAILED(engine->UpdateViewport(srNewViewport));
@@ -456,6 +560,10 @@ void Renderer::TriggerScroll()
 // - <none>
 void Renderer::TriggerScroll(const til::point* const pcoordDelta)
 {
+    // The pending redraws are relative to the viewport and need to be scrolled along with the rest.
+    _flushPendingRedraws(false);
+    _rowFingerprints.clear();
+
     FOREACH_ENGINE(pEngine)
     {
         LOG_IF_FAILED(pEngine->InvalidateScroll(pcoordDelta));
@@ -499,8 +607,7 @@ void Renderer::TriggerNewTextNotification(const std::wstring_view newText)
 // - the HRESULT of the underlying engine's UpdateTitle call.
 HRESULT Renderer::_PaintTitle(IRenderEngine* const pEngine)
 {
-    const auto newTitle = _pData->GetConsoleTitle();
-    return pEngine->UpdateTitle(newTitle);
+    return pEngine->UpdateTitle(_snapshot.title);
 }
 
 // Routine Description:
@@ -669,9 +776,9 @@ void Renderer::_PaintBufferOutput(_In_ IRenderEngine* const pEngine)
     // This is the subsection of the entire screen buffer that is currently being presented.
     // It can move left/right or top/bottom depending on how the viewport is scrolled
     // relative to the entire buffer.
-    const auto view = _pData->GetViewport();
-    const auto compositionRow = _compositionCache ? _compositionCache->absoluteOrigin.y : -1;
-    const auto& activeComposition = _pData->GetActiveComposition();
+    const auto view = _snapshot.viewport;
+    // The snapshot only contains the rows of the viewport, with the active composition already drawn into them.
+    const auto& buffer = _snapshot.GetTextBuffer();
 
     // This is effectively the number of cells on the visible screen that need to be redrawn.
     // The origin is always 0, 0 because it represents the screen itself, not the underlying buffer.
@@ -683,6 +790,10 @@ void Renderer::_PaintBufferOutput(_In_ IRenderEngine* const pEngine)
         LOG_IF_FAILED(pEngine->ResetLineTransform());
     });
 
+    // Whether the engine accepts entire rows via PaintBufferRow(). We find out on the first row.
+    // Soft fonts need to be flagged per run, which only the cluster-based path supports.
+    auto paintRows = _snapshot.lastSoftFontChar < _firstSoftFontChar;
+
     for (const auto& dirtyRect : dirtyAreas)
     {
         if (!dirtyRect)
@@ -701,65 +812,17 @@ void Renderer::_PaintBufferOutput(_In_ IRenderEngine* const pEngine)
         // we need to walk through line-by-line and repaint onto the screen.
         const auto redraw = Viewport::Intersect(dirty, view);
 
-        // Retrieve the text buffer so we can read information out of it.
-        auto& buffer = _pData->GetTextBuffer();
         // Now walk through each row of text that we need to redraw.
         for (auto row = redraw.Top(); row < redraw.BottomExclusive(); row++)
         {
             // Calculate the boundaries of a single line. This is from the left to right edge of the dirty
             // area in width and exactly 1 tall.
             const auto screenLine = til::inclusive_rect{ redraw.Left(), row, redraw.RightInclusive(), row };
-            const auto& r = buffer.GetRowByOffset(row);
-
-            // Draw the active composition.
-            // We have to use some tricks here with const_cast, because the code after it relies on TextBufferCellIterator,
-            // which isn't compatible with the scratchpad row. This forces us to back up and modify the actual row `r`.
-            ROW* rowBackup = nullptr;
-            if (row == compositionRow)
-            {
-                auto& scratch = buffer.GetScratchpadRow();
-                scratch.CopyFrom(r);
-                rowBackup = &scratch;
-
-                std::wstring_view text{ activeComposition.text };
-                RowWriteState state{
-                    .columnLimit = r.GetReadableColumnCount(),
-                    .columnEnd = _compositionCache->absoluteOrigin.x,
-                };
-
-                size_t off = 0;
-                for (const auto& range : activeComposition.attributes)
-                {
-                    const auto len = range.len;
-                    auto attr = range.attr;
-
-                    // Use the color at the cursor if TSF didn't specify any explicit color.
-                    if (attr.GetBackground().IsDefault())
-                    {
-                        attr.SetBackground(_compositionCache->baseAttribute.GetBackground());
-                    }
-                    if (attr.GetForeground().IsDefault())
-                    {
-                        attr.SetForeground(_compositionCache->baseAttribute.GetForeground());
-                    }
-
-                    state.text = text.substr(off, len);
-                    state.columnBegin = state.columnEnd;
-                    const_cast<ROW&>(r).ReplaceText(state);
-                    const_cast<ROW&>(r).ReplaceAttributes(state.columnBegin, state.columnEnd, attr);
-                    off += len;
-                }
-            }
-            const auto restore = wil::scope_exit([&] {
-                if (rowBackup)
-                {
-                    const_cast<ROW&>(r).CopyFrom(*rowBackup);
-                }
-            });
+            const auto& r = buffer.GetRowByOffset(row - view.Top());
 
             // Convert the screen coordinates of the line to an equivalent
             // range of buffer cells, taking line rendition into account.
-            const auto lineRendition = buffer.GetLineRendition(row);
+            const auto lineRendition = r.GetLineRendition();
             const auto bufferLine = Viewport::FromInclusive(ScreenToBufferLine(screenLine, lineRendition));
 
             // Find where on the screen we should place this line information. This requires us to re-map
@@ -769,24 +832,38 @@ void Renderer::_PaintBufferOutput(_In_ IRenderEngine* const pEngine)
             // of the backing buffer to fill in line 1 of the screen.
             const auto screenPosition = bufferLine.Origin() - til::point{ 0, view.Top() };
 
-            // Retrieve the cell information iterator limited to just this line we want to redraw.
-            auto it = buffer.GetCellDataAt(bufferLine.Origin(), bufferLine);
-
             // Calculate if two things are true:
             // 1. this row wrapped
             // 2. We're painting the last col of the row.
             // In that case, set lineWrapped=true for the _PaintBufferOutputHelper call.
-            const auto lineWrapped = (buffer.GetRowByOffset(bufferLine.Origin().y).WasWrapForced()) &&
-                                     (bufferLine.RightExclusive() == buffer.GetSize().Width());
+            const auto lineWrapped = r.WasWrapForced() && (bufferLine.RightExclusive() == buffer.GetSize().Width());
 
             // Prepare the appropriate line transform for the current row and viewport offset.
             LOG_IF_FAILED(pEngine->PrepareLineTransform(lineRendition, screenPosition.y, view.Left()));
 
-            // Ask the helper to paint through this specific line.
-            _PaintBufferOutputHelper(pEngine, it, screenPosition, lineWrapped);
+            // Hovered patterns change the gridlines of individual cells, which only the cluster-based path supports.
+            const auto& hoveredInterval = _snapshot.hoveredInterval;
+            const auto hoveredRow = hoveredInterval && hoveredInterval->start.y <= screenPosition.y && screenPosition.y <= hoveredInterval->stop.y;
+            auto hr = S_FALSE;
+            if (paintRows && !hoveredRow && !r.WasDoubleBytePadded())
+            {
+                hr = _PaintBufferRow(pEngine, r, bufferLine, screenPosition.y, lineWrapped);
+                THROW_IF_FAILED(hr);
+                paintRows = hr == S_OK;
+            }
+
+            if (hr != S_OK)
+            {
+                // Retrieve the cell information iterator limited to just this line we want to redraw.
+                const auto snapshotLine = Viewport::Offset(bufferLine, { 0, -view.Top() });
+                auto it = buffer.GetCellDataAt(snapshotLine.Origin(), snapshotLine);
+
+                // Ask the helper to paint through this specific line.
+                _PaintBufferOutputHelper(pEngine, it, screenPosition, lineWrapped);
+            }
 
             // Paint any image content on top of the text.
-            const auto imageSlice = buffer.GetRowByOffset(row).GetImageSlice();
+            const auto imageSlice = r.GetImageSlice();
             if (imageSlice) [[unlikely]]
             {
                 LOG_IF_FAILED(pEngine->PaintImageSlice(*imageSlice, screenPosition.y, view.Left()));
@@ -806,7 +883,7 @@ void Renderer::_PaintBufferOutputHelper(_In_ IRenderEngine* const pEngine,
                                         const til::point target,
                                         const bool lineWrapped)
 {
-    auto globalInvert{ _renderSettings.GetRenderMode(RenderSettings::Mode::ScreenReversed) };
+    auto globalInvert{ _snapshot.settings.GetRenderMode(RenderSettings::Mode::ScreenReversed) };
 
     // If we have valid data, let's figure out how to draw it.
     if (it)
@@ -817,12 +894,13 @@ void Renderer::_PaintBufferOutputHelper(_In_ IRenderEngine* const pEngine,
         // Retrieve the iterator for one line of information.
         til::CoordType cols = 0;
 
-        // Retrieve the first color.
+        // Retrieve the first color. Comparing the ids is cheaper than comparing the attributes.
         auto color = it->TextAttr();
-        // Retrieve the first pattern id
-        auto patternIds = _pData->GetPatternId(target);
+        auto colorId = it.TextAttrId();
+        // Retrieve whether we start inside a hovered pattern
+        auto inPattern = _snapshot.IsInHoveredPattern(target);
         // Determine whether we're using a soft font.
-        auto usingSoftFont = s_IsSoftFontChar(it->Chars(), _firstSoftFontChar, _lastSoftFontChar);
+        auto usingSoftFont = s_IsSoftFontChar(it->Chars(), _firstSoftFontChar, _snapshot.lastSoftFontChar);
 
         // And hold the point where we should start drawing.
         auto screenPoint = target;
@@ -836,9 +914,6 @@ void Renderer::_PaintBufferOutputHelper(_In_ IRenderEngine* const pEngine,
             // when we go to draw gridlines for the length of the run.
             const auto currentRunColor = color;
 
-            // Hold onto the current pattern id as well
-            const auto currentPatternId = patternIds;
-
             // Update the drawing brushes with our color and font usage.
             THROW_IF_FAILED(_UpdateDrawingBrushes(pEngine, currentRunColor, usingSoftFont, false));
 
@@ -868,10 +943,10 @@ void Renderer::_PaintBufferOutputHelper(_In_ IRenderEngine* const pEngine,
             do
             {
                 til::point thisPoint{ screenPoint.x + cols, screenPoint.y };
-                const auto thisPointPatterns = _pData->GetPatternId(thisPoint);
-                const auto thisUsingSoftFont = s_IsSoftFontChar(it->Chars(), _firstSoftFontChar, _lastSoftFontChar);
-                const auto changedPatternOrFont = patternIds != thisPointPatterns || usingSoftFont != thisUsingSoftFont;
-                if (color != it->TextAttr() || changedPatternOrFont)
+                const auto thisInPattern = _snapshot.IsInHoveredPattern(thisPoint);
+                const auto thisUsingSoftFont = s_IsSoftFontChar(it->Chars(), _firstSoftFontChar, _snapshot.lastSoftFontChar);
+                const auto changedPatternOrFont = inPattern != thisInPattern || usingSoftFont != thisUsingSoftFont;
+                if (colorId != it.TextAttrId() || changedPatternOrFont)
                 {
                     auto newAttr{ it->TextAttr() };
                     // foreground doesn't matter for runs of spaces (!)
@@ -879,7 +954,8 @@ void Renderer::_PaintBufferOutputHelper(_In_ IRenderEngine* const pEngine,
                     if (!_IsAllSpaces(it->Chars()) || !newAttr.HasIdenticalVisualRepresentationForBlankSpace(color, globalInvert) || changedPatternOrFont)
                     {
                         color = newAttr;
-                        patternIds = thisPointPatterns;
+                        colorId = it.TextAttrId();
+                        inPattern = thisInPattern;
                         usingSoftFont = thisUsingSoftFont;
                         break; // vend this run
                     }
@@ -918,7 +994,7 @@ void Renderer::_PaintBufferOutputHelper(_In_ IRenderEngine* const pEngine,
 
             // If we're allowed to do grid drawing, draw that now too (since it will be coupled with the color data)
             // We're only allowed to draw the grid lines under certain circumstances.
-            if (_pData->IsGridLineDrawingAllowed())
+            if (_snapshot.gridLinesAllowed)
             {
                 // See GH: 803
                 // If we found a wide character while we looped above, it's possible we skipped over the right half
@@ -953,6 +1029,88 @@ void Renderer::_PaintBufferOutputHelper(_In_ IRenderEngine* const pEngine,
     }
 }
 
+// Routine Description:
+// - Paints the given part of a row with a single IRenderEngine::PaintBufferRow() call.
+//   Unlike _PaintBufferOutputHelper() it splits the row at attribute changes only,
+//   which it reads straight from the ROW instead of walking it cell by cell.
+// Arguments:
+// - pEngine - The engine to paint with.
+// - row - The row to paint.
+// - bufferLine - The columns of the row to paint (in buffer coordinates).
+// - targetRow - The row on the screen to paint at.
+// - lineWrapped - Whether the row wrapped and the last column is being painted.
+// Return Value:
+// - S_FALSE if the engine doesn't support PaintBufferRow().
+[[nodiscard]] HRESULT Renderer::_PaintBufferRow(_In_ IRenderEngine* const pEngine,
+                                                const ROW& row,
+                                                const Viewport& bufferLine,
+                                                const til::CoordType targetRow,
+                                                const bool lineWrapped)
+{
+    // If the dirty area starts or ends in the middle of a wide glyph, we paint all of it.
+    const auto columnBegin = row.AdjustToGlyphStart(bufferLine.Left());
+    const auto columnEnd = row.AdjustToGlyphEnd(bufferLine.RightExclusive());
+    const auto gridLinesAllowed = _snapshot.gridLinesAllowed;
+    const auto& table = row.GetAttributeTable();
+
+    _rowRuns.clear();
+    til::CoordType runBegin = 0;
+    for (const auto& run : row.Attributes().runs())
+    {
+        const auto runEnd = runBegin + run.length;
+        const auto beg = std::max(runBegin, columnBegin);
+        const auto end = std::min(runEnd, columnEnd);
+
+        if (beg < end)
+        {
+            auto& r = _rowRuns.emplace_back(BufferRowRun{
+                .attributes = table.Get(run.value),
+                .columnBegin = beg,
+                .columnEnd = end,
+            });
+
+            if (gridLinesAllowed)
+            {
+                r.gridlines = s_GetGridlines(r.attributes);
+
+                // For now, we dash underline patterns and switch to regular underline on hover
+                if (_isHoveredHyperlink(r.attributes))
+                {
+                    r.gridlines.reset(GridLines::HyperlinkUnderline);
+                    r.gridlines.set(GridLines::Underline);
+                }
+
+                if (r.gridlines.any())
+                {
+                    r.gridlineColor = _snapshot.settings.GetAttributeColors(r.attributes).first;
+                    r.underlineColor = _snapshot.settings.GetAttributeUnderlineColor(r.attributes);
+                }
+            }
+        }
+
+        if (runEnd >= columnEnd)
+        {
+            break;
+        }
+        runBegin = runEnd;
+    }
+
+    _rowCharOffsets.resize(gsl::narrow_cast<size_t>(columnEnd - columnBegin) + 1);
+    row.GetCharOffsets(columnBegin, columnEnd, _rowCharOffsets);
+
+    const BufferRow bufferRow{
+        .text = row.GetText(columnBegin, columnEnd),
+        .charOffsets = _rowCharOffsets,
+        .runs = _rowRuns,
+        .columnBegin = columnBegin,
+        .columnEnd = columnEnd,
+        .targetRow = targetRow,
+        .lineRendition = row.GetLineRendition(),
+        .lineWrapped = lineWrapped,
+    };
+    return pEngine->PaintBufferRow(bufferRow, _snapshot.settings);
+}
+
 // Method Description:
 // - Generates a GridLines structure from the values in the
 //      provided textAttribute
@@ -1051,8 +1209,8 @@ void Renderer::_PaintBufferOutputGridLineHelper(_In_ IRenderEngine* const pEngin
     if (lines.any())
     {
         // Get the current foreground and underline colors to render the lines.
-        const auto fg = _renderSettings.GetAttributeColors(textAttribute).first;
-        const auto underlineColor = _renderSettings.GetAttributeUnderlineColor(textAttribute);
+        const auto fg = _snapshot.settings.GetAttributeColors(textAttribute).first;
+        const auto underlineColor = _snapshot.settings.GetAttributeUnderlineColor(textAttribute);
         // Draw the lines
         LOG_IF_FAILED(pEngine->PaintBufferGridLines(lines, fg, underlineColor, cchLine, coordTarget));
     }
@@ -1060,14 +1218,12 @@ void Renderer::_PaintBufferOutputGridLineHelper(_In_ IRenderEngine* const pEngin
 
 bool Renderer::_isHoveredHyperlink(const TextAttribute& textAttribute) const noexcept
 {
-    return _hyperlinkHoveredId && _hyperlinkHoveredId == textAttribute.GetHyperlinkId();
+    return _snapshot.hyperlinkHoveredId && _snapshot.hyperlinkHoveredId == textAttribute.GetHyperlinkId();
 }
 
 bool Renderer::_isInHoveredInterval(const til::point coordTarget) const noexcept
 {
-    return _hoveredInterval &&
-           _hoveredInterval->start <= coordTarget && coordTarget <= _hoveredInterval->stop &&
-           _pData->GetPatternId(coordTarget).size() > 0;
+    return _snapshot.IsInHoveredPattern(coordTarget);
 }
 
 // Routine Description:
@@ -1231,6 +1387,78 @@ void Renderer::_prepareNewComposition()
     }
 }
 
+// Routine Description:
+// - Copies everything that painting a frame needs into _snapshot, so that the engines don't
+//   need to access the console while painting. Must be called with the console lock held.
+// - The active composition is drawn into the snapshot's copy of its row, which saves us
+//   from temporarily modifying the console's text buffer while painting.
+void Renderer::_publishSnapshot()
+{
+    const auto view = _pData->GetViewport();
+
+    _snapshot.viewport = view;
+    _snapshot.CopyRows(_pData->GetTextBuffer(), view);
+
+    _snapshot.settings = _renderSettings;
+    _snapshot.cursor = _currentCursorOptions;
+    _snapshot.selectionRects = _GetSelectionRects();
+    const auto searchHighlights = _pData->GetSearchHighlights();
+    _snapshot.searchHighlights.assign(searchHighlights.begin(), searchHighlights.end());
+    const auto searchHighlightFocused = _pData->GetSearchHighlightFocused();
+    _snapshot.searchHighlightFocused = searchHighlightFocused ? std::optional{ *searchHighlightFocused } : std::nullopt;
+    _snapshot.title = _pData->GetConsoleTitle();
+    _snapshot.gridLinesAllowed = _pData->IsGridLineDrawingAllowed();
+    _snapshot.lastSoftFontChar = _lastSoftFontChar;
+    _snapshot.hyperlinkHoveredId = _hyperlinkHoveredId;
+    _snapshot.CopyHoveredPatterns(*_pData, _hoveredInterval);
+
+    if (!_compositionCache)
+    {
+        return;
+    }
+
+    const auto y = _compositionCache->absoluteOrigin.y - view.Top();
+    if (y < 0 || y >= view.Height())
+    {
+        return;
+    }
+
+    auto& r = _snapshot.GetMutableTextBuffer().GetMutableRowByOffset(y);
+    const auto& activeComposition = _pData->GetActiveComposition();
+
+    std::wstring_view text{ activeComposition.text };
+    RowWriteState state{
+        .columnLimit = r.GetReadableColumnCount(),
+        .columnEnd = _compositionCache->absoluteOrigin.x,
+    };
+
+    size_t off = 0;
+    for (const auto& range : activeComposition.attributes)
+    {
+        const auto len = range.len;
+        auto attr = range.attr;
+
+        // Use the color at the cursor if TSF didn't specify any explicit color.
+        if (attr.GetBackground().IsDefault())
+        {
+            attr.SetBackground(_compositionCache->baseAttribute.GetBackground());
+        }
+        if (attr.GetForeground().IsDefault())
+        {
+            attr.SetForeground(_compositionCache->baseAttribute.GetForeground());
+        }
+
+        state.text = text.substr(off, len);
+        state.columnBegin = state.columnEnd;
+        r.ReplaceText(state);
+        r.ReplaceAttributes(state.columnBegin, state.columnEnd, attr);
+        off += len;
+    }
+
+    // The composition isn't part of the console's buffer, so the row needs to be copied again next frame.
+    _snapshot.InvalidateRow(y);
+}
+
 // Routine Description:
 // - Paint helper to draw the cursor within the buffer.
 // Arguments:
@@ -1239,9 +1467,9 @@ void Renderer::_prepareNewComposition()
 // - <none>
 void Renderer::_PaintCursor(_In_ IRenderEngine* const pEngine)
 {
-    if (_currentCursorOptions.inViewport && _currentCursorOptions.isVisible)
+    if (_snapshot.cursor.inViewport && _snapshot.cursor.isVisible)
     {
-        LOG_IF_FAILED(pEngine->PaintCursor(_currentCursorOptions));
+        LOG_IF_FAILED(pEngine->PaintCursor(_snapshot.cursor));
     }
 }
 
@@ -1259,8 +1487,8 @@ void Renderer::_PaintCursor(_In_ IRenderEngine* const pEngine)
 [[nodiscard]] HRESULT Renderer::_PrepareRenderInfo(_In_ IRenderEngine* const pEngine)
 {
     RenderFrameInfo info;
-    info.searchHighlights = _pData->GetSearchHighlights();
-    info.searchHighlightFocused = _pData->GetSearchHighlightFocused();
+    info.searchHighlights = _snapshot.searchHighlights;
+    info.searchHighlightFocused = _snapshot.searchHighlightFocused ? &*_snapshot.searchHighlightFocused : nullptr;
     return pEngine->PrepareRenderInfo(std::move(info));
 }
 
@@ -1277,10 +1505,8 @@ void Renderer::_PaintSelection(_In_ IRenderEngine* const pEngine)
         std::span<const til::rect> dirtyAreas;
         LOG_IF_FAILED(pEngine->GetDirtyArea(dirtyAreas));
 
-        // Get selection rectangles
-        const auto rectangles = _GetSelectionRects();
+        const auto& rectangles = _snapshot.selectionRects;
 
-        std::vector<til::rect> dirtySearchRectangles;
         for (auto& dirtyRect : dirtyAreas)
         {
             for (const auto& rect : rectangles)
@@ -1314,7 +1540,7 @@ void Renderer::_PaintSelection(_In_ IRenderEngine* const pEngine)
 {
     // The last color needs to be each engine's responsibility. If it's local to this function,
     //      then on the next engine we might not update the color.
-    return pEngine->UpdateDrawingBrushes(textAttributes, _renderSettings, _pData, usingSoftFont, isSettingDefaultBrushes);
+    return pEngine->UpdateDrawingBrushes(textAttributes, _snapshot.settings, _pData, usingSoftFont, isSettingDefaultBrushes);
 }
 
 // Routine Description:
@@ -1474,6 +1700,134 @@ void Renderer::UpdateLastHoveredInterval(const std::optional<PointTree::interval
     _hoveredInterval = newInterval;
 }
 
+// Method Description:
+// - Returns how many redraws were dropped so far. The console lock must be held.
+Renderer::FrameSkipCounters Renderer::GetFrameSkipCounters() const noexcept
+{
+    return _frameSkipCounters;
+}
+
+// Routine Description:
+// - Hands the redraws queued up by TriggerRedraw() to the engines.
+// - Applications like progress bars and TUIs frequently rewrite rows with identical contents.
+//   We remember the fingerprint of each visible row as of its last redraw and drop the redraw
+//   if it didn't change since. This relies on the fact that anything that modifies the buffer
+//   calls TriggerRedraw(), TriggerScroll() or TriggerRedrawAll(), which is what keeps the
+//   fingerprints in sync with what the engines show.
+// Arguments:
+// - dropUnchangedRows - If false, all pending redraws are passed on, but the fingerprints are still updated.
+void Renderer::_flushPendingRedraws(const bool dropUnchangedRows)
+{
+    if (_pendingRedraws.empty())
+    {
+        return;
+    }
+
+    const auto& buffer = _pData->GetTextBuffer();
+    const auto view = _pData->GetViewport();
+    const auto rows = std::min(_pendingRedraws.size(), gsl::narrow_cast<size_t>(view.Height()));
+    auto pendingRows = false;
+    auto changedRows = false;
+
+    if (_rowFingerprints.size() < rows)
+    {
+        _rowFingerprints.resize(rows);
+    }
+    _rowChanged.assign(rows, 0);
+
+    for (size_t y = 0; y < rows; ++y)
+    {
+        const auto& pending = til::at(_pendingRedraws, y);
+        if (pending.left >= pending.right)
+        {
+            continue;
+        }
+
+        pendingRows = true;
+
+        const auto& row = buffer.GetRowByOffset(view.Top() + gsl::narrow_cast<til::CoordType>(y));
+        auto& fingerprint = til::at(_rowFingerprints, y);
+        const auto generation = row.GetGeneration();
+
+        // Two rows with the same generation have the same contents, which lets us skip hashing it.
+        if (fingerprint.hash == 0 || fingerprint.generation != generation)
+        {
+            const auto hash = row.GetContentHash();
+            til::at(_rowChanged, y) = !dropUnchangedRows || hash != fingerprint.hash;
+            fingerprint = { generation, hash };
+        }
+        else
+        {
+            til::at(_rowChanged, y) = !dropUnchangedRows;
+        }
+
+        if (til::at(_rowChanged, y))
+        {
+            changedRows = true;
+        }
+        else
+        {
+            _frameSkipCounters.droppedRows++;
+        }
+    }
+
+    if (pendingRows && !changedRows)
+    {
+        _frameSkipCounters.droppedFrames++;
+    }
+
+    // Invalidate consecutive rows with identical columns with a single call.
+    for (size_t y = 0; y < rows;)
+    {
+        const auto& pending = til::at(_pendingRedraws, y);
+        auto end = y + 1;
+
+        if (til::at(_rowChanged, y))
+        {
+            for (; end < rows && til::at(_rowChanged, end) && til::at(_pendingRedraws, end).left == pending.left && til::at(_pendingRedraws, end).right == pending.right; ++end)
+            {
+            }
+
+            const til::rect rect{ pending.left, gsl::narrow_cast<til::CoordType>(y), pending.right, gsl::narrow_cast<til::CoordType>(end) };
+            FOREACH_ENGINE(pEngine)
+            {
+                LOG_IF_FAILED(pEngine->Invalidate(&rect));
+            }
+        }
+
+        y = end;
+    }
+
+    _pendingRedraws.clear();
+}
+
+// Routine Description:
+// - Drops all pending redraws and forgets the row fingerprints.
+//   Used when everything is getting redrawn anyway.
+void Renderer::_resetPendingRedraws() noexcept
+{
+    _pendingRedraws.clear();
+    _rowFingerprints.clear();
+}
+
+// Routine Description:
+// - Returns a hash of the state outside of the text buffer rows that affects how they're drawn.
+//   If it changes, none of the pending redraws may be dropped.
+size_t Renderer::_getDecorationHash() const noexcept
+{
+    const auto buffer = &_pData->GetTextBuffer();
+    til::hasher hasher;
+    hasher.write(&buffer, 1);
+    hasher.write(_hyperlinkHoveredId);
+    hasher.write(static_cast<uint8_t>(_pData->IsGridLineDrawingAllowed()));
+    if (_hoveredInterval)
+    {
+        hasher.write(_hoveredInterval->start);
+        hasher.write(_hoveredInterval->stop);
+    }
+    return hasher.finalize();
+}
+
 // Method Description:
 // - Blocks until the engines are able to render without blocking.
 void Renderer::WaitUntilCanRender()
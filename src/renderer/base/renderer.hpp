@@ -19,6 +19,7 @@ Author(s):
 #include "../inc/IRenderEngine.hpp"
 #include "../inc/RenderSettings.hpp"
 
+#include "RenderSnapshot.hpp"
 #include "thread.hpp"
 
 #include "../../buffer/out/textBuffer.hpp"
@@ -85,7 +86,34 @@ namespace Microsoft::Console::Render
         void UpdateHyperlinkHoveredId(uint16_t id) noexcept;
         void UpdateLastHoveredInterval(const std::optional<interval_tree::IntervalTree<til::point, size_t>::interval>& newInterval);
 
+        // Counts the redraws that got dropped, because the rows already looked the same on screen.
+        struct FrameSkipCounters
+        {
+            // Rows whose redraw was dropped.
+            uint64_t droppedRows = 0;
+            // Frames in which every requested redraw was dropped. Unless something else
+            // got invalidated as well (the cursor for instance) nothing gets painted at all.
+            uint64_t droppedFrames = 0;
+        };
+
+        FrameSkipCounters GetFrameSkipCounters() const noexcept;
+
     private:
+        // The state of a visible row the last time its redraw was handed to the engines.
+        struct RowFingerprint
+        {
+            uint64_t generation = 0;
+            // 0 if unknown.
+            size_t hash = 0;
+        };
+
+        // The columns [left, right) of a visible row that are waiting to be redrawn.
+        struct PendingRedraw
+        {
+            til::CoordType left = til::CoordTypeMax;
+            til::CoordType right = til::CoordTypeMin;
+        };
+
         // Caches some essential information about the active composition.
         // This allows us to properly invalidate it between frames, etc.
         struct CompositionCache
@@ -99,10 +127,12 @@ namespace Microsoft::Console::Render
 
         [[nodiscard]] HRESULT _PaintFrame() noexcept;
         [[nodiscard]] HRESULT _PaintFrameForEngine(_In_ IRenderEngine* const pEngine) noexcept;
+        [[nodiscard]] HRESULT _PaintFrameContents(_In_ IRenderEngine* const pEngine) noexcept;
         bool _CheckViewportAndScroll();
         [[nodiscard]] HRESULT _PaintBackground(_In_ IRenderEngine* const pEngine);
         void _PaintBufferOutput(_In_ IRenderEngine* const pEngine);
         void _PaintBufferOutputHelper(_In_ IRenderEngine* const pEngine, TextBufferCellIterator it, const til::point target, const bool lineWrapped);
+        [[nodiscard]] HRESULT _PaintBufferRow(_In_ IRenderEngine* const pEngine, const ROW& row, const Microsoft::Console::Types::Viewport& bufferLine, const til::CoordType targetRow, const bool lineWrapped);
         void _PaintBufferOutputGridLineHelper(_In_ IRenderEngine* const pEngine, const TextAttribute textAttribute, const size_t cchLine, const til::point coordTarget);
         bool _isHoveredHyperlink(const TextAttribute& textAttribute) const noexcept;
         void _PaintSelection(_In_ IRenderEngine* const pEngine);
@@ -117,7 +147,11 @@ namespace Microsoft::Console::Render
         void _invalidateCurrentCursor() const;
         void _invalidateOldComposition() const;
         void _prepareNewComposition();
+        void _publishSnapshot();
         [[nodiscard]] HRESULT _PrepareRenderInfo(_In_ IRenderEngine* const pEngine);
+        void _flushPendingRedraws(const bool dropUnchangedRows);
+        void _resetPendingRedraws() noexcept;
+        size_t _getDecorationHash() const noexcept;
 
         const RenderSettings& _renderSettings;
         std::array<IRenderEngine*, 2> _engines{};
@@ -130,8 +164,17 @@ namespace Microsoft::Console::Render
         Microsoft::Console::Types::Viewport _viewport;
         CursorOptions _currentCursorOptions;
         std::optional<CompositionCache> _compositionCache;
+        // Everything below _PaintFrameContents() reads from the snapshot instead of _pData.
+        RenderSnapshot _snapshot;
         std::vector<Cluster> _clusterBuffer;
+        std::vector<BufferRowRun> _rowRuns;
+        std::vector<uint16_t> _rowCharOffsets;
         std::vector<til::rect> _previousSelection;
+        std::vector<PendingRedraw> _pendingRedraws;
+        std::vector<RowFingerprint> _rowFingerprints;
+        std::vector<uint8_t> _rowChanged;
+        size_t _lastDecorationHash = 0;
+        FrameSkipCounters _frameSkipCounters;
         std::function<void()> _pfnBackgroundColorChanged;
         std::function<void()> _pfnFrameColorChanged;
         std::function<void()> _pfnRendererEnteredErrorState;
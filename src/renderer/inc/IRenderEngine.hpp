@@ -51,6 +51,36 @@ namespace Microsoft::Console::Render
     };
     using GridLineSet = til::enumset<GridLines>;
 
+    // A run of cells in a BufferRow that share the same attributes.
+    struct BufferRowRun
+    {
+        TextAttribute attributes;
+        // The gridlines are only set if IRenderData::IsGridLineDrawingAllowed().
+        GridLineSet gridlines;
+        COLORREF gridlineColor = 0;
+        COLORREF underlineColor = 0;
+        til::CoordType columnBegin = 0;
+        til::CoordType columnEnd = 0;
+    };
+
+    // The dirty part of a row, as passed to IRenderEngine::PaintBufferRow().
+    // The columns are buffer columns, just like the coord.x given to PaintBufferLine().
+    struct BufferRow
+    {
+        // The text of the columns [columnBegin, columnEnd).
+        std::wstring_view text;
+        // For each column in [columnBegin, columnEnd] the offset into `text` at which it begins.
+        // Both halves of a wide glyph have the same offset. Has columnEnd - columnBegin + 1 items.
+        std::span<const uint16_t> charOffsets;
+        // Covers [columnBegin, columnEnd) without gaps.
+        std::span<const BufferRowRun> runs;
+        til::CoordType columnBegin;
+        til::CoordType columnEnd;
+        til::CoordType targetRow;
+        LineRendition lineRendition;
+        bool lineWrapped;
+    };
+
     class __declspec(novtable) IRenderEngine
     {
     public:
@@ -60,6 +90,10 @@ namespace Microsoft::Console::Render
         [[nodiscard]] virtual HRESULT StartPaint() noexcept = 0;
         [[nodiscard]] virtual HRESULT EndPaint() noexcept = 0;
         [[nodiscard]] virtual bool RequiresContinuousRedraw() noexcept = 0;
+        // If true, only StartPaint() is called while the console lock is held. Everything up to and including
+        // EndPaint() happens without it, concurrently with Invalidate*(), UpdateViewport(), UpdateTitle(), etc.
+        // calls from other threads. The engine must not access the IRenderData given to UpdateDrawingBrushes().
+        [[nodiscard]] virtual bool SupportsUnlockedPainting() noexcept = 0;
         virtual void WaitUntilCanRender() noexcept = 0;
         [[nodiscard]] virtual HRESULT Present() noexcept = 0;
         [[nodiscard]] virtual HRESULT ScrollFrame() noexcept = 0;
@@ -77,6 +111,9 @@ namespace Microsoft::Console::Render
         [[nodiscard]] virtual HRESULT PrepareLineTransform(LineRendition lineRendition, til::CoordType targetRow, til::CoordType viewportLeft) noexcept = 0;
         [[nodiscard]] virtual HRESULT PaintBackground() noexcept = 0;
         [[nodiscard]] virtual HRESULT PaintBufferLine(std::span<const Cluster> clusters, til::point coord, bool fTrimLeft, bool lineWrapped) noexcept = 0;
+        // Optional alternative to the UpdateDrawingBrushes(), PaintBufferLine() and PaintBufferGridLines() calls for an entire row.
+        // Returns S_FALSE if the engine doesn't support it, in which case the Renderer falls back to the other calls.
+        [[nodiscard]] virtual HRESULT PaintBufferRow(const BufferRow& row, const RenderSettings& renderSettings) noexcept = 0;
         [[nodiscard]] virtual HRESULT PaintBufferGridLines(GridLineSet lines, COLORREF gridlineColor, COLORREF underlineColor, size_t cchLine, til::point coordTarget) noexcept = 0;
         [[nodiscard]] virtual HRESULT PaintImageSlice(const ImageSlice& imageSlice, til::CoordType targetRow, til::CoordType viewportLeft) noexcept = 0;
         [[nodiscard]] virtual HRESULT PaintSelection(const til::rect& rect) noexcept = 0;
@@ -0,0 +1,603 @@
+/*++
+Copyright (c) Microsoft Corporation
+Licensed under the MIT license.
+
+Module Name:
+- RecordingRenderEngine.hpp
+
+Abstract:
+- A headless render engine that doesn't draw anything. Instead, it records the
+    calls the Renderer makes into a text log with one line per primitive, and
+    keeps call counts and timings per primitive. This allows tests and
+    benchmarks to drive the entire Renderer without a window or a GPU, and to
+    diff the frames of two runs against each other.
+- Like a real engine it tracks a dirty region in cells, which it shifts when the
+    viewport scrolls, so that the Renderer only repaints what actually changed.
+- StartPaint() takes over the dirty region and resets it, so that the engine can
+    optionally be painted without the console lock (see SetUnlockedPainting()).
+--*/
+
+#pragma once
+
+#include "RenderEngineBase.hpp"
+
+#include <chrono>
+
+namespace Microsoft::Console::Render
+{
+    class RecordingRenderEngine final : public RenderEngineBase
+    {
+    public:
+        enum class Primitive : size_t
+        {
+            StartPaint,
+            EndPaint,
+            Present,
+            ScrollFrame,
+            PaintBackground,
+            UpdateDrawingBrushes,
+            PrepareLineTransform,
+            PaintBufferLine,
+            PaintBufferRow,
+            PaintBufferGridLines,
+            PaintImageSlice,
+            PaintSelection,
+            PaintCursor,
+            Count,
+        };
+
+        static constexpr std::array<std::string_view, static_cast<size_t>(Primitive::Count)> PrimitiveNames{
+            "startPaint",
+            "endPaint",
+            "present",
+            "scrollFrame",
+            "paintBackground",
+            "updateDrawingBrushes",
+            "prepareLineTransform",
+            "paintBufferLine",
+            "paintBufferRow",
+            "paintBufferGridLines",
+            "paintImageSlice",
+            "paintSelection",
+            "paintCursor",
+        };
+
+        struct PrimitiveStats
+        {
+            uint64_t calls = 0;
+            // Each call is charged the time that elapsed since the previous call into the engine
+            // during the same frame. This includes the work the Renderer did to prepare the call,
+            // which is usually what we're interested in, since this engine itself does next to nothing.
+            std::chrono::nanoseconds time{};
+        };
+
+        static constexpr til::size CellSize{ 8, 16 };
+
+        // Turning the recording off only keeps the statistics, which is useful for
+        // benchmarks, where formatting the log would dominate the measurements.
+        void SetRecording(const bool enabled) noexcept
+        {
+            _recording = enabled;
+        }
+
+        // By default rows are painted cluster by cluster via PaintBufferLine(),
+        // which is what most engines do. This opts into PaintBufferRow() instead.
+        void SetRowPainting(const bool enabled) noexcept
+        {
+            _rowPainting = enabled;
+        }
+
+        // Lets the Renderer paint this engine without holding the console lock.
+        // The log is identical either way, which is what the tests rely on.
+        void SetUnlockedPainting(const bool enabled) noexcept
+        {
+            _unlockedPainting = enabled;
+        }
+
+        std::string_view Log() const noexcept
+        {
+            return _log;
+        }
+
+        void ClearLog() noexcept
+        {
+            _log.clear();
+        }
+
+        uint64_t FrameCount() const noexcept
+        {
+            return _frameCount;
+        }
+
+        std::span<const PrimitiveStats> Stats() const noexcept
+        {
+            return _stats;
+        }
+
+        const PrimitiveStats& Stats(const Primitive primitive) const noexcept
+        {
+            return til::at(_stats, static_cast<size_t>(primitive));
+        }
+
+        void ResetStats() noexcept
+        {
+            _stats = {};
+            _frameCount = 0;
+        }
+
+        [[nodiscard]] bool SupportsUnlockedPainting() noexcept override
+        {
+            return _unlockedPainting;
+        }
+
+        [[nodiscard]] HRESULT StartPaint() noexcept override
+        try
+        {
+            if (_invalidatedTitle)
+            {
+                _titleChanged = _titleChanged || *_invalidatedTitle != _lastFrameTitle;
+                _invalidatedTitle.reset();
+            }
+
+            if (!_dirty && _scrollDelta == til::point{} && !_titleChanged)
+            {
+                return S_FALSE;
+            }
+
+            // From here on until EndPaint() only the paint* fields are used.
+            _paintDirty = std::exchange(_dirty, {});
+            _paintScrollDelta = std::exchange(_scrollDelta, {});
+
+            _lastCall = std::chrono::steady_clock::now();
+            _charge(Primitive::StartPaint);
+            ++_frameCount;
+
+            if (_recording)
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("frame {} dirty {},{},{},{}\n"), _frameCount, _paintDirty.left, _paintDirty.top, _paintDirty.right, _paintDirty.bottom);
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT EndPaint() noexcept override
+        try
+        {
+            _charge(Primitive::EndPaint);
+            _paintDirty = {};
+            _paintScrollDelta = {};
+            _titleChanged = false;
+
+            if (_recording)
+            {
+                _log.append("end\n");
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        void WaitUntilCanRender() noexcept override
+        {
+        }
+
+        [[nodiscard]] HRESULT Present() noexcept override
+        try
+        {
+            _charge(Primitive::Present);
+
+            if (_recording)
+            {
+                _log.append("present\n");
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT ScrollFrame() noexcept override
+        try
+        {
+            _charge(Primitive::ScrollFrame);
+
+            if (_recording && _paintScrollDelta != til::point{})
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("scroll {},{}\n"), _paintScrollDelta.x, _paintScrollDelta.y);
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT Invalidate(const til::rect* const psrRegion) noexcept override
+        {
+            _dirty |= *psrRegion & _viewportCells;
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT InvalidateCursor(const til::rect* const psrRegion) noexcept override
+        {
+            return Invalidate(psrRegion);
+        }
+
+        [[nodiscard]] HRESULT InvalidateSystem(const til::rect* const prcDirtyClient) noexcept override
+        {
+            const auto cells = til::rect{
+                prcDirtyClient->left / CellSize.width,
+                prcDirtyClient->top / CellSize.height,
+                (prcDirtyClient->right + CellSize.width - 1) / CellSize.width,
+                (prcDirtyClient->bottom + CellSize.height - 1) / CellSize.height,
+            };
+            return Invalidate(&cells);
+        }
+
+        [[nodiscard]] HRESULT InvalidateSelection(const std::vector<til::rect>& rectangles) noexcept override
+        {
+            for (const auto& rect : rectangles)
+            {
+                RETURN_IF_FAILED(Invalidate(&rect));
+            }
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT InvalidateScroll(const til::point* const pcoordDelta) noexcept override
+        {
+            const auto delta = *pcoordDelta;
+            if (delta == til::point{})
+            {
+                return S_OK;
+            }
+
+            _scrollDelta = { _scrollDelta.x + delta.x, _scrollDelta.y + delta.y };
+
+            // Whatever was dirty moves along with the contents. The area that
+            // scrolled into view is new and needs to be painted as well.
+            if (_dirty)
+            {
+                _dirty = til::rect{ _dirty.left + delta.x, _dirty.top + delta.y, _dirty.right + delta.x, _dirty.bottom + delta.y } & _viewportCells;
+            }
+
+            const auto width = _viewportCells.width();
+            const auto height = _viewportCells.height();
+            if (delta.y > 0)
+            {
+                _dirty |= til::rect{ 0, 0, width, std::min(delta.y, height) };
+            }
+            else if (delta.y < 0)
+            {
+                _dirty |= til::rect{ 0, std::max(0, height + delta.y), width, height };
+            }
+            if (delta.x > 0)
+            {
+                _dirty |= til::rect{ 0, 0, std::min(delta.x, width), height };
+            }
+            else if (delta.x < 0)
+            {
+                _dirty |= til::rect{ std::max(0, width + delta.x), 0, width, height };
+            }
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT InvalidateAll() noexcept override
+        {
+            _dirty = _viewportCells;
+            return S_OK;
+        }
+
+        // Unlike RenderEngineBase this doesn't compare the title right away, because
+        // _lastFrameTitle belongs to the painting thread. StartPaint() does it instead.
+        [[nodiscard]] HRESULT InvalidateTitle(const std::wstring_view proposedTitle) noexcept override
+        try
+        {
+            _invalidatedTitle.emplace(proposedTitle);
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT PrepareLineTransform(const LineRendition lineRendition, const til::CoordType targetRow, const til::CoordType viewportLeft) noexcept override
+        try
+        {
+            _charge(Primitive::PrepareLineTransform);
+
+            if (_recording && lineRendition != LineRendition::SingleWidth)
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("rendition {} row={} left={}\n"), static_cast<int>(lineRendition), targetRow, viewportLeft);
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT PaintBackground() noexcept override
+        try
+        {
+            _charge(Primitive::PaintBackground);
+
+            if (_recording)
+            {
+                _log.append("background\n");
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT PaintBufferLine(const std::span<const Cluster> clusters, const til::point coord, const bool fTrimLeft, const bool lineWrapped) noexcept override
+        try
+        {
+            _charge(Primitive::PaintBufferLine);
+
+            if (_recording)
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("line {},{} \""), coord.x, coord.y);
+
+                auto uniformWidth = true;
+                _text.clear();
+                for (const auto& cluster : clusters)
+                {
+                    _appendEscaped(_text, cluster.GetText());
+                    uniformWidth &= cluster.GetColumns() == 1;
+                }
+                THROW_IF_FAILED(til::u16u8(_text, _utf8));
+                _log.append(_utf8);
+                _log.push_back('"');
+
+                if (!uniformWidth)
+                {
+                    _log.append(" cols=");
+                    for (const auto& cluster : clusters)
+                    {
+                        fmt::format_to(std::back_inserter(_log), FMT_COMPILE("{}"), cluster.GetColumns());
+                    }
+                }
+                if (fTrimLeft)
+                {
+                    _log.append(" trim");
+                }
+                if (lineWrapped)
+                {
+                    _log.append(" wrap");
+                }
+                _log.push_back('\n');
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT PaintBufferRow(const BufferRow& row, const RenderSettings& renderSettings) noexcept override
+        try
+        {
+            if (!_rowPainting)
+            {
+                return S_FALSE;
+            }
+
+            _charge(Primitive::PaintBufferRow);
+
+            if (_recording)
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("row {}-{},{} \""), row.columnBegin, row.columnEnd, row.targetRow);
+                _text.clear();
+                _appendEscaped(_text, row.text);
+                THROW_IF_FAILED(til::u16u8(_text, _utf8));
+                _log.append(_utf8);
+                _log.push_back('"');
+
+                for (const auto& run : row.runs)
+                {
+                    const auto [fg, bg] = renderSettings.GetAttributeColors(run.attributes);
+                    fmt::format_to(std::back_inserter(_log), FMT_COMPILE(" {}-{}:"), run.columnBegin, run.columnEnd);
+                    _appendColor(fg);
+                    _appendColor(bg);
+                    if (run.gridlines.any())
+                    {
+                        fmt::format_to(std::back_inserter(_log), FMT_COMPILE(":{:#x}"), run.gridlines.bits());
+                    }
+                }
+                if (row.lineWrapped)
+                {
+                    _log.append(" wrap");
+                }
+                _log.push_back('\n');
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT PaintBufferGridLines(const GridLineSet lines, const COLORREF gridlineColor, const COLORREF underlineColor, const size_t cchLine, const til::point coordTarget) noexcept override
+        try
+        {
+            _charge(Primitive::PaintBufferGridLines);
+
+            if (_recording && lines.any())
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("grid {},{} n={} lines={:#x} "), coordTarget.x, coordTarget.y, cchLine, lines.bits());
+                _appendColor(gridlineColor);
+                _log.push_back(' ');
+                _appendColor(underlineColor);
+                _log.push_back('\n');
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT PaintImageSlice(const ImageSlice& imageSlice, const til::CoordType targetRow, const til::CoordType viewportLeft) noexcept override
+        try
+        {
+            _charge(Primitive::PaintImageSlice);
+
+            if (_recording)
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("image row={} left={} cols={}-{}\n"), targetRow, viewportLeft, imageSlice.ColumnOffset(), imageSlice.ColumnEnd());
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT PaintSelection(const til::rect& rect) noexcept override
+        try
+        {
+            _charge(Primitive::PaintSelection);
+
+            if (_recording)
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("selection {},{},{},{}\n"), rect.left, rect.top, rect.right, rect.bottom);
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT PaintCursor(const CursorOptions& options) noexcept override
+        try
+        {
+            _charge(Primitive::PaintCursor);
+
+            if (_recording)
+            {
+                fmt::format_to(std::back_inserter(_log), FMT_COMPILE("cursor {},{} type={} height={}{}\n"), options.coordCursor.x, options.coordCursor.y, static_cast<int>(options.cursorType), options.ulCursorHeightPercent, options.fIsDoubleWidth ? " wide" : "");
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT UpdateDrawingBrushes(const TextAttribute& textAttributes, const RenderSettings& renderSettings, const gsl::not_null<IRenderData*> /*pData*/, const bool usingSoftFont, const bool isSettingDefaultBrushes) noexcept override
+        try
+        {
+            _charge(Primitive::UpdateDrawingBrushes);
+
+            if (_recording)
+            {
+                const auto [fg, bg] = renderSettings.GetAttributeColors(textAttributes);
+                _log.append(isSettingDefaultBrushes ? "brush default " : "brush ");
+                _appendColor(fg);
+                _log.push_back(' ');
+                _appendColor(bg);
+                if (textAttributes.IsIntense())
+                {
+                    _log.append(" intense");
+                }
+                if (textAttributes.IsItalic())
+                {
+                    _log.append(" italic");
+                }
+                if (usingSoftFont)
+                {
+                    _log.append(" softfont");
+                }
+                _log.push_back('\n');
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+        [[nodiscard]] HRESULT UpdateFont(const FontInfoDesired& /*FontInfoDesired*/, _Out_ FontInfo& /*FontInfo*/) noexcept override
+        {
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT UpdateDpi(const int /*iDpi*/) noexcept override
+        {
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT UpdateViewport(const til::inclusive_rect& srNewViewport) noexcept override
+        {
+            const til::rect viewportCells{ 0, 0, srNewViewport.right - srNewViewport.left + 1, srNewViewport.bottom - srNewViewport.top + 1 };
+            if (viewportCells != _viewportCells)
+            {
+                _viewportCells = viewportCells;
+                _dirty = viewportCells;
+            }
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT GetProposedFont(const FontInfoDesired& /*FontInfoDesired*/, _Out_ FontInfo& /*FontInfo*/, const int /*iDpi*/) noexcept override
+        {
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT GetDirtyArea(std::span<const til::rect>& area) noexcept override
+        {
+            area = { &_paintDirty, 1 };
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT GetFontSize(_Out_ til::size* const pFontSize) noexcept override
+        {
+            *pFontSize = CellSize;
+            return S_OK;
+        }
+
+        [[nodiscard]] HRESULT IsGlyphWideByFont(const std::wstring_view /*glyph*/, _Out_ bool* const pResult) noexcept override
+        {
+            *pResult = false;
+            return S_OK;
+        }
+
+    protected:
+        [[nodiscard]] HRESULT _DoUpdateTitle(const std::wstring_view newTitle) noexcept override
+        try
+        {
+            if (_recording)
+            {
+                _log.append("title \"");
+                _text.clear();
+                _appendEscaped(_text, newTitle);
+                THROW_IF_FAILED(til::u16u8(_text, _utf8));
+                _log.append(_utf8);
+                _log.append("\"\n");
+            }
+            return S_OK;
+        }
+        CATCH_RETURN()
+
+    private:
+        void _charge(const Primitive primitive) noexcept
+        {
+            const auto now = std::chrono::steady_clock::now();
+            auto& stats = til::at(_stats, static_cast<size_t>(primitive));
+            stats.calls++;
+            stats.time += now - _lastCall;
+            _lastCall = now;
+        }
+
+        // Quotes and control characters are escaped so that each primitive stays on a single line.
+        static void _appendEscaped(std::wstring& out, const std::wstring_view text)
+        {
+            for (const auto ch : text)
+            {
+                if (ch == L'"' || ch == L'\\')
+                {
+                    out.push_back(L'\\');
+                    out.push_back(ch);
+                }
+                else if (ch < L' ' || ch == 0x7f)
+                {
+                    fmt::format_to(std::back_inserter(out), FMT_COMPILE(L"\\x{:02x}"), static_cast<unsigned>(ch));
+                }
+                else
+                {
+                    out.push_back(ch);
+                }
+            }
+        }
+
+        void _appendColor(const COLORREF color)
+        {
+            fmt::format_to(std::back_inserter(_log), FMT_COMPILE("#{:02x}{:02x}{:02x}"), GetRValue(color), GetGValue(color), GetBValue(color));
+        }
+
+        std::string _log;
+        std::wstring _text;
+        std::string _utf8;
+        bool _recording = true;
+        bool _rowPainting = false;
+        bool _unlockedPainting = false;
+
+        til::rect _viewportCells;
+        til::rect _dirty;
+        til::point _scrollDelta;
+        std::optional<std::wstring> _invalidatedTitle;
+        til::rect _paintDirty;
+        til::point _paintScrollDelta;
+
+        std::array<PrimitiveStats, static_cast<size_t>(Primitive::Count)> _stats{};
+        std::chrono::steady_clock::time_point _lastCall;
+        uint64_t _frameCount = 0;
+    };
+}
@@ -42,11 +42,14 @@ namespace Microsoft::Console::Render
                                                    const til::CoordType targetRow,
                                                    const til::CoordType viewportLeft) noexcept override;
 
+        [[nodiscard]] HRESULT PaintBufferRow(const BufferRow& row, const RenderSettings& renderSettings) noexcept override;
+
         [[nodiscard]] HRESULT PaintImageSlice(const ImageSlice& imageSlice,
                                               const til::CoordType targetRow,
                                               const til::CoordType viewportLeft) noexcept override;
 
         [[nodiscard]] bool RequiresContinuousRedraw() noexcept override;
+        [[nodiscard]] bool SupportsUnlockedPainting() noexcept override;
 
         void WaitUntilCanRender() noexcept override;
         void UpdateHyperlinkHoveredId(const uint16_t hoveredId) noexcept override;
@@ -43,6 +43,8 @@ namespace Microsoft::Console::Render
         std::pair<COLORREF, COLORREF> GetAttributeColorsWithAlpha(const TextAttribute& attr) const noexcept;
         COLORREF GetAttributeUnderlineColor(const TextAttribute& attr) const noexcept;
         void ToggleBlinkRendition(class Renderer* renderer) noexcept;
+        bool IsBlinkInUse() const noexcept;
+        void MergeBlinkUsage(const RenderSettings& other) const noexcept;
 
     private:
         til::enumset<Mode> _renderMode{ Mode::BlinkAllowed, Mode::IntenseIsBright };
@@ -805,6 +805,12 @@ void SixelParser::_maybeFlushImageBuffer(const bool endOfSequence)
                         }
                         std::advance(dstIterator, dstSlice->PixelWidth());
                     }
+                    // Once the image is complete, rows with identical content can share their
+                    // pixels. This is skipped for partial output, since it'll be overwritten anyway.
+                    if (endOfSequence)
+                    {
+                        page.Buffer().GetImageTileTable().Deduplicate(*dstSlice);
+                    }
                 }
                 else
                 {
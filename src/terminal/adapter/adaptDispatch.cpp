@@ -606,8 +606,9 @@ void AdaptDispatch::_ScrollRectVertically(const Page& page, const til::rect& scr
         if (width == page.Width())
         {
             // If the scrollRect is the full width of the buffer, we can scroll
-            // more efficiently by rotating the row storage.
-            textBuffer.ScrollRows(top, height, actualDelta);
+            // more efficiently by rotating the row storage. The rows revealed
+            // by the scroll are erased below, so they don't need to be kept.
+            textBuffer.ScrollRows(top, height, actualDelta, false);
             textBuffer.TriggerRedraw(Viewport::FromExclusive(scrollRect));
         }
         else
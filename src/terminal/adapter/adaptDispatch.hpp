@@ -314,6 +314,20 @@ namespace Microsoft::Console::VirtualTerminal
 
         SgrStack _sgrStack;
 
+        // Colored output repeats the same few SGR sequences over and over, which is why
+        // SetGraphicsRendition() caches the attribute that results from applying a given
+        // list of plain parameters to a given attribute. It's a small direct-mapped cache.
+        // Entries don't need to be invalidated, because the result depends on nothing else.
+        static constexpr size_t SgrCacheMaxParameters = 8;
+        struct SgrCacheEntry
+        {
+            TextAttribute input;
+            TextAttribute output;
+            std::array<VTInt, SgrCacheMaxParameters> parameters{};
+            size_t parameterCount = 0;
+        };
+        std::array<SgrCacheEntry, 32> _sgrCache;
+
         void _SetUnderlineStyleHelper(const VTParameter option, TextAttribute& attr) noexcept;
         size_t _SetRgbColorsHelper(const VTParameters options,
                                    TextAttribute& attr,
@@ -329,6 +343,8 @@ namespace Microsoft::Console::VirtualTerminal
                                                TextAttribute& attr) noexcept;
         void _ApplyGraphicsOptions(const VTParameters options,
                                    TextAttribute& attr) noexcept;
+        void _ApplyCachedGraphicsOptions(const VTParameters options,
+                                         TextAttribute& attr) noexcept;
 
 #ifdef UNIT_TESTING
         friend class AdapterTest;
@@ -6,6 +6,8 @@
 #include "adaptDispatch.hpp"
 #include "../../types/inc/utils.hpp"
 
+#include <til/hash.h>
+
 #define ENABLE_INTSAFE_SIGNED_FUNCTIONS
 #include <intsafe.h>
 
@@ -410,6 +412,51 @@ void AdaptDispatch::_ApplyGraphicsOptions(const VTParameters options,
     }
 }
 
+// Routine Description:
+// - Same as _ApplyGraphicsOptions(), but looks the result up in _sgrCache first.
+//   Only short parameter lists without sub parameters are cached.
+// Arguments:
+// - options - An array of options that will be applied in sequence.
+// - attr - The attribute that will be updated with the applied options.
+// Return Value:
+// - <none>
+void AdaptDispatch::_ApplyCachedGraphicsOptions(const VTParameters options,
+                                                TextAttribute& attr) noexcept
+{
+    const auto count = options.size();
+    if (count > SgrCacheMaxParameters || options.hasSubParams())
+    {
+        _ApplyGraphicsOptions(options, attr);
+        return;
+    }
+
+    std::array<VTInt, SgrCacheMaxParameters> parameters{};
+    for (size_t i = 0; i < count; ++i)
+    {
+        // This retains the distinction between omitted and 0 parameters.
+        til::at(parameters, i) = options.at(i).value();
+    }
+
+    til::hasher hasher;
+    hasher.write(static_cast<const void*>(&attr), sizeof(TextAttribute));
+    hasher.write(static_cast<const void*>(parameters.data()), count * sizeof(parameters[0]));
+    auto& entry = til::at(_sgrCache, hasher.finalize() % _sgrCache.size());
+
+    // The hash only selects the slot. A hit must match the entry's input and all of its parameters,
+    // because different parameter lists may end up in the same slot.
+    if (entry.parameterCount == count && entry.input == attr && entry.parameters == parameters)
+    {
+        attr = entry.output;
+        return;
+    }
+
+    entry.input = attr;
+    entry.parameters = parameters;
+    entry.parameterCount = count;
+    _ApplyGraphicsOptions(options, attr);
+    entry.output = attr;
+}
+
 // Routine Description:
 // - SGR - Modifies the graphical rendering options applied to the next
 //   characters written into the buffer.
@@ -424,7 +471,7 @@ bool AdaptDispatch::SetGraphicsRendition(const VTParameters options)
 {
     const auto page = _pages.ActivePage();
     auto attr = page.Attributes();
-    _ApplyGraphicsOptions(options, attr);
+    _ApplyCachedGraphicsOptions(options, attr);
     page.SetAttributes(attr, &_api);
     return true;
 }
@@ -1472,6 +1472,74 @@ public:
         VERIFY_IS_TRUE(_testGetSet->_textBuffer->GetCurrentAttributes().IsIntense());
     }
 
+    TEST_METHOD(GraphicsCacheTests)
+    {
+        Log::Comment(L"Starting test...");
+
+        _testGetSet->PrepData(); // default color from here is gray on black, FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED
+
+        VTParameter rgOptions[16];
+        size_t cOptions = 1;
+
+        Log::Comment(L"Resetting graphics options");
+        rgOptions[0] = DispatchTypes::GraphicsOptions::Off;
+        _testGetSet->_expectedAttribute = {};
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+
+        Log::Comment(L"Applying the same options twice must yield the same result both times");
+        rgOptions[0] = DispatchTypes::GraphicsOptions::ForegroundExtended;
+        rgOptions[1] = DispatchTypes::GraphicsOptions::BlinkOrXterm256Index;
+        rgOptions[2] = 208;
+        cOptions = 3;
+        _testGetSet->_expectedAttribute.SetIndexedForeground256(208);
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+
+        Log::Comment(L"Cached results must depend on the attribute they were applied to");
+        rgOptions[0] = DispatchTypes::GraphicsOptions::Off;
+        cOptions = 1;
+        _testGetSet->_expectedAttribute = {};
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+
+        rgOptions[0] = DispatchTypes::GraphicsOptions::Italics;
+        _testGetSet->_expectedAttribute.SetItalic(true);
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+
+        rgOptions[0] = DispatchTypes::GraphicsOptions::ForegroundExtended;
+        rgOptions[1] = DispatchTypes::GraphicsOptions::BlinkOrXterm256Index;
+        rgOptions[2] = 208;
+        cOptions = 3;
+        _testGetSet->_expectedAttribute.SetIndexedForeground256(208);
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+        VERIFY_IS_TRUE(_testGetSet->_textBuffer->GetCurrentAttributes().IsItalic());
+
+        Log::Comment(L"Parameter lists that only differ in their last parameter must not share a cached result");
+        rgOptions[0] = DispatchTypes::GraphicsOptions::Off;
+        cOptions = 1;
+        _testGetSet->_expectedAttribute = {};
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+
+        rgOptions[0] = DispatchTypes::GraphicsOptions::ForegroundExtended;
+        rgOptions[1] = DispatchTypes::GraphicsOptions::RGBColorOrFaint;
+        rgOptions[2] = 1;
+        rgOptions[3] = 2;
+        rgOptions[4] = 3;
+        cOptions = 5;
+        _testGetSet->_expectedAttribute.SetForeground(RGB(1, 2, 3));
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+
+        rgOptions[0] = DispatchTypes::GraphicsOptions::Off;
+        cOptions = 1;
+        _testGetSet->_expectedAttribute = {};
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+
+        rgOptions[0] = DispatchTypes::GraphicsOptions::ForegroundExtended;
+        rgOptions[4] = 4;
+        cOptions = 5;
+        _testGetSet->_expectedAttribute.SetForeground(RGB(1, 2, 4));
+        VERIFY_IS_TRUE(_pDispatch->SetGraphicsRendition({ rgOptions, cOptions }));
+    }
+
     TEST_METHOD(DeviceStatusReportTests)
     {
         Log::Comment(L"Starting test...");
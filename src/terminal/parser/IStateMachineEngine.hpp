@@ -50,6 +50,11 @@ namespace Microsoft::Console::VirtualTerminal
 
         virtual bool ActionSs3Dispatch(const wchar_t wch, const VTParameters parameters) = 0;
 
+        // Gives the engine a chance to process a burst of sequences at the start of the
+        // string in one go, instead of sending them through the state machine one by one.
+        // `consumed` receives the number of characters that were processed.
+        virtual bool ActionBatchDispatch(const std::wstring_view string, size_t& consumed) = 0;
+
     protected:
         IStateMachineEngine() = default;
     };
@@ -9,6 +9,7 @@
 #include <til/atomic.h>
 
 #include "../../inc/unicode.hpp"
+#include "../../types/inc/utils.hpp"
 #include "../../interactivity/inc/VtApiRedirection.hpp"
 
 using namespace Microsoft::Console::VirtualTerminal;
@@ -89,6 +90,52 @@ static bool operator==(const Ss3ToVkey& pair, const Ss3ActionCodes code) noexcep
     return pair.action == code;
 }
 
+// Parses the parameters of a CSI sequence that starts at `beg` the same way the state machine would,
+// as long as there are no more than N of them. Returns a pointer to the final character of
+// the sequence or nullptr if the sequence is incomplete or has too many parameters.
+#pragma warning(push)
+#pragma warning(disable : 26481) // Don't use pointer arithmetic. Use span instead (bounds.1).
+
+template<size_t N>
+static const wchar_t* parseBatchParameters(const wchar_t* beg, const wchar_t* end, std::array<VTParameter, N>& parameters, size_t& count) noexcept
+{
+    const auto final = Microsoft::Console::Utils::FindNonParameterCharacter(beg, end - beg);
+    if (final == end)
+    {
+        return nullptr;
+    }
+
+    std::array<VTInt, N> values;
+    values.fill(-1);
+    count = final != beg ? 1 : 0;
+
+    for (auto it = beg; it < final; ++it)
+    {
+        const auto wch = *it;
+        if (wch == L';')
+        {
+            if (count == N)
+            {
+                return nullptr;
+            }
+            ++count;
+            continue;
+        }
+
+        // Values larger than the maximum are mapped to the largest supported value, just like in the state machine.
+        auto& value = til::at(values, count - 1);
+        value = std::min(std::max(value, 0) * 10 + (wch - L'0'), MAX_PARAMETER_VALUE);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        til::at(parameters, i) = til::at(values, i);
+    }
+    return final;
+}
+
+#pragma warning(pop)
+
 InputStateMachineEngine::InputStateMachineEngine(std::unique_ptr<IInteractDispatch> pDispatch) :
     InputStateMachineEngine(std::move(pDispatch), false)
 {
@@ -518,6 +565,87 @@ bool InputStateMachineEngine::ActionSs3Dispatch(const wchar_t wch, const VTParam
     return success;
 }
 
+#pragma warning(push)
+#pragma warning(disable : 26481) // Don't use pointer arithmetic. Use span instead (bounds.1).
+
+// Routine Description:
+// - Holding down a key or moving the mouse produces long, uninterrupted runs of
+//      win32-input-mode and SGR mouse sequences. This recognizes complete sequences
+//      of either kind at the start of the string without going through the state
+//      machine and writes all of their input records to the input buffer at once.
+// - Anything else, including keys that WriteCtrlKey handles specially (Ctrl+C,
+//      Ctrl+Break, etc.), ends the batch and is left to the state machine.
+// Arguments:
+// - string - the unprocessed remainder of the input.
+// - consumed - receives the number of characters that were processed.
+// Return Value:
+// - true iff we successfully dispatched the sequences.
+bool InputStateMachineEngine::ActionBatchDispatch(const std::wstring_view string, size_t& consumed)
+{
+    // Mouse sequences are passed through to the client if it requested VT input. See ActionCsiDispatch.
+    const auto mouseAllowed = !(_pDispatch->IsVtInputEnabled() && _pfnFlushToInputQueue);
+    const auto beg = string.data();
+    const auto end = beg + string.size();
+    auto it = beg;
+
+    _batchedInput.clear();
+
+    // The shortest possible sequence is "\x1b[_".
+    while (end - it >= 3 && it[0] == L'\x1b' && it[1] == L'[')
+    {
+        std::array<VTParameter, 6> parameters;
+        size_t count = 0;
+
+        if (it[2] == L'<')
+        {
+            const auto final = mouseAllowed ? parseBatchParameters(it + 3, end, parameters, count) : nullptr;
+            if (!final || (*final != L'M' && *final != L'm'))
+            {
+                break;
+            }
+
+            const VTParameters params{ parameters.data(), count };
+            const auto id = *final == L'M' ? CsiActionCodes::MouseDown : CsiActionCodes::MouseUp;
+            const auto firstParameter = params.at(0).value_or(0);
+            const til::point uiPos{ params.at(1) - 1, params.at(2) - 1 };
+            DWORD buttonState = 0;
+            DWORD eventFlags = 0;
+
+            const auto modifierState = _GetSGRMouseModifierState(firstParameter);
+            if (_UpdateSGRMouseButtonState(id, firstParameter, buttonState, eventFlags, uiPos))
+            {
+                _batchedInput.push_back(SynthesizeMouseEvent(uiPos, buttonState, modifierState, eventFlags));
+            }
+
+            it = final + 1;
+        }
+        else
+        {
+            const auto final = parseBatchParameters(it + 2, end, parameters, count);
+            if (!final || *final != L'_')
+            {
+                break;
+            }
+
+            const auto key = _GenerateWin32Key({ parameters.data(), count });
+            const auto& keyEvent = key.Event.KeyEvent;
+            if (keyEvent.bKeyDown && (keyEvent.wVirtualKeyCode == 'C' || keyEvent.wVirtualKeyCode == VK_CANCEL || keyEvent.wVirtualKeyCode == VK_ESCAPE))
+            {
+                break;
+            }
+
+            _batchedInput.push_back(key);
+            _encounteredWin32InputModeSequence = true;
+            it = final + 1;
+        }
+    }
+
+    consumed = gsl::narrow_cast<size_t>(it - beg);
+    return _batchedInput.empty() || _pDispatch->WriteInput(_batchedInput);
+}
+
+#pragma warning(pop)
+
 // Method Description:
 // - Triggers the Clear action to indicate that the state machine should erase
 //      all internal state.
@@ -161,6 +161,8 @@ namespace Microsoft::Console::VirtualTerminal
 
         bool ActionSs3Dispatch(const wchar_t wch, const VTParameters parameters) override;
 
+        bool ActionBatchDispatch(const std::wstring_view string, size_t& consumed) override;
+
         void SetFlushToInputQueueCallback(std::function<bool()> pfnFlushToInputQueue);
 
     private:
@@ -173,6 +175,7 @@ namespace Microsoft::Console::VirtualTerminal
         std::optional<til::point> _lastMouseClickPos{};
         std::optional<std::chrono::steady_clock::time_point> _lastMouseClickTime{};
         std::optional<size_t> _lastMouseClickButton{};
+        InputEventQueue _batchedInput;
 
         DWORD _GetCursorKeysModifierState(const VTParameters parameters, const VTID id) noexcept;
         DWORD _GetGenericKeysModifierState(const VTParameters parameters) noexcept;
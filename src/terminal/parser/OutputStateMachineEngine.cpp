@@ -920,6 +920,21 @@ bool OutputStateMachineEngine::ActionSs3Dispatch(const wchar_t /*wch*/, const VT
     return false;
 }
 
+// Routine Description:
+// - Triggers the BatchDispatch action to give the engine a chance to process
+//      multiple sequences at once.
+// Arguments:
+// - string - the unprocessed remainder of the input.
+// - consumed - receives the number of characters that were processed.
+// Return Value:
+// - true iff we successfully dispatched the sequences.
+bool OutputStateMachineEngine::ActionBatchDispatch(const std::wstring_view /*string*/, size_t& consumed) noexcept
+{
+    // The output engine handles its sequences one at a time.
+    consumed = 0;
+    return false;
+}
+
 // Routine Description:
 // - OSC 4 ; c ; spec ST
 //      c: the index of the ansi color table
@@ -51,6 +51,8 @@ namespace Microsoft::Console::VirtualTerminal
 
         bool ActionSs3Dispatch(const wchar_t wch, const VTParameters parameters) noexcept override;
 
+        bool ActionBatchDispatch(const std::wstring_view string, size_t& consumed) noexcept override;
+
         const ITermDispatch& Dispatch() const noexcept;
         ITermDispatch& Dispatch() noexcept;
 
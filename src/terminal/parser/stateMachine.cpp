@@ -151,6 +151,18 @@ static constexpr bool _isEscape(const wchar_t wch) noexcept
     return wch == AsciiChars::ESC;
 }
 
+// Routine Description:
+// - Determines if a character is printed when it's encountered in the ground state,
+//   as opposed to being executed, ignored or starting a control sequence.
+// Arguments:
+// - wch - Character to check.
+// Return Value:
+// - True if it is. False if it isn't.
+static constexpr bool _isPrintableInGround(const wchar_t wch) noexcept
+{
+    return wch >= AsciiChars::SPC && !_isDelete(wch) && !_isC1ControlCharacter(wch);
+}
+
 // Routine Description:
 // - Determines if a character is a delimiter between two parameters in an escape sequence.
 // Arguments:
@@ -475,6 +487,30 @@ void StateMachine::_ActionCsiDispatch(const wchar_t wch)
     }));
 }
 
+// Routine Description:
+// - Triggers the BatchDispatch action to let the input engine process a burst of
+//      complete sequences at once. See InputStateMachineEngine::ActionBatchDispatch.
+// Arguments:
+// - string - the unprocessed remainder of the input, starting with a control character.
+// Return Value:
+// - The number of characters the engine consumed.
+size_t StateMachine::_ActionBatchDispatch(const std::wstring_view string)
+{
+    size_t consumed = 0;
+    if (_isEngineForInput)
+    {
+        const auto success = _SafeExecute([&]() {
+            return _engine->ActionBatchDispatch(string, consumed);
+        });
+        if (consumed)
+        {
+            _trace.TraceOnAction(L"BatchDispatch");
+            _trace.DispatchSequenceTrace(success);
+        }
+    }
+    return consumed;
+}
+
 // Routine Description:
 // - Triggers the Collect action to indicate that the state machine should store this character as part of an escape/control sequence.
 // Arguments:
@@ -2015,6 +2051,21 @@ void StateMachine::ProcessString(const std::wstring_view string)
             break;
         }
 
+        if (_state == VTStates::Ground)
+        {
+#pragma warning(suppress : 26481) // Don't use pointer arithmetic. Use span instead (bounds.1).)
+            if (const auto length = _ProcessFastSgr(string.data() + i, string.data() + string.size()))
+            {
+                i += length;
+                continue;
+            }
+            if (const auto length = _ActionBatchDispatch(string.substr(i)))
+            {
+                i += length;
+                continue;
+            }
+        }
+
         do
         {
             _runSize++;
@@ -2086,6 +2137,124 @@ void StateMachine::ProcessString(const std::wstring_view string)
     }
 }
 
+// Routine Description:
+// - The UTF-8 counterpart to ProcessString(std::wstring_view). Printable runs
+//   are found directly in the UTF-8 input and only transcoded right before
+//   they're handed to the engine. Everything else is transcoded piecewise and
+//   fed into the state machine one character at a time.
+// - Incomplete UTF-8 sequences at the end of the string are retained and
+//   completed by the next call. Since the input isn't available as UTF-16,
+//   injections and passthrough of the current run aren't supported, which
+//   limits this variant to output engines.
+// Arguments:
+// - string - UTF-8 encoded characters to operate upon
+// Return Value:
+// - <none>
+void StateMachine::ProcessString(const std::string_view string)
+{
+    assert(!_isEngineForInput);
+
+    _currentString = {};
+    _runOffset = 0;
+    _runSize = 0;
+    _injections.clear();
+
+    // Pointer arithmetic is perfectly fine for our hot path.
+#pragma warning(push)
+#pragma warning(disable : 26481) // Don't use pointer arithmetic. Use span instead (bounds.1).)
+    auto it = string.data();
+    const auto end = it + string.size();
+
+    while (it != end)
+    {
+        // A pending partial UTF-8 sequence could complete to a C1 control
+        // character, so it always needs to go through the slow path below.
+        if (_state == VTStates::Ground && _utf8State.have == 0)
+        {
+            auto runEnd = it;
+            for (;;)
+            {
+                runEnd = Microsoft::Console::Utils::FindActionableControlCharacter(runEnd, gsl::narrow_cast<size_t>(end - runEnd));
+                // 0xC2 is the lead byte of both the C1 control characters (U+0080-U+009F)
+                // and the printable characters U+00A0-U+00BF. The latter aren't actionable.
+                if (end - runEnd >= 2 && runEnd[0] == '\xc2' && static_cast<uint8_t>(runEnd[1]) >= 0xa0)
+                {
+                    runEnd += 2;
+                    continue;
+                }
+                break;
+            }
+
+            if (runEnd != it)
+            {
+                THROW_IF_FAILED(til::u8u16({ it, runEnd }, _utf8Buffer, _utf8State));
+                if (!_utf8Buffer.empty())
+                {
+                    _ActionPrintString(_utf8Buffer);
+                }
+                it = runEnd;
+                continue;
+            }
+        }
+
+        if (_state == VTStates::Ground && _utf8State.have == 0)
+        {
+            if (const auto length = _ProcessFastSgr(it, end))
+            {
+                it += length;
+                continue;
+            }
+        }
+
+        // Sequences mostly consist of ASCII, which we can pass through as is.
+        if (_utf8State.have == 0 && static_cast<uint8_t>(*it) < 0x80)
+        {
+            _processingLastCharacter = it + 1 == end;
+            ProcessCharacter(static_cast<wchar_t>(*it));
+            ++it;
+            continue;
+        }
+
+        // Otherwise, transcode the following non-ASCII bytes (or the byte that
+        // terminates a pending partial sequence) and process them one by one.
+        auto sliceEnd = it + 1;
+        if (_utf8State.have == 0)
+        {
+            for (; sliceEnd != end && static_cast<uint8_t>(*sliceEnd) >= 0x80; ++sliceEnd)
+            {
+            }
+        }
+
+        THROW_IF_FAILED(til::u8u16({ it, sliceEnd }, _utf8Buffer, _utf8State));
+        it = sliceEnd;
+
+        for (size_t i = 0, len = _utf8Buffer.size(); i < len;)
+        {
+            // Printable characters are passed on as a whole, because a surrogate pair
+            // that was split across two calls must not be printed as two lone surrogates.
+            if (_state == VTStates::Ground)
+            {
+                auto printEnd = i;
+                for (; printEnd < len && _isPrintableInGround(til::at(_utf8Buffer, printEnd)); ++printEnd)
+                {
+                }
+                if (printEnd != i)
+                {
+                    _processingLastCharacter = it == end && printEnd == len;
+                    _ActionPrintString({ _utf8Buffer.data() + i, printEnd - i });
+                    i = printEnd;
+                    continue;
+                }
+            }
+
+            _processingLastCharacter = it == end && i + 1 == len;
+            ProcessCharacter(til::at(_utf8Buffer, i));
+            ++i;
+        }
+    }
+#pragma warning(pop)
+}
+
 // Routine Description:
 // - Determines whether the character being processed is the last in the
 //   current output fragment, or there are more still to come. Other parts
@@ -2157,6 +2326,92 @@ void StateMachine::_AccumulateTo(const wchar_t wch, VTInt& value) noexcept
     }
 }
 
+// Routine Description:
+// - Colored output consists of little else than text and SGR sequences, most of which only have a
+//   handful of numeric parameters, like "\x1b[38;5;208m". This recognizes a complete sequence of
+//   that kind at the start of the given string and dispatches it directly, instead of stepping
+//   through the state machine one character at a time. Anything else, including sequences that
+//   are split across calls, is left to the state machine. Must only be called in the ground state.
+// Arguments:
+// - beg - The start of the remaining input.
+// - end - The end of the remaining input.
+// Return Value:
+// - The number of characters that were consumed, or 0 if there wasn't a sequence to process.
+template<typename T>
+size_t StateMachine::_ProcessFastSgr(const T* const beg, const T* const end)
+{
+    // Longer sequences are rare and don't benefit much from this.
+    static constexpr ptrdiff_t maxLength = 64;
+
+    // The input engine doesn't receive SGR sequences and VT52 mode doesn't have them.
+    if (_isEngineForInput || !_parserMode.test(Mode::Ansi) || end - beg < 3 || beg[0] != T{ 0x1b } || beg[1] != T{ '[' })
+    {
+        return 0;
+    }
+
+    // Pointer arithmetic is perfectly fine for our hot path.
+#pragma warning(push)
+#pragma warning(disable : 26481) // Don't use pointer arithmetic. Use span instead (bounds.1).)
+    const auto paramsBeg = beg + 2;
+    const auto limit = end - beg > maxLength ? beg + maxLength : end;
+    auto paramsEnd = paramsBeg;
+    size_t delimiters = 0;
+    for (; paramsEnd != limit; ++paramsEnd)
+    {
+        const auto ch = *paramsEnd;
+        if (ch == T{ ';' })
+        {
+            ++delimiters;
+        }
+        else if (ch < T{ '0' } || ch > T{ '9' })
+        {
+            break;
+        }
+    }
+
+    // Sequences with too many parameters are left to _ActionParam(), which knows how to ignore the excess ones.
+    if (paramsEnd == limit || *paramsEnd != T{ 'm' } || delimiters >= MAX_PARAMETER_COUNT)
+    {
+        return 0;
+    }
+
+    const auto length = gsl::narrow_cast<size_t>(paramsEnd + 1 - beg);
+    _runSize = length;
+    _processingLastCharacter = paramsEnd + 1 == end;
+
+    // This performs the same transitions as the character-wise ESC [ ... m path.
+    _EnterEscape();
+    _EnterCsiEntry();
+    _EnterCsiParam();
+
+    if (paramsBeg != paramsEnd)
+    {
+        _parameters.emplace_back();
+        _subParameterRanges.emplace_back(BYTE{ 0 }, BYTE{ 0 });
+
+        for (auto it = paramsBeg; it != paramsEnd; ++it)
+        {
+            if (*it == T{ ';' })
+            {
+                _parameters.emplace_back();
+                _subParameterRanges.emplace_back(BYTE{ 0 }, BYTE{ 0 });
+            }
+            else
+            {
+                auto value = _parameters.back().value_or(0);
+                _AccumulateTo(static_cast<wchar_t>(*it), value);
+                _parameters.back() = value;
+            }
+        }
+    }
+#pragma warning(pop)
+
+    _ActionCsiDispatch(L'm');
+    _EnterGround();
+    _ExecuteCsiCompleteCallback();
+    return length;
+}
+
 template<typename TLambda>
 bool StateMachine::_SafeExecute(TLambda&& lambda)
 try
@@ -75,6 +75,7 @@ namespace Microsoft::Console::VirtualTerminal
 
         void ProcessCharacter(const wchar_t wch);
         void ProcessString(const std::wstring_view string);
+        void ProcessString(const std::string_view string);
         bool IsProcessingLastCharacter() const noexcept;
 
         void InjectSequence(InjectionType type);
@@ -105,6 +106,7 @@ namespace Microsoft::Console::VirtualTerminal
         void _ActionParam(const wchar_t wch);
         void _ActionSubParam(const wchar_t wch);
         void _ActionCsiDispatch(const wchar_t wch);
+        size_t _ActionBatchDispatch(const std::wstring_view string);
         void _ActionOscParam(const wchar_t wch) noexcept;
         void _ActionOscPut(const wchar_t wch);
         void _ActionOscDispatch();
@@ -159,6 +161,9 @@ namespace Microsoft::Console::VirtualTerminal
 
         void _AccumulateTo(const wchar_t wch, VTInt& value) noexcept;
 
+        template<typename T>
+        size_t _ProcessFastSgr(const T* beg, const T* end);
+
         template<typename TLambda>
         bool _SafeExecute(TLambda&& lambda);
 
@@ -226,6 +231,11 @@ namespace Microsoft::Console::VirtualTerminal
         std::optional<std::wstring> _cachedSequence;
         til::small_vector<Injection, 8> _injections;
 
+        // State for ProcessString(std::string_view). The buffer is reused
+        // across calls so that transcoding doesn't allocate on every call.
+        til::u8state _utf8State;
+        std::wstring _utf8Buffer;
+
         // This is tracked per state machine instance so that separate calls to Process*
         //   can start and finish a sequence.
         bool _processingLastCharacter;
@@ -275,6 +275,9 @@ class Microsoft::Console::VirtualTerminal::InputEngineTest
     TEST_METHOD(TestWin32InputParsing);
     TEST_METHOD(TestWin32InputOptionals);
 
+    TEST_METHOD(TestBatchedInput);
+    TEST_METHOD(BatchedInputThroughput);
+
     friend class TestInteractDispatch;
 };
 
@@ -1607,3 +1610,105 @@ void InputEngineTest::TestWin32InputOptionals()
         }
     }
 }
+
+void InputEngineTest::TestBatchedInput()
+{
+    std::vector<std::vector<INPUT_RECORD>> writes;
+    auto pfn = [&](const std::span<const INPUT_RECORD>& records) {
+        writes.emplace_back(records.begin(), records.end());
+    };
+
+    auto dispatch = std::make_unique<TestInteractDispatch>(pfn, &testState);
+    auto inputEngine = std::make_unique<InputStateMachineEngine>(std::move(dispatch));
+    StateMachine stateMachine{ std::move(inputEngine) };
+
+    const auto keyDownA = SynthesizeKeyEvent(true, 1, 'A', 30, L'a', 0);
+    const auto keyUpB = SynthesizeKeyEvent(false, 1, 'B', 48, L'b', 0);
+    const auto ctrlC = SynthesizeKeyEvent(true, 1, 'C', 46, L'\x03', LEFT_CTRL_PRESSED);
+    const auto mouseDown = SynthesizeMouseEvent({ 4, 9 }, FROM_LEFT_1ST_BUTTON_PRESSED, 0, 0);
+    const auto mouseUp = SynthesizeMouseEvent({ 4, 9 }, 0, 0, 0);
+
+    Log::Comment(L"Consecutive win32-input-mode and SGR mouse sequences are written in a single call");
+    stateMachine.ProcessString(L"\x1b[65;30;97;1;0;1_\x1b[<0;5;10M\x1b[<0;5;10m\x1b[66;48;98;0;0;1_");
+    VERIFY_ARE_EQUAL(1u, writes.size());
+    VERIFY_ARE_EQUAL(4u, writes[0].size());
+    VERIFY_ARE_EQUAL(keyDownA, writes[0][0]);
+    VERIFY_ARE_EQUAL(mouseDown, writes[0][1]);
+    VERIFY_ARE_EQUAL(mouseUp, writes[0][2]);
+    VERIFY_ARE_EQUAL(keyUpB, writes[0][3]);
+
+    // Keys that the state machine processes go through WriteCtrlKey.
+    testState._expectSendCtrlC = true;
+
+    Log::Comment(L"Ctrl+C ends the batch, since it needs to be handled by WriteCtrlKey");
+    writes.clear();
+    stateMachine.ProcessString(L"\x1b[65;30;97;1;0;1_\x1b[67;46;3;1;8;1_\x1b[65;30;97;1;0;1_");
+    VERIFY_ARE_EQUAL(3u, writes.size());
+    VERIFY_ARE_EQUAL(keyDownA, writes[0].at(0));
+    VERIFY_ARE_EQUAL(ctrlC, writes[1].at(0));
+    VERIFY_ARE_EQUAL(keyDownA, writes[2].at(0));
+
+    Log::Comment(L"Incomplete sequences are left to the state machine");
+    writes.clear();
+    stateMachine.ProcessString(L"\x1b[65;30;97;1;0;1_\x1b[66;48");
+    VERIFY_ARE_EQUAL(1u, writes.size());
+    stateMachine.ProcessString(L";98;0;0;1_");
+    VERIFY_ARE_EQUAL(2u, writes.size());
+    VERIFY_ARE_EQUAL(keyUpB, writes[1].at(0));
+
+    Log::Comment(L"Sequences with sub-parameters are left to the state machine");
+    writes.clear();
+    stateMachine.ProcessString(L"\x1b[65;30:1;97;1;0;1_");
+    VERIFY_ARE_EQUAL(1u, writes.size());
+
+    testState._expectSendCtrlC = false;
+}
+
+// Not a test per se, but a micro-benchmark for the input engine which logs records/s for bursts of
+// win32-input-mode sequences, like those produced by holding down a key, and of SGR mouse movements.
+void InputEngineTest::BatchedInputThroughput()
+{
+    static constexpr size_t iterations = 1000;
+    static constexpr size_t sequences = 1000;
+
+    size_t records = 0;
+    auto pfn = [&](const std::span<const INPUT_RECORD>& span) {
+        records += span.size();
+    };
+
+    auto dispatch = std::make_unique<TestInteractDispatch>(pfn, &testState);
+    auto inputEngine = std::make_unique<InputStateMachineEngine>(std::move(dispatch));
+    StateMachine stateMachine{ std::move(inputEngine) };
+
+    std::wstring keys;
+    std::wstring mouse;
+    for (size_t i = 0; i < sequences; ++i)
+    {
+        keys.append(i % 2 ? L"\x1b[65;30;97;0;0;1_" : L"\x1b[65;30;97;1;0;1_");
+        // Mouse movement with the left button held down.
+        mouse.append(L"\x1b[<32;");
+        mouse.append(std::to_wstring(i % 120 + 1));
+        mouse.append(L";");
+        mouse.append(std::to_wstring(i % 30 + 1));
+        mouse.append(L"M");
+    }
+
+    const auto measure = [&](const std::wstring_view& text) {
+        records = 0;
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            stateMachine.ProcessString(text);
+        }
+
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        VERIFY_ARE_EQUAL(iterations * sequences, records);
+        return records / elapsed;
+    };
+
+    const auto keyRecordsPerSecond = measure(keys);
+    const auto mouseRecordsPerSecond = measure(mouse);
+
+    Log::Comment(NoThrowString().Format(L"%.0f records/s win32-input-mode, %.0f records/s SGR mouse", keyRecordsPerSecond, mouseRecordsPerSecond));
+}
@@ -2160,6 +2160,68 @@ class StateMachineExternalTest final
         pDispatch->ClearState();
     }
 
+    TEST_METHOD(TestSetGraphicsRenditionFastPath)
+    {
+        auto dispatch = std::make_unique<StatefulDispatch>();
+        auto pDispatch = dispatch.get();
+        auto engine = std::make_unique<OutputStateMachineEngine>(std::move(dispatch));
+        StateMachine mach(std::move(engine));
+
+        DispatchTypes::GraphicsOptions rgExpected[3];
+
+        Log::Comment(L"Test 1: A complete sequence in UTF-16 input.");
+        mach.ProcessString(L"abc\x1b[38;5;208mdef");
+        VERIFY_IS_TRUE(pDispatch->_setGraphics);
+
+        rgExpected[0] = DispatchTypes::GraphicsOptions::ForegroundExtended;
+        rgExpected[1] = DispatchTypes::GraphicsOptions::BlinkOrXterm256Index;
+        rgExpected[2] = static_cast<DispatchTypes::GraphicsOptions>(208);
+        VerifyDispatchTypes({ rgExpected, 3 }, *pDispatch);
+
+        pDispatch->ClearState();
+
+        Log::Comment(L"Test 2: A complete sequence in UTF-8 input.");
+        mach.ProcessString(std::string_view{ "abc\x1b[1;31mdef" });
+        VERIFY_IS_TRUE(pDispatch->_setGraphics);
+
+        rgExpected[0] = DispatchTypes::GraphicsOptions::Intense;
+        rgExpected[1] = DispatchTypes::GraphicsOptions::ForegroundRed;
+        VerifyDispatchTypes({ rgExpected, 2 }, *pDispatch);
+
+        pDispatch->ClearState();
+
+        Log::Comment(L"Test 3: A sequence that's split across two strings.");
+        mach.ProcessString(L"\x1b[1;3");
+        VERIFY_IS_FALSE(pDispatch->_setGraphics);
+        mach.ProcessString(L"1m");
+        VERIFY_IS_TRUE(pDispatch->_setGraphics);
+
+        rgExpected[0] = DispatchTypes::GraphicsOptions::Intense;
+        rgExpected[1] = DispatchTypes::GraphicsOptions::ForegroundRed;
+        VerifyDispatchTypes({ rgExpected, 2 }, *pDispatch);
+
+        pDispatch->ClearState();
+
+        Log::Comment(L"Test 4: A sequence with sub parameters.");
+        mach.ProcessString(L"\x1b[4:3;1m");
+        VERIFY_IS_TRUE(pDispatch->_setGraphics);
+
+        rgExpected[0] = DispatchTypes::GraphicsOptions::Underline;
+        rgExpected[1] = DispatchTypes::GraphicsOptions::Intense;
+        VerifyDispatchTypes({ rgExpected, 2 }, *pDispatch);
+
+        pDispatch->ClearState();
+
+        Log::Comment(L"Test 5: A parameter value beyond the maximum.");
+        mach.ProcessString(L"\x1b[99999m");
+        VERIFY_IS_TRUE(pDispatch->_setGraphics);
+
+        rgExpected[0] = static_cast<DispatchTypes::GraphicsOptions>(MAX_PARAMETER_VALUE);
+        VerifyDispatchTypes({ rgExpected, 1 }, *pDispatch);
+
+        pDispatch->ClearState();
+    }
+
     TEST_METHOD(TestDeviceStatusReport)
     {
         auto dispatch = std::make_unique<StatefulDispatch>();
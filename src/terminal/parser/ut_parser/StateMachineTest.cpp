@@ -31,6 +31,7 @@ public:
     void ResetTestState()
     {
         printed.clear();
+        printedCharacters.clear();
         passedThrough.clear();
         executed.clear();
         csiId = 0;
@@ -52,7 +53,11 @@ public:
     };
 
     bool ActionExecuteFromEscape(const wchar_t /* wch */) override { return true; };
-    bool ActionPrint(const wchar_t /* wch */) override { return true; };
+    bool ActionPrint(const wchar_t wch) override
+    {
+        printedCharacters += wch;
+        return true;
+    };
     bool ActionPrintString(const std::wstring_view string) override
     {
         printed += string;
@@ -85,6 +90,12 @@ public:
 
     bool ActionSs3Dispatch(const wchar_t /* wch */, const VTParameters /* parameters */) override { return true; };
 
+    bool ActionBatchDispatch(const std::wstring_view /* string */, size_t& consumed) override
+    {
+        consumed = 0;
+        return false;
+    };
+
     // ActionCsiDispatch is the only method that's actually implemented.
     bool ActionCsiDispatch(const VTID id, const VTParameters parameters) override
     {
@@ -129,6 +140,10 @@ public:
     // Printed string.
     std::wstring printed;
 
+    // Characters printed one at a time. Kept separately from the above, since
+    // printing a surrogate pair that way would break it into two lone surrogates.
+    std::wstring printedCharacters;
+
     // Executed string.
     std::wstring executed;
 
@@ -157,6 +172,7 @@ class Microsoft::Console::VirtualTerminal::StateMachineTest
     TEST_METHOD(PassThroughUnhandled);
     TEST_METHOD(RunStorageBeforeEscape);
     TEST_METHOD(BulkTextPrint);
+    TEST_METHOD(Utf8TextSplitAcrossWrites);
     TEST_METHOD(PassThroughUnhandledSplitAcrossWrites);
 
     TEST_METHOD(DcsDataStringsReceivedByHandler);
@@ -234,6 +250,32 @@ void StateMachineTest::BulkTextPrint()
     VERIFY_ARE_EQUAL(String(L"12345 Hello World"), String(engine.printed.c_str()));
 }
 
+void StateMachineTest::Utf8TextSplitAcrossWrites()
+{
+    auto enginePtr{ std::make_unique<TestStateMachineEngine>() };
+    // this dance is required because StateMachine presumes to take ownership of its engine.
+    auto& engine{ *enginePtr.get() };
+    StateMachine machine{ std::move(enginePtr) };
+    machine.SetParserMode(StateMachine::Mode::AcceptC1, true);
+
+    // Contains a CSI, a C1 CSI (U+009B), a C0 control, U+00A0 (which shares its lead byte with
+    // the C1 controls), as well as multi-byte and surrogate pair characters.
+    static constexpr std::string_view input{ "\x1b[12;34mH\xc3\xa9llo\xc2\xa0\xe2\x82\xac\r\xc2\x9b" "56m\xf0\x9f\x98\x80!" };
+
+    // Every possible split point must produce the same result as processing the string at once.
+    for (size_t split = 0; split <= input.size(); ++split)
+    {
+        engine.ResetTestState();
+        machine.ProcessString(input.substr(0, split));
+        machine.ProcessString(input.substr(split));
+
+        VERIFY_ARE_EQUAL(String(L"H\u00e9llo\u00a0\u20ac\U0001F600!"), String(engine.printed.c_str()));
+        VERIFY_ARE_EQUAL(L"", engine.printedCharacters);
+        VERIFY_ARE_EQUAL(String(L"\r"), String(engine.executed.c_str()));
+        VERIFY_ARE_EQUAL((std::vector<size_t>{ 12u, 34u, 56u }), engine.csiParams);
+    }
+}
+
 void StateMachineTest::PassThroughUnhandledSplitAcrossWrites()
 {
     auto enginePtr{ std::make_unique<TestStateMachineEngine>() };
@@ -57,6 +57,7 @@ class SPSCTests
     TEST_METHOD(DropSameRevolutionTest);
     TEST_METHOD(DropDifferentRevolutionTest);
     TEST_METHOD(IntegrationTest);
+    TEST_METHOD(PooledChannelTest);
 };
 
 void SPSCTests::SmokeTest()
@@ -227,3 +228,61 @@ void SPSCTests::IntegrationTest()
 
     t.join();
 }
+
+void SPSCTests::PooledChannelTest()
+{
+    auto [tx, rx] = til::spsc::pooled_channel<int>(3, 4);
+    std::array<std::span<int>, 8> buffers{};
+
+    // All buffers can be acquired up front and the consumer receives as many as were submitted at once.
+    const auto first = tx.acquire();
+    VERIFY_ARE_EQUAL(4u, first.size());
+    for (auto i = 0; i < 3; ++i)
+    {
+        const auto buffer = i == 0 ? first : tx.acquire();
+        std::ranges::fill(buffer, i);
+        tx.submit(buffer, static_cast<size_t>(i + 1));
+    }
+
+    VERIFY_ARE_EQUAL(3u, rx.drain(buffers.data(), buffers.size()));
+    for (auto i = 0; i < 3; ++i)
+    {
+        VERIFY_ARE_EQUAL(static_cast<size_t>(i + 1), buffers[i].size());
+        VERIFY_IS_TRUE(std::ranges::all_of(buffers[i], [=](int v) { return v == i; }));
+    }
+
+    // Recycled buffers are handed out again in order and with their full size.
+    rx.recycle(buffers.data(), 3);
+    const auto recycled = tx.acquire();
+    VERIFY_IS_TRUE(first.data() == recycled.data());
+    VERIFY_ARE_EQUAL(4u, recycled.size());
+
+    std::thread t([tx = std::move(tx), recycled]() {
+        auto buffer = recycled;
+        for (auto i = 0; i < 100; ++i)
+        {
+            buffer[0] = i;
+            tx.submit(buffer, 1);
+            // Blocks whenever the consumer holds on to all buffers.
+            buffer = tx.acquire();
+        }
+    });
+
+    auto expected = 0;
+    for (;;)
+    {
+        const auto count = rx.drain(buffers.data(), buffers.size());
+        if (count == 0)
+        {
+            break;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            VERIFY_ARE_EQUAL(expected++, buffers[i][0]);
+        }
+        rx.recycle(buffers.data(), count);
+    }
+    VERIFY_ARE_EQUAL(100, expected);
+
+    t.join();
+}
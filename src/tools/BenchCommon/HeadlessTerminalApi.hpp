@@ -0,0 +1,204 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// The parts of the VT output path that VtBench and RenderBench share: A stub for the parts of Terminal/conhost
+// that AdaptDispatch calls into, which owns the StateMachine, the AdaptDispatch and the text buffers.
+
+#pragma once
+
+#include "../../renderer/base/renderer.hpp"
+#include "../../terminal/adapter/adaptDispatch.hpp"
+#include "../../terminal/parser/OutputStateMachineEngine.hpp"
+
+namespace Microsoft::Console::Bench
+{
+    constexpr til::CoordType viewportWidth = 120;
+    constexpr til::CoordType viewportHeight = 30;
+    constexpr til::CoordType scrollbackLines = 9001;
+
+    // It supports panning the viewport and the alternate screen buffer, since those affect
+    // how the buffer is written to, and ignores the rest. If a Renderer is given, the text buffers
+    // are connected to it, so that they invalidate it exactly like they would in Windows Terminal.
+    class HeadlessTerminalApi : public VirtualTerminal::ITerminalApi
+    {
+    public:
+        // The renderer is only stored, so it's fine if it's still under construction.
+        explicit HeadlessTerminalApi(Render::Renderer* renderer = nullptr) :
+            _pRenderer{ renderer }
+        {
+            _mainBuffer = std::make_unique<TextBuffer>(til::size{ viewportWidth, viewportHeight + scrollbackLines }, TextAttribute{}, 25, true, _pRenderer);
+
+            auto dispatch = std::make_unique<VirtualTerminal::AdaptDispatch>(*this, _pRenderer, _renderSettings, _terminalInput);
+            auto engine = std::make_unique<VirtualTerminal::OutputStateMachineEngine>(std::move(dispatch));
+            _stateMachine = std::make_unique<VirtualTerminal::StateMachine>(std::move(engine));
+        }
+
+        void ReturnResponse(const std::wstring_view) override
+        {
+        }
+
+        VirtualTerminal::StateMachine& GetStateMachine() override
+        {
+            return *_stateMachine;
+        }
+
+        BufferState GetBufferAndViewport() override
+        {
+            if (_altBuffer)
+            {
+                return { *_altBuffer, til::rect{ 0, 0, viewportWidth, viewportHeight }, false };
+            }
+            return { *_mainBuffer, _viewport, true };
+        }
+
+        void SetViewportPosition(const til::point position) override
+        {
+            if (!_altBuffer)
+            {
+                _viewport = til::rect{ til::point{ 0, position.y }, _viewport.size() };
+                if (_pRenderer)
+                {
+                    _pRenderer->TriggerScroll();
+                }
+            }
+        }
+
+        bool IsVtInputEnabled() const override
+        {
+            return false;
+        }
+
+        void SetTextAttributes(const TextAttribute& attrs) override
+        {
+            GetBufferAndViewport().buffer.SetCurrentAttributes(attrs);
+        }
+
+        void SetSystemMode(const Mode mode, const bool enabled) override
+        {
+            _systemMode.set(mode, enabled);
+        }
+
+        bool GetSystemMode(const Mode mode) const override
+        {
+            return _systemMode.test(mode);
+        }
+
+        void WarningBell() override
+        {
+        }
+
+        void SetWindowTitle(const std::wstring_view title) override
+        {
+            _title = title;
+            if (_pRenderer)
+            {
+                _pRenderer->TriggerTitleChange();
+            }
+        }
+
+        void UseAlternateScreenBuffer(const TextAttribute& attrs) override
+        {
+            _altBuffer = std::make_unique<TextBuffer>(til::size{ viewportWidth, viewportHeight }, attrs, 25, true, _pRenderer);
+            _mainBuffer->SetAsActiveBuffer(false);
+            if (_pRenderer)
+            {
+                _pRenderer->TriggerScroll();
+                _altBuffer->TriggerRedrawAll();
+            }
+        }
+
+        void UseMainScreenBuffer() override
+        {
+            _altBuffer.reset();
+            _mainBuffer->SetAsActiveBuffer(true);
+            if (_pRenderer)
+            {
+                _pRenderer->TriggerScroll();
+                _mainBuffer->TriggerRedrawAll();
+            }
+        }
+
+        CursorType GetUserDefaultCursorStyle() const override
+        {
+            return CursorType::Legacy;
+        }
+
+        void ShowWindow(bool) override
+        {
+        }
+
+        void SetConsoleOutputCP(const unsigned int) override
+        {
+        }
+
+        unsigned int GetConsoleOutputCP() const override
+        {
+            return CP_UTF8;
+        }
+
+        void CopyToClipboard(const wil::zwstring_view) override
+        {
+        }
+
+        void SetTaskbarProgress(const VirtualTerminal::DispatchTypes::TaskbarState, const size_t) override
+        {
+        }
+
+        void SetWorkingDirectory(const std::wstring_view) override
+        {
+        }
+
+        void PlayMidiNote(const int, const int, const std::chrono::microseconds) override
+        {
+        }
+
+        bool ResizeWindow(const til::CoordType, const til::CoordType) override
+        {
+            return false;
+        }
+
+        void NotifyAccessibilityChange(const til::rect&) override
+        {
+        }
+
+        void NotifyBufferRotation(const int) override
+        {
+        }
+
+        void InvokeCompletions(std::wstring_view, unsigned int) override
+        {
+        }
+
+        void SearchMissingCommand(const std::wstring_view) override
+        {
+        }
+
+    protected:
+        Render::RenderSettings _renderSettings;
+        VirtualTerminal::TerminalInput _terminalInput;
+        Render::Renderer* _pRenderer = nullptr;
+        std::unique_ptr<TextBuffer> _mainBuffer;
+        std::unique_ptr<TextBuffer> _altBuffer;
+        til::rect _viewport{ 0, 0, viewportWidth, viewportHeight };
+        til::enumset<Mode> _systemMode{ Mode::AutoWrap };
+        std::unique_ptr<VirtualTerminal::StateMachine> _stateMachine;
+        std::wstring _title;
+    };
+
+    // Runs one pass of a benchmark to warm up the caches and commit the text buffer memory, calls
+    // afterWarmUp() and then runs `iterations` more passes. pass() returns the duration it measured.
+    template<typename Pass, typename AfterWarmUp>
+    std::vector<int64_t> warmUpAndMeasure(const size_t iterations, Pass&& pass, AfterWarmUp&& afterWarmUp)
+    {
+        std::ignore = pass();
+        afterWarmUp();
+
+        std::vector<int64_t> durations;
+        durations.reserve(iterations);
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            durations.emplace_back(std::chrono::duration_cast<std::chrono::nanoseconds>(pass()).count());
+        }
+        return durations;
+    }
+}
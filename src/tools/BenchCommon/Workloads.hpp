@@ -0,0 +1,142 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// The synthetic VT output that VtBench and RenderBench both replay.
+// Workloads that only make sense for one of them live in its main.cpp.
+
+#pragma once
+
+#include "HeadlessTerminalApi.hpp"
+
+namespace Microsoft::Console::Bench
+{
+    // A tiny xorshift generator. We don't need quality randomness, just workloads
+    // that are identical across runs and machines, which <random> doesn't guarantee.
+    struct Rng
+    {
+        uint32_t state = 0x9E3779B9;
+
+        uint32_t next() noexcept
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+
+        uint32_t next(uint32_t lo, uint32_t hi) noexcept
+        {
+            return lo + next() % (hi - lo);
+        }
+    };
+
+    inline void appendUtf8(std::string& out, const char32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            out.push_back(static_cast<char>(cp));
+        }
+        else if (cp < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    inline void appendWord(std::string& out, Rng& rng)
+    {
+        const auto len = rng.next(1, 10);
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            out.push_back(static_cast<char>(rng.next('a', 'z' + 1)));
+        }
+    }
+
+    // Plain ASCII text of varying line length, like `cat` of a source file.
+    inline std::string generateAscii(const size_t size)
+    {
+        std::string out;
+        Rng rng;
+        while (out.size() < size)
+        {
+            const auto len = rng.next(0, 120);
+            for (uint32_t i = 0; i < len; ++i)
+            {
+                out.push_back(static_cast<char>(rng.next(0x20, 0x7f)));
+            }
+            out.append("\r\n");
+        }
+        return out;
+    }
+
+    // CJK text mixed with emoji and accented latin characters, which produces wide clusters.
+    inline std::string generateUnicode(const size_t size)
+    {
+        std::string out;
+        Rng rng;
+        while (out.size() < size)
+        {
+            const auto len = rng.next(10, 60);
+            for (uint32_t i = 0; i < len; ++i)
+            {
+                switch (rng.next(0, 8))
+                {
+                case 0:
+                    appendUtf8(out, rng.next(0x1F600, 0x1F650));
+                    break;
+                case 1:
+                    appendUtf8(out, rng.next(0xC0, 0x100));
+                    break;
+                case 2:
+                    out.push_back(' ');
+                    break;
+                default:
+                    appendUtf8(out, rng.next(0x4E00, 0xA000));
+                    break;
+                }
+            }
+            out.append("\r\n");
+        }
+        return out;
+    }
+
+    // Full-screen redraws in the alternate screen buffer with absolute cursor
+    // positioning and erasures, similar to what htop or vim produce.
+    inline std::string generateTui(const size_t size)
+    {
+        std::string out;
+        Rng rng;
+        out.append("\x1b[?1049h\x1b[?25l");
+        while (out.size() < size)
+        {
+            out.append("\x1b[H\x1b[7m  PID USER      PRI  NI  VIRT   RES   SHR S CPU% MEM%   TIME+  Command\x1b[K\x1b[m");
+            for (til::CoordType row = 2; row < viewportHeight; ++row)
+            {
+                const auto cpu = rng.next(0, 1000);
+                const auto bar = cpu * 20 / 1000;
+                fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[{};1H{:5} user       20   0 \x1b[36m{:5}M\x1b[m [\x1b[32m"), row, rng.next(1, 99999), rng.next(1, 9999));
+                out.append(bar, '|');
+                out.append(20 - bar, ' ');
+                fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[m {:3}.{}%] "), cpu / 10, cpu % 10);
+                appendWord(out, rng);
+                out.append("\x1b[K");
+            }
+            fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[{};1H\x1b[30;46mF1\x1b[mHelp \x1b[30;46mF10\x1b[mQuit\x1b[K"), viewportHeight);
+        }
+        out.append("\x1b[?25h\x1b[?1049l");
+        return out;
+    }
+}
@@ -11,6 +11,7 @@
 #define ENABLE_TEST_OUTPUT_SCROLL 1
 #define ENABLE_TEST_OUTPUT_FILL 1
 #define ENABLE_TEST_OUTPUT_READ 1
+#define ENABLE_TEST_OUTPUT_REFLOW 1
 #define ENABLE_TEST_INPUT 1
 #define ENABLE_TEST_CLIPBOARD 1
 
@@ -342,6 +343,37 @@ static constexpr Benchmark s_benchmarks[] = {
         },
     },
 #endif
+#if ENABLE_TEST_OUTPUT_REFLOW
+    Benchmark{
+        .title = "SetConsoleScreenBufferSize reflow",
+        .exec = [](BenchmarkContext& ctx) {
+            // 64 characters and 128 columns. Interleaved with the narrow payload, this results
+            // in a full scrollback where the wide glyphs get split at varying positions.
+            static constexpr std::wstring_view wide{ L"吾輩は猫である。名前はまだ無い。吾輩は猫である。名前はまだ無い。吾輩は猫である。名前はまだ無い。吾輩は猫である。名前はまだ無い。" };
+            static constexpr COORD sizes[]{ { 157, s_buffer_size.Y }, s_buffer_size };
+
+            const auto scratch = mem::get_scratch_arena(ctx.arena);
+            const auto wide_4Ki = mem::repeat(scratch.arena, wide, 4 * 1024 / wide.size());
+
+            for (int i = 0; i < 10; i++)
+            {
+                WriteConsoleW(ctx.output, ctx.utf16_128Ki.data(), static_cast<DWORD>(ctx.utf16_128Ki.size()), nullptr, nullptr);
+                WriteConsoleW(ctx.output, wide_4Ki.data(), static_cast<DWORD>(wide_4Ki.size()), nullptr, nullptr);
+            }
+
+            size_t i = 0;
+            while (ctx.wants_more())
+            {
+                ctx.mark_beg();
+                const auto res = SetConsoleScreenBufferSize(ctx.output, sizes[i++ & 1]);
+                ctx.mark_end();
+                debugAssert(res == TRUE);
+            }
+
+            SetConsoleScreenBufferSize(ctx.output, s_buffer_size);
+        },
+    },
+#endif
 #if ENABLE_TEST_INPUT
     Benchmark{
         .title = "WriteConsoleInputW 4Ki",
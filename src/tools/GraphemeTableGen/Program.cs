@@ -102,10 +102,14 @@ var ucd = ExtractValuesFromUcd(args[0]);
 // More stages = Less size. The trajectory roughly follows a+b*c^stages, where c < 1.
 // 4 still gives ~30% savings over 3 stages and going beyond 5 gives diminishing returns (<10%).
 var trie = BuildBestTrie(ucd.Values, 2, 8, 4);
+// The trie requires 4 dependent loads per lookup. Since the vast majority of text is found in the BMP,
+// we additionally emit a flattened two-stage table for U+0000-U+FFFF which only requires 2 loads.
+// 2^6 = 64 values per chunk, so that each chunk occupies exactly one cache line.
+var bmp = BuildFlatTable(ucd.Values, 0x10000, 6);
 // The joinRules above has 2 bits per value. This packs it into 32-bit integers to save space.
 var rules = PrepareRulesTable(joinRules);
 // Each rules item has the same length. Each item is 32 bits = 4 bytes.
-var totalSize = trie.TotalSize + rules.Length * rules[0].Length * sizeof(TrieType);
+var totalSize = trie.TotalSize + bmp.TotalSize + rules.Length * rules[0].Length * sizeof(TrieType);
 
 // Run a quick sanity check to ensure that the trie works as expected.
 foreach (var (expected, cp) in ucd.Values.Select((v, i) => (v, i)))
@@ -120,6 +124,11 @@ foreach (var (expected, cp) in ucd.Values.Select((v, i) => (v, i)))
     {
         throw new Exception($"trie sanity check failed for {cp:X}");
     }
+
+    if (cp < bmp.Count && bmp.Values[(int)bmp.Index[cp >> bmp.Shift] * (1 << bmp.Shift) + (cp & ((1 << bmp.Shift) - 1))] != expected)
+    {
+        throw new Exception($"bmp sanity check failed for {cp:X}");
+    }
 }
 
 // All the remaining code starting here simply generates the C++ output.
@@ -149,6 +158,28 @@ foreach (var stage in trie.Stages)
     buf.Append("\n};\n");
 }
 
+buf.Append($"static constexpr uint{bmp.IndexBits}_t s_bmpIndex[] = {{");
+foreach (var (value, j) in bmp.Index.Select((v, j) => (v, j)))
+{
+    if (j % 16 == 0)
+    {
+        buf.Append("\n   ");
+    }
+    buf.AppendFormat($" 0x{{0:x{bmp.IndexBits / 4}}},", value);
+}
+buf.Append("\n};\n");
+
+buf.Append($"alignas({1 << bmp.Shift}) static constexpr uint{bmp.ValueBits}_t s_bmpValues[] = {{");
+foreach (var (value, j) in bmp.Values.Select((v, j) => (v, j)))
+{
+    if (j % 16 == 0)
+    {
+        buf.Append("\n   ");
+    }
+    buf.AppendFormat($" 0x{{0:x{bmp.ValueBits / 4}}},", value);
+}
+buf.Append("\n};\n");
+
 buf.Append($"static constexpr uint32_t s_joinRules[{rules.Length}][{rules[0].Length}] = {{\n");
 foreach (var table in rules)
 {
@@ -163,6 +194,10 @@ buf.Append("};\n");
 
 buf.Append($"constexpr uint{trie.Stages[^1].Bits}_t ucdLookup(const char32_t cp) noexcept\n");
 buf.Append("{\n");
+buf.Append($"    if (cp < 0x{bmp.Count:x})\n");
+buf.Append("    {\n");
+buf.Append($"        return s_bmpValues[s_bmpIndex[cp >> {bmp.Shift}] * {1 << bmp.Shift} + (cp & {(1 << bmp.Shift) - 1})];\n");
+buf.Append("    }\n");
 foreach (var stage in trie.Stages)
 {
     buf.Append($"    const auto s{stage.Index} = s_stage{stage.Index}[");
@@ -486,6 +521,51 @@ static Trie BuildTrie(List<TrieType> uncompressed, Span<int> shifts)
     };
 }
 
+// Splits the first `count` values into chunks of 2^shift values and deduplicates them.
+// Unlike BuildTrie() this doesn't search for overlaps between chunks, so that each chunk stays aligned
+// to its size. This trades off size for a lookup that only needs a shift and a multiplication.
+static FlatTable BuildFlatTable(List<TrieType> uncompressed, int count, int shift)
+{
+    var chunkSize = 1 << shift;
+    var cache = new Dictionary<ReadOnlyTrieTypeSpan, TrieType>();
+    var index = new List<TrieType>();
+    var values = new List<TrieType>();
+
+    for (var off = 0; off < count; off += chunkSize)
+    {
+        var key = new ReadOnlyTrieTypeSpan(uncompressed, off, chunkSize);
+        if (!cache.TryGetValue(key, out var chunk))
+        {
+            chunk = (TrieType)(values.Count / chunkSize);
+            cache[key] = chunk;
+            values.AddRange(key.AsSpan());
+        }
+
+        index.Add(chunk);
+    }
+
+    static int Bits(List<TrieType> list) => list.Max() switch
+    {
+        <= 0xff => 8,
+        <= 0xffff => 16,
+        _ => 32
+    };
+
+    var indexBits = Bits(index);
+    var valueBits = Bits(values);
+
+    return new FlatTable
+    {
+        Index = index,
+        Values = values,
+        Count = count,
+        Shift = shift,
+        IndexBits = indexBits,
+        ValueBits = valueBits,
+        TotalSize = (indexBits / 8) * index.Count + (valueBits / 8) * values.Count,
+    };
+}
+
 // Finds needle in haystack. Returns -1 if it couldn't be found.
 static int FindExisting(ReadOnlySpan<TrieType> haystack, ReadOnlySpan<TrieType> needle)
 {
@@ -555,6 +635,17 @@ class Trie
     public required int TotalSize;
 }
 
+class FlatTable
+{
+    public required List<TrieType> Index;
+    public required List<TrieType> Values;
+    public required int Count;
+    public required int Shift;
+    public required int IndexBits;
+    public required int ValueBits;
+    public required int TotalSize;
+}
+
 // Because you can't put a Span<TrieType> into a Dictionary.
 // This works around that by simply keeping a reference to the List<TrieType> around.
 struct ReadOnlyTrieTypeSpan(List<TrieType> list, int start, int length)
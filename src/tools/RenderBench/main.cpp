@@ -0,0 +1,778 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// RenderBench is a headless benchmark for the Renderer. It wires up the same VT output path as VtBench,
+// but with a Renderer and a RecordingRenderEngine attached to the text buffer. It replays a set of synthetic
+// workloads, paints a frame after every --frame-size KiB of output like the render thread would, and prints
+// the frames per second and the time spent per render primitive as JSON.
+//
+// With --record it instead writes the primitive log of each workload to <dir>\<name>.log. The logs don't
+// contain any timings, so they can be diffed between two builds to catch rendering regressions without a GPU.
+//
+// --api selects whether the engine accepts whole rows (IRenderEngine::PaintBufferRow) or only clusters (PaintBufferLine).
+//
+// --mode concurrent instead measures how fast the output is parsed while a second thread paints frames back to back,
+// which is the worst case for the parser. It's measured three times: without painting, with the engine painted under
+// the console lock (like GdiEngine) and with the engine painted from the Renderer's snapshot without the lock (like AtlasEngine).
+//
+// Usage: RenderBench [--size <KiB>] [--frame-size <KiB>] [--iterations <count>] [--filter <name>] [--api cluster|row] [--mode frames|concurrent] [--output <path>] [--record <dir>]
+
+#include "pch.h"
+
+#include <thread>
+
+#include <til/ticket_lock.h>
+
+#include "../../renderer/inc/RecordingRenderEngine.hpp"
+#include "../BenchCommon/Workloads.hpp"
+
+using namespace Microsoft::Console::Bench;
+using namespace Microsoft::Console::Render;
+using namespace Microsoft::Console::Types;
+using namespace Microsoft::Console::VirtualTerminal;
+
+namespace
+{
+    // Adds the parts of Terminal that the Renderer calls into to the shared HeadlessTerminalApi.
+    // Its text buffers are connected to the Renderer, so that they invalidate
+    // the engine exactly like they would in Windows Terminal.
+    class HeadlessTerminal final : public HeadlessTerminalApi, public IRenderData
+    {
+    public:
+        HeadlessTerminal() :
+            HeadlessTerminalApi{ &_renderer }
+        {
+            _renderer.AddRenderEngine(&_engine);
+            _renderer.EnablePainting();
+        }
+
+        Renderer& GetRenderer() noexcept
+        {
+            return _renderer;
+        }
+
+        RecordingRenderEngine& GetEngine() noexcept
+        {
+            return _engine;
+        }
+
+        // Selects a block of the given viewport-relative cells.
+        void SelectViewportBlock(const til::inclusive_rect& rect)
+        {
+            const auto top = _altBuffer ? 0 : _viewport.top;
+            _selection = til::inclusive_rect{ rect.left, rect.top + top, rect.right, rect.bottom + top };
+            _renderer.TriggerSelection();
+        }
+
+#pragma region ITerminalApi
+        void UseAlternateScreenBuffer(const TextAttribute& attrs) override
+        {
+            _selection.reset();
+            HeadlessTerminalApi::UseAlternateScreenBuffer(attrs);
+        }
+
+        void UseMainScreenBuffer() override
+        {
+            _selection.reset();
+            HeadlessTerminalApi::UseMainScreenBuffer();
+        }
+
+        void NotifyBufferRotation(const int delta) override
+        {
+            if (_selection)
+            {
+                _selection->top -= delta;
+                _selection->bottom -= delta;
+                if (_selection->bottom < 0)
+                {
+                    _selection.reset();
+                }
+            }
+        }
+#pragma endregion
+
+#pragma region IRenderData
+        Viewport GetViewport() noexcept override
+        {
+            return Viewport::FromExclusive(_altBuffer ? til::rect{ 0, 0, viewportWidth, viewportHeight } : _viewport);
+        }
+
+        til::point GetTextBufferEndPosition() const noexcept override
+        {
+            return { viewportWidth - 1, _altBuffer ? viewportHeight - 1 : _viewport.bottom - 1 };
+        }
+
+        TextBuffer& GetTextBuffer() const noexcept override
+        {
+            return _altBuffer ? *_altBuffer : *_mainBuffer;
+        }
+
+        const FontInfo& GetFontInfo() const noexcept override
+        {
+            return _fontInfo;
+        }
+
+        std::vector<Viewport> GetSelectionRects() noexcept override
+        try
+        {
+            std::vector<Viewport> rects;
+            if (_selection)
+            {
+                for (auto y = std::max(0, _selection->top); y <= _selection->bottom; ++y)
+                {
+                    rects.emplace_back(Viewport::FromInclusive({ _selection->left, y, _selection->right, y }));
+                }
+            }
+            return rects;
+        }
+        catch (...)
+        {
+            LOG_CAUGHT_EXCEPTION();
+            return {};
+        }
+
+        std::span<const til::point_span> GetSearchHighlights() const noexcept override
+        {
+            return {};
+        }
+
+        const til::point_span* GetSearchHighlightFocused() const noexcept override
+        {
+            return nullptr;
+        }
+
+        void LockConsole() noexcept override
+        {
+            _lock.lock();
+        }
+
+        void UnlockConsole() noexcept override
+        {
+            _lock.unlock();
+        }
+
+        til::point GetCursorPosition() const noexcept override
+        {
+            return GetTextBuffer().GetCursor().GetPosition();
+        }
+
+        bool IsCursorVisible() const noexcept override
+        {
+            return GetTextBuffer().GetCursor().IsVisible();
+        }
+
+        bool IsCursorOn() const noexcept override
+        {
+            return GetTextBuffer().GetCursor().IsOn();
+        }
+
+        ULONG GetCursorHeight() const noexcept override
+        {
+            return GetTextBuffer().GetCursor().GetSize();
+        }
+
+        CursorType GetCursorStyle() const noexcept override
+        {
+            return GetTextBuffer().GetCursor().GetType();
+        }
+
+        ULONG GetCursorPixelWidth() const noexcept override
+        {
+            return 1;
+        }
+
+        bool IsCursorDoubleWidth() const override
+        {
+            const auto& buffer = GetTextBuffer();
+            const auto position = buffer.GetCursor().GetPosition();
+            return buffer.GetRowByOffset(position.y).DbcsAttrAt(position.x) != DbcsAttribute::Single;
+        }
+
+        const bool IsGridLineDrawingAllowed() noexcept override
+        {
+            return true;
+        }
+
+        const std::wstring_view GetConsoleTitle() const noexcept override
+        {
+            return _title;
+        }
+
+        const std::wstring GetHyperlinkUri(uint16_t id) const override
+        {
+            return GetTextBuffer().GetHyperlinkUriFromId(id);
+        }
+
+        const std::wstring GetHyperlinkCustomId(uint16_t id) const override
+        {
+            return GetTextBuffer().GetCustomIdFromId(id);
+        }
+
+        const std::vector<size_t> GetPatternId(const til::point) const override
+        {
+            return {};
+        }
+
+        std::pair<COLORREF, COLORREF> GetAttributeColors(const TextAttribute& attr) const noexcept override
+        {
+            return _renderSettings.GetAttributeColors(attr);
+        }
+
+        const bool IsSelectionActive() const override
+        {
+            return _selection.has_value();
+        }
+
+        const bool IsBlockSelection() const override
+        {
+            return true;
+        }
+
+        void ClearSelection() override
+        {
+            _selection.reset();
+        }
+
+        void SelectNewRegion(const til::point coordStart, const til::point coordEnd) override
+        {
+            _selection = til::inclusive_rect{ coordStart.x, coordStart.y, coordEnd.x, coordEnd.y };
+        }
+
+        const til::point GetSelectionAnchor() const noexcept override
+        {
+            return _selection ? til::point{ _selection->left, _selection->top } : til::point{};
+        }
+
+        const til::point GetSelectionEnd() const noexcept override
+        {
+            return _selection ? til::point{ _selection->right, _selection->bottom } : til::point{};
+        }
+
+        const bool IsUiaDataInitialized() const noexcept override
+        {
+            return true;
+        }
+#pragma endregion
+
+    private:
+        til::recursive_ticket_lock _lock;
+        RecordingRenderEngine _engine;
+        // The base class only stores a pointer to it, so it's fine that it's constructed after it.
+        Renderer _renderer{ _renderSettings, this, nullptr, 0, nullptr };
+        FontInfo _fontInfo{ L"Consolas", 0, FW_NORMAL, RecordingRenderEngine::CellSize, CP_UTF8 };
+        std::optional<til::inclusive_rect> _selection;
+    };
+
+    // Colored log output, which results in many short runs and brush changes per row.
+    std::string generateSgr(const size_t size)
+    {
+        std::string out;
+        Rng rng;
+        while (out.size() < size)
+        {
+            const auto words = rng.next(3, 16);
+            for (uint32_t i = 0; i < words; ++i)
+            {
+                switch (rng.next(0, 4))
+                {
+                case 0:
+                    fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[{}m"), rng.next(30, 38));
+                    break;
+                case 1:
+                    fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[38;5;{};48;5;{}m"), rng.next(0, 256), rng.next(0, 256));
+                    break;
+                case 2:
+                    fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[1;38;2;{};{};{}m"), rng.next(0, 256), rng.next(0, 256), rng.next(0, 256));
+                    break;
+                default:
+                    break;
+                }
+                appendWord(out, rng);
+                out.append("\x1b[m ");
+            }
+            out.append("\r\n");
+        }
+        return out;
+    }
+
+    // Underline styles, underline colors, strikethrough and hyperlinks, all of which are drawn as gridlines.
+    std::string generateGridlines(const size_t size)
+    {
+        static constexpr std::string_view styles[]{
+            "\x1b[4m",
+            "\x1b[21m",
+            "\x1b[4:3;58;5;196m",
+            "\x1b[4:4;58;2;0;128;255m",
+            "\x1b[4:5m",
+            "\x1b[9m",
+            "\x1b]8;;https://example.com\x1b\\",
+        };
+
+        std::string out;
+        Rng rng;
+        while (out.size() < size)
+        {
+            const auto words = rng.next(3, 16);
+            for (uint32_t i = 0; i < words; ++i)
+            {
+                const auto style = rng.next(0, 10);
+                if (style < std::size(styles))
+                {
+                    out.append(til::at(styles, style));
+                }
+                appendWord(out, rng);
+                out.append("\x1b]8;;\x1b\\\x1b[m ");
+            }
+            out.append("\r\n");
+        }
+        return out;
+    }
+
+    // Text scrolling within a scroll region (DECSTBM), which can't be handled
+    // by scrolling the entire viewport and invalidates the region instead.
+    std::string generateScrollRegion(const size_t size)
+    {
+        std::string out;
+        Rng rng;
+        fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[5;{}r\x1b[{};1H"), viewportHeight - 5, viewportHeight - 5);
+        while (out.size() < size)
+        {
+            const auto words = rng.next(1, 15);
+            for (uint32_t i = 0; i < words; ++i)
+            {
+                appendWord(out, rng);
+                out.push_back(' ');
+            }
+            out.append("\r\n");
+        }
+        out.append("\x1b[r");
+        return out;
+    }
+
+    struct Workload
+    {
+        std::string_view name;
+        std::string (*generate)(size_t size);
+        // Keeps a block selection active in the middle of the viewport.
+        bool selection = false;
+    };
+
+    constexpr Workload workloads[]{
+        { "ascii", generateAscii },
+        { "sgr", generateSgr },
+        { "unicode", generateUnicode },
+        { "gridlines", generateGridlines },
+        { "tui", generateTui },
+        { "scroll-region", generateScrollRegion },
+        { "selection", generateSgr, true },
+    };
+
+    struct Options
+    {
+        size_t size = 4 * 1024 * 1024;
+        size_t frameSize = 16 * 1024;
+        size_t iterations = 5;
+        std::wstring_view filter;
+        bool rowPainting = false;
+        bool concurrent = false;
+        std::wstring_view output;
+        std::wstring_view record;
+    };
+
+    Options parseOptions(const int argc, const wchar_t* argv[])
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::wstring_view arg{ argv[i] };
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument{ "missing value for the last argument" };
+            }
+
+            const std::wstring_view value{ argv[++i] };
+            if (arg == L"--size")
+            {
+                options.size = std::stoull(std::wstring{ value }) * 1024;
+            }
+            else if (arg == L"--frame-size")
+            {
+                options.frameSize = std::max<size_t>(1, std::stoull(std::wstring{ value })) * 1024;
+            }
+            else if (arg == L"--iterations")
+            {
+                options.iterations = std::max<size_t>(1, std::stoull(std::wstring{ value }));
+            }
+            else if (arg == L"--filter")
+            {
+                options.filter = value;
+            }
+            else if (arg == L"--api")
+            {
+                if (value != L"cluster" && value != L"row")
+                {
+                    throw std::invalid_argument{ "--api must be either cluster or row" };
+                }
+                options.rowPainting = value == L"row";
+            }
+            else if (arg == L"--mode")
+            {
+                if (value != L"frames" && value != L"concurrent")
+                {
+                    throw std::invalid_argument{ "--mode must be either frames or concurrent" };
+                }
+                options.concurrent = value == L"concurrent";
+            }
+            else if (arg == L"--output")
+            {
+                options.output = value;
+            }
+            else if (arg == L"--record")
+            {
+                options.record = value;
+            }
+            else
+            {
+                throw std::invalid_argument{ "unknown argument" };
+            }
+        }
+
+        return options;
+    }
+
+    void writeFile(const std::wstring& path, const std::string_view content)
+    {
+        const wil::unique_hfile file{ CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+        THROW_LAST_ERROR_IF(!file);
+        DWORD written = 0;
+        THROW_IF_WIN32_BOOL_FALSE(WriteFile(file.get(), content.data(), gsl::narrow<DWORD>(content.size()), &written, nullptr));
+    }
+
+    // Feeds the payload to the terminal in chunks of `frameSize` and paints a frame after each
+    // of them, the same way the render thread coalesces output. Returns the time spent painting.
+    std::chrono::nanoseconds replay(HeadlessTerminal& terminal, const Workload& workload, const std::string_view payload, const size_t frameSize)
+    {
+        auto& stateMachine = terminal.GetStateMachine();
+        auto& renderer = terminal.GetRenderer();
+        std::chrono::nanoseconds elapsed{};
+
+        for (size_t offset = 0; offset < payload.size(); offset += frameSize)
+        {
+            stateMachine.ProcessString(payload.substr(offset, frameSize));
+            if (workload.selection)
+            {
+                terminal.SelectViewportBlock({ 10, 5, viewportWidth - 10, viewportHeight - 5 });
+            }
+
+            const auto beg = std::chrono::steady_clock::now();
+            THROW_IF_FAILED(renderer.PaintFrame());
+            elapsed += std::chrono::steady_clock::now() - beg;
+        }
+
+        return elapsed;
+    }
+
+    void record(const Workload& workload, const Options& options)
+    {
+        const auto payload = workload.generate(options.size);
+        HeadlessTerminal terminal;
+        terminal.GetEngine().SetRowPainting(options.rowPainting);
+        replay(terminal, workload, payload, options.frameSize);
+
+        auto path = std::wstring{ options.record };
+        path.append(L"\\");
+        path.append(til::u8u16(workload.name));
+        path.append(L".log");
+        writeFile(path, terminal.GetEngine().Log());
+    }
+
+    struct Result
+    {
+        std::string_view name;
+        size_t bytes = 0;
+        uint64_t frames = 0;
+        std::vector<int64_t> durations;
+        Renderer::FrameSkipCounters skips;
+        std::array<RecordingRenderEngine::PrimitiveStats, static_cast<size_t>(RecordingRenderEngine::Primitive::Count)> stats{};
+    };
+
+    Result run(const Workload& workload, const Options& options)
+    {
+        const auto payload = workload.generate(options.size);
+        HeadlessTerminal terminal;
+        auto& engine = terminal.GetEngine();
+        engine.SetRecording(false);
+        engine.SetRowPainting(options.rowPainting);
+
+        Result result;
+        result.name = workload.name;
+        result.bytes = payload.size();
+
+        Renderer::FrameSkipCounters skipsBefore;
+        result.durations = warmUpAndMeasure(
+            options.iterations,
+            [&]() { return replay(terminal, workload, payload, options.frameSize); },
+            [&]() {
+                engine.ResetStats();
+                skipsBefore = terminal.GetRenderer().GetFrameSkipCounters();
+            });
+
+        const auto skipsAfter = terminal.GetRenderer().GetFrameSkipCounters();
+        result.skips.droppedRows = skipsAfter.droppedRows - skipsBefore.droppedRows;
+        result.skips.droppedFrames = skipsAfter.droppedFrames - skipsBefore.droppedFrames;
+        result.frames = engine.FrameCount();
+        std::ranges::copy(engine.Stats(), result.stats.begin());
+        return result;
+    }
+
+    std::string formatResults(const Options& options, std::vector<Result>& results)
+    {
+        std::string out;
+        fmt::format_to(
+            std::back_inserter(out),
+            FMT_COMPILE("{{\n  \"version\": 1,\n  \"config\": {{ \"width\": {}, \"height\": {}, \"scrollback\": {}, \"frameSize\": {}, \"iterations\": {}, \"api\": \"{}\" }},\n  \"results\": ["),
+            viewportWidth,
+            viewportHeight,
+            scrollbackLines,
+            options.frameSize,
+            options.iterations,
+            options.rowPainting ? "row" : "cluster");
+
+        for (auto& r : results)
+        {
+            std::ranges::sort(r.durations);
+
+            const auto iterations = static_cast<double>(r.durations.size());
+            const auto framesPerIteration = static_cast<double>(r.frames) / iterations;
+            const auto min = r.durations.front();
+            const auto median = r.durations[r.durations.size() / 2];
+            const auto mean = static_cast<int64_t>(std::accumulate(r.durations.begin(), r.durations.end(), 0.0) / iterations);
+
+            fmt::format_to(
+                std::back_inserter(out),
+                FMT_COMPILE("{}\n    {{ \"name\": \"{}\", \"bytes\": {}, \"framesPerIteration\": {:.0f}, \"ns\": {{ \"min\": {}, \"median\": {}, \"mean\": {} }}, \"framesPerSec\": {:.1f}, \"droppedRowsPerIteration\": {:.0f}, \"droppedFramesPerIteration\": {:.0f}, \"phases\": {{"),
+                &r == &results.front() ? "" : ",",
+                r.name,
+                r.bytes,
+                framesPerIteration,
+                min,
+                median,
+                mean,
+                framesPerIteration / (static_cast<double>(median) / 1e9),
+                static_cast<double>(r.skips.droppedRows) / iterations,
+                static_cast<double>(r.skips.droppedFrames) / iterations);
+
+            const auto frames = static_cast<double>(std::max<uint64_t>(1, r.frames));
+            for (size_t i = 0; i < r.stats.size(); ++i)
+            {
+                const auto& stats = til::at(r.stats, i);
+                fmt::format_to(
+                    std::back_inserter(out),
+                    FMT_COMPILE("{}\n      \"{}\": {{ \"callsPerFrame\": {:.2f}, \"nsPerFrame\": {:.0f} }}"),
+                    i == 0 ? "" : ",",
+                    til::at(RecordingRenderEngine::PrimitiveNames, i),
+                    static_cast<double>(stats.calls) / frames,
+                    static_cast<double>(stats.time.count()) / frames);
+            }
+
+            out.append("\n    } }");
+        }
+
+        out.append("\n  ]\n}\n");
+        return out;
+    }
+
+    // How the engine gets painted while the output is parsed in --mode concurrent.
+    enum class Painting : size_t
+    {
+        // There's no render thread at all, which is the upper bound.
+        Idle,
+        // The Renderer holds the console lock for the entire frame.
+        Locked,
+        // The Renderer only holds the console lock while updating its snapshot.
+        Unlocked,
+        Count,
+    };
+
+    constexpr std::array<std::string_view, static_cast<size_t>(Painting::Count)> paintingNames{
+        "idle",
+        "locked",
+        "unlocked",
+    };
+
+    // Feeds the payload to the terminal in chunks of `frameSize` and holds the console lock for each of them,
+    // like ControlCore does for each read from the connection. Meanwhile, another thread paints frames back to back.
+    // Returns the time it took to parse the payload.
+    std::chrono::nanoseconds parse(HeadlessTerminal& terminal, const std::string_view payload, const size_t frameSize, const Painting painting)
+    {
+        auto& stateMachine = terminal.GetStateMachine();
+        auto& renderer = terminal.GetRenderer();
+        terminal.GetEngine().SetUnlockedPainting(painting == Painting::Unlocked);
+
+        std::atomic<bool> done{ false };
+        std::thread renderThread;
+        if (painting != Painting::Idle)
+        {
+            renderThread = std::thread{ [&]() {
+                while (!done.load(std::memory_order_relaxed))
+                {
+                    LOG_IF_FAILED(renderer.PaintFrame());
+                }
+            } };
+        }
+        const auto joinRenderThread = wil::scope_exit([&]() {
+            done.store(true, std::memory_order_relaxed);
+            if (renderThread.joinable())
+            {
+                renderThread.join();
+            }
+        });
+
+        const auto beg = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < payload.size(); offset += frameSize)
+        {
+            terminal.LockConsole();
+            const auto unlock = wil::scope_exit([&]() {
+                terminal.UnlockConsole();
+            });
+            stateMachine.ProcessString(payload.substr(offset, frameSize));
+        }
+        return std::chrono::steady_clock::now() - beg;
+    }
+
+    struct ConcurrentResult
+    {
+        std::string_view name;
+        size_t bytes = 0;
+        std::array<std::vector<int64_t>, static_cast<size_t>(Painting::Count)> durations;
+        std::array<uint64_t, static_cast<size_t>(Painting::Count)> frames{};
+    };
+
+    ConcurrentResult runConcurrent(const Workload& workload, const Options& options)
+    {
+        const auto payload = workload.generate(options.size);
+
+        ConcurrentResult result;
+        result.name = workload.name;
+        result.bytes = payload.size();
+
+        for (size_t i = 0; i < paintingNames.size(); ++i)
+        {
+            const auto painting = static_cast<Painting>(i);
+            HeadlessTerminal terminal;
+            auto& engine = terminal.GetEngine();
+            engine.SetRecording(false);
+            engine.SetRowPainting(options.rowPainting);
+
+            til::at(result.durations, i) = warmUpAndMeasure(
+                options.iterations,
+                [&]() { return parse(terminal, payload, options.frameSize, painting); },
+                [&]() { engine.ResetStats(); });
+            til::at(result.frames, i) = engine.FrameCount();
+        }
+
+        return result;
+    }
+
+    std::string formatConcurrentResults(const Options& options, std::vector<ConcurrentResult>& results)
+    {
+        std::string out;
+        fmt::format_to(
+            std::back_inserter(out),
+            FMT_COMPILE("{{\n  \"version\": 1,\n  \"config\": {{ \"width\": {}, \"height\": {}, \"scrollback\": {}, \"frameSize\": {}, \"iterations\": {}, \"api\": \"{}\", \"mode\": \"concurrent\" }},\n  \"results\": ["),
+            viewportWidth,
+            viewportHeight,
+            scrollbackLines,
+            options.frameSize,
+            options.iterations,
+            options.rowPainting ? "row" : "cluster");
+
+        for (auto& r : results)
+        {
+            fmt::format_to(std::back_inserter(out), FMT_COMPILE("{}\n    {{ \"name\": \"{}\", \"bytes\": {}, \"painting\": {{"), &r == &results.front() ? "" : ",", r.name, r.bytes);
+
+            for (size_t i = 0; i < paintingNames.size(); ++i)
+            {
+                auto& durations = til::at(r.durations, i);
+                std::ranges::sort(durations);
+
+                const auto iterations = static_cast<double>(durations.size());
+                const auto min = durations.front();
+                const auto median = durations[durations.size() / 2];
+
+                fmt::format_to(
+                    std::back_inserter(out),
+                    FMT_COMPILE("{}\n      \"{}\": {{ \"ns\": {{ \"min\": {}, \"median\": {} }}, \"parseMBPerSec\": {:.1f}, \"framesPerIteration\": {:.0f} }}"),
+                    i == 0 ? "" : ",",
+                    til::at(paintingNames, i),
+                    min,
+                    median,
+                    static_cast<double>(r.bytes) / (static_cast<double>(median) / 1e9) / (1024.0 * 1024.0),
+                    static_cast<double>(til::at(r.frames, i)) / iterations);
+            }
+
+            out.append("\n    } }");
+        }
+
+        out.append("\n  ]\n}\n");
+        return out;
+    }
+}
+
+int __cdecl wmain(int argc, const wchar_t* argv[])
+try
+{
+    const auto options = parseOptions(argc, argv);
+
+    std::vector<Result> results;
+    std::vector<ConcurrentResult> concurrentResults;
+    for (const auto& workload : workloads)
+    {
+        if (!options.filter.empty() && options.filter != til::u8u16(workload.name))
+        {
+            continue;
+        }
+
+        if (!options.record.empty())
+        {
+            record(workload, options);
+        }
+        else if (options.concurrent)
+        {
+            concurrentResults.emplace_back(runConcurrent(workload, options));
+        }
+        else
+        {
+            results.emplace_back(run(workload, options));
+        }
+    }
+
+    if (!options.record.empty())
+    {
+        return 0;
+    }
+
+    const auto json = options.concurrent ? formatConcurrentResults(options, concurrentResults) : formatResults(options, results);
+
+    if (options.output.empty())
+    {
+        fwrite(json.data(), 1, json.size(), stdout);
+    }
+    else
+    {
+        writeFile(std::wstring{ options.output }, json);
+    }
+
+    return 0;
+}
+catch (const std::invalid_argument& e)
+{
+    fprintf(stderr, "RenderBench: %s\nUsage: RenderBench [--size <KiB>] [--frame-size <KiB>] [--iterations <count>] [--filter <name>] [--api cluster|row] [--mode frames|concurrent] [--output <path>] [--record <dir>]\n", e.what());
+    return 1;
+}
+catch (...)
+{
+    fprintf(stderr, "RenderBench: failed with 0x%08lx\n", static_cast<unsigned long>(wil::ResultFromCaughtException()));
+    return 1;
+}
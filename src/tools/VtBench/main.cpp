@@ -0,0 +1,372 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// VtBench is a headless throughput benchmark for the VT output path. Unlike ConsoleBench and
+// benchcat it doesn't need a console session: It wires up StateMachine, OutputStateMachineEngine,
+// AdaptDispatch and TextBuffer behind a stub ITerminalApi without a renderer, replays a set of
+// synthetic workloads and prints the results as JSON, so that runs can be diffed against each other.
+// Each workload is fed to the parser once as UTF-8 and once converted to UTF-16 chunk by chunk,
+// the way ConptyConnection used to do, unless --encoding picks one of the two.
+//
+// Usage: VtBench [--size <MiB>] [--iterations <count>] [--filter <name>] [--encoding <utf8|utf16>] [--output <path>]
+
+#include "pch.h"
+
+#include "../BenchCommon/Workloads.hpp"
+
+using namespace Microsoft::Console::Bench;
+
+#pragma warning(disable : 26409) // Avoid calling new and delete explicitly, use std::make_unique<T> instead (r.11).
+#pragma warning(disable : 26481) // Don't use pointer arithmetic. Use span instead (bounds.1).
+
+static std::atomic<uint64_t> s_allocations{ 0 };
+
+// The global allocation functions are replaced so that we can report the number of allocations per MB.
+// The array and nothrow variants forward to these by default.
+void* __cdecl operator new(size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (const auto p = malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void __cdecl operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void __cdecl operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+    // The same read size as ConptyConnection::_OutputThread.
+    constexpr size_t chunkSize = 128 * 1024;
+
+    // Colored log output with 16-color, 256-color and RGB SGR sequences.
+    std::string generateSgr(const size_t size)
+    {
+        static constexpr std::string_view levels[]{
+            "\x1b[32mINFO\x1b[m ",
+            "\x1b[1;33mWARN\x1b[m ",
+            "\x1b[1;37;41mFAIL\x1b[m ",
+            "\x1b[2;3mDEBUG\x1b[22;23m ",
+        };
+
+        std::string out;
+        Rng rng;
+        for (uint32_t line = 0; out.size() < size; ++line)
+        {
+            fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[90m2024-01-01T00:{:02}:{:02}.{:03}Z\x1b[m "), line / 60 % 60, line % 60, line % 1000);
+            out.append(levels[rng.next(0, 4)]);
+
+            const auto words = rng.next(3, 12);
+            for (uint32_t i = 0; i < words; ++i)
+            {
+                switch (rng.next(0, 4))
+                {
+                case 0:
+                    fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[38;5;{}m"), rng.next(0, 256));
+                    break;
+                case 1:
+                    fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[38;2;{};{};{}m"), rng.next(0, 256), rng.next(0, 256), rng.next(0, 256));
+                    break;
+                case 2:
+                    out.append("\x1b[4m");
+                    break;
+                default:
+                    break;
+                }
+                appendWord(out, rng);
+                out.append("\x1b[m ");
+            }
+            out.append("\r\n");
+        }
+        return out;
+    }
+
+    // Sixel images in the main buffer, which scroll the buffer as they're drawn.
+    std::string generateSixel(const size_t size)
+    {
+        std::string out;
+        Rng rng;
+        while (out.size() < size)
+        {
+            out.append("\x1bPq\"1;1;240;60");
+            for (auto color = 0; color < 16; ++color)
+            {
+                fmt::format_to(std::back_inserter(out), FMT_COMPILE("#{};2;{};{};{}"), color, rng.next(0, 101), rng.next(0, 101), rng.next(0, 101));
+            }
+            for (auto band = 0; band < 10; ++band)
+            {
+                for (auto color = 0; color < 16; ++color)
+                {
+                    fmt::format_to(std::back_inserter(out), FMT_COMPILE("#{}"), color);
+                    for (uint32_t x = 0; x < 240;)
+                    {
+                        const auto repeat = rng.next(1, 16);
+                        fmt::format_to(std::back_inserter(out), FMT_COMPILE("!{}{}"), repeat, static_cast<char>(rng.next('?', '~' + 1)));
+                        x += repeat;
+                    }
+                    out.push_back('$');
+                }
+                out.push_back('-');
+            }
+            out.append("\x1b\\\r\n");
+        }
+        return out;
+    }
+
+    // Text scrolling within a scroll region (DECSTBM) combined with line
+    // insertions and deletions, like a pager or a chat client would do.
+    std::string generateScrollRegion(const size_t size)
+    {
+        std::string out;
+        Rng rng;
+        fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[5;{}r\x1b[{};1H"), viewportHeight - 5, viewportHeight - 5);
+        for (uint32_t line = 0; out.size() < size; ++line)
+        {
+            const auto words = rng.next(1, 15);
+            for (uint32_t i = 0; i < words; ++i)
+            {
+                appendWord(out, rng);
+                out.push_back(' ');
+            }
+            out.append("\r\n");
+
+            if (line % 16 == 0)
+            {
+                fmt::format_to(std::back_inserter(out), FMT_COMPILE("\x1b[{};1H\x1b[{}L\x1b[{}M\x1b[{};1H"), rng.next(5, viewportHeight - 5), rng.next(1, 4), rng.next(1, 4), viewportHeight - 5);
+            }
+        }
+        out.append("\x1b[r");
+        return out;
+    }
+
+    struct Workload
+    {
+        std::string_view name;
+        std::string (*generate)(size_t size);
+    };
+
+    constexpr Workload workloads[]{
+        { "ascii", generateAscii },
+        { "sgr", generateSgr },
+        { "unicode", generateUnicode },
+        { "tui", generateTui },
+        { "sixel", generateSixel },
+        { "scroll-region", generateScrollRegion },
+    };
+
+    enum class Encoding
+    {
+        Utf8,
+        Utf16,
+    };
+
+    constexpr std::string_view encodingName(const Encoding encoding) noexcept
+    {
+        return encoding == Encoding::Utf8 ? "utf8" : "utf16";
+    }
+
+    struct Options
+    {
+        size_t size = 16 * 1024 * 1024;
+        size_t iterations = 5;
+        std::wstring_view filter;
+        std::wstring_view encoding;
+        std::wstring_view output;
+    };
+
+    Options parseOptions(const int argc, const wchar_t* argv[])
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::wstring_view arg{ argv[i] };
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument{ "missing value for the last argument" };
+            }
+
+            const std::wstring_view value{ argv[++i] };
+            if (arg == L"--size")
+            {
+                options.size = std::stoull(std::wstring{ value }) * 1024 * 1024;
+            }
+            else if (arg == L"--iterations")
+            {
+                options.iterations = std::max<size_t>(1, std::stoull(std::wstring{ value }));
+            }
+            else if (arg == L"--filter")
+            {
+                options.filter = value;
+            }
+            else if (arg == L"--encoding")
+            {
+                if (value != L"utf8" && value != L"utf16")
+                {
+                    throw std::invalid_argument{ "unknown encoding" };
+                }
+                options.encoding = value;
+            }
+            else if (arg == L"--output")
+            {
+                options.output = value;
+            }
+            else
+            {
+                throw std::invalid_argument{ "unknown argument" };
+            }
+        }
+
+        return options;
+    }
+
+    struct Result
+    {
+        std::string_view name;
+        Encoding encoding = Encoding::Utf8;
+        size_t bytes = 0;
+        std::vector<int64_t> durations;
+        uint64_t allocations = 0;
+    };
+
+    Result run(const Workload& workload, const std::string& payload, const Encoding encoding, const Options& options)
+    {
+        HeadlessTerminalApi api;
+        auto& stateMachine = api.GetStateMachine();
+        til::u8state u8State;
+        std::wstring wstr;
+        uint64_t allocations = 0;
+
+        const auto replay = [&]() {
+            const auto allocationsBeg = s_allocations.load(std::memory_order_relaxed);
+            const auto beg = std::chrono::steady_clock::now();
+            for (size_t offset = 0; offset < payload.size(); offset += chunkSize)
+            {
+                const auto chunk = std::string_view{ payload }.substr(offset, chunkSize);
+                if (encoding == Encoding::Utf8)
+                {
+                    stateMachine.ProcessString(chunk);
+                }
+                else
+                {
+                    THROW_IF_FAILED(til::u8u16(chunk, wstr, u8State));
+                    stateMachine.ProcessString(wstr);
+                }
+            }
+            const auto end = std::chrono::steady_clock::now();
+            allocations += s_allocations.load(std::memory_order_relaxed) - allocationsBeg;
+            return end - beg;
+        };
+
+        Result result;
+        result.name = workload.name;
+        result.encoding = encoding;
+        result.bytes = payload.size();
+        result.durations = warmUpAndMeasure(options.iterations, replay, [&]() {
+            allocations = 0;
+        });
+        result.allocations = allocations;
+        return result;
+    }
+
+    std::string formatResults(const Options& options, std::vector<Result>& results)
+    {
+        std::string out;
+        fmt::format_to(
+            std::back_inserter(out),
+            FMT_COMPILE("{{\n  \"version\": 1,\n  \"config\": {{ \"width\": {}, \"height\": {}, \"scrollback\": {}, \"chunkSize\": {}, \"iterations\": {} }},\n  \"results\": ["),
+            viewportWidth,
+            viewportHeight,
+            scrollbackLines,
+            chunkSize,
+            options.iterations);
+
+        for (auto& r : results)
+        {
+            std::ranges::sort(r.durations);
+
+            const auto iterations = static_cast<double>(r.durations.size());
+            const auto bytes = static_cast<double>(r.bytes);
+            const auto megabytes = bytes / (1024.0 * 1024.0);
+            const auto min = r.durations.front();
+            const auto median = r.durations[r.durations.size() / 2];
+            const auto mean = static_cast<int64_t>(std::accumulate(r.durations.begin(), r.durations.end(), 0.0) / iterations);
+
+            fmt::format_to(
+                std::back_inserter(out),
+                FMT_COMPILE("{}\n    {{ \"name\": \"{}\", \"encoding\": \"{}\", \"bytes\": {}, \"ns\": {{ \"min\": {}, \"median\": {}, \"mean\": {} }}, \"mbPerSec\": {:.2f}, \"nsPerByte\": {:.3f}, \"allocationsPerMB\": {:.1f} }}"),
+                &r == &results.front() ? "" : ",",
+                r.name,
+                encodingName(r.encoding),
+                r.bytes,
+                min,
+                median,
+                mean,
+                megabytes / (static_cast<double>(median) / 1e9),
+                static_cast<double>(median) / bytes,
+                static_cast<double>(r.allocations) / iterations / megabytes);
+        }
+
+        out.append("\n  ]\n}\n");
+        return out;
+    }
+}
+
+int __cdecl wmain(int argc, const wchar_t* argv[])
+try
+{
+    const auto options = parseOptions(argc, argv);
+
+    std::vector<Result> results;
+    for (const auto& workload : workloads)
+    {
+        if (!options.filter.empty() && options.filter != til::u8u16(workload.name))
+        {
+            continue;
+        }
+
+        const auto payload = workload.generate(options.size);
+        for (const auto encoding : { Encoding::Utf8, Encoding::Utf16 })
+        {
+            if (options.encoding.empty() || options.encoding == til::u8u16(encodingName(encoding)))
+            {
+                results.emplace_back(run(workload, payload, encoding, options));
+            }
+        }
+    }
+
+    const auto json = formatResults(options, results);
+
+    if (options.output.empty())
+    {
+        fwrite(json.data(), 1, json.size(), stdout);
+    }
+    else
+    {
+        const wil::unique_hfile file{ CreateFileW(std::wstring{ options.output }.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+        THROW_LAST_ERROR_IF(!file);
+        DWORD written = 0;
+        THROW_IF_WIN32_BOOL_FALSE(WriteFile(file.get(), json.data(), gsl::narrow<DWORD>(json.size()), &written, nullptr));
+    }
+
+    return 0;
+}
+catch (const std::invalid_argument& e)
+{
+    fprintf(stderr, "VtBench: %s\nUsage: VtBench [--size <MiB>] [--iterations <count>] [--filter <name>] [--encoding <utf8|utf16>] [--output <path>]\n", e.what());
+    return 1;
+}
+catch (...)
+{
+    fprintf(stderr, "VtBench: failed with 0x%08lx\n", static_cast<unsigned long>(wil::ResultFromCaughtException()));
+    return 1;
+}
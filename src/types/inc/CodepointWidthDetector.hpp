@@ -47,6 +47,15 @@ struct GraphemeState
     int _last = 0;
 };
 
+// A single grapheme cluster as returned by CodepointWidthDetector::GraphemeSegment().
+struct GraphemeCluster
+{
+    // The length of the cluster in UTF-16 code units.
+    int len;
+    // The width of the cluster. Just like GraphemeState::width it's between 0 and 2.
+    int width;
+};
+
 struct CodepointWidthDetector
 {
     static CodepointWidthDetector& Singleton() noexcept;
@@ -54,6 +63,10 @@ struct CodepointWidthDetector
     // Returns false if the end of the string has been reached.
     bool GraphemeNext(GraphemeState& s, const std::wstring_view& str) noexcept;
     bool GraphemePrev(GraphemeState& s, const std::wstring_view& str) noexcept;
+    // Splits the string into consecutive grapheme clusters in a single pass and returns how many were written into
+    // `clusters`. Unlike GraphemeNext() it doesn't carry state between calls: The string is treated as complete,
+    // and if `clusters` is too small, you may simply continue with the remainder of the string.
+    size_t GraphemeSegment(const std::wstring_view& str, std::span<GraphemeCluster> clusters) noexcept;
 
     TextMeasurementMode GetMode() const noexcept;
     void SetFallbackMethod(std::function<bool(const std::wstring_view&)> pfnFallback) noexcept;
@@ -62,6 +75,7 @@ struct CodepointWidthDetector
 private:
     bool _graphemeNext(GraphemeState& s, const std::wstring_view& str) const noexcept;
     bool _graphemePrev(GraphemeState& s, const std::wstring_view& str) const noexcept;
+    size_t _graphemeSegment(const std::wstring_view& str, std::span<GraphemeCluster> clusters) const noexcept;
     bool _graphemeNextWcswidth(GraphemeState& s, const std::wstring_view& str) const noexcept;
     bool _graphemePrevWcswidth(GraphemeState& s, const std::wstring_view& str) const noexcept;
     bool _graphemeNextConsole(GraphemeState& s, const std::wstring_view& str) noexcept;
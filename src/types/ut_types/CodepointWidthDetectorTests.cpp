@@ -1285,6 +1285,61 @@ class CodepointWidthDetectorTests
         }
     }
 
+    // GraphemeSegment() must produce exactly the same clusters as a series of GraphemeNext() calls.
+    // The tests are concatenated with some ASCII in between to exercise the transitions in and out of its fast-path.
+    TEST_METHOD(GraphemeSegment)
+    {
+        auto& cwd = CodepointWidthDetector::Singleton();
+        std::wstring text;
+
+        for (const auto& test : s_graphemeBreakTests)
+        {
+            for (const auto g : test.graphemes)
+            {
+                if (!g)
+                {
+                    break;
+                }
+                text.append(g);
+            }
+            text.append(L"ab\u3042");
+        }
+
+        std::vector<std::pair<int, int>> expected;
+        for (GraphemeState state;;)
+        {
+            const auto ok = cwd.GraphemeNext(state, text);
+            expected.emplace_back(state.len, state.width);
+            if (!ok)
+            {
+                break;
+            }
+        }
+
+        // A capacity of 1 and 3 forces the segmentation to resume in the middle of the text.
+        for (const size_t capacity : { 1, 3, 64 })
+        {
+            std::vector<GraphemeCluster> clusters(capacity);
+            std::vector<std::pair<int, int>> actual;
+            std::wstring_view remaining{ text };
+
+            while (!remaining.empty())
+            {
+                const auto count = cwd.GraphemeSegment(remaining, clusters);
+                VERIFY_IS_GREATER_THAN(count, 0u);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    actual.emplace_back(clusters[i].len, clusters[i].width);
+                    remaining = remaining.substr(clusters[i].len);
+                }
+            }
+
+            VERIFY_ARE_EQUAL(expected.size(), actual.size());
+            VERIFY_IS_TRUE(expected == actual);
+        }
+    }
+
     TEST_METHOD(BasicGraphemes)
     {
         static constexpr std::wstring_view text{ L"a\u0363e\u0364\u0364i\u0365" };
@@ -35,6 +35,8 @@ class UtilsTests
 
     TEST_METHOD(TestEvaluateStartingDirectory);
 
+    TEST_METHOD(TestFindNonParameterCharacter);
+
     void _VerifyXTermColorResult(const std::wstring_view wstr, DWORD colorValue);
     void _VerifyXTermColorInvalid(const std::wstring_view wstr);
 };
@@ -618,3 +620,29 @@ void UtilsTests::TestEvaluateStartingDirectory()
         test(L"/dev", cwd, L"/dev");
     }
 }
+
+// FindNonParameterCharacter() processes the input in vectorized chunks of 8 chars.
+// This tests every chunk boundary with each kind of character that ends the parameters.
+void UtilsTests::TestFindNonParameterCharacter()
+{
+    for (size_t length = 0; length <= 24; ++length)
+    {
+        std::wstring text;
+        for (size_t i = 0; i < length; ++i)
+        {
+            text.push_back(i % 3 == 2 ? L';' : static_cast<wchar_t>(L'0' + i % 10));
+        }
+
+        VERIFY_ARE_EQUAL(text.data() + length, FindNonParameterCharacter(text.data(), text.size()));
+
+        for (const auto wch : { L'/', L':', L'<', L'_', L'\x1b', L'\x2030' })
+        {
+            for (size_t position = 0; position < length; ++position)
+            {
+                auto copy = text;
+                copy[position] = wch;
+                VERIFY_ARE_EQUAL(copy.data() + position, FindNonParameterCharacter(copy.data(), copy.size()));
+            }
+        }
+    }
+}
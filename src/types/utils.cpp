@@ -11,6 +11,8 @@
 
 using namespace Microsoft::Console;
 
+extern "C" int __isa_available;
+
 // Routine Description:
 // - Determines if a character is a valid number character, 0-9.
 // Arguments:
@@ -1153,6 +1155,175 @@ plainSearch:
     return it;
 }
 
+// Returns true for C0 characters, DEL and the lead byte of UTF-8 encoded C1 characters.
+// 0xC2 is also the lead byte of U+00A0-U+00BF, so the caller needs to check the trail byte.
+constexpr bool isActionableFromGround(const char ch) noexcept
+{
+    const auto b = static_cast<uint8_t>(ch);
+    return (b <= 0x1f) | (b == 0x7f) | (b == 0xc2);
+}
+
+// The UTF-8 counterpart to the above function. It's used by StateMachine::ProcessString(std::string_view)
+// to find the printable runs of text without having to transcode the input to UTF-16 first.
+const char* Utils::FindActionableControlCharacter(const char* beg, const size_t len) noexcept
+{
+    auto it = beg;
+
+    // The following vectorized code replicates isActionableFromGround which is equivalent to:
+    //   (b <= 0x1f) || (b == 0x7f) || (b == 0xc2)
+#if defined(TIL_SSE_INTRINSICS)
+
+    if (__isa_available >= __ISA_AVAILABLE_AVX2)
+    {
+        const auto c0 = _mm256_set1_epi8(0x1f);
+        const auto del = _mm256_set1_epi8(0x7f);
+        const auto c1 = _mm256_set1_epi8(static_cast<char>(0xc2));
+        const auto z = _mm256_setzero_si256();
+
+        for (const auto end = beg + (len & ~size_t{ 31 }); it < end; it += 32)
+        {
+            const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+            // See the SSE2 variant below for an explanation of the "SubS" trick.
+            const auto x = _mm256_cmpeq_epi8(_mm256_subs_epu8(b, c0), z);
+            const auto y = _mm256_or_si256(_mm256_cmpeq_epi8(b, del), _mm256_cmpeq_epi8(b, c1));
+            const auto mask = static_cast<unsigned long>(_mm256_movemask_epi8(_mm256_or_si256(x, y)));
+
+            if (mask)
+            {
+                unsigned long offset;
+                _BitScanForward(&offset, mask);
+                return it + offset;
+            }
+        }
+    }
+
+    {
+        const auto c0 = _mm_set1_epi8(0x1f);
+        const auto del = _mm_set1_epi8(0x7f);
+        const auto c1 = _mm_set1_epi8(static_cast<char>(0xc2));
+        const auto z = _mm_setzero_si128();
+
+        for (const auto end = beg + (len & ~size_t{ 15 }); it < end; it += 16)
+        {
+            const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+            // "max(0, b - 0x1f) == 0" is equivalent to "b <= 0x1f" for unsigned bytes.
+            const auto x = _mm_cmpeq_epi8(_mm_subs_epu8(b, c0), z);
+            const auto y = _mm_or_si128(_mm_cmpeq_epi8(b, del), _mm_cmpeq_epi8(b, c1));
+            const auto mask = static_cast<unsigned long>(_mm_movemask_epi8(_mm_or_si128(x, y)));
+
+            if (mask)
+            {
+                unsigned long offset;
+                _BitScanForward(&offset, mask);
+                return it + offset;
+            }
+        }
+    }
+
+#elif defined(TIL_ARM_NEON_INTRINSICS)
+
+    for (const auto end = beg + (len & ~size_t{ 15 }); it < end; it += 16)
+    {
+        const auto b = vld1q_u8(reinterpret_cast<const uint8_t*>(it));
+        const auto x = vcleq_u8(b, vdupq_n_u8(0x1f));
+        const auto y = vorrq_u8(vceqq_u8(b, vdupq_n_u8(0x7f)), vceqq_u8(b, vdupq_n_u8(0xc2)));
+        const auto c = vreinterpretq_u64_u8(vorrq_u8(x, y));
+
+        auto mask = vgetq_lane_u64(c, 0);
+        auto base = it;
+        if (!mask)
+        {
+            mask = vgetq_lane_u64(c, 1);
+            base += 8;
+        }
+        if (mask)
+        {
+            unsigned long offset;
+            _BitScanForward64(&offset, mask);
+            return base + offset / 8;
+        }
+    }
+
+#endif
+
+#pragma loop(no_vector)
+    for (const auto end = beg + len; it < end && !isActionableFromGround(*it); ++it)
+    {
+    }
+
+    return it;
+}
+
+// Returns true for the characters that make up the parameters of a CSI sequence, excluding sub-parameters.
+constexpr bool isParameterCharacter(const wchar_t wch) noexcept
+{
+    return (static_cast<wchar_t>(wch - L'0') <= 9) | (wch == L';');
+}
+
+// Returns a pointer to the first character that isn't a digit or a ';'. The input engine uses this to find the end of
+// the parameters of win32-input-mode and SGR mouse sequences, which often arrive in bursts of hundreds of sequences.
+const wchar_t* Utils::FindNonParameterCharacter(const wchar_t* beg, const size_t len) noexcept
+{
+    auto it = beg;
+
+#if defined(TIL_SSE_INTRINSICS)
+
+    const auto zero = _mm_set1_epi16(static_cast<short>(0x10000 - L'0'));
+    const auto nine = _mm_set1_epi16(9);
+    const auto semicolon = _mm_set1_epi16(L';');
+    const auto z = _mm_setzero_si128();
+
+    for (const auto end = beg + (len & ~size_t{ 7 }); it < end; it += 8)
+    {
+        const auto wch = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+        // Characters below '0' wrap around to large numbers when we subtract '0', which leaves
+        // only digits to be <= 9. See FindActionableControlCharacter for the "SubS" trick.
+        const auto a = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_add_epi16(wch, zero), nine), z);
+        const auto b = _mm_cmpeq_epi16(wch, semicolon);
+        const auto mask = static_cast<unsigned long>(_mm_movemask_epi8(_mm_or_si128(a, b)) ^ 0xffff);
+
+        if (mask)
+        {
+            unsigned long offset;
+            _BitScanForward(&offset, mask);
+            return it + offset / 2;
+        }
+    }
+
+#elif defined(TIL_ARM_NEON_INTRINSICS)
+
+    for (const auto end = beg + (len & ~size_t{ 7 }); it < end; it += 8)
+    {
+        const auto wch = vld1q_u16(it);
+        const auto a = vcleq_u16(vsubq_u16(wch, vdupq_n_u16(L'0')), vdupq_n_u16(9));
+        const auto b = vceqq_u16(wch, vdupq_n_u16(L';'));
+        const auto c = vreinterpretq_u64_u16(vmvnq_u16(vorrq_u16(a, b)));
+
+        auto mask = vgetq_lane_u64(c, 0);
+        auto base = it;
+        if (!mask)
+        {
+            mask = vgetq_lane_u64(c, 1);
+            base += 4;
+        }
+        if (mask)
+        {
+            unsigned long offset;
+            _BitScanForward64(&offset, mask);
+            return base + offset / 16;
+        }
+    }
+
+#endif
+
+#pragma loop(no_vector)
+    for (const auto end = beg + len; it < end && isParameterCharacter(*it); ++it)
+    {
+    }
+
+    return it;
+}
+
 #pragma warning(pop)
 
 std::wstring Utils::EvaluateStartingDirectory(